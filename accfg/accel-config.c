@@ -33,8 +33,13 @@ static struct cmd_struct commands[] = {
 	{"config-device", cmd_config_device},
 	{"config-group", cmd_config_group},
 	{"config-wq", cmd_config_wq},
+	{"reconfigure-wq", cmd_reconfigure_wq},
 	{"config-engine", cmd_config_engine},
 	{"config-user-default", cmd_config_default},
+	{"autotune", cmd_autotune},
+	{"monitor", cmd_monitor},
+	{"metrics", cmd_metrics},
+	{"perf", cmd_perf},
 #ifdef ENABLE_TEST
 	{"test", cmd_test},
 #endif
@@ -0,0 +1,1000 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright(c) 2019 Intel Corporation. All rights reserved.
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <json-c/json.h>
+#include <linux/limits.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <util/util.h>
+#include <util/parse-options.h>
+#include <util/portal.h>
+#include <accfg/libaccel_config.h>
+#include <accfg/idxd.h>
+#include <accfg.h>
+
+#define TUNE_PORTAL_SIZE	0x1000
+#define TUNE_BUF_SIZE		(1UL << 21)
+#define TUNE_MAX_WINDOW		32
+#define TUNE_MAX_BATCH		128
+#define TUNE_MAX_VALS		6
+#define TUNE_DURATION_MS	200
+#define TUNE_PASSES		2
+#define TUNE_DRAIN_NS		1000000000ULL
+#define TUNE_NAME		"autotune"
+
+/* transfer sizes of the benchmark mix, 0 is a batch of 4K copies */
+static const unsigned int tune_mix[] = { 4096, 65536, 1 << 20, 0 };
+
+enum tune_dim_id {
+	TUNE_GROUPS,
+	TUNE_WQS,
+	TUNE_MODE,
+	TUNE_SIZE,
+	TUNE_THRESHOLD,
+	TUNE_XFER,
+	TUNE_BATCH,
+	TUNE_RDBUF,
+	TUNE_DPL,
+	TUNE_BPL,
+	TUNE_DIMS,
+};
+
+struct tune_dim {
+	const char *name;
+	int num;
+	int val[TUNE_MAX_VALS];
+};
+
+static struct tune_dim tune_dims[TUNE_DIMS] = {
+	[TUNE_GROUPS] = { .name = "groups" },
+	[TUNE_WQS] = { .name = "wqs/group" },
+	[TUNE_MODE] = { .name = "mode" },
+	[TUNE_SIZE] = { .name = "size%" },
+	[TUNE_THRESHOLD] = { .name = "threshold%" },
+	[TUNE_XFER] = { .name = "xfer" },
+	[TUNE_BATCH] = { .name = "batch" },
+	[TUNE_RDBUF] = { .name = "rdbuf%" },
+	[TUNE_DPL] = { .name = "dpl" },
+	[TUNE_BPL] = { .name = "bpl" },
+};
+
+struct tune_worker {
+	pthread_t thread;
+	bool started;
+	struct accfg_wq *wq;
+	bool dedicated;
+	unsigned int window;
+	unsigned int size;
+	unsigned int xfer;
+	unsigned int batch;
+	uint64_t duration_ns;
+	uint64_t bytes;
+	uint64_t ns;
+	int rc;
+};
+
+/* Attributes tune_apply() changes, restored if tuning fails */
+struct tune_saved_wq {
+	enum accfg_wq_mode mode;
+	enum accfg_wq_type type;
+	int size;
+	int threshold;
+	int group_id;
+	int priority;
+	unsigned int batch;
+	uint64_t xfer;
+	char *name;
+	char *driver_name;
+	bool enabled;
+};
+
+struct tune_saved_group {
+	int use_rdbuf;
+	int dpl;
+	int bpl;
+};
+
+struct tune_saved {
+	bool enabled;
+	unsigned int rdbuf_limit;
+	struct tune_saved_wq *wqs;
+	struct tune_saved_group *groups;
+	int *engines;
+};
+
+static const char * const tune_wq_type_str[] = {
+	[ACCFG_WQT_NONE] = "none",
+	[ACCFG_WQT_KERNEL] = "kernel",
+	[ACCFG_WQT_USER] = "user",
+};
+
+static uint64_t tune_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void tune_add_val(struct tune_dim *dim, int val)
+{
+	int i;
+
+	for (i = 0; i < dim->num; i++)
+		if (dim->val[i] == val)
+			return;
+	if (dim->num < TUNE_MAX_VALS)
+		dim->val[dim->num++] = val;
+}
+
+/* Builds the candidate values of each dimension from the device limits */
+static void tune_init_dims(struct accfg_device *dev)
+{
+	unsigned int max_groups = accfg_device_get_max_groups(dev);
+	unsigned int max_engines = accfg_device_get_max_engines(dev);
+	unsigned int max_batch = accfg_device_get_max_batch_size(dev);
+	uint64_t max_xfer = accfg_device_get_max_transfer_size(dev);
+	struct accfg_group *group = accfg_group_get_first(dev);
+	static const int pcts[] = { 25, 50, 75, 100 };
+	unsigned int i;
+	int shift;
+
+	if (max_engines < max_groups)
+		max_groups = max_engines;
+	for (i = 1; i <= max_groups && i <= 8; i <<= 1)
+		tune_add_val(&tune_dims[TUNE_GROUPS], i);
+
+	for (i = 1; i <= 4; i <<= 1)
+		tune_add_val(&tune_dims[TUNE_WQS], i);
+
+	tune_add_val(&tune_dims[TUNE_MODE], ACCFG_WQ_DEDICATED);
+	tune_add_val(&tune_dims[TUNE_MODE], ACCFG_WQ_SHARED);
+
+	for (i = 0; i < ARRAY_SIZE(pcts); i++) {
+		tune_add_val(&tune_dims[TUNE_SIZE], pcts[i]);
+		if (pcts[i] >= 50)
+			tune_add_val(&tune_dims[TUNE_THRESHOLD], pcts[i]);
+	}
+
+	for (shift = 16; shift <= 20; shift += 2)
+		if ((1ULL << shift) <= max_xfer)
+			tune_add_val(&tune_dims[TUNE_XFER], shift);
+	shift = 0;
+	while ((2ULL << shift) <= max_xfer && shift < 31)
+		shift++;
+	tune_add_val(&tune_dims[TUNE_XFER], shift);
+
+	for (i = 8; i <= TUNE_MAX_BATCH && i <= max_batch; i <<= 2)
+		tune_add_val(&tune_dims[TUNE_BATCH], i);
+	if (!tune_dims[TUNE_BATCH].num)
+		tune_add_val(&tune_dims[TUNE_BATCH], max_batch);
+
+	tune_add_val(&tune_dims[TUNE_RDBUF], 0);
+	if (accfg_device_get_max_read_buffers(dev)) {
+		tune_add_val(&tune_dims[TUNE_RDBUF], 50);
+		tune_add_val(&tune_dims[TUNE_RDBUF], 75);
+	}
+
+	/* progress limits are only present on DSA 2.0 and later */
+	if (group && accfg_group_get_desc_progress_limit(group) >= 0) {
+		for (i = 0; i < 4; i++) {
+			tune_add_val(&tune_dims[TUNE_DPL], i);
+			tune_add_val(&tune_dims[TUNE_BPL], i);
+		}
+	} else {
+		tune_add_val(&tune_dims[TUNE_DPL], -1);
+		tune_add_val(&tune_dims[TUNE_BPL], -1);
+	}
+}
+
+static int tune_wq_size(struct accfg_device *dev, const int *c)
+{
+	unsigned int max_size = accfg_device_get_max_work_queues_size(dev);
+
+	return max_size * c[TUNE_SIZE] / 100 / (c[TUNE_GROUPS] * c[TUNE_WQS]);
+}
+
+static int tune_wq_threshold(struct accfg_device *dev, const int *c)
+{
+	int threshold = tune_wq_size(dev, c) * c[TUNE_THRESHOLD] / 100;
+
+	return threshold ? threshold : 1;
+}
+
+static bool tune_valid(struct accfg_device *dev, const int *c)
+{
+	int num_wqs = c[TUNE_GROUPS] * c[TUNE_WQS];
+
+	if (num_wqs > (int)accfg_device_get_max_work_queues(dev))
+		return false;
+
+	return tune_wq_size(dev, c) > 0;
+}
+
+static void tune_print(FILE *f, const int *c, double score)
+{
+	fprintf(f, "groups %d wqs/group %d %s size %d%%", c[TUNE_GROUPS],
+		c[TUNE_WQS], c[TUNE_MODE] == ACCFG_WQ_SHARED ?
+		"shared" : "dedicated", c[TUNE_SIZE]);
+	if (c[TUNE_MODE] == ACCFG_WQ_SHARED)
+		fprintf(f, " threshold %d%%", c[TUNE_THRESHOLD]);
+	fprintf(f, " xfer %llu batch %d", 1ULL << c[TUNE_XFER], c[TUNE_BATCH]);
+	if (tune_dims[TUNE_RDBUF].num > 1)
+		fprintf(f, " rdbuf %d%%", c[TUNE_RDBUF]);
+	if (c[TUNE_DPL] >= 0)
+		fprintf(f, " dpl %d bpl %d", c[TUNE_DPL], c[TUNE_BPL]);
+	if (score < 0)
+		fprintf(f, ": failed\n");
+	else
+		fprintf(f, ": %.2f GB/s\n", score);
+}
+
+static int tune_apply(struct accfg_device *dev, const int *c)
+{
+	int num_groups = c[TUNE_GROUPS];
+	int num_wqs = num_groups * c[TUNE_WQS];
+	bool rdbuf = tune_dims[TUNE_RDBUF].num > 1;
+	struct accfg_engine *engine;
+	struct accfg_group *group;
+	struct accfg_wq *wq;
+	int rc, id;
+
+	if (accfg_device_is_active(dev)) {
+		rc = accfg_device_disable(dev, true);
+		if (rc)
+			return rc;
+	}
+
+	/* release every wq first so the new sizes fit the device total */
+	accfg_wq_foreach(dev, wq) {
+		rc = accfg_wq_set_size(wq, 0);
+		if (rc)
+			return rc;
+		rc = accfg_wq_set_group_id(wq, -1);
+		if (rc)
+			return rc;
+	}
+
+	accfg_group_foreach(dev, group) {
+		if (rdbuf) {
+			rc = accfg_group_set_use_read_buffer_limit(group, 0);
+			if (rc)
+				return rc;
+		}
+		if (c[TUNE_DPL] < 0)
+			continue;
+		rc = accfg_group_set_desc_progress_limit(group, c[TUNE_DPL]);
+		if (rc)
+			return rc;
+		rc = accfg_group_set_batch_progress_limit(group, c[TUNE_BPL]);
+		if (rc)
+			return rc;
+	}
+
+	if (rdbuf) {
+		rc = accfg_device_set_read_buffer_limit(dev,
+			accfg_device_get_max_read_buffers(dev) *
+			c[TUNE_RDBUF] / 100);
+		if (rc)
+			return rc;
+		accfg_group_foreach(dev, group) {
+			if (!c[TUNE_RDBUF] ||
+					accfg_group_get_id(group) >= num_groups)
+				continue;
+			rc = accfg_group_set_use_read_buffer_limit(group, 1);
+			if (rc)
+				return rc;
+		}
+	}
+
+	accfg_engine_foreach(dev, engine) {
+		id = accfg_engine_get_id(engine);
+		rc = accfg_engine_set_group_id(engine, id % num_groups);
+		if (rc)
+			return rc;
+	}
+
+	accfg_wq_foreach(dev, wq) {
+		id = accfg_wq_get_id(wq);
+		if (id >= num_wqs)
+			continue;
+
+		rc = accfg_wq_set_mode(wq, c[TUNE_MODE]);
+		if (rc)
+			return rc;
+		rc = accfg_wq_set_size(wq, tune_wq_size(dev, c));
+		if (rc)
+			return rc;
+		if (c[TUNE_MODE] == ACCFG_WQ_SHARED) {
+			rc = accfg_wq_set_threshold(wq,
+					tune_wq_threshold(dev, c));
+			if (rc)
+				return rc;
+		}
+		rc = accfg_wq_set_group_id(wq, id % num_groups);
+		if (rc)
+			return rc;
+		rc = accfg_wq_set_priority(wq, 10);
+		if (rc)
+			return rc;
+		rc = accfg_wq_set_max_transfer_size(wq, 1ULL << c[TUNE_XFER]);
+		if (rc)
+			return rc;
+		rc = accfg_wq_set_max_batch_size(wq, c[TUNE_BATCH]);
+		if (rc)
+			return rc;
+		rc = accfg_wq_set_str_type(wq, "user");
+		if (rc)
+			return rc;
+		rc = accfg_wq_set_str_name(wq, TUNE_NAME);
+		if (rc)
+			return rc;
+		rc = accfg_wq_set_str_driver_name(wq, "user");
+		if (rc)
+			return rc;
+	}
+
+	rc = accfg_device_enable(dev);
+	if (rc)
+		return rc;
+
+	accfg_wq_foreach(dev, wq) {
+		if (accfg_wq_get_id(wq) >= num_wqs)
+			continue;
+		rc = accfg_wq_enable(wq);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static void tune_prep_list(struct tune_worker *w, struct hw_desc *list,
+		char *src, char *dst)
+{
+	unsigned int i;
+
+	for (i = 0; i < w->batch; i++) {
+		memset(&list[i], 0, sizeof(list[i]));
+		list[i].opcode = DSA_OPCODE_MEMMOVE;
+		list[i].flags = IDXD_OP_FLAG_CC;
+		list[i].src_addr = (uint64_t)src + i * 4096;
+		list[i].dst_addr = (uint64_t)dst + i * 4096;
+		list[i].xfer_size = 4096;
+	}
+}
+
+static void tune_prep_desc(struct tune_worker *w, struct hw_desc *desc,
+		struct hw_desc *list, struct completion_record *comp,
+		char *src, char *dst, unsigned int len)
+{
+	memset(desc, 0, sizeof(*desc));
+	desc->flags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR;
+	desc->completion_addr = (uint64_t)comp;
+
+	if (w->size) {
+		desc->opcode = DSA_OPCODE_MEMMOVE;
+		desc->flags |= IDXD_OP_FLAG_CC;
+		desc->src_addr = (uint64_t)src;
+		desc->dst_addr = (uint64_t)dst;
+		desc->xfer_size = len;
+		return;
+	}
+
+	desc->opcode = DSA_OPCODE_BATCH;
+	desc->desc_list_addr = (uint64_t)list;
+	desc->desc_count = w->batch;
+}
+
+/*
+ * Keeps up to window descriptors in flight on one wq for duration_ns,
+ * moving size byte transfers in pieces of at most xfer bytes.
+ */
+static void *tune_worker_run(void *arg)
+{
+	struct tune_worker *w = arg;
+	struct completion_record *comp = NULL;
+	struct hw_desc *desc = NULL, *list = NULL;
+	char *src = NULL, *dst = NULL;
+	char path[PATH_MAX];
+	bool busy[TUNE_MAX_WINDOW] = { false };
+	unsigned int len[TUNE_MAX_WINDOW];
+	unsigned int i, off = 0, inflight = 0;
+	uint64_t start, now;
+	void *portal;
+	bool stop = false;
+	int fd;
+
+	w->rc = accfg_wq_get_user_dev_path(w->wq, path, sizeof(path));
+	if (w->rc)
+		return NULL;
+
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		w->rc = -errno;
+		return NULL;
+	}
+
+	portal = mmap(NULL, TUNE_PORTAL_SIZE, PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, 0);
+	if (portal == MAP_FAILED) {
+		w->rc = -errno;
+		close(fd);
+		return NULL;
+	}
+
+	desc = aligned_alloc(64, w->window * sizeof(*desc));
+	comp = aligned_alloc(64, w->window * sizeof(*comp));
+	list = aligned_alloc(64, w->window * TUNE_MAX_BATCH * sizeof(*list));
+	src = aligned_alloc(4096, TUNE_BUF_SIZE);
+	dst = aligned_alloc(4096, TUNE_BUF_SIZE);
+	if (!desc || !comp || !list || !src || !dst) {
+		w->rc = -ENOMEM;
+		goto out;
+	}
+
+	/* fault the buffers in so the device does not see page faults */
+	memset(src, 0xa5, TUNE_BUF_SIZE);
+	memset(dst, 0, TUNE_BUF_SIZE);
+	if (!w->size) {
+		for (i = 0; i < w->window; i++)
+			tune_prep_list(w, &list[i * TUNE_MAX_BATCH], src, dst);
+	}
+
+	start = tune_now_ns();
+	for (;;) {
+		for (i = 0; i < w->window; i++) {
+			if (busy[i]) {
+				if (comp[i].status == DSA_COMP_NONE)
+					continue;
+				if (comp[i].status != DSA_COMP_SUCCESS)
+					w->rc = -EIO;
+				else
+					w->bytes += len[i];
+				busy[i] = false;
+				inflight--;
+			}
+			if (stop || w->rc)
+				continue;
+
+			len[i] = w->batch * 4096;
+			if (w->size)
+				len[i] = w->size - off < w->xfer ?
+					w->size - off : w->xfer;
+			tune_prep_desc(w, &desc[i], &list[i * TUNE_MAX_BATCH],
+					&comp[i], src + off, dst + off, len[i]);
+			comp[i].status = DSA_COMP_NONE;
+			if (w->dedicated)
+				movdir64b(portal, &desc[i]);
+			else if (enqcmd(portal, &desc[i]))
+				continue;
+			busy[i] = true;
+			inflight++;
+			if (w->size)
+				off = (off + len[i]) % w->size;
+		}
+
+		now = tune_now_ns();
+		if (now - start >= w->duration_ns || w->rc) {
+			if (!stop)
+				w->ns = now - start;
+			stop = true;
+		}
+		if (stop && !inflight)
+			break;
+		if (now - start >= w->duration_ns + TUNE_DRAIN_NS) {
+			/* the device may still write these, so leak them */
+			w->rc = -ETIMEDOUT;
+			desc = NULL;
+			comp = NULL;
+			list = NULL;
+			src = NULL;
+			dst = NULL;
+			break;
+		}
+	}
+
+out:
+	free(desc);
+	free(comp);
+	free(list);
+	free(src);
+	free(dst);
+	munmap(portal, TUNE_PORTAL_SIZE);
+	close(fd);
+	return NULL;
+}
+
+/* Runs the benchmark mix over every enabled wq and returns the score */
+static double tune_bench(struct accfg_device *dev, const int *c,
+		unsigned int duration_ms, bool verbose)
+{
+	unsigned int max_wqs = accfg_device_get_max_work_queues(dev);
+	struct tune_worker *workers;
+	struct accfg_wq *wq;
+	double log_sum = 0;
+	unsigned int m, i, num = 0;
+	unsigned int window;
+	int rc = 0, err;
+
+	workers = calloc(max_wqs, sizeof(*workers));
+	if (!workers)
+		return -1;
+
+	window = c[TUNE_MODE] == ACCFG_WQ_SHARED ?
+		tune_wq_threshold(dev, c) : tune_wq_size(dev, c);
+	if (window > TUNE_MAX_WINDOW)
+		window = TUNE_MAX_WINDOW;
+
+	accfg_wq_foreach(dev, wq) {
+		if (accfg_wq_get_state(wq) != ACCFG_WQ_ENABLED ||
+				num == max_wqs)
+			continue;
+		workers[num].wq = wq;
+		workers[num].dedicated = c[TUNE_MODE] == ACCFG_WQ_DEDICATED;
+		workers[num].window = window;
+		workers[num].batch = c[TUNE_BATCH];
+		workers[num].duration_ns = duration_ms * 1000000ULL;
+		num++;
+	}
+
+	for (m = 0; m < ARRAY_SIZE(tune_mix) && num && !rc; m++) {
+		uint64_t bytes = 0, ns = 0;
+		unsigned int xfer = tune_mix[m];
+
+		/* transfers above the wq limit go out as several descriptors */
+		if (xfer > (1U << c[TUNE_XFER]))
+			xfer = 1U << c[TUNE_XFER];
+
+		for (i = 0; i < num; i++) {
+			workers[i].size = tune_mix[m];
+			workers[i].xfer = xfer;
+			workers[i].bytes = 0;
+			workers[i].ns = 0;
+			workers[i].rc = 0;
+			err = pthread_create(&workers[i].thread, NULL,
+					tune_worker_run, &workers[i]);
+			workers[i].started = !err;
+			if (err)
+				workers[i].rc = -err;
+		}
+
+		for (i = 0; i < num; i++) {
+			if (workers[i].started)
+				pthread_join(workers[i].thread, NULL);
+			if (workers[i].rc)
+				rc = workers[i].rc;
+			bytes += workers[i].bytes;
+			if (workers[i].ns > ns)
+				ns = workers[i].ns;
+		}
+
+		if (!rc && (!bytes || !ns))
+			rc = -EIO;
+		if (rc)
+			break;
+
+		if (verbose)
+			fprintf(stderr, "  %s %u: %.2f GB/s\n",
+				tune_mix[m] ? "memmove" : "batch",
+				tune_mix[m] ? tune_mix[m] :
+				(unsigned int)c[TUNE_BATCH],
+				(double)bytes / ns);
+		log_sum += log((double)bytes / ns);
+	}
+
+	free(workers);
+	if (!num || rc)
+		return -1;
+
+	return exp(log_sum / ARRAY_SIZE(tune_mix));
+}
+
+static double tune_eval(struct accfg_device *dev, const int *c,
+		unsigned int duration_ms, bool verbose)
+{
+	double score = -1;
+
+	if (tune_apply(dev, c) == 0)
+		score = tune_bench(dev, c, duration_ms, verbose);
+	tune_print(stderr, c, score);
+
+	return score;
+}
+
+static struct json_object *tune_to_json(struct accfg_device *dev)
+{
+	struct json_object *jdevices, *jdev, *jgroups, *jgroup, *jobj;
+	struct json_object *jwqs, *jengines;
+	struct accfg_engine *engine;
+	struct accfg_group *group;
+	struct accfg_wq *wq;
+	int id;
+
+	jdevices = json_object_new_array();
+	jdev = util_device_to_json(dev, UTIL_JSON_SAVE | UTIL_JSON_IDLE);
+	jgroups = json_object_new_array();
+	if (!jdevices || !jdev || !jgroups)
+		goto err;
+
+	json_object_array_add(jdevices, jdev);
+	json_object_object_add(jdev, "groups", jgroups);
+
+	accfg_group_foreach(dev, group) {
+		id = accfg_group_get_id(group);
+		jgroup = util_group_to_json(group, UTIL_JSON_SAVE);
+		jwqs = json_object_new_array();
+		jengines = json_object_new_array();
+		if (!jgroup || !jwqs || !jengines)
+			goto err;
+
+		json_object_array_add(jgroups, jgroup);
+		json_object_object_add(jgroup, "grouped_workqueues", jwqs);
+		json_object_object_add(jgroup, "grouped_engines", jengines);
+
+		accfg_wq_foreach(dev, wq) {
+			if (accfg_wq_get_group_id(wq) != id)
+				continue;
+			jobj = util_wq_to_json(wq, UTIL_JSON_SAVE);
+			if (!jobj)
+				goto err;
+			json_object_array_add(jwqs, jobj);
+		}
+
+		accfg_engine_foreach(dev, engine) {
+			if (accfg_engine_get_group_id(engine) != id)
+				continue;
+			jobj = util_engine_to_json(engine, UTIL_JSON_SAVE);
+			if (!jobj)
+				goto err;
+			json_object_array_add(jengines, jobj);
+		}
+	}
+
+	return jdevices;
+
+err:
+	json_object_put(jdevices);
+	return NULL;
+}
+
+static void tune_free_saved(struct accfg_device *dev,
+		struct tune_saved *saved)
+{
+	unsigned int i;
+
+	if (!saved)
+		return;
+
+	if (saved->wqs) {
+		for (i = 0; i < accfg_device_get_max_work_queues(dev); i++) {
+			free(saved->wqs[i].name);
+			free(saved->wqs[i].driver_name);
+		}
+	}
+	free(saved->wqs);
+	free(saved->groups);
+	free(saved->engines);
+	free(saved);
+}
+
+static struct tune_saved *tune_save(struct accfg_device *dev)
+{
+	struct tune_saved *saved;
+	struct tune_saved_group *g;
+	struct tune_saved_wq *w;
+	struct accfg_engine *engine;
+	struct accfg_group *group;
+	struct accfg_wq *wq;
+
+	saved = calloc(1, sizeof(*saved));
+	if (!saved)
+		return NULL;
+
+	saved->wqs = calloc(accfg_device_get_max_work_queues(dev),
+			sizeof(*saved->wqs));
+	saved->groups = calloc(accfg_device_get_max_groups(dev),
+			sizeof(*saved->groups));
+	saved->engines = calloc(accfg_device_get_max_engines(dev),
+			sizeof(*saved->engines));
+	if (!saved->wqs || !saved->groups || !saved->engines)
+		goto err;
+
+	saved->enabled = accfg_device_is_active(dev);
+	saved->rdbuf_limit = accfg_device_get_read_buffer_limit(dev);
+
+	accfg_group_foreach(dev, group) {
+		g = &saved->groups[accfg_group_get_id(group)];
+		g->use_rdbuf = accfg_group_get_use_read_buffer_limit(group);
+		g->dpl = accfg_group_get_desc_progress_limit(group);
+		g->bpl = accfg_group_get_batch_progress_limit(group);
+	}
+
+	accfg_engine_foreach(dev, engine)
+		saved->engines[accfg_engine_get_id(engine)] =
+			accfg_engine_get_group_id(engine);
+
+	accfg_wq_foreach(dev, wq) {
+		w = &saved->wqs[accfg_wq_get_id(wq)];
+		w->mode = accfg_wq_get_mode(wq);
+		w->type = accfg_wq_get_type(wq);
+		w->size = accfg_wq_get_size(wq);
+		w->threshold = accfg_wq_get_threshold(wq);
+		w->group_id = accfg_wq_get_group_id(wq);
+		w->priority = accfg_wq_get_priority(wq);
+		w->batch = accfg_wq_get_max_batch_size(wq);
+		w->xfer = accfg_wq_get_max_transfer_size(wq);
+		w->enabled = accfg_wq_get_state(wq) == ACCFG_WQ_ENABLED;
+		if (accfg_wq_get_type_name(wq)) {
+			w->name = strdup(accfg_wq_get_type_name(wq));
+			if (!w->name)
+				goto err;
+		}
+		if (accfg_wq_get_driver_name(wq)) {
+			w->driver_name = strdup(accfg_wq_get_driver_name(wq));
+			if (!w->driver_name)
+				goto err;
+		}
+	}
+
+	return saved;
+
+err:
+	tune_free_saved(dev, saved);
+	return NULL;
+}
+
+/* Puts back what tune_save() recorded, carrying on past failures */
+static int tune_restore(struct accfg_device *dev, struct tune_saved *saved)
+{
+	bool rdbuf = accfg_device_get_max_read_buffers(dev);
+	struct tune_saved_group *g;
+	struct tune_saved_wq *w;
+	struct accfg_engine *engine;
+	struct accfg_group *group;
+	struct accfg_wq *wq;
+	int rc = 0;
+
+#define TUNE_RESTORE(call) do {						\
+	int _rc = (call);						\
+	if (_rc && !rc)						\
+		rc = _rc;						\
+} while (0)
+
+	if (accfg_device_is_active(dev))
+		TUNE_RESTORE(accfg_device_disable(dev, true));
+
+	accfg_wq_foreach(dev, wq) {
+		TUNE_RESTORE(accfg_wq_set_size(wq, 0));
+		TUNE_RESTORE(accfg_wq_set_group_id(wq, -1));
+	}
+
+	accfg_group_foreach(dev, group) {
+		g = &saved->groups[accfg_group_get_id(group)];
+		if (rdbuf)
+			TUNE_RESTORE(accfg_group_set_use_read_buffer_limit(
+						group, g->use_rdbuf));
+		if (g->dpl < 0)
+			continue;
+		TUNE_RESTORE(accfg_group_set_desc_progress_limit(group,
+					g->dpl));
+		TUNE_RESTORE(accfg_group_set_batch_progress_limit(group,
+					g->bpl));
+	}
+
+	if (rdbuf)
+		TUNE_RESTORE(accfg_device_set_read_buffer_limit(dev,
+					saved->rdbuf_limit));
+
+	accfg_engine_foreach(dev, engine)
+		TUNE_RESTORE(accfg_engine_set_group_id(engine,
+				saved->engines[accfg_engine_get_id(engine)]));
+
+	accfg_wq_foreach(dev, wq) {
+		w = &saved->wqs[accfg_wq_get_id(wq)];
+		TUNE_RESTORE(accfg_wq_set_mode(wq, w->mode));
+		TUNE_RESTORE(accfg_wq_set_size(wq, w->size));
+		if (w->mode == ACCFG_WQ_SHARED && w->size)
+			TUNE_RESTORE(accfg_wq_set_threshold(wq, w->threshold));
+		TUNE_RESTORE(accfg_wq_set_group_id(wq, w->group_id));
+		TUNE_RESTORE(accfg_wq_set_priority(wq, w->priority));
+		TUNE_RESTORE(accfg_wq_set_max_transfer_size(wq, w->xfer));
+		TUNE_RESTORE(accfg_wq_set_max_batch_size(wq, w->batch));
+		TUNE_RESTORE(accfg_wq_set_str_type(wq,
+					tune_wq_type_str[w->type]));
+		if (w->name)
+			TUNE_RESTORE(accfg_wq_set_str_name(wq, w->name));
+		if (w->driver_name && *w->driver_name)
+			TUNE_RESTORE(accfg_wq_set_str_driver_name(wq,
+						w->driver_name));
+	}
+
+	if (saved->enabled) {
+		TUNE_RESTORE(accfg_device_enable(dev));
+		accfg_wq_foreach(dev, wq) {
+			if (saved->wqs[accfg_wq_get_id(wq)].enabled)
+				TUNE_RESTORE(accfg_wq_enable(wq));
+		}
+	}
+
+#undef TUNE_RESTORE
+
+	return rc;
+}
+
+static int tune_search(struct accfg_device *dev, unsigned int duration_ms,
+		unsigned int passes, bool verbose, const char *output)
+{
+	struct json_object *jdevices;
+	int cur[TUNE_DIMS], cand[TUNE_DIMS];
+	double best, score;
+	unsigned int pass;
+	bool improved = true;
+	FILE *f = stdout;
+	int d, i, rc;
+
+	tune_init_dims(dev);
+
+	/* baseline: one group, dedicated wq, device limits */
+	for (d = 0; d < TUNE_DIMS; d++)
+		cur[d] = tune_dims[d].val[0];
+	cur[TUNE_SIZE] = 100;
+	cur[TUNE_THRESHOLD] = 100;
+	cur[TUNE_XFER] = tune_dims[TUNE_XFER].val[tune_dims[TUNE_XFER].num - 1];
+	cur[TUNE_BATCH] = tune_dims[TUNE_BATCH].val[tune_dims[TUNE_BATCH].num - 1];
+
+	best = tune_eval(dev, cur, duration_ms, verbose);
+	if (best < 0) {
+		fprintf(stderr, "%s: baseline configuration failed\n",
+			accfg_device_get_devname(dev));
+		return -EIO;
+	}
+
+	/* coordinate descent: sweep one dimension at a time */
+	for (pass = 0; pass < passes && improved; pass++) {
+		improved = false;
+		for (d = 0; d < TUNE_DIMS; d++) {
+			if (d == TUNE_THRESHOLD &&
+					cur[TUNE_MODE] != ACCFG_WQ_SHARED)
+				continue;
+			if (d == TUNE_BPL && cur[TUNE_DPL] < 0)
+				continue;
+
+			memcpy(cand, cur, sizeof(cand));
+			for (i = 0; i < tune_dims[d].num; i++) {
+				if (tune_dims[d].val[i] == cur[d])
+					continue;
+				cand[d] = tune_dims[d].val[i];
+				if (!tune_valid(dev, cand))
+					continue;
+				score = tune_eval(dev, cand, duration_ms, verbose);
+				if (score > best) {
+					best = score;
+					memcpy(cur, cand, sizeof(cur));
+					improved = true;
+				}
+			}
+		}
+	}
+
+	/* leave the winner applied so the saved attributes match it */
+	rc = tune_apply(dev, cur);
+	if (rc) {
+		fprintf(stderr, "%s: failed to apply best configuration\n",
+			accfg_device_get_devname(dev));
+		return rc;
+	}
+
+	fprintf(stderr, "best: ");
+	tune_print(stderr, cur, best);
+
+	jdevices = tune_to_json(dev);
+	if (!jdevices)
+		return -ENOMEM;
+
+	if (output) {
+		f = fopen(output, "w");
+		if (!f) {
+			fprintf(stderr, "Failed to open %s for save: %s\n",
+				output, strerror(errno));
+			json_object_put(jdevices);
+			return -EIO;
+		}
+	}
+
+	util_display_json_array(f, jdevices, UTIL_JSON_SAVE);
+	if (output)
+		fclose(f);
+	json_object_put(jdevices);
+
+	return 0;
+}
+
+/* Searches for the best configuration, putting the old one back on error */
+static int tune_device(struct accfg_device *dev, unsigned int duration_ms,
+		unsigned int passes, bool verbose, const char *output)
+{
+	struct tune_saved *saved;
+	int rc;
+
+	saved = tune_save(dev);
+	if (!saved)
+		return -ENOMEM;
+
+	rc = tune_search(dev, duration_ms, passes, verbose, output);
+	if (rc && tune_restore(dev, saved))
+		fprintf(stderr, "%s: failed to restore the configuration\n",
+			accfg_device_get_devname(dev));
+
+	tune_free_saved(dev, saved);
+	return rc;
+}
+
+int cmd_autotune(int argc, const char **argv, void *ctx)
+{
+	unsigned int duration_ms = TUNE_DURATION_MS;
+	unsigned int passes = TUNE_PASSES;
+	const char *output = NULL;
+	struct accfg_device *dev;
+	bool verbose = false, force = false;
+
+	const struct option options[] = {
+		OPT_STRING('o', "output", &output, "output-file",
+			   "write the best config to a file"),
+		OPT_UINTEGER('t', "time", &duration_ms,
+			     "ms to run each benchmark of the mix (default 200)"),
+		OPT_UINTEGER('p', "passes", &passes,
+			     "maximum passes over the parameters (default 2)"),
+		OPT_BOOLEAN('f', "force", &force,
+			    "tune even if the device has clients"),
+		OPT_BOOLEAN('v', "verbose", &verbose,
+			    "show the result of each benchmark"),
+		OPT_END(),
+	};
+
+	const char *const u[] = {
+		"accel-config autotune <device name> [<options>]",
+		NULL
+	};
+
+	argc = parse_options(argc, argv, options, u, 0);
+
+	if (argc != 1) {
+		error("specify one device name to tune\n");
+		return -EINVAL;
+	}
+
+	if (parse_device_name(ctx, argv[0], &dev)) {
+		fprintf(stderr, "%s is not a valid device name\n", argv[0]);
+		return -EINVAL;
+	}
+
+	if (accfg_device_get_type(dev) != ACCFG_DEVICE_DSA) {
+		fprintf(stderr, "%s: only DSA devices can be tuned\n",
+			argv[0]);
+		return -EOPNOTSUPP;
+	}
+
+	if (!force && accfg_device_get_clients(dev) > 0) {
+		fprintf(stderr, "%s is in use, use --force to tune it\n",
+			argv[0]);
+		return -EBUSY;
+	}
+
+	if (!duration_ms || !passes) {
+		error("time and passes must be non-zero\n");
+		return -EINVAL;
+	}
+
+	return tune_device(dev, duration_ms, passes, verbose, output);
+}
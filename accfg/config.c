@@ -2,10 +2,12 @@
 /* Copyright(c) 2019 Intel Corporation. All rights reserved. */
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 #include <json-c/json.h>
 #include <libgen.h>
 #include <dirent.h>
@@ -15,6 +17,7 @@
 #include <util/util.h>
 #include <util/parse-options.h>
 #include <util/strbuf.h>
+#include <util/image.h>
 #include <accfg/libaccel_config.h>
 #include <sys/epoll.h>
 #include <sys/stat.h>
@@ -23,16 +26,56 @@
 static bool verbose;
 static bool enable;
 static bool forced;
+static bool diff;
+static bool dry_run;
 static struct util_filter_params util_param;
 static bool warn_once = true;
 
 static LIST_HEAD(activate_dev_list);
 static LIST_HEAD(activate_wq_list);
+static pthread_mutex_t activate_lock = PTHREAD_MUTEX_INITIALIZER;
 struct activate_dev {
 	void *dev;
 	struct list_node list;
 };
 
+/*
+ * Devices are configured and enabled by one worker each. Results are
+ * collected per worker and reported in config file or device order.
+ */
+struct config_worker {
+	pthread_t thread;
+	bool started;
+	struct accfg_ctx *ctx;
+	json_object *jobj;
+	char *img;
+	char *img_end;
+	struct accfg_device *dev;
+	const char *name;
+	const char *err_name;
+	struct strbuf log;
+	int rc;
+};
+
+/* Where config_err() collects the diagnostics of the running worker */
+static __thread struct strbuf *config_log;
+
+__attribute__((format(printf, 1, 2)))
+static void config_err(const char *fmt, ...)
+{
+	char msg[256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+
+	if (config_log)
+		strbuf_addstr(config_log, msg);
+	else
+		fputs(msg, stderr);
+}
+
 static struct config {
 	bool devices;
 	bool groups;
@@ -40,7 +83,9 @@ static struct config {
 	bool wqs;
 	const char *config_file;
 	const char *user_default_wq_name;
+	const char *format;
 	char *buf;
+	size_t len;
 } config;
 
 static uint64_t config_opts_to_flags(void)
@@ -184,16 +229,9 @@ static bool conf_def_dev_configured(struct accfg_device *dev)
 }
 
 /* Set WQ parameters based on device cap: size and threshold. */
-static int config_default_wq_set_on_dev(struct accfg_device *dev)
+static int config_default_wq_set_on_dev(struct accfg_device *dev,
+		struct wq_parameters *p)
 {
-	enum accfg_device_type dev_type;
-	struct wq_parameters *p;
-
-	dev_type = accfg_device_get_type(dev);
-	p = get_conf_def_wq_param(dev_type);
-	if (!p)
-		return -EINVAL;
-
 	p->wq_size = get_wq_size(dev);
 	if (p->wq_size <= 0)
 		return -ENOSPC;
@@ -613,46 +651,116 @@ static int add_to_activation_list(struct list_head *activate_list, void *dev)
 
 	act_dev = calloc(1, sizeof(struct activate_dev));
 	if (!act_dev) {
-		fprintf(stderr, "Error allocating memory for activation list\n");
+		config_err("Error allocating memory for activation list\n");
 		return -ENOMEM;
 	}
 	act_dev->dev = dev;
+	pthread_mutex_lock(&activate_lock);
 	list_add(activate_list, &act_dev->list);
+	pthread_mutex_unlock(&activate_lock);
 
 	return 0;
 }
 
 /*
- * Enable devices in activation list
+ * Run fn on every worker in its own thread, falling back to the calling
+ * thread if one cannot be created.
  */
-static int activate_devices(void)
+static void config_workers_run(struct config_worker *workers, int num,
+		void *(*fn)(void *))
 {
-	struct activate_dev *iter, *next;
-	int rc;
+	int i;
 
-	list_for_each_safe(&activate_dev_list, iter, next, list) {
-		printf("Enabling device %s\n",
-				accfg_device_get_devname(iter->dev));
-		rc = accfg_device_enable(iter->dev);
-		if (rc) {
-			fprintf(stderr, "Error enabling device\n");
-			return rc;
-		}
+	for (i = 0; i < num; i++) {
+		workers[i].started = !pthread_create(&workers[i].thread, NULL,
+				fn, &workers[i]);
+		if (!workers[i].started)
+			fn(&workers[i]);
+	}
 
-		free(iter);
+	for (i = 0; i < num; i++) {
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
 	}
+}
+
+/* Enable one device and then the wqs on it that were configured */
+static void *activate_device_worker(void *arg)
+{
+	struct config_worker *w = arg;
+	struct activate_dev *iter;
+	int rc;
+
+	printf("Enabling device %s\n", w->name);
+	rc = accfg_device_enable(w->dev);
+	if (rc) {
+		w->err_name = w->name;
+		w->rc = rc;
+		return NULL;
+	}
+
+	list_for_each(&activate_wq_list, iter, list) {
+		if (accfg_wq_get_device(iter->dev) != w->dev)
+			continue;
 
-	list_for_each_safe(&activate_wq_list, iter, next, list) {
 		printf("Enabling wq %s\n", accfg_wq_get_devname(iter->dev));
 		rc = accfg_wq_enable(iter->dev);
 		if (rc) {
-			fprintf(stderr, "Error enabling wq\n");
-			return rc;
+			w->err_name = accfg_wq_get_devname(iter->dev);
+			w->rc = rc;
+			return NULL;
 		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Enable devices in activation list
+ */
+static int activate_devices(void)
+{
+	struct activate_dev *iter, *next;
+	struct config_worker *workers;
+	int i, num = 0, rc = 0;
+
+	list_for_each(&activate_dev_list, iter, list)
+		num++;
+
+	workers = calloc(num, sizeof(*workers));
+	if (num && !workers) {
+		fprintf(stderr, "Error allocating memory for activation workers\n");
+		return -ENOMEM;
+	}
+
+	i = 0;
+	list_for_each(&activate_dev_list, iter, list) {
+		workers[i].dev = iter->dev;
+		workers[i].name = accfg_device_get_devname(iter->dev);
+		i++;
+	}
+
+	config_workers_run(workers, num, activate_device_worker);
+
+	for (i = 0; i < num; i++) {
+		if (!workers[i].rc)
+			continue;
+		fprintf(stderr, "Error enabling %s\n", workers[i].err_name);
+		if (!rc)
+			rc = workers[i].rc;
+	}
+	free(workers);
+
+	list_for_each_safe(&activate_dev_list, iter, next, list) {
+		list_del_from(&activate_dev_list, &iter->list);
+		free(iter);
+	}
+	list_for_each_safe(&activate_wq_list, iter, next, list) {
+		list_del_from(&activate_wq_list, &iter->list);
 		free(iter);
 	}
 
-	return 0;
+	return rc;
 }
 
 static void config_default_json(struct accfg_wq *wq,
@@ -698,10 +806,11 @@ static int configure_json_value(struct accfg_ctx *ctx,
 	char *parsed_string;
 	char dev_type[MAX_DEV_LEN];
 	char *accel_type = NULL;
-	static struct accfg_device *dev, *parent;
-	static struct accfg_wq *wq;
-	static struct accfg_engine *engine;
-	static struct accfg_group *group;
+	/* Parse state is per thread, each device is walked by its own worker */
+	static __thread struct accfg_device *dev, *parent;
+	static __thread struct accfg_wq *wq;
+	static __thread struct accfg_engine *engine;
+	static __thread struct accfg_group *group;
 	enum accfg_device_state dev_state = ACCFG_DEVICE_DISABLED;
 	enum accfg_wq_state wq_state = ACCFG_WQ_DISABLED;
 
@@ -733,23 +842,23 @@ static int configure_json_value(struct accfg_ctx *ctx,
 				dev = accfg_ctx_device_get_by_name(ctx,
 						parsed_string);
 				if (!dev) {
-					fprintf(stderr, "device is not available\n");
+					config_err("device is not available\n");
 					return -ENOENT;
 				}
 				dev_state = accfg_device_get_state(dev);
 				if (dev_state == ACCFG_DEVICE_ENABLED) {
-					fprintf(stderr, "%s is active. ",
+					config_err("%s is active. ",
 							parsed_string);
 					if (forced) {
-						fprintf(stderr, "Disabling...\n");
+						config_err("Disabling...\n");
 						rc = accfg_device_disable(dev, true);
 						if (rc) {
-							fprintf(stderr,
+							config_err(
 								"Failed disabling device\n");
 							return rc;
 						}
 					} else {
-						fprintf(stderr, "Skipping...\n");
+						config_err("Skipping...\n");
 						dev = NULL;
 						return 0;
 					}
@@ -783,7 +892,7 @@ static int configure_json_value(struct accfg_ctx *ctx,
 				return -ENOENT;
 			wq_state = accfg_wq_get_state(wq);
 			if (wq_state == ACCFG_WQ_ENABLED || wq_state == ACCFG_WQ_LOCKED) {
-				fprintf(stderr, "%s is active, will skip...\n", parsed_string);
+				config_err("%s is active, will skip...\n", parsed_string);
 				wq = NULL;
 				return 0;
 			}
@@ -826,7 +935,7 @@ static int configure_json_value(struct accfg_ctx *ctx,
 		return 0;
 
 	if (warn_once && strstr(key, "token")) {
-		fprintf(stderr, "Warning: \"token\" attributes are deprecated\n");
+		config_err("Warning: \"token\" attributes are deprecated\n");
 		warn_once = false;
 	}
 
@@ -839,14 +948,14 @@ static int configure_json_value(struct accfg_ctx *ctx,
 	if (dev && dev_state != ACCFG_DEVICE_ENABLED) {
 		rc = device_json_set_val(dev, jobj, key);
 		if (rc < 0) {
-			fprintf(stderr, "device set %s value failed\n",
+			config_err("device set %s value failed\n",
 					key);
 			return rc;
 		}
 	} else if (group) {
 		rc = group_json_set_val(group, jobj, key);
 		if (rc < 0) {
-			fprintf(stderr, "group set %s value failed\n",
+			config_err("group set %s value failed\n",
 					key);
 			return rc;
 		}
@@ -854,91 +963,474 @@ static int configure_json_value(struct accfg_ctx *ctx,
 			wq_state != ACCFG_WQ_LOCKED) {
 		rc = wq_json_set_val(wq, jobj, key);
 		if (rc < 0) {
-			fprintf(stderr, "wq set %s value failed\n",
+			config_err("wq set %s value failed\n",
 					key);
 			return rc;
 		}
 	} else if (engine) {
 		rc = engine_json_set_val(engine, jobj, key);
 		if (rc < 0) {
-			fprintf(stderr, "engine set %s value failed\n",
+			config_err("engine set %s value failed\n",
 					key);
 			return rc;
 		}
 	} else {
-		fprintf(stderr, "device type not matched\n");
+		config_err("device type not matched\n");
 		return -EINVAL;
 	}
 
 	return 0;
 }
 
-static struct json_object *config_group_to_json(struct accfg_group *group,
-						uint64_t flags)
+static const char *config_json_dev_name(json_object *jobj)
 {
-	struct json_object *jgroup = json_object_new_object();
-	struct json_object *jobj = NULL;
-	int dpl, gpl;
+	json_object *jdev;
 
-	if (!jgroup)
+	if (json_object_get_type(jobj) != json_type_object)
+		return NULL;
+	if (!json_object_object_get_ex(jobj, "dev", &jdev))
 		return NULL;
 
-	jobj = json_object_new_string(accfg_group_get_devname(group));
-	if (!jobj)
-		goto err;
+	return json_object_get_string(jdev);
+}
 
-	json_object_object_add(jgroup, "dev", jobj);
-	jobj = json_object_new_int(accfg_group_get_read_buffers_reserved(group));
-	if (!jobj)
-		goto err;
+/*
+ * Incremental apply: compare each component in the config file with its
+ * live state and only write the attributes that differ.
+ */
+enum diff_type {
+	DIFF_DEVICE,
+	DIFF_GROUP,
+	DIFF_WQ,
+	DIFF_ENGINE,
+};
 
-	json_object_object_add(jgroup, "read_buffers_reserved", jobj);
-	jobj = json_object_new_int(accfg_group_get_use_read_buffer_limit(group));
-	if (!jobj)
-		goto err;
+struct diff_obj {
+	struct list_node list;
+	enum diff_type type;
+	void *obj;
+	const char *name;
+	json_object *jtarget;
+	json_object *jlive;
+	int num_diffs;
+};
 
-	json_object_object_add(jgroup, "use_read_buffer_limit", jobj);
-	jobj = json_object_new_int(accfg_group_get_read_buffers_allowed(group));
-	if (!jobj)
-		goto err;
+/* wq attributes the driver only accepts while the device is disabled */
+static bool diff_wq_key_needs_device(const char *key)
+{
+	return !strcmp(key, "size") || !strcmp(key, "group_id");
+}
 
-	json_object_object_add(jgroup, "read_buffers_allowed", jobj);
-	jobj = json_object_new_int(accfg_group_get_traffic_class_a(
-				group));
-	if (!jobj)
-		goto err;
+static bool diff_key_writable(struct diff_obj *d, const char *key,
+		json_object *jval)
+{
+	struct accfg_device *dev;
+	int val = json_object_get_int(jval);
+	int i;
 
-	json_object_object_add(jgroup, "traffic_class_a", jobj);
-	jobj = json_object_new_int(accfg_group_get_traffic_class_b(
-				group));
-	if (!jobj)
-		goto err;
+	switch (d->type) {
+	case DIFF_DEVICE:
+		return device_attribute_filter((char *)key);
+	case DIFF_ENGINE:
+		return engine_attribute_filter((char *)key);
+	case DIFF_WQ:
+		for (i = 0; i < (int)ARRAY_SIZE(wq_table); i++) {
+			if (strcmp(key, wq_table[i].name))
+				continue;
+			return !wq_table[i].is_writable ||
+				wq_table[i].is_writable(d->obj, val);
+		}
+		return false;
+	case DIFF_GROUP:
+		dev = accfg_group_get_device(d->obj);
+		if (accfg_device_get_type(dev) == ACCFG_DEVICE_IAX &&
+				(strstr(key, "token") || strstr(key, "read_buffer")))
+			return false;
+		for (i = 0; i < (int)ARRAY_SIZE(group_table); i++) {
+			if (strcmp(key, group_table[i].name))
+				continue;
+			return !group_table[i].is_writable ||
+				group_table[i].is_writable(d->obj, val);
+		}
+		return false;
+	}
+
+	return false;
+}
+
+static bool diff_json_equal(json_object *jtarget, json_object *jlive)
+{
+	if (!jlive)
+		return false;
+
+	if (json_object_get_type(jtarget) == json_type_string ||
+			json_object_get_type(jlive) == json_type_string)
+		return !strcmp(json_object_get_string(jtarget),
+				json_object_get_string(jlive));
+
+	return json_object_get_int64(jtarget) == json_object_get_int64(jlive);
+}
+
+static int diff_set_val(struct diff_obj *d, json_object *jval, char *key)
+{
+	switch (d->type) {
+	case DIFF_DEVICE:
+		return device_json_set_val(d->obj, jval, key);
+	case DIFF_GROUP:
+		return group_json_set_val(d->obj, jval, key);
+	case DIFF_WQ:
+		return wq_json_set_val(d->obj, jval, key);
+	case DIFF_ENGINE:
+		return engine_json_set_val(d->obj, jval, key);
+	}
+
+	return -EINVAL;
+}
+
+/*
+ * Walk the scalar attributes of one component. Returns the number of
+ * attributes that differ, or a negative error if applying one failed.
+ * needs_dev counts the differences that need the device disabled.
+ */
+static int diff_obj_keys(struct diff_obj *d, bool apply, int *needs_dev)
+{
+	json_object_iter iter;
+	json_object *jlive;
+	enum json_type type;
+	int rc, num = 0;
 
-	json_object_object_add(jgroup, "traffic_class_b", jobj);
+	json_object_object_foreachC(d->jtarget, iter) {
+		type = json_object_get_type(iter.val);
+		if (type == json_type_object || type == json_type_array ||
+				type == json_type_null)
+			continue;
+		if (!strcmp(iter.key, "dev"))
+			continue;
+		if (!diff_key_writable(d, iter.key, iter.val))
+			continue;
+
+		jlive = NULL;
+		json_object_object_get_ex(d->jlive, iter.key, &jlive);
+		if (diff_json_equal(iter.val, jlive))
+			continue;
 
-	dpl = accfg_group_get_desc_progress_limit(group);
-	if (dpl >= 0) {
-		jobj = json_object_new_int(dpl);
-		if (!jobj)
-			goto err;
+		num++;
+		if (needs_dev && (d->type != DIFF_WQ ||
+				diff_wq_key_needs_device(iter.key)))
+			(*needs_dev)++;
 
-		json_object_object_add(jgroup, "desc_progress_limit", jobj);
+		if (!apply) {
+			printf("%s: %s %s -> %s\n", d->name, iter.key,
+					jlive ? json_object_get_string(jlive) : "(none)",
+					json_object_get_string(iter.val));
+			continue;
+		}
+
+		rc = diff_set_val(d, iter.val, iter.key);
+		if (rc < 0) {
+			fprintf(stderr, "%s set %s value failed\n", d->name,
+					iter.key);
+			return rc;
+		}
 	}
 
-	gpl = accfg_group_get_batch_progress_limit(group);
-	if (gpl >= 0) {
-		jobj = json_object_new_int(gpl);
-		if (!jobj)
-			goto err;
+	return num;
+}
+
+static int diff_add_obj(struct accfg_device *dev, const char *name,
+		json_object *jobj, struct list_head *objs)
+{
+	struct diff_obj *d;
+	int dev_id, id;
 
-		json_object_object_add(jgroup, "batch_progress_limit", jobj);
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return -ENOMEM;
+	d->name = name;
+	d->jtarget = jobj;
+
+	if (!strcmp(name, accfg_device_get_devname(dev))) {
+		d->type = DIFF_DEVICE;
+		d->obj = dev;
+		d->jlive = util_device_to_json(dev, UTIL_JSON_SAVE | UTIL_JSON_IDLE);
+	} else if (sscanf(name, "wq%d.%d", &dev_id, &id) == 2) {
+		d->type = DIFF_WQ;
+		d->obj = accfg_device_wq_get_by_id(dev, id);
+		if (d->obj)
+			d->jlive = util_wq_to_json(d->obj,
+					UTIL_JSON_SAVE | UTIL_JSON_IDLE);
+	} else if (sscanf(name, "engine%d.%d", &dev_id, &id) == 2) {
+		d->type = DIFF_ENGINE;
+		d->obj = accfg_device_engine_get_by_id(dev, id);
+		if (d->obj)
+			d->jlive = util_engine_to_json(d->obj, 0);
+	} else if (sscanf(name, "group%d.%d", &dev_id, &id) == 2) {
+		d->type = DIFF_GROUP;
+		d->obj = accfg_device_group_get_by_id(dev, id);
+		if (d->obj)
+			d->jlive = util_group_to_json(d->obj, 0);
 	}
 
-	return jgroup;
+	if (!d->obj) {
+		fprintf(stderr, "%s is not available\n", name);
+		free(d);
+		return -ENOENT;
+	}
 
-err:
-	json_object_put(jgroup);
-	return NULL;
+	list_add_tail(objs, &d->list);
+
+	return 0;
+}
+
+static int diff_walk(struct accfg_device *dev, json_object *jobj,
+		struct list_head *objs)
+{
+	json_object_iter iter;
+	const char *name;
+	enum json_type type;
+	int i, num, rc;
+
+	type = json_object_get_type(jobj);
+	if (type == json_type_array) {
+		num = json_object_array_length(jobj);
+		for (i = 0; i < num; i++) {
+			rc = diff_walk(dev, json_object_array_get_idx(jobj, i),
+					objs);
+			if (rc)
+				return rc;
+		}
+		return 0;
+	}
+
+	if (type != json_type_object)
+		return 0;
+
+	name = config_json_dev_name(jobj);
+	if (name) {
+		rc = diff_add_obj(dev, name, jobj, objs);
+		if (rc)
+			return rc;
+	}
+
+	json_object_object_foreachC(jobj, iter) {
+		type = json_object_get_type(iter.val);
+		if (type != json_type_object && type != json_type_array)
+			continue;
+		rc = diff_walk(dev, iter.val, objs);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static void diff_free_objs(struct list_head *objs)
+{
+	struct diff_obj *d, *next;
+
+	list_for_each_safe(objs, d, next, list) {
+		list_del_from(objs, &d->list);
+		if (d->jlive)
+			json_object_put(d->jlive);
+		free(d);
+	}
+}
+
+static bool diff_wq_active(struct accfg_wq *wq)
+{
+	enum accfg_wq_state state = accfg_wq_get_state(wq);
+
+	return state == ACCFG_WQ_ENABLED || state == ACCFG_WQ_LOCKED;
+}
+
+static int diff_enable_wq(struct accfg_wq *wq)
+{
+	int rc;
+
+	printf("Enabling wq %s\n", accfg_wq_get_devname(wq));
+	rc = accfg_wq_enable(wq);
+	if (rc)
+		fprintf(stderr, "Error enabling %s\n", accfg_wq_get_devname(wq));
+
+	return rc;
+}
+
+/*
+ * Apply the differences for one device. A change that needs the device
+ * disabled takes the whole device down (only with -f) and brings back the
+ * wqs that were running. Otherwise only the changed wqs are cycled.
+ */
+static int diff_apply_device(struct accfg_device *dev, struct list_head *objs)
+{
+	const char *dev_name = accfg_device_get_devname(dev);
+	int max_wqs = accfg_device_get_max_work_queues(dev);
+	bool dev_enabled, *was_enabled;
+	int num = 0, needs_dev = 0;
+	struct diff_obj *d;
+	struct accfg_wq *wq;
+	int rc = 0, n;
+
+	list_for_each(objs, d, list) {
+		d->num_diffs = diff_obj_keys(d, false, &needs_dev);
+		num += d->num_diffs;
+	}
+
+	dev_enabled = accfg_device_get_state(dev) == ACCFG_DEVICE_ENABLED;
+	printf("%s: %d attribute(s) differ%s\n", dev_name, num,
+			needs_dev && dev_enabled ? ", device restart needed" : "");
+	if (dry_run)
+		return 0;
+
+	if (needs_dev && dev_enabled) {
+		if (!forced) {
+			fprintf(stderr, "%s is active, use -f to restart it\n",
+					dev_name);
+			return -EBUSY;
+		}
+
+		was_enabled = calloc(max_wqs, sizeof(bool));
+		if (!was_enabled)
+			return -ENOMEM;
+		accfg_wq_foreach(dev, wq) {
+			if (accfg_wq_get_id(wq) < max_wqs)
+				was_enabled[accfg_wq_get_id(wq)] = diff_wq_active(wq);
+		}
+
+		printf("Disabling device %s\n", dev_name);
+		rc = accfg_device_disable(dev, true);
+		if (rc) {
+			fprintf(stderr, "Failed disabling device\n");
+			free(was_enabled);
+			return rc;
+		}
+
+		list_for_each(objs, d, list) {
+			rc = diff_obj_keys(d, true, NULL);
+			if (rc < 0)
+				break;
+		}
+
+		if (rc >= 0) {
+			printf("Enabling device %s\n", dev_name);
+			rc = accfg_device_enable(dev);
+		}
+		if (!rc) {
+			accfg_wq_foreach(dev, wq) {
+				n = accfg_wq_get_id(wq);
+				if (n < max_wqs && was_enabled[n] && !rc)
+					rc = diff_enable_wq(wq);
+			}
+		}
+		free(was_enabled);
+		if (rc < 0)
+			return rc;
+	} else if (needs_dev) {
+		list_for_each(objs, d, list) {
+			rc = diff_obj_keys(d, true, NULL);
+			if (rc < 0)
+				return rc;
+		}
+	} else {
+		list_for_each(objs, d, list) {
+			bool active;
+
+			if (!d->num_diffs)
+				continue;
+
+			/* Only wq attributes differ, cycle just this wq */
+			active = diff_wq_active(d->obj);
+			if (active) {
+				printf("Disabling wq %s\n", d->name);
+				rc = accfg_wq_disable(d->obj, forced);
+				if (rc) {
+					fprintf(stderr, "Failed disabling %s\n",
+							d->name);
+					return rc;
+				}
+			}
+
+			rc = diff_obj_keys(d, true, NULL);
+			if (rc < 0)
+				return rc;
+
+			if (active) {
+				rc = diff_enable_wq(d->obj);
+				if (rc)
+					return rc;
+			}
+		}
+	}
+
+	if (!enable)
+		return 0;
+
+	if (accfg_device_get_state(dev) != ACCFG_DEVICE_ENABLED) {
+		printf("Enabling device %s\n", dev_name);
+		rc = accfg_device_enable(dev);
+		if (rc) {
+			fprintf(stderr, "Error enabling %s\n", dev_name);
+			return rc;
+		}
+	}
+
+	list_for_each(objs, d, list) {
+		if (d->type != DIFF_WQ || diff_wq_active(d->obj))
+			continue;
+		rc = diff_enable_wq(d->obj);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static int diff_config(struct accfg_ctx *ctx, struct config *conf)
+{
+	struct accfg_device *dev;
+	json_object *jobj, *jdev;
+	struct list_head objs;
+	const char *name;
+	int i, num, rc, ret = 0;
+
+	if (!conf->buf)
+		return -EINVAL;
+
+	jobj = json_tokener_parse(conf->buf);
+	if (!jobj)
+		return -ENOMEM;
+
+	if (json_object_get_type(jobj) != json_type_array) {
+		json_object_put(jobj);
+		return -EINVAL;
+	}
+
+	num = json_object_array_length(jobj);
+	for (i = 0; i < num; i++) {
+		jdev = json_object_array_get_idx(jobj, i);
+		name = config_json_dev_name(jdev);
+		if (!name)
+			continue;
+
+		dev = accfg_ctx_device_get_by_name(ctx, name);
+		if (!dev) {
+			fprintf(stderr, "%s is not available\n", name);
+			if (!ret)
+				ret = -ENOENT;
+			continue;
+		}
+
+		list_head_init(&objs);
+		rc = diff_walk(dev, jdev, &objs);
+		if (!rc)
+			rc = diff_apply_device(dev, &objs);
+		diff_free_objs(&objs);
+		if (rc && !ret)
+			ret = rc;
+	}
+
+	json_object_put(jobj);
+
+	return ret;
 }
 
 /* Parsing the json object */
@@ -1020,6 +1512,79 @@ static int json_parse_array(struct accfg_ctx *ctx, json_object *jobj,
 	return 0;
 }
 
+static void *config_device_worker(void *arg)
+{
+	struct config_worker *w = arg;
+
+	config_log = &w->log;
+	w->rc = json_parse(w->ctx, w->jobj);
+	config_log = NULL;
+
+	return NULL;
+}
+
+/* Print what each worker logged in file order, returns the first error */
+static int config_workers_report(struct config_worker *workers, int num)
+{
+	int i, rc = 0;
+
+	for (i = 0; i < num; i++) {
+		if (workers[i].log.len)
+			fputs(workers[i].log.buf, stderr);
+		strbuf_release(&workers[i].log);
+		if (!workers[i].rc)
+			continue;
+		fprintf(stderr, "Configuring %s failed\n", workers[i].name);
+		if (!rc)
+			rc = workers[i].rc;
+	}
+
+	return rc;
+}
+
+/*
+ * Apply each top level device entry in its own worker. Anything that is
+ * not one entry per device is parsed serially as before.
+ */
+static int json_parse_devices(struct accfg_ctx *ctx, json_object *jarray)
+{
+	struct config_worker *workers;
+	int i, j, num, rc = 0;
+
+	if (json_object_get_type(jarray) != json_type_array)
+		return json_parse_array(ctx, jarray, NULL);
+
+	num = json_object_array_length(jarray);
+	if (num < 2)
+		return json_parse_array(ctx, jarray, NULL);
+
+	workers = calloc(num, sizeof(*workers));
+	if (!workers)
+		return -ENOMEM;
+
+	for (i = 0; i < num; i++) {
+		workers[i].ctx = ctx;
+		workers[i].jobj = json_object_array_get_idx(jarray, i);
+		workers[i].name = config_json_dev_name(workers[i].jobj);
+		if (!workers[i].name)
+			goto serial;
+		for (j = 0; j < i; j++) {
+			if (!strcmp(workers[i].name, workers[j].name))
+				goto serial;
+		}
+	}
+
+	config_workers_run(workers, num, config_device_worker);
+	rc = config_workers_report(workers, num);
+	free(workers);
+
+	return rc;
+
+ serial:
+	free(workers);
+	return json_parse_array(ctx, jarray, NULL);
+}
+
 static int parse_config(struct accfg_ctx *ctx, struct config *conf)
 {
 	int rc;
@@ -1032,13 +1597,116 @@ static int parse_config(struct accfg_ctx *ctx, struct config *conf)
 	if (!jobj)
 		return -ENOMEM;
 
-	rc = json_parse_array(ctx, jobj, NULL);
+	/* config-default collects shared WQ parameters, keep it serial */
+	if (config_default_file)
+		rc = json_parse_array(ctx, jobj, NULL);
+	else
+		rc = json_parse_devices(ctx, jobj);
 	if (rc < 0)
 		return rc;
 
 	return 0;
 }
 
+/*
+ * Apply the records of a binary image up to the next device entry. The
+ * records are in the order json_parse() visits the JSON keys, so each value
+ * goes through configure_json_value() without tokenizing or building a tree.
+ */
+static int image_apply(struct accfg_ctx *ctx, char *pos, char *end)
+{
+	struct util_image_rec rec;
+	json_object *jval;
+	int rc;
+
+	while ((rc = util_image_next(&pos, end, &rec)) > 0) {
+		if (rec.type == UTIL_IMAGE_DEVICE)
+			continue;
+		if (rec.type == UTIL_IMAGE_INT)
+			jval = json_object_new_int64(rec.ival);
+		else
+			jval = json_object_new_string(rec.sval);
+		if (!jval)
+			return -ENOMEM;
+		rc = configure_json_value(ctx, jval, rec.key);
+		json_object_put(jval);
+		if (rc)
+			return rc;
+	}
+
+	return rc;
+}
+
+static void *config_image_worker(void *arg)
+{
+	struct config_worker *w = arg;
+
+	config_log = &w->log;
+	w->rc = image_apply(w->ctx, w->img, w->img_end);
+	config_log = NULL;
+
+	return NULL;
+}
+
+static int parse_config_image(struct accfg_ctx *ctx, struct config *conf)
+{
+	struct config_worker *workers;
+	struct util_image_rec rec;
+	char *recs, *end, *pos;
+	int i, j, num, rc = 0;
+
+	num = util_image_check(conf->buf, conf->len, &recs, &end);
+	if (num < 0) {
+		fprintf(stderr, "invalid config image: %s\n", strerror(-num));
+		return num;
+	}
+	if (num < 2)
+		return image_apply(ctx, recs, end);
+
+	workers = calloc(num, sizeof(*workers));
+	if (!workers)
+		return -ENOMEM;
+
+	/* split the records at each device entry */
+	i = -1;
+	pos = recs;
+	while (util_image_next(&pos, end, &rec) > 0) {
+		if (rec.type == UTIL_IMAGE_DEVICE) {
+			if (++i == num)
+				goto serial;
+			workers[i].ctx = ctx;
+			workers[i].img = pos;
+			if (i)
+				workers[i - 1].img_end = pos;
+		} else if (i >= 0 && !workers[i].name &&
+				!strcmp(rec.key, "dev") && rec.sval) {
+			workers[i].name = rec.sval;
+		}
+	}
+	if (i != num - 1 || pos != end)
+		goto serial;
+	workers[i].img_end = end;
+
+	for (i = 0; i < num; i++) {
+		if (!workers[i].name)
+			goto serial;
+		for (j = 0; j < i; j++) {
+			if (!strcmp(workers[i].name, workers[j].name))
+				goto serial;
+		}
+	}
+
+	config_workers_run(workers, num, config_image_worker);
+	rc = config_workers_report(workers, num);
+	free(workers);
+
+	return rc;
+
+ serial:
+	free(workers);
+	return image_apply(ctx, recs, end);
+}
+
 static int read_config_file(struct accfg_ctx *ctx, struct config *conf,
 			    struct util_filter_params *param)
 {
@@ -1084,6 +1752,7 @@ static int read_config_file(struct accfg_ctx *ctx, struct config *conf,
 		fprintf(stderr, "fread of buffer failed\n");
 		goto err;
 	}
+	conf->len = len;
 
  err:
 	fclose(f);
@@ -1172,7 +1841,7 @@ static bool filter_group(struct accfg_group *group,
 					       jc->jgroups);
 	}
 
-	jgroup = config_group_to_json(group, lfa->flags);
+	jgroup = util_group_to_json(group, lfa->flags);
 	if (!jgroup)
 		return false;
 
@@ -1321,6 +1990,12 @@ int cmd_config(int argc, const char **argv, void *ctx)
 				"enable configured devices and wqs"),
 		OPT_BOOLEAN('f', "forced", &forced,
 				"enabled devices will be disabled before configuring"),
+		OPT_BOOLEAN('d', "diff", &diff,
+				"only write attributes that differ from the live config"),
+		OPT_BOOLEAN('n', "dry-run", &dry_run,
+				"with --diff, print the differences without applying them"),
+		OPT_STRING('F', "format", &config.format, "json|binary",
+				"config file format, detected when not given"),
 		OPT_END(),
 	};
 	const char *const u[] = {
@@ -1333,6 +2008,7 @@ int cmd_config(int argc, const char **argv, void *ctx)
 	struct list_filter_arg cfa = {
 		0
 	};
+	bool binary;
 
 	argc = parse_options_prefix(argc, argv, prefix, options, u, 0);
 	for (i = 0; i < argc; i++) {
@@ -1341,6 +2017,12 @@ int cmd_config(int argc, const char **argv, void *ctx)
 	if (argc)
 		usage_with_options(u, options);
 
+	if (config.format && strcmp(config.format, "json") &&
+			strcmp(config.format, "binary")) {
+		error("unknown format \"%s\"\n", config.format);
+		usage_with_options(u, options);
+	}
+
 	cfa.jdevices = json_object_new_array();
 	if (!cfa.jdevices)
 		return -ENOMEM;
@@ -1361,6 +2043,35 @@ int cmd_config(int argc, const char **argv, void *ctx)
 	if (rc < 0)
 		fprintf(stderr, "Reading config file failed: %d\n", rc);
 
+	if (config.format)
+		binary = !strcmp(config.format, "binary");
+	else
+		binary = util_image_detect(config.buf, config.len);
+
+	if (binary) {
+		if (diff || dry_run) {
+			fprintf(stderr, "--diff needs a json config file\n");
+			free_containers(&cfa);
+			return -EINVAL;
+		}
+		rc = parse_config_image((struct accfg_ctx *)ctx, &config);
+		if (rc < 0)
+			fprintf(stderr, "Parse image and set device fail: %d\n",
+					rc);
+		free_containers(&cfa);
+		if (enable && !rc)
+			rc = activate_devices();
+		return rc;
+	}
+
+	if (diff || dry_run) {
+		free_containers(&cfa);
+		rc = diff_config((struct accfg_ctx *)ctx, &config);
+		if (rc < 0)
+			fprintf(stderr, "Applying config differences failed: %d\n", rc);
+		return rc;
+	}
+
 	rc = parse_config((struct accfg_ctx *)ctx, &config);
 	if (rc < 0)
 		fprintf(stderr, "Parse json and set device fail: %d\n", rc);
@@ -1373,20 +2084,13 @@ int cmd_config(int argc, const char **argv, void *ctx)
 	return rc;
 }
 
-static int config_default_wq(struct accfg_wq *wq)
+static int config_default_wq(struct accfg_wq *wq, struct wq_parameters *p)
 {
 	struct accfg_device *dev = accfg_wq_get_device(wq);
-	enum accfg_device_type dev_type;
-	struct wq_parameters *p;
 
 	if (!conf_def_dev_configured(dev))
 		return 0;
 
-	dev_type = accfg_device_get_type(dev);
-	p = get_conf_def_wq_param(dev_type);
-	if (!p)
-		return -EINVAL;
-
 	accfg_wq_set_priority(wq, p->priority);
 	accfg_wq_set_group_id(wq, p->group_id);
 	accfg_wq_set_block_on_fault(wq, p->block_on_fault);
@@ -1418,15 +2122,75 @@ static int config_default_engine(struct accfg_engine *engine,
 	return accfg_engine_set_group_id(engine, p->group_id);
 }
 
+static void *config_default_device_worker(void *arg)
+{
+	struct config_worker *w = arg;
+	struct accfg_device *dev = w->dev;
+	struct accfg_engine *engine;
+	struct wq_parameters p;
+	struct accfg_wq *wq;
+	const char *wq_name;
+	int rc;
+
+	/* Set WQ parameters calculated based on dev, on a private copy. */
+	p = *get_conf_def_wq_param(accfg_device_get_type(dev));
+	config_default_wq_set_on_dev(dev, &p);
+
+	/* Config WQs */
+	accfg_wq_foreach(dev, wq) {
+		if (verbose)
+			printf("config %s\n", accfg_wq_get_devname(wq));
+
+		config_default_wq(wq, &p);
+	}
+
+	/* Config engines */
+	accfg_engine_foreach(dev, engine)
+		config_default_engine(engine, dev);
+
+	/* Enable device */
+	if (verbose)
+		printf("enable %s\n", w->name);
+	rc = accfg_device_enable(dev);
+	if (rc) {
+		w->err_name = w->name;
+		w->rc = rc;
+		return NULL;
+	}
+
+	/* Enable WQs, keep going past a failed one */
+	accfg_wq_foreach(dev, wq) {
+		wq_name = accfg_wq_get_devname(wq);
+		if (verbose)
+			printf("enable %s\n", wq_name);
+
+		rc = accfg_wq_enable(wq);
+		if (rc && !w->rc) {
+			w->err_name = wq_name;
+			w->rc = rc;
+		}
+	}
+
+	return NULL;
+}
+
 static void config_default_activate_devices(void *ctx)
 {
 	enum accfg_device_state dev_state;
-	const char *dev_name, *wq_name;
-	struct accfg_engine *engine;
+	struct config_worker *workers;
 	struct accfg_device *dev;
-	struct accfg_wq *wq;
-	int rc = 0;
+	int i, num = 0;
+
+	accfg_device_foreach(ctx, dev)
+		num++;
+
+	workers = calloc(num, sizeof(*workers));
+	if (num && !workers) {
+		fprintf(stderr, "Error allocating memory for device workers\n");
+		return;
+	}
 
+	num = 0;
 	accfg_device_foreach(ctx, dev) {
 		/* Skip device that is not configured. */
 		if (!conf_def_dev_configured(dev))
@@ -1437,44 +2201,21 @@ static void config_default_activate_devices(void *ctx)
 		if (dev_state == ACCFG_DEVICE_ENABLED)
 			continue;
 
-		/* Set WQ parameters calculated based on dev. */
-		config_default_wq_set_on_dev(dev);
-
-		/* Config WQs */
-		accfg_wq_foreach(dev, wq) {
-			if (verbose)
-				printf("config %s\n", accfg_wq_get_devname(wq));
-
-			config_default_wq(wq);
-		}
-
-		/* Config engines */
-		accfg_engine_foreach(dev, engine)
-			config_default_engine(engine, dev);
-
-		/* Enable device */
-		dev_name = accfg_device_get_devname(dev);
-		if (verbose)
-			printf("enable %s\n", dev_name);
-		rc = accfg_device_enable(dev);
-		if (rc) {
-			fprintf(stderr, "Error enabling %s\n", dev_name);
+		if (!get_conf_def_wq_param(accfg_device_get_type(dev)))
 			continue;
-		}
 
-		/* Enable WQs */
-		accfg_wq_foreach(dev, wq) {
-			wq_name = accfg_wq_get_devname(wq);
-			if (verbose)
-				printf("enable %s\n", wq_name);
+		workers[num].dev = dev;
+		workers[num].name = accfg_device_get_devname(dev);
+		num++;
+	}
 
-			rc = accfg_wq_enable(wq);
-			if (rc) {
-				fprintf(stderr, "Error enabling %s\n", wq_name);
-				continue;
-			}
-		}
+	config_workers_run(workers, num, config_default_device_worker);
+
+	for (i = 0; i < num; i++) {
+		if (workers[i].rc)
+			fprintf(stderr, "Error enabling %s\n", workers[i].err_name);
 	}
+	free(workers);
 }
 
 #define CONFIG_DEFAULT_WQ_PRIORITY		10
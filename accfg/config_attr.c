@@ -51,6 +51,34 @@ static struct wq_parameters wq_param = {
 
 static struct engine_parameters engine_param;
 
+/* All fields unset, accel_config_parse_wq_attribs() skips INT_MAX */
+static const struct wq_parameters wq_param_unset = {
+	.group_id = INT_MAX,
+	.wq_size = INT_MAX,
+	.priority = INT_MAX,
+	.block_on_fault = INT_MAX,
+	.threshold = INT_MAX,
+	.max_batch_size = INT_MAX,
+	.max_transfer_size = INT_MAX,
+	.ats_disable = INT_MAX,
+	.prs_disable = INT_MAX,
+};
+
+static struct wq_parameters reconf_param = {
+	.group_id = INT_MAX,
+	.wq_size = INT_MAX,
+	.priority = INT_MAX,
+	.block_on_fault = INT_MAX,
+	.threshold = INT_MAX,
+	.max_batch_size = INT_MAX,
+	.max_transfer_size = INT_MAX,
+	.ats_disable = INT_MAX,
+	.prs_disable = INT_MAX,
+};
+
+#define RECONF_DRAIN_TIMEOUT_MS	5000
+#define RECONF_POLL_US		1000
+
 static int accel_config_parse_device_attribs(struct accfg_device *dev,
 		struct dev_parameters *device_param)
 {
@@ -199,13 +227,12 @@ static int accel_config_parse_group_attribs(struct accfg_group *group,
 	return 0;
 }
 
-static int accel_config_parse_wq_attribs(struct accfg_device *device,
-		struct accfg_wq *wq, struct wq_parameters *wq_params)
+static int accel_config_check_wq_attribs(struct accfg_device *device,
+		struct wq_parameters *wq_params)
 {
 	int max_groups;
 	unsigned int max_wq_size, max_batch_size;
 	uint64_t max_transfer_size;
-	int rc = 0;
 
 	if (wq_params->mode) {
 		if ((strcmp(wq_params->mode, "shared") != 0) &&
@@ -273,6 +300,18 @@ static int accel_config_parse_wq_attribs(struct accfg_device *device,
 		return -EINVAL;
 	}
 
+	return 0;
+}
+
+static int accel_config_parse_wq_attribs(struct accfg_device *device,
+		struct accfg_wq *wq, struct wq_parameters *wq_params)
+{
+	int rc;
+
+	rc = accel_config_check_wq_attribs(device, wq_params);
+	if (rc)
+		return rc;
+
 	if (wq_params->mode) {
 		rc = accfg_wq_set_str_mode(wq, wq_params->mode);
 		if (rc < 0)
@@ -633,3 +672,168 @@ int cmd_config_engine(int argc, const char **argv, void *ctx)
 
 	return 0;
 }
+
+static uint64_t reconf_elapsed_us(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000000ULL +
+		(now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/*
+ * Drain, disable, apply and re-enable one wq. If applying the new values
+ * fails the old ones are written back, so the wq always comes back up.
+ */
+static int reconfigure_wq(struct accfg_device *device, struct accfg_wq *wq,
+		struct wq_parameters *params, unsigned int timeout_ms,
+		bool force)
+{
+	const char *wq_name = accfg_wq_get_devname(wq);
+	struct wq_parameters old = wq_param_unset;
+	unsigned int size, threshold;
+	struct timespec start, down;
+	uint64_t drain_us, down_us;
+	int clients, occupancy;
+	int rc, apply_rc;
+
+	rc = accel_config_check_wq_attribs(device, params);
+	if (rc)
+		return rc;
+
+	/* A shared wq will not enable with a threshold above its size */
+	size = params->wq_size != INT_MAX ? params->wq_size :
+		(unsigned int)accfg_wq_get_size(wq);
+	threshold = params->threshold != INT_MAX ? params->threshold :
+		(unsigned int)accfg_wq_get_threshold(wq);
+	if (accfg_wq_get_mode(wq) == ACCFG_WQ_SHARED && threshold > size) {
+		fprintf(stderr, "%s: threshold %u is above wq size %u\n",
+				wq_name, threshold, size);
+		return -EINVAL;
+	}
+
+	if (accfg_wq_get_state(wq) != ACCFG_WQ_ENABLED)
+		return accel_config_parse_wq_attribs(device, wq, params);
+
+	/* wq size is only writable while the device is disabled */
+	if (params->wq_size != INT_MAX && accfg_device_get_state(device) ==
+			ACCFG_DEVICE_ENABLED) {
+		fprintf(stderr, "%s: wq size needs %s to be disabled\n",
+				wq_name, accfg_device_get_devname(device));
+		return -EBUSY;
+	}
+
+	if (params->wq_size != INT_MAX)
+		old.wq_size = accfg_wq_get_size(wq);
+	if (params->threshold != INT_MAX)
+		old.threshold = accfg_wq_get_threshold(wq);
+	if (params->priority != INT_MAX)
+		old.priority = accfg_wq_get_priority(wq);
+	if (params->max_transfer_size != INT_MAX)
+		old.max_transfer_size = accfg_wq_get_max_transfer_size(wq);
+	if (params->max_batch_size != INT_MAX)
+		old.max_batch_size = accfg_wq_get_max_batch_size(wq);
+
+	clients = accfg_wq_get_clients(wq);
+	printf("%s: %d client(s), draining\n", wq_name, clients);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while ((occupancy = accfg_wq_get_occupancy(wq)) > 0) {
+		if (reconf_elapsed_us(&start) >= timeout_ms * 1000ULL)
+			break;
+		usleep(RECONF_POLL_US);
+	}
+	drain_us = reconf_elapsed_us(&start);
+
+	if (occupancy < 0) {
+		printf("%s: occupancy not reported, not waiting for drain\n",
+				wq_name);
+	} else if (occupancy > 0) {
+		fprintf(stderr, "%s: %d descriptor(s) still queued after %u ms\n",
+				wq_name, occupancy, timeout_ms);
+		if (!force)
+			return -ETIMEDOUT;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &down);
+	rc = accfg_wq_disable(wq, true);
+	if (rc) {
+		fprintf(stderr, "%s: disable failed\n", wq_name);
+		return rc;
+	}
+
+	apply_rc = accel_config_parse_wq_attribs(device, wq, params);
+	if (apply_rc) {
+		fprintf(stderr, "%s: applying attributes failed, restoring\n",
+				wq_name);
+		accel_config_parse_wq_attribs(device, wq, &old);
+	}
+
+	rc = accfg_wq_enable(wq);
+	down_us = reconf_elapsed_us(&down);
+	if (rc) {
+		fprintf(stderr, "%s: enable failed, down for %" PRIu64 " us\n",
+				wq_name, down_us);
+		return rc;
+	}
+
+	printf("%s: %s, drained in %" PRIu64 " us, down for %" PRIu64 " us\n",
+			wq_name, apply_rc ? "restored" : "reconfigured",
+			drain_us, down_us);
+
+	return apply_rc;
+}
+
+int cmd_reconfigure_wq(int argc, const char **argv, void *ctx)
+{
+	unsigned int timeout_ms = RECONF_DRAIN_TIMEOUT_MS;
+	bool force = false;
+	int i, rc = 0;
+
+	const struct option options[] = {
+		OPT_UINTEGER('s', "wq-size", &reconf_param.wq_size,
+			     "specify wq-size used by wq"),
+		OPT_UINTEGER('t', "threshold", &reconf_param.threshold,
+			    "specify threshold by wq"),
+		OPT_UINTEGER('p', "priority", &reconf_param.priority,
+			    "specify priority used by wq"),
+		OPT_UINTEGER('c', "max-batch-size", &reconf_param.max_batch_size,
+			     "specify max-batch-size used by wq"),
+		OPT_U64('x', "max-transfer-size", &reconf_param.max_transfer_size,
+			     "specify max-transfer-size used by wq"),
+		OPT_UINTEGER('w', "timeout", &timeout_ms,
+			     "ms to wait for the wq to drain (default 5000)"),
+		OPT_BOOLEAN('f', "force", &force,
+			    "reconfigure even if the wq did not drain in time"),
+		OPT_END(),
+	};
+
+	const char *const u[] = {
+		"accel-config reconfigure-wq <device name>/<wq name> [<options>]",
+		NULL
+	};
+
+	argc = parse_options(argc, argv, options, u, 0);
+
+	if (argc == 0)
+		error("specify a wq name to reconfigure\n");
+
+	for (i = 0; i < argc; i++) {
+		struct accfg_device *device;
+		struct accfg_wq *wq;
+
+		if (parse_wq_name(ctx, argv[i], &device, &wq)) {
+			fprintf(stderr,
+				"%s is not a valid workqueue name\n", argv[i]);
+			continue;
+		}
+
+		rc = reconfigure_wq(device, wq, &reconf_param, timeout_ms, force);
+		if (rc < 0)
+			return rc;
+	}
+
+	return rc;
+}
@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <immintrin.h>
+#include "private.h"
+
+/*
+ * Hybrid copy: the CPU copies what is below the crossover size, DSA
+ * what is above it, and copies large enough to saturate either one are
+ * split so that both finish at about the same time.
+ */
+
+#define DSA_COPY_OPS		8
+#define DSA_CAL_MIN		1024
+#define DSA_CAL_MAX		(4 << 20)
+#define DSA_CAL_BYTES		(16 << 20)
+#define DSA_CAL_MIN_REPS	4
+
+static uint64_t dsa_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void __attribute__((target("avx512f")))
+dsa_copy_nt_avx512(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	size_t head = -(uintptr_t)dst & 63;
+
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	len -= head;
+
+	for (; len >= 64; len -= 64, dst += 64, src += 64)
+		_mm512_stream_si512((void *)dst, _mm512_loadu_si512(src));
+	_mm_sfence();
+
+	memcpy(dst, src, len);
+}
+
+/*
+ * Streaming stores bypass the cache, which only pays off once the copy
+ * would evict most of it anyway.
+ */
+void dsa_cpu_copy(struct dsa_ctx *ctx, void *dst, const void *src,
+		size_t len)
+{
+	if (ctx->avx512 && len >= DSA_NT_MIN)
+		dsa_copy_nt_avx512(dst, src, len);
+	else
+		memcpy(dst, src, len);
+}
+
+/* The part of a split copy that is left for the CPU */
+struct dsa_copy_cpu {
+	uint8_t *dst;
+	const uint8_t *src;
+	size_t len;
+};
+
+/* Copies the CPU share in slices while op is in flight, then waits for op */
+static void dsa_copy_wait(struct dsa_ctx *ctx, struct dsa_op *op,
+		void *dst, const void *src, size_t len,
+		struct dsa_copy_cpu *cpu)
+{
+	size_t slice;
+	int rc;
+
+	while (cpu->len && dsa_op_poll(op) > 0) {
+		slice = cpu->len < DSA_NT_MIN ? cpu->len : DSA_NT_MIN;
+		dsa_cpu_copy(ctx, cpu->dst, cpu->src, slice);
+		cpu->dst += slice;
+		cpu->src += slice;
+		cpu->len -= slice;
+	}
+
+	rc = dsa_op_wait(op, -1);
+	if (rc) {
+		/* redo what the device did not copy */
+		dbg(ctx, "copy of %zu bytes failed: %d\n", len, rc);
+		dsa_cpu_copy(ctx, dst, src, len);
+	}
+}
+
+/**
+ * dsa_memcpy - copy with the CPU, DSA or both
+ * @ctx: dsa context
+ * @dst: destination, must not overlap src
+ * @src: source
+ * @len: bytes to copy
+ *
+ * The copy is complete on return. The crossover size and the CPU share
+ * of large copies come from dsa_ctx_calibrate() or the setters.
+ */
+DSA_EXPORT int dsa_memcpy(struct dsa_ctx *ctx, void *dst, const void *src,
+		size_t len)
+{
+	struct dsa_op ops[DSA_COPY_OPS];
+	size_t cpu_len = 0, dsa_len, off = 0, chunk;
+	size_t offs[DSA_COPY_OPS], lens[DSA_COPY_OPS];
+	struct dsa_copy_cpu cpu;
+	unsigned int head = 0, tail = 0, i;
+	int rc;
+
+	if (len < ctx->copy_threshold) {
+		dsa_cpu_copy(ctx, dst, src, len);
+		return 0;
+	}
+
+	if (len >= DSA_SPLIT_MIN)
+		cpu_len = (len / 100 * ctx->copy_split) & ~(size_t)4095;
+	dsa_len = len - cpu_len;
+	cpu.dst = (uint8_t *)dst + dsa_len;
+	cpu.src = (const uint8_t *)src + dsa_len;
+	cpu.len = cpu_len;
+
+	for (i = 0; i < DSA_COPY_OPS; i++)
+		dsa_op_init(&ops[i], ctx, &ops[i].hw);
+
+	/* keep up to DSA_COPY_OPS chunks in flight */
+	while (off < dsa_len) {
+		i = tail % DSA_COPY_OPS;
+		if (tail - head == DSA_COPY_OPS) {
+			dsa_copy_wait(ctx, &ops[i], (char *)dst + offs[i],
+					(const char *)src + offs[i], lens[i],
+					&cpu);
+			head++;
+		}
+
+		chunk = dsa_len - off;
+		if (chunk > ctx->max_xfer_size)
+			chunk = ctx->max_xfer_size;
+		dsa_op_memmove(&ops[i], (char *)dst + off,
+				(const char *)src + off, chunk);
+		rc = dsa_op_submit(&ops[i]);
+		if (rc == -EBUSY && tail != head) {
+			/* wait for the oldest chunk to free a slot */
+			dsa_copy_wait(ctx, &ops[head % DSA_COPY_OPS],
+					(char *)dst + offs[head % DSA_COPY_OPS],
+					(const char *)src +
+					offs[head % DSA_COPY_OPS],
+					lens[head % DSA_COPY_OPS], &cpu);
+			head++;
+			continue;
+		}
+		if (rc)
+			dsa_cpu_copy(ctx, (char *)dst + off,
+					(const char *)src + off, chunk);
+		else
+			tail++;
+		offs[i] = off;
+		lens[i] = chunk;
+		off += chunk;
+	}
+
+	for (; head != tail; head++) {
+		i = head % DSA_COPY_OPS;
+		dsa_copy_wait(ctx, &ops[i], (char *)dst + offs[i],
+				(const char *)src + offs[i], lens[i], &cpu);
+	}
+
+	/* whatever of the CPU share the waits did not cover */
+	if (cpu.len)
+		dsa_cpu_copy(ctx, cpu.dst, cpu.src, cpu.len);
+
+	return 0;
+}
+
+DSA_EXPORT size_t dsa_ctx_get_copy_threshold(struct dsa_ctx *ctx)
+{
+	return ctx->copy_threshold;
+}
+
+DSA_EXPORT void dsa_ctx_set_copy_threshold(struct dsa_ctx *ctx,
+		size_t threshold)
+{
+	ctx->copy_threshold = threshold;
+}
+
+DSA_EXPORT unsigned int dsa_ctx_get_copy_split(struct dsa_ctx *ctx)
+{
+	return ctx->copy_split;
+}
+
+DSA_EXPORT int dsa_ctx_set_copy_split(struct dsa_ctx *ctx, unsigned int pct)
+{
+	if (pct > 100)
+		return -EINVAL;
+	ctx->copy_split = pct;
+	return 0;
+}
+
+/* Average ns per copy of len bytes */
+static uint64_t dsa_cal_time(struct dsa_ctx *ctx, void *dst, void *src,
+		size_t len, bool cpu)
+{
+	unsigned int reps = DSA_CAL_BYTES / len, i;
+	uint64_t start;
+
+	if (reps < DSA_CAL_MIN_REPS)
+		reps = DSA_CAL_MIN_REPS;
+
+	start = dsa_now_ns();
+	for (i = 0; i < reps; i++) {
+		if (cpu)
+			dsa_cpu_copy(ctx, dst, src, len);
+		else
+			dsa_memcpy(ctx, dst, src, len);
+	}
+
+	return (dsa_now_ns() - start) / reps;
+}
+
+static void dsa_cal_measure(struct dsa_ctx *ctx, void *dst, void *src)
+{
+	uint64_t t_cpu = 0, t_dsa = 0;
+	size_t len, threshold = SIZE_MAX;
+
+	ctx->copy_threshold = 0;
+	ctx->copy_split = 0;
+
+	for (len = DSA_CAL_MAX; len >= DSA_CAL_MIN; len /= 2) {
+		t_cpu = dsa_cal_time(ctx, dst, src, len, true);
+		t_dsa = dsa_cal_time(ctx, dst, src, len, false);
+		dbg(ctx, "%zu bytes cpu %" PRIu64 "ns dsa %" PRIu64 "ns\n",
+				len, t_cpu, t_dsa);
+		/* the smallest size from which DSA is faster for all sizes */
+		if (t_dsa >= t_cpu)
+			break;
+		threshold = len;
+	}
+
+	/* both finish together when each takes a share of its speed */
+	len = DSA_CAL_MAX;
+	t_cpu = dsa_cal_time(ctx, dst, src, len, true);
+	t_dsa = dsa_cal_time(ctx, dst, src, len, false);
+	ctx->copy_split = t_cpu + t_dsa ? t_dsa * 100 / (t_cpu + t_dsa) : 0;
+	ctx->copy_threshold = threshold;
+}
+
+static void dsa_cal_key(struct dsa_ctx *ctx, char *buf, size_t size)
+{
+	struct accfg_device *dev = accfg_wq_get_device(ctx->wq);
+
+	snprintf(buf, size, "%s/%s", accfg_device_get_devname(dev),
+			accfg_wq_get_devname(ctx->wq));
+}
+
+static int dsa_cal_load(struct dsa_ctx *ctx, const char *path)
+{
+	char line[256], key[64], name[128], val[128];
+	unsigned long long threshold = 0;
+	unsigned int split = 0, found = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+
+	dsa_cal_key(ctx, name, sizeof(name));
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%63s %127s", key, val) != 2)
+			break;
+		if (!strcmp(key, "wq") && !strcmp(val, name))
+			found |= 1;
+		else if (!strcmp(key, "threshold")) {
+			threshold = strtoull(val, NULL, 0);
+			found |= 2;
+		} else if (!strcmp(key, "split")) {
+			split = strtoul(val, NULL, 0);
+			found |= 4;
+		}
+	}
+	fclose(f);
+
+	/* recalibrate when the file is for another wq */
+	if (found != 7 || split > 100)
+		return -ESTALE;
+
+	ctx->copy_threshold = threshold;
+	ctx->copy_split = split;
+	return 0;
+}
+
+static int dsa_cal_save(struct dsa_ctx *ctx, const char *path)
+{
+	char name[128];
+	FILE *f;
+
+	f = fopen(path, "w");
+	if (!f)
+		return -errno;
+
+	dsa_cal_key(ctx, name, sizeof(name));
+	fprintf(f, "# libaccel-dsa copy calibration\nwq %s\n", name);
+	fprintf(f, "threshold %zu\nsplit %u\n", ctx->copy_threshold,
+			ctx->copy_split);
+
+	return fclose(f) ? -errno : 0;
+}
+
+/**
+ * dsa_ctx_calibrate - find the CPU/DSA crossover of dsa_memcpy()
+ * @ctx: dsa context
+ * @path: calibration cache, NULL to always measure
+ *
+ * Loads the crossover from @path when it was measured on the same work
+ * queue, otherwise times CPU and DSA copies of 1KB to 4MB and writes the
+ * result to @path.
+ */
+DSA_EXPORT int dsa_ctx_calibrate(struct dsa_ctx *ctx, const char *path)
+{
+	void *src, *dst;
+
+	if (ctx->cpu) {
+		ctx->copy_threshold = SIZE_MAX;
+		ctx->copy_split = 100;
+		return 0;
+	}
+
+	if (path && !dsa_cal_load(ctx, path)) {
+		info(ctx, "copy threshold %zu split %u%% from %s\n",
+				ctx->copy_threshold, ctx->copy_split, path);
+		return 0;
+	}
+
+	src = aligned_alloc(4096, DSA_CAL_MAX);
+	dst = aligned_alloc(4096, DSA_CAL_MAX);
+	if (!src || !dst) {
+		free(src);
+		free(dst);
+		return -ENOMEM;
+	}
+	/* fault the buffers in so that no run pays for it */
+	memset(src, 0x5a, DSA_CAL_MAX);
+	memset(dst, 0, DSA_CAL_MAX);
+
+	dsa_cal_measure(ctx, dst, src);
+	free(src);
+	free(dst);
+
+	info(ctx, "copy threshold %zu split %u%%\n", ctx->copy_threshold,
+			ctx->copy_split);
+
+	return path ? dsa_cal_save(ctx, path) : 0;
+}
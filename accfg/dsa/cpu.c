@@ -0,0 +1,409 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <string.h>
+#include <immintrin.h>
+#include "private.h"
+
+/*
+ * CPU implementation of the descriptors, used when no work queue is
+ * available. It reads the same hw_desc and fills in the same completion
+ * record fields the device would.
+ */
+
+#define CPU_CACHE_LINE		64
+
+/* dif_status bits of a DIF error */
+#define DIF_ERR_GUARD		0x1
+#define DIF_ERR_APP_TAG		0x2
+#define DIF_ERR_REF_TAG		0x4
+
+static uint32_t crc32c_table[256];
+/* t10dif_table[k][b]: CRC-T10DIF of byte b followed by k zero bytes */
+static uint16_t t10dif_table[8][256];
+
+static void __attribute__((constructor)) dsa_cpu_init(void)
+{
+	uint32_t crc;
+	uint16_t t10;
+	int i, j, k;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		t10 = i << 8;
+		for (j = 0; j < 8; j++) {
+			crc = (crc >> 1) ^ (0x82f63b78U & -(crc & 1));
+			t10 = (t10 << 1) ^ (0x8bb7 & -(t10 >> 15));
+		}
+		crc32c_table[i] = crc;
+		t10dif_table[0][i] = t10;
+	}
+	for (k = 1; k < 8; k++)
+		for (i = 0; i < 256; i++) {
+			t10 = t10dif_table[k - 1][i];
+			t10dif_table[k][i] = (t10 << 8) ^
+				t10dif_table[0][t10 >> 8];
+		}
+}
+
+/* CRC-32C with the seed and result inversion CRCGEN applies by default */
+uint32_t dsa_cpu_crc32c(const void *buf, size_t len, uint32_t seed)
+{
+	const uint8_t *p = buf;
+	uint32_t crc = ~seed;
+
+	while (len--)
+		crc = (crc >> 8) ^ crc32c_table[(crc ^ *p++) & 0xff];
+
+	return ~crc;
+}
+
+/*
+ * The DIF guard tag, CRC-T10DIF with a zero seed and no inversion. Eight
+ * bytes are folded per step, the first two of them absorb the crc.
+ */
+uint16_t dsa_cpu_crc_t10dif(const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	uint16_t crc = 0;
+
+	for (; len >= 8; len -= 8, p += 8)
+		crc = t10dif_table[7][p[0] ^ (crc >> 8)] ^
+			t10dif_table[6][p[1] ^ (crc & 0xff)] ^
+			t10dif_table[5][p[2]] ^ t10dif_table[4][p[3]] ^
+			t10dif_table[3][p[4]] ^ t10dif_table[2][p[5]] ^
+			t10dif_table[1][p[6]] ^ t10dif_table[0][p[7]];
+	while (len--)
+		crc = (crc << 8) ^ t10dif_table[0][(crc >> 8) ^ *p++];
+
+	return crc;
+}
+
+static const uint32_t dif_block_sizes[] = { 512, 520, 4096, 4104 };
+
+/* Writes the 8 bytes of big endian protection info of one block */
+void dsa_cpu_dif_gen(uint8_t *pi, const void *data, size_t len,
+		uint16_t app_tag, uint32_t ref_tag)
+{
+	uint16_t guard = dsa_cpu_crc_t10dif(data, len);
+
+	pi[0] = guard >> 8;
+	pi[1] = guard;
+	pi[2] = app_tag >> 8;
+	pi[3] = app_tag;
+	pi[4] = ref_tag >> 24;
+	pi[5] = ref_tag >> 16;
+	pi[6] = ref_tag >> 8;
+	pi[7] = ref_tag;
+}
+
+/* Returns the dif_status bits of the protection info of one block */
+int dsa_cpu_dif_verify(const uint8_t *pi, const void *data, size_t len,
+		uint16_t app_mask, uint16_t app_tag, uint32_t ref_tag)
+{
+	uint8_t want[8];
+	int status = 0;
+
+	dsa_cpu_dif_gen(want, data, len, app_tag, ref_tag);
+	if (memcmp(pi, want, 2))
+		status |= DIF_ERR_GUARD;
+	if (((pi[2] ^ want[2]) & ~(app_mask >> 8)) ||
+			((pi[3] ^ want[3]) & ~app_mask & 0xff))
+		status |= DIF_ERR_APP_TAG;
+	if (memcmp(pi + 4, want + 4, 4))
+		status |= DIF_ERR_REF_TAG;
+
+	return status;
+}
+
+/*
+ * DIF with the default flags only: incrementing reference tags, a zero
+ * guard seed and no F detection.
+ */
+static void cpu_dif(struct hw_desc *hw, struct completion_record *comp)
+{
+	const uint8_t *src = (const uint8_t *)hw->src_addr;
+	uint8_t *dst = (uint8_t *)hw->dst_addr;
+	uint8_t src_flags, dst_flags, op_flags;
+	uint16_t chk_mask, chk_app, ins_app;
+	uint32_t bs, blocks, i, chk_ref, ins_ref;
+	bool check, insert;
+	int status;
+
+	switch (hw->opcode) {
+	case DSA_OPCODE_DIF_CHECK:
+	case DSA_OPCODE_DIF_STRP:
+		src_flags = hw->src_dif_flags;
+		dst_flags = 0;
+		op_flags = hw->dif_chk_flags;
+		chk_ref = hw->chk_ref_tag_seed;
+		chk_mask = hw->chk_app_tag_mask;
+		chk_app = hw->chk_app_tag_seed;
+		ins_ref = ins_app = 0;
+		break;
+	case DSA_OPCODE_DIF_INS:
+		src_flags = 0;
+		dst_flags = hw->dest_dif_flag;
+		op_flags = hw->dif_ins_flags;
+		ins_ref = hw->ins_ref_tag_seed;
+		ins_app = hw->ins_app_tag_seed;
+		chk_ref = chk_mask = chk_app = 0;
+		break;
+	case DSA_OPCODE_DIX_GEN:
+		src_flags = 0;
+		dst_flags = hw->dest_dif_flags;
+		op_flags = hw->dif_flags;
+		ins_ref = hw->ref_tag_seed;
+		ins_app = hw->app_tag_seed;
+		chk_ref = chk_mask = chk_app = 0;
+		break;
+	default:
+		src_flags = hw->src_upd_flags;
+		dst_flags = hw->upd_dest_flags;
+		op_flags = hw->dif_upd_flags;
+		chk_ref = hw->src_ref_tag_seed;
+		chk_mask = hw->src_app_tag_mask;
+		chk_app = hw->src_app_tag_seed;
+		ins_ref = hw->dest_ref_tag_seed;
+		ins_app = hw->dest_app_tag_seed;
+		break;
+	}
+
+	if (src_flags || dst_flags || op_flags & ~DSA_DIF_BLOCK_MASK) {
+		comp->status = DSA_COMP_BAD_OPCODE;
+		return;
+	}
+
+	check = hw->opcode != DSA_OPCODE_DIF_INS &&
+		hw->opcode != DSA_OPCODE_DIX_GEN;
+	insert = hw->opcode == DSA_OPCODE_DIF_INS ||
+		hw->opcode == DSA_OPCODE_DIF_UPDT;
+	bs = dif_block_sizes[op_flags & DSA_DIF_BLOCK_MASK];
+	blocks = hw->xfer_size / (check ? bs + 8 : bs);
+	if (!blocks || hw->xfer_size % (check ? bs + 8 : bs)) {
+		comp->status = DSA_COMP_XFER_ERANGE;
+		return;
+	}
+
+	for (i = 0; i < blocks; i++) {
+		if (check) {
+			status = dsa_cpu_dif_verify(src + bs, src, bs,
+					chk_mask, chk_app, chk_ref + i);
+			if (status) {
+				comp->dif_status = status;
+				comp->bytes_completed = i * (bs + 8);
+				comp->status = DSA_COMP_DIF_ERR;
+				return;
+			}
+		}
+		/* DIX writes the protection info alone to its own buffer */
+		if (hw->opcode == DSA_OPCODE_DIX_GEN) {
+			dsa_cpu_dif_gen(dst, src, bs, ins_app, ins_ref + i);
+			dst += 8;
+		} else if (hw->opcode != DSA_OPCODE_DIF_CHECK) {
+			memmove(dst, src, bs);
+			dst += bs;
+		}
+		if (insert) {
+			dsa_cpu_dif_gen(dst, dst - bs, bs, ins_app,
+					ins_ref + i);
+			dst += 8;
+		}
+		src += check ? bs + 8 : bs;
+	}
+
+	comp->status = DSA_COMP_SUCCESS;
+}
+
+/* Writes back and evicts every cache line the range touches */
+static void cpu_cflush(const uint8_t *addr, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)((uintptr_t)addr &
+			~(uintptr_t)(CPU_CACHE_LINE - 1));
+
+	for (; p < addr + len; p += CPU_CACHE_LINE)
+		_mm_clflush(p);
+	_mm_mfence();
+}
+
+static void cpu_memfill(uint8_t *dst, uint64_t pattern, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i + sizeof(pattern) <= len; i += sizeof(pattern))
+		memcpy(dst + i, &pattern, sizeof(pattern));
+	memcpy(dst + i, &pattern, len - i);
+}
+
+/* Returns the offset of the first difference, or len */
+static size_t cpu_compare(const uint8_t *a, const uint8_t *b, size_t len)
+{
+	size_t i;
+
+	if (!memcmp(a, b, len))
+		return len;
+	for (i = 0; i < len && a[i] == b[i]; i++)
+		;
+	return i;
+}
+
+static size_t cpu_compval(const uint8_t *src, uint64_t pattern, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)&pattern;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (src[i] != p[i % sizeof(pattern)])
+			break;
+	return i;
+}
+
+static void cpu_cr_delta(struct hw_desc *hw, struct completion_record *comp)
+{
+	const uint64_t *s1 = (const uint64_t *)hw->src_addr;
+	const uint64_t *s2 = (const uint64_t *)hw->src2_addr;
+	uint8_t *rec = (uint8_t *)hw->delta_addr;
+	uint32_t words = hw->xfer_size / sizeof(uint64_t);
+	uint32_t size = 0, i;
+	uint16_t off;
+
+	if (hw->xfer_size % sizeof(uint64_t) || words > UINT16_MAX + 1) {
+		comp->status = DSA_COMP_XFER_ERANGE;
+		return;
+	}
+
+	comp->result = DSA_OP_RESULT_MATCH;
+	for (i = 0; i < words; i++) {
+		if (s1[i] == s2[i])
+			continue;
+		if (size + DSA_DELTA_ENTRY_SIZE > hw->max_delta_size) {
+			comp->result = DSA_OP_RESULT_OVERFLOW;
+			break;
+		}
+		off = i;
+		memcpy(rec + size, &off, sizeof(off));
+		memcpy(rec + size + sizeof(off), &s2[i], sizeof(s2[i]));
+		size += DSA_DELTA_ENTRY_SIZE;
+		comp->result = DSA_OP_RESULT_MISMATCH;
+	}
+
+	comp->delta_rec_size = size;
+	comp->bytes_completed = i * sizeof(uint64_t);
+	comp->status = DSA_COMP_SUCCESS;
+}
+
+static void cpu_ap_delta(struct hw_desc *hw, struct completion_record *comp)
+{
+	const uint8_t *rec = (const uint8_t *)hw->src_addr;
+	uint8_t *dst = (uint8_t *)hw->dst_addr;
+	uint32_t i;
+	uint16_t off;
+
+	if (hw->delta_rec_size % DSA_DELTA_ENTRY_SIZE) {
+		comp->status = DSA_COMP_DR_ERANGE;
+		return;
+	}
+
+	for (i = 0; i < hw->delta_rec_size; i += DSA_DELTA_ENTRY_SIZE) {
+		memcpy(&off, rec + i, sizeof(off));
+		if ((off + 1) * sizeof(uint64_t) > hw->xfer_size) {
+			comp->status = DSA_COMP_DR_OFFSET_ERANGE;
+			return;
+		}
+		memcpy(dst + off * sizeof(uint64_t), rec + i + sizeof(off),
+				sizeof(uint64_t));
+	}
+
+	comp->status = DSA_COMP_SUCCESS;
+}
+
+static void cpu_batch(struct dsa_ctx *ctx, struct hw_desc *hw,
+		struct completion_record *comp)
+{
+	struct hw_desc *list = (struct hw_desc *)hw->desc_list_addr;
+	struct completion_record *sub;
+	uint32_t i, done = 0;
+	bool failed = false;
+
+	for (i = 0; i < hw->desc_count; i++) {
+		sub = (struct completion_record *)list[i].completion_addr;
+		dsa_cpu_run(ctx, &list[i], sub);
+		if ((sub->status & DSA_COMP_STATUS_MASK) != DSA_COMP_SUCCESS)
+			failed = true;
+		done++;
+	}
+
+	comp->descs_completed = done;
+	comp->status = failed ? DSA_COMP_BATCH_FAIL : DSA_COMP_SUCCESS;
+}
+
+void dsa_cpu_run(struct dsa_ctx *ctx, struct hw_desc *hw,
+		struct completion_record *comp)
+{
+	void *dst = (void *)hw->dst_addr;
+	void *src = (void *)hw->src_addr;
+	size_t len = hw->xfer_size;
+	size_t off;
+
+	comp->result = 0;
+	comp->bytes_completed = 0;
+
+	switch (hw->opcode) {
+	case DSA_OPCODE_NOOP:
+	case DSA_OPCODE_DRAIN:
+		break;
+	case DSA_OPCODE_BATCH:
+		cpu_batch(ctx, hw, comp);
+		return;
+	case DSA_OPCODE_MEMMOVE:
+		memmove(dst, src, len);
+		/* what the device reads back has reached memory */
+		if (hw->flags & IDXD_OP_FLAG_DRDBK)
+			cpu_cflush(dst, len);
+		break;
+	case DSA_OPCODE_DUALCAST:
+		memmove(dst, src, len);
+		memmove((void *)hw->dest2, src, len);
+		break;
+	case DSA_OPCODE_MEMFILL:
+		cpu_memfill(dst, hw->pattern, len);
+		break;
+	case DSA_OPCODE_COMPARE:
+		off = cpu_compare(src, (void *)hw->src2_addr, len);
+		comp->result = off < len;
+		comp->bytes_completed = off < len ? off : 0;
+		break;
+	case DSA_OPCODE_COMPVAL:
+		off = cpu_compval(src, hw->comp_pattern, len);
+		comp->result = off < len;
+		comp->bytes_completed = off < len ? off : 0;
+		break;
+	case DSA_OPCODE_COPY_CRC:
+		memmove(dst, src, len);
+		/* fallthrough */
+	case DSA_OPCODE_CRCGEN:
+		comp->crc_val = dsa_cpu_crc32c(src, len, hw->crc_seed);
+		break;
+	case DSA_OPCODE_CR_DELTA:
+		cpu_cr_delta(hw, comp);
+		return;
+	case DSA_OPCODE_DIF_CHECK:
+	case DSA_OPCODE_DIF_INS:
+	case DSA_OPCODE_DIF_STRP:
+	case DSA_OPCODE_DIF_UPDT:
+	case DSA_OPCODE_DIX_GEN:
+		cpu_dif(hw, comp);
+		return;
+	case DSA_OPCODE_AP_DELTA:
+		cpu_ap_delta(hw, comp);
+		return;
+	case DSA_OPCODE_CFLUSH:
+		cpu_cflush(dst, len);
+		break;
+	default:
+		dbg(ctx, "opcode %#x has no CPU path\n", hw->opcode);
+		comp->status = DSA_COMP_BAD_OPCODE;
+		return;
+	}
+
+	comp->status = DSA_COMP_SUCCESS;
+}
@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "private.h"
+
+/*
+ * Block dedup: blocks are fingerprinted with batched CRCGEN and looked up
+ * in a CPU hash table of the unique blocks seen so far. A fingerprint hit
+ * is only a candidate, the block is a duplicate once a batched COMPARE
+ * against the stored block matched.
+ */
+
+#define DSA_DEDUP_BATCH		32
+#define DSA_DEDUP_PROBES	4	/* candidates compared per block */
+#define DSA_DEDUP_BUCKETS	1024
+
+struct dsa_dedup_ent {
+	uint32_t crc;
+	int64_t next;
+	uint64_t id;
+	const void *addr;
+};
+
+struct dsa_dedup {
+	struct dsa_ctx *ctx;
+	size_t block;
+	struct dsa_batch *batch;
+	unsigned int size;
+	/* unique blocks, chained from buckets by crc */
+	struct dsa_dedup_ent *ents;
+	size_t nents;
+	size_t max_ents;
+	int64_t *buckets;
+	size_t nbuckets;
+	uint64_t next_id;
+	/* state of the blocks of one batch */
+	uint32_t *crcs;
+	int64_t *cand;
+	unsigned int *slot;
+	struct dsa_dedup_stats stats;
+};
+
+static uint64_t dsa_dedup_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * dsa_dedup_new - allocate a block dedup engine
+ * @ctx: dsa context
+ * @block_size: bytes per block, up to dsa_ctx_get_max_xfer_size()
+ * @dedup: dedup engine to establish
+ */
+DSA_EXPORT int dsa_dedup_new(struct dsa_ctx *ctx, size_t block_size,
+		struct dsa_dedup **dedup)
+{
+	struct dsa_dedup *d;
+	size_t i;
+	int rc;
+
+	if (!block_size || block_size > ctx->max_xfer_size)
+		return -EINVAL;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return -ENOMEM;
+
+	d->ctx = ctx;
+	d->block = block_size;
+	d->size = ctx->max_batch_size < DSA_DEDUP_BATCH ?
+		ctx->max_batch_size : DSA_DEDUP_BATCH;
+	d->nbuckets = DSA_DEDUP_BUCKETS;
+	d->buckets = malloc(d->nbuckets * sizeof(*d->buckets));
+	d->crcs = calloc(d->size, sizeof(*d->crcs));
+	d->cand = calloc(d->size, sizeof(*d->cand));
+	d->slot = calloc(d->size, sizeof(*d->slot));
+	if (!d->buckets || !d->crcs || !d->cand || !d->slot) {
+		rc = -ENOMEM;
+		goto err;
+	}
+	for (i = 0; i < d->nbuckets; i++)
+		d->buckets[i] = -1;
+
+	rc = dsa_batch_new(ctx, d->size, &d->batch);
+	if (rc)
+		goto err;
+
+	*dedup = d;
+	return 0;
+
+ err:
+	dsa_dedup_free(d);
+	return rc;
+}
+
+DSA_EXPORT void dsa_dedup_free(struct dsa_dedup *dedup)
+{
+	if (!dedup)
+		return;
+
+	dsa_batch_free(dedup->batch);
+	free(dedup->ents);
+	free(dedup->buckets);
+	free(dedup->crcs);
+	free(dedup->cand);
+	free(dedup->slot);
+	free(dedup);
+}
+
+DSA_EXPORT void dsa_dedup_get_stats(struct dsa_dedup *dedup,
+		struct dsa_dedup_stats *stats)
+{
+	*stats = dedup->stats;
+}
+
+/* First entry from ent on with the given crc, or -1 */
+static int64_t dsa_dedup_find(struct dsa_dedup *d, int64_t ent,
+		uint32_t crc)
+{
+	while (ent >= 0 && d->ents[ent].crc != crc)
+		ent = d->ents[ent].next;
+	return ent;
+}
+
+static int64_t dsa_dedup_lookup(struct dsa_dedup *d, uint32_t crc)
+{
+	return dsa_dedup_find(d, d->buckets[crc & (d->nbuckets - 1)], crc);
+}
+
+static int dsa_dedup_rehash(struct dsa_dedup *d)
+{
+	size_t n = d->nbuckets * 2, i, b;
+	int64_t *buckets;
+
+	buckets = malloc(n * sizeof(*buckets));
+	if (!buckets)
+		return -ENOMEM;
+
+	for (i = 0; i < n; i++)
+		buckets[i] = -1;
+	for (i = 0; i < d->nents; i++) {
+		b = d->ents[i].crc & (n - 1);
+		d->ents[i].next = buckets[b];
+		buckets[b] = i;
+	}
+
+	free(d->buckets);
+	d->buckets = buckets;
+	d->nbuckets = n;
+	return 0;
+}
+
+static int dsa_dedup_insert(struct dsa_dedup *d, uint32_t crc, uint64_t id,
+		const void *addr)
+{
+	struct dsa_dedup_ent *ents;
+	size_t b, max;
+	int rc;
+
+	if (d->nents == d->max_ents) {
+		max = d->max_ents * 2 + 64;
+		ents = realloc(d->ents, max * sizeof(*ents));
+		if (!ents)
+			return -ENOMEM;
+		d->ents = ents;
+		d->max_ents = max;
+	}
+	if (d->nents >= d->nbuckets) {
+		rc = dsa_dedup_rehash(d);
+		if (rc)
+			return rc;
+	}
+
+	b = crc & (d->nbuckets - 1);
+	d->ents[d->nents].crc = crc;
+	d->ents[d->nents].id = id;
+	d->ents[d->nents].addr = addr;
+	d->ents[d->nents].next = d->buckets[b];
+	d->buckets[b] = d->nents++;
+	return 0;
+}
+
+/* Compares the blocks in slot[] against those in other[] */
+static int dsa_dedup_compare(struct dsa_dedup *d, const uint8_t *buf,
+		unsigned int m, const void **other)
+{
+	unsigned int k;
+
+	for (k = 0; k < m; k++)
+		dsa_op_compare(dsa_batch_get_op(d->batch, k),
+				buf + d->slot[k] * d->block, other[k],
+				d->block);
+
+	return dsa_batch_run(d->batch, m);
+}
+
+static bool dsa_dedup_match(struct dsa_dedup *d, unsigned int k)
+{
+	return dsa_op_get_result(dsa_batch_get_op(d->batch, k)) ==
+		DSA_OP_RESULT_MATCH;
+}
+
+/* Dedups the n blocks at buf, ids[] holds UINT64_MAX for each */
+static int dsa_dedup_group(struct dsa_dedup *d, const uint8_t *buf,
+		unsigned int n, uint64_t *ids)
+{
+	const void *other[DSA_DEDUP_BATCH];
+	unsigned int i, j, k, m, probe;
+	int rc;
+
+	for (i = 0; i < n; i++)
+		dsa_op_crcgen(dsa_batch_get_op(d->batch, i),
+				buf + i * d->block, d->block, 0);
+	rc = dsa_batch_run(d->batch, n);
+	if (rc)
+		return rc;
+	for (i = 0; i < n; i++) {
+		d->crcs[i] = dsa_op_get_crc(dsa_batch_get_op(d->batch, i));
+		d->cand[i] = dsa_dedup_lookup(d, d->crcs[i]);
+	}
+
+	/* confirm fingerprint hits against the stored blocks */
+	for (probe = 0; probe < DSA_DEDUP_PROBES; probe++) {
+		for (i = 0, m = 0; i < n; i++) {
+			if (ids[i] != UINT64_MAX || d->cand[i] < 0)
+				continue;
+			d->slot[m] = i;
+			other[m++] = d->ents[d->cand[i]].addr;
+		}
+		if (!m)
+			break;
+
+		rc = dsa_dedup_compare(d, buf, m, other);
+		if (rc)
+			return rc;
+		for (k = 0; k < m; k++) {
+			i = d->slot[k];
+			if (dsa_dedup_match(d, k)) {
+				ids[i] = d->ents[d->cand[i]].id;
+				d->stats.duplicates++;
+				continue;
+			}
+			d->stats.collisions++;
+			d->cand[i] = dsa_dedup_find(d,
+					d->ents[d->cand[i]].next, d->crcs[i]);
+		}
+	}
+
+	/*
+	 * What is left is new to the table. The first block of each crc is
+	 * unique, later ones with the same crc are compared against it.
+	 */
+	for (i = 0, m = 0; i < n; i++) {
+		if (ids[i] != UINT64_MAX)
+			continue;
+		for (j = 0; j < i; j++)
+			if (ids[j] == d->next_id + j &&
+					d->crcs[j] == d->crcs[i])
+				break;
+		if (j < i) {
+			d->slot[m] = i;
+			d->cand[m] = j;
+			other[m++] = buf + j * d->block;
+			continue;
+		}
+		ids[i] = d->next_id + i;
+		rc = dsa_dedup_insert(d, d->crcs[i], ids[i],
+				buf + i * d->block);
+		if (rc)
+			return rc;
+	}
+
+	if (m) {
+		rc = dsa_dedup_compare(d, buf, m, other);
+		if (rc)
+			return rc;
+	}
+	for (k = 0; k < m; k++) {
+		i = d->slot[k];
+		if (dsa_dedup_match(d, k)) {
+			ids[i] = ids[d->cand[k]];
+			d->stats.duplicates++;
+			continue;
+		}
+		/* a collision within the batch, keep it unique */
+		d->stats.collisions++;
+		ids[i] = d->next_id + i;
+		rc = dsa_dedup_insert(d, d->crcs[i], ids[i],
+				buf + i * d->block);
+		if (rc)
+			return rc;
+	}
+
+	d->next_id += n;
+	return 0;
+}
+
+/**
+ * dsa_dedup_blocks - dedup a buffer of blocks
+ * @dedup: dedup engine
+ * @buf: blocks, the unique ones are referenced by later calls and must
+ *	 stay valid until dsa_dedup_free()
+ * @len: bytes in @buf, a multiple of the block size
+ * @ids: one entry per block, set to the id of the first identical block
+ *
+ * Blocks are numbered across calls from 0. A block whose id is its own
+ * number is unique and is stored, any other is a duplicate of the block
+ * with that number.
+ */
+DSA_EXPORT int dsa_dedup_blocks(struct dsa_dedup *dedup, const void *buf,
+		size_t len, uint64_t *ids)
+{
+	size_t blocks = len / dedup->block, first, dups;
+	uint64_t start = dsa_dedup_now_ns(), ns;
+	const uint8_t *p = buf;
+	unsigned int n;
+	int rc = 0;
+
+	if (len % dedup->block)
+		return -EINVAL;
+
+	dups = dedup->stats.duplicates;
+	for (first = 0; first < blocks; first += n) {
+		n = blocks - first < dedup->size ? blocks - first :
+			dedup->size;
+		memset(ids + first, 0xff, n * sizeof(*ids));
+		rc = dsa_dedup_group(dedup, p + first * dedup->block, n,
+				ids + first);
+		if (rc)
+			break;
+		dedup->stats.blocks += n;
+	}
+
+	ns = dsa_dedup_now_ns() - start;
+	dedup->stats.ns += ns;
+	dups = dedup->stats.duplicates - dups;
+	info(dedup->ctx, "%zu blocks %zu duplicates ratio %.2f %.0f blocks/s\n",
+			first, dups, first > dups ?
+			(double)first / (first - dups) : 0,
+			ns ? first * 1e9 / ns : 0);
+
+	return rc;
+}
@@ -0,0 +1,465 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "private.h"
+
+/*
+ * DIF pipeline: scatter-gather lists of blocks with interleaved T10
+ * protection info are checked, inserted, stripped or updated by batches
+ * of DIF descriptors. Reference tags increment per block across the
+ * whole list, so each descriptor is seeded with the tag of its first
+ * block.
+ *
+ * DIX keeps the protection info in a buffer of its own. DIX_GEN writes
+ * it, and as the device has no DIX check, verifying regenerates it into
+ * a scratch buffer that the CPU compares with the stored one.
+ */
+
+#define DSA_DIF_BATCH		32
+#define DSA_DIF_PI_SIZE		8
+#define DSA_DIX_BLOCKS		256	/* blocks per DIX verify op */
+
+/* The stored protection info a DIX verify descriptor regenerated */
+struct dsa_dix_slot {
+	const uint8_t *pi;
+	size_t blocks;
+	size_t first;
+};
+
+struct dsa_dif_pipe {
+	struct dsa_ctx *ctx;
+	struct dsa_batch *batch;
+	unsigned int size;
+	unsigned int count;
+	/* DIX verify state, allocated on first use */
+	struct dsa_dix_slot *slots;
+	uint8_t *scratch;
+	uint16_t app_tag_mask;
+	bool dix_check;
+	size_t bad;
+	struct dsa_dif_stats stats;
+};
+
+static uint64_t dsa_dif_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * dsa_dif_pipe_new - allocate a DIF pipeline
+ * @ctx: dsa context
+ * @pipe: pipeline to establish
+ */
+DSA_EXPORT int dsa_dif_pipe_new(struct dsa_ctx *ctx,
+		struct dsa_dif_pipe **pipe)
+{
+	struct dsa_dif_pipe *p;
+	int rc;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+
+	p->ctx = ctx;
+	p->size = ctx->max_batch_size < DSA_DIF_BATCH ?
+		ctx->max_batch_size : DSA_DIF_BATCH;
+	rc = dsa_batch_new(ctx, p->size, &p->batch);
+	if (rc) {
+		free(p);
+		return rc;
+	}
+
+	*pipe = p;
+	return 0;
+}
+
+DSA_EXPORT void dsa_dif_pipe_free(struct dsa_dif_pipe *pipe)
+{
+	if (!pipe)
+		return;
+
+	dsa_batch_free(pipe->batch);
+	free(pipe->slots);
+	free(pipe->scratch);
+	free(pipe);
+}
+
+DSA_EXPORT void dsa_dif_pipe_get_stats(struct dsa_dif_pipe *pipe,
+		struct dsa_dif_stats *stats)
+{
+	*stats = pipe->stats;
+}
+
+/* Whether stored DIX protection info matches the regenerated one */
+static bool dsa_dix_match(const uint8_t *want, const uint8_t *pi,
+		uint16_t app_tag_mask)
+{
+	uint16_t app = (want[2] ^ pi[2]) << 8 | (want[3] ^ pi[3]);
+
+	return !memcmp(want, pi, 2) && !(app & ~app_tag_mask) &&
+		!memcmp(want + 4, pi + 4, 4);
+}
+
+static int dsa_dix_compare(struct dsa_dif_pipe *p)
+{
+	struct dsa_dix_slot *slot;
+	const uint8_t *want;
+	unsigned int k;
+	size_t b;
+
+	for (k = 0; k < p->count; k++) {
+		slot = &p->slots[k];
+		want = p->scratch + k * DSA_DIX_BLOCKS * DSA_DIF_PI_SIZE;
+		for (b = 0; b < slot->blocks; b++)
+			if (!dsa_dix_match(want + b * DSA_DIF_PI_SIZE,
+					slot->pi + b * DSA_DIF_PI_SIZE,
+					p->app_tag_mask)) {
+				p->bad = slot->first + b;
+				return -EBADMSG;
+			}
+	}
+
+	return 0;
+}
+
+static int dsa_dif_pipe_flush(struct dsa_dif_pipe *p)
+{
+	int rc;
+
+	if (!p->count)
+		return 0;
+
+	rc = dsa_batch_run(p->batch, p->count);
+	if (!rc && p->dix_check)
+		rc = dsa_dix_compare(p);
+	p->count = 0;
+	return rc;
+}
+
+static int dsa_dif_pipe_add(struct dsa_dif_pipe *p, int op, void *dst,
+		const void *src, size_t len, const struct dsa_dif *src_dif,
+		const struct dsa_dif *dst_dif)
+{
+	struct dsa_op *o;
+	int rc;
+
+	if (p->count == p->size) {
+		rc = dsa_dif_pipe_flush(p);
+		if (rc)
+			return rc;
+	}
+
+	o = dsa_batch_get_op(p->batch, p->count);
+	switch (op) {
+	case DSA_DIF_OP_CHECK:
+		rc = dsa_op_dif_check(o, src, len, src_dif);
+		break;
+	case DSA_DIF_OP_INSERT:
+		rc = dsa_op_dif_insert(o, dst, src, len, dst_dif);
+		break;
+	case DSA_DIF_OP_STRIP:
+		rc = dsa_op_dif_strip(o, dst, src, len, src_dif);
+		break;
+	default:
+		rc = dsa_op_dif_update(o, dst, src, len, src_dif, dst_dif);
+		break;
+	}
+	if (!rc)
+		p->count++;
+
+	return rc;
+}
+
+static void dsa_dif_pipe_account(struct dsa_dif_pipe *p, size_t blocks,
+		size_t bs, uint64_t start, int rc)
+{
+	uint64_t ns = dsa_dif_now_ns() - start;
+
+	if (rc == -EBADMSG)
+		p->stats.errors++;
+	p->stats.blocks += blocks;
+	p->stats.bytes += blocks * bs;
+	p->stats.ns += ns;
+	info(p->ctx, "%zu blocks %.0f blocks/s %.2f GB/s\n", blocks,
+			ns ? blocks * 1e9 / ns : 0,
+			ns ? (double)blocks * bs / ns : 0);
+}
+
+/* Rechecks one block of a completed operation on the CPU */
+static int dsa_dif_verify_block(int op, const uint8_t *dst,
+		const uint8_t *src, size_t bs, const struct dsa_dif *src_dif,
+		const struct dsa_dif *dst_dif, uint32_t idx)
+{
+	if (op != DSA_DIF_OP_INSERT && dsa_cpu_dif_verify(src + bs, src, bs,
+			src_dif->app_tag_mask, src_dif->app_tag,
+			src_dif->ref_tag + idx))
+		return -EBADMSG;
+	if (op != DSA_DIF_OP_CHECK && memcmp(dst, src, bs))
+		return -EBADMSG;
+	if ((op == DSA_DIF_OP_INSERT || op == DSA_DIF_OP_UPDATE) &&
+			dsa_cpu_dif_verify(dst + bs, dst, bs, 0,
+			dst_dif->app_tag, dst_dif->ref_tag + idx))
+		return -EBADMSG;
+
+	return 0;
+}
+
+static int dsa_dif_verify(struct dsa_dif_pipe *p, int op,
+		const struct dsa_dif_sg *sg, unsigned int count,
+		const struct dsa_dif *src_dif, const struct dsa_dif *dst_dif,
+		size_t bs, size_t in_bs, size_t out_bs)
+{
+	uint32_t idx = 0;
+	unsigned int i;
+	size_t b;
+
+	for (i = 0; i < count; i++) {
+		for (b = 0; b < sg[i].blocks; b++, idx++) {
+			if (!dsa_dif_verify_block(op,
+					(const uint8_t *)sg[i].dst + b * out_bs,
+					(const uint8_t *)sg[i].src + b * in_bs,
+					bs, src_dif, dst_dif, idx))
+				continue;
+			err(p->ctx, "DIF verify failed, entry %u block %zu\n",
+					i, b);
+			return -EBADMSG;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * dsa_dif_pipe_run - process a scatter-gather list of DIF blocks
+ * @pipe: DIF pipeline
+ * @op: DSA_DIF_OP_*
+ * @sg: buffers, src and dst hold whole blocks with or without the 8 bytes
+ *	of protection info after each as @op implies
+ * @count: number of entries in @sg
+ * @src_dif: protection info of the source, for check, strip and update
+ * @dst_dif: protection info to write, for insert and update
+ * @flags: DSA_DIF_VERIFY to recheck the result with a CPU CRC-T10DIF
+ *
+ * The reference tags of @src_dif and @dst_dif are those of the first
+ * block of the list. Returns -EBADMSG when protection info did not check.
+ */
+DSA_EXPORT int dsa_dif_pipe_run(struct dsa_dif_pipe *pipe, int op,
+		const struct dsa_dif_sg *sg, unsigned int count,
+		const struct dsa_dif *src_dif, const struct dsa_dif *dst_dif,
+		int flags)
+{
+	const struct dsa_dif *pi = op == DSA_DIF_OP_INSERT ? dst_dif : src_dif;
+	size_t bs, in_bs, out_bs, per, n, b, total = 0;
+	uint64_t start = dsa_dif_now_ns();
+	struct dsa_dif s, d;
+	unsigned int i;
+	int rc = 0;
+
+	if (op < DSA_DIF_OP_CHECK || op > DSA_DIF_OP_UPDATE || !pi ||
+			!pi->block_size ||
+			(op == DSA_DIF_OP_UPDATE && !dst_dif) ||
+			flags & ~DSA_DIF_VERIFY)
+		return -EINVAL;
+	/* the CPU check knows the default flags only */
+	if ((flags & DSA_DIF_VERIFY) && (pi->flags || pi->op_flags ||
+			(dst_dif && (dst_dif->flags || dst_dif->op_flags))))
+		return -EOPNOTSUPP;
+
+	bs = pi->block_size;
+	in_bs = op == DSA_DIF_OP_INSERT ? bs : bs + DSA_DIF_PI_SIZE;
+	out_bs = op == DSA_DIF_OP_STRIP ? bs : bs + DSA_DIF_PI_SIZE;
+	per = pipe->ctx->max_xfer_size / in_bs;
+	if (!per)
+		return -EINVAL;
+
+	memset(&s, 0, sizeof(s));
+	memset(&d, 0, sizeof(d));
+	for (i = 0; i < count && !rc; i++) {
+		for (b = 0; b < sg[i].blocks; b += n) {
+			n = sg[i].blocks - b < per ? sg[i].blocks - b : per;
+			if (src_dif) {
+				s = *src_dif;
+				s.ref_tag += total + b;
+			}
+			if (dst_dif) {
+				d = *dst_dif;
+				d.ref_tag += total + b;
+			}
+			rc = dsa_dif_pipe_add(pipe, op,
+					(uint8_t *)sg[i].dst + b * out_bs,
+					(const uint8_t *)sg[i].src + b * in_bs,
+					n * in_bs, &s, &d);
+			if (rc)
+				break;
+		}
+		total += sg[i].blocks;
+	}
+
+	if (rc)
+		pipe->count = 0;
+	else
+		rc = dsa_dif_pipe_flush(pipe);
+	if (!rc && (flags & DSA_DIF_VERIFY))
+		rc = dsa_dif_verify(pipe, op, sg, count, src_dif, dst_dif, bs,
+				in_bs, out_bs);
+
+	dsa_dif_pipe_account(pipe, total, bs, start, rc);
+	return rc;
+}
+
+/* Issues DIX_GEN over the list, to sg[].pi or to the scratch buffer */
+static int dsa_dix_run(struct dsa_dif_pipe *p, const struct dsa_dix_sg *sg,
+		unsigned int count, const struct dsa_dif *dif, size_t per,
+		size_t *total)
+{
+	struct dsa_op *op;
+	struct dsa_dif d;
+	unsigned int i;
+	size_t b, n;
+	uint8_t *pi;
+	int rc;
+
+	*total = 0;
+	for (i = 0; i < count; i++) {
+		for (b = 0; b < sg[i].blocks; b += n) {
+			n = sg[i].blocks - b < per ? sg[i].blocks - b : per;
+			if (p->count == p->size) {
+				rc = dsa_dif_pipe_flush(p);
+				if (rc)
+					return rc;
+			}
+
+			pi = (uint8_t *)sg[i].pi + b * DSA_DIF_PI_SIZE;
+			if (p->dix_check) {
+				p->slots[p->count].pi = pi;
+				p->slots[p->count].blocks = n;
+				p->slots[p->count].first = *total + b;
+				pi = p->scratch + p->count * DSA_DIX_BLOCKS *
+					DSA_DIF_PI_SIZE;
+			}
+			d = *dif;
+			d.ref_tag += *total + b;
+			op = dsa_batch_get_op(p->batch, p->count);
+			rc = dsa_op_dix_gen(op, pi,
+					(const uint8_t *)sg[i].data +
+					b * dif->block_size,
+					n * dif->block_size, &d);
+			if (rc)
+				return rc;
+			p->count++;
+		}
+		*total += sg[i].blocks;
+	}
+
+	return dsa_dif_pipe_flush(p);
+}
+
+/**
+ * dsa_dix_gen - generate separate protection info for a list of blocks
+ * @pipe: DIF pipeline
+ * @sg: data blocks and the buffers for their 8 bytes of protection info
+ * @count: number of entries in @sg
+ * @dif: protection info to write, reference tag of the first block
+ * @flags: DSA_DIF_VERIFY to recheck the result with a CPU CRC-T10DIF
+ */
+DSA_EXPORT int dsa_dix_gen(struct dsa_dif_pipe *pipe,
+		const struct dsa_dix_sg *sg, unsigned int count,
+		const struct dsa_dif *dif, int flags)
+{
+	uint64_t start = dsa_dif_now_ns();
+	size_t per, total = 0, b, idx;
+	unsigned int i;
+	int rc;
+
+	if (flags & ~DSA_DIF_VERIFY || !dif->block_size)
+		return -EINVAL;
+	if ((flags & DSA_DIF_VERIFY) && (dif->flags || dif->op_flags))
+		return -EOPNOTSUPP;
+	per = pipe->ctx->max_xfer_size / dif->block_size;
+	if (!per)
+		return -EINVAL;
+
+	pipe->dix_check = false;
+	rc = dsa_dix_run(pipe, sg, count, dif, per, &total);
+	pipe->count = 0;
+
+	for (i = 0, idx = 0; !rc && (flags & DSA_DIF_VERIFY) && i < count;
+			i++)
+		for (b = 0; b < sg[i].blocks; b++, idx++)
+			if (dsa_cpu_dif_verify((const uint8_t *)sg[i].pi +
+					b * DSA_DIF_PI_SIZE,
+					(const uint8_t *)sg[i].data +
+					b * dif->block_size, dif->block_size,
+					0, dif->app_tag, dif->ref_tag + idx)) {
+				err(pipe->ctx, "DIX verify failed, block %zu\n",
+						idx);
+				rc = -EBADMSG;
+				break;
+			}
+
+	dsa_dif_pipe_account(pipe, total, dif->block_size, start, rc);
+	return rc;
+}
+
+/**
+ * dsa_dix_verify - check separate protection info of a list of blocks
+ * @pipe: DIF pipeline
+ * @sg: data blocks and their stored protection info
+ * @count: number of entries in @sg
+ * @dif: expected protection info, reference tag of the first block
+ * @bad_block: set to the index in the list of the first block that did
+ *	       not check, may be NULL
+ *
+ * The device regenerates the protection info and the CPU compares it,
+ * ignoring the app tag bits set in the app tag mask. Returns -EBADMSG
+ * when a block did not check.
+ */
+DSA_EXPORT int dsa_dix_verify(struct dsa_dif_pipe *pipe,
+		const struct dsa_dix_sg *sg, unsigned int count,
+		const struct dsa_dif *dif, size_t *bad_block)
+{
+	uint64_t start = dsa_dif_now_ns();
+	size_t per, total = 0;
+	int rc;
+
+	if (!dif->block_size)
+		return -EINVAL;
+	per = pipe->ctx->max_xfer_size / dif->block_size;
+	if (!per)
+		return -EINVAL;
+	if (per > DSA_DIX_BLOCKS)
+		per = DSA_DIX_BLOCKS;
+
+	if (!pipe->scratch) {
+		pipe->slots = calloc(pipe->size, sizeof(*pipe->slots));
+		pipe->scratch = aligned_alloc(64, pipe->size *
+				DSA_DIX_BLOCKS * DSA_DIF_PI_SIZE);
+		if (!pipe->slots || !pipe->scratch) {
+			free(pipe->slots);
+			free(pipe->scratch);
+			pipe->slots = NULL;
+			pipe->scratch = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	pipe->dix_check = true;
+	pipe->app_tag_mask = dif->app_tag_mask;
+	rc = dsa_dix_run(pipe, sg, count, dif, per, &total);
+	pipe->dix_check = false;
+	pipe->count = 0;
+	if (rc == -EBADMSG) {
+		err(pipe->ctx, "DIX verify failed, block %zu\n", pipe->bad);
+		if (bad_block)
+			*bad_block = pipe->bad;
+	}
+
+	dsa_dif_pipe_account(pipe, total, dif->block_size, start, rc);
+	return rc;
+}
@@ -0,0 +1,1158 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <util/portal.h>
+#include "private.h"
+
+/* ~10us at the usual TSC rates, bounds a umwait that misses a wakeup */
+#define DSA_UMWAIT_CYCLES	30000
+
+static void dsa_detect_cpu(struct dsa_ctx *ctx)
+{
+	unsigned int eax = 7, ebx, ecx = 0, edx;
+
+	cpuid(&eax, &ebx, &ecx, &edx);
+	ctx->umwait = ecx & (1 << 5);
+	ctx->movdir64b = ecx & (1 << 28);
+	ctx->enqcmd = ecx & (1 << 29);
+	ctx->avx512 = __builtin_cpu_supports("avx512f");
+	dbg(ctx, "umwait %d movdir64b %d enqcmd %d avx512 %d\n", ctx->umwait,
+			ctx->movdir64b, ctx->enqcmd, ctx->avx512);
+}
+
+static int dsa_wq_open(struct dsa_ctx *ctx, struct accfg_wq *wq)
+{
+	struct accfg_device *dev = accfg_wq_get_device(wq);
+	char path[PATH_MAX];
+	unsigned int batch;
+	uint64_t xfer;
+	int rc;
+
+	ctx->dedicated = accfg_wq_get_mode(wq) == ACCFG_WQ_DEDICATED;
+	if (ctx->dedicated && !ctx->movdir64b)
+		return -EOPNOTSUPP;
+
+	rc = accfg_wq_get_user_dev_path(wq, path, sizeof(path));
+	if (rc)
+		return rc;
+
+	ctx->fd = open(path, O_RDWR);
+	if (ctx->fd < 0) {
+		rc = -errno;
+		dbg(ctx, "%s: %s\n", path, strerror(errno));
+		return rc;
+	}
+
+	ctx->portal = mmap(NULL, DSA_PORTAL_SIZE, PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ctx->fd, 0);
+	if (ctx->portal == MAP_FAILED) {
+		rc = -errno;
+		ctx->portal = NULL;
+		/* shared wqs can still be fed through write() */
+		if (ctx->dedicated) {
+			close(ctx->fd);
+			ctx->fd = -1;
+			return rc;
+		}
+	}
+
+	xfer = accfg_wq_get_max_transfer_size(wq);
+	if (!xfer || xfer > accfg_device_get_max_transfer_size(dev))
+		xfer = accfg_device_get_max_transfer_size(dev);
+	batch = accfg_wq_get_max_batch_size(wq);
+	if (!batch || batch > accfg_device_get_max_batch_size(dev))
+		batch = accfg_device_get_max_batch_size(dev);
+
+	ctx->wq = wq;
+	ctx->wq_size = accfg_wq_get_size(wq);
+	ctx->max_xfer_size = xfer;
+	ctx->max_batch_size = batch;
+	ctx->gen_cap = accfg_device_get_gen_cap(dev);
+	if (accfg_wq_get_block_on_fault(wq) > 0)
+		ctx->desc_flags |= IDXD_OP_FLAG_BOF;
+
+	info(ctx, "using %s %s size %u xfer %#" PRIx64 " batch %u\n",
+			accfg_wq_get_devname(wq),
+			ctx->dedicated ? "dedicated" : "shared",
+			ctx->wq_size, xfer, batch);
+	return 0;
+}
+
+/* Matches "wq0.1" as well as "dsa0/wq0.1" */
+static bool dsa_wq_match(struct accfg_wq *wq, const char *name)
+{
+	struct accfg_device *dev = accfg_wq_get_device(wq);
+	const char *slash = strchr(name, '/');
+
+	if (!slash)
+		return !strcmp(name, accfg_wq_get_devname(wq));
+
+	return !strncmp(name, accfg_device_get_devname(dev),
+			slash - name) &&
+		!strcmp(slash + 1, accfg_wq_get_devname(wq));
+}
+
+bool dsa_device_usable(struct accfg_device *dev)
+{
+	return accfg_device_get_type(dev) == ACCFG_DEVICE_DSA &&
+		accfg_device_get_state(dev) == ACCFG_DEVICE_ENABLED;
+}
+
+/* An enabled user wq of the mode the DSA_CTX_* flags ask for */
+bool dsa_wq_usable(struct accfg_wq *wq, int flags)
+{
+	enum accfg_wq_mode mode = accfg_wq_get_mode(wq);
+
+	if (accfg_wq_get_state(wq) != ACCFG_WQ_ENABLED ||
+			accfg_wq_get_type(wq) != ACCFG_WQT_USER)
+		return false;
+
+	return !((mode == ACCFG_WQ_SHARED && (flags & DSA_CTX_DEDICATED)) ||
+			(mode == ACCFG_WQ_DEDICATED &&
+			(flags & DSA_CTX_SHARED)));
+}
+
+static int dsa_ctx_open(struct dsa_ctx *ctx, const char *wq_name, int flags)
+{
+	struct accfg_device *dev;
+	struct accfg_wq *wq;
+	int rc;
+
+	rc = accfg_new(&ctx->accfg);
+	if (rc < 0)
+		return rc;
+
+	rc = -ENODEV;
+	accfg_device_foreach(ctx->accfg, dev) {
+		if (!dsa_device_usable(dev))
+			continue;
+
+		accfg_wq_foreach(dev, wq) {
+			if (!dsa_wq_usable(wq, flags))
+				continue;
+			if (wq_name && !dsa_wq_match(wq, wq_name))
+				continue;
+
+			rc = dsa_wq_open(ctx, wq);
+			if (!rc)
+				return 0;
+			dbg(ctx, "%s: %s\n", accfg_wq_get_devname(wq),
+					strerror(-rc));
+		}
+	}
+
+	return rc;
+}
+
+static struct dsa_ctx *dsa_ctx_alloc(void)
+{
+	struct dsa_ctx *c;
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return NULL;
+
+	log_init(&c->ctx, "libaccel-dsa", "ACCDSA_LOG");
+	c->fd = -1;
+	c->copy_threshold = DSA_COPY_THRESHOLD;
+	dsa_detect_cpu(c);
+	return c;
+}
+
+/* Opens a context on a given wq, sharing the caller's accfg_ctx */
+int dsa_ctx_new_wq(struct dsa_ctx **ctx, struct accfg_ctx *accfg,
+		struct accfg_wq *wq)
+{
+	struct dsa_ctx *c;
+	int rc;
+
+	c = dsa_ctx_alloc();
+	if (!c)
+		return -ENOMEM;
+
+	c->accfg = accfg_ref(accfg);
+	rc = dsa_wq_open(c, wq);
+	if (rc) {
+		dsa_ctx_free(c);
+		return rc;
+	}
+
+	*ctx = c;
+	return 0;
+}
+
+/**
+ * dsa_ctx_new - open a DSA work queue for offload
+ * @ctx: context to establish
+ * @wq_name: "wqX.Y" or "dsaX/wqX.Y" to use, NULL for the first usable one
+ * @flags: DSA_CTX_* flags
+ *
+ * Without a usable work queue the context executes operations on the
+ * CPU, unless DSA_CTX_NO_CPU is given.
+ */
+DSA_EXPORT int dsa_ctx_new(struct dsa_ctx **ctx, const char *wq_name,
+		int flags)
+{
+	struct dsa_ctx *c;
+	int rc = 0;
+
+	if ((flags & DSA_CTX_CPU) && (flags & DSA_CTX_NO_CPU))
+		return -EINVAL;
+	if ((flags & DSA_CTX_SHARED) && (flags & DSA_CTX_DEDICATED))
+		return -EINVAL;
+
+	c = dsa_ctx_alloc();
+	if (!c)
+		return -ENOMEM;
+
+	if (!(flags & DSA_CTX_CPU))
+		rc = dsa_ctx_open(c, wq_name, flags);
+
+	if (!c->wq) {
+		if (flags & DSA_CTX_NO_CPU) {
+			dsa_ctx_free(c);
+			return rc ? rc : -ENODEV;
+		}
+		c->cpu = true;
+		c->max_xfer_size = DSA_CPU_MAX_XFER;
+		c->max_batch_size = DSA_CPU_MAX_BATCH;
+		c->copy_threshold = SIZE_MAX;
+		info(c, "no usable work queue, running on the CPU\n");
+	}
+
+	*ctx = c;
+	return 0;
+}
+
+DSA_EXPORT void dsa_ctx_free(struct dsa_ctx *ctx)
+{
+	if (!ctx)
+		return;
+
+	if (ctx->inflight)
+		err(ctx, "%d descriptors still in flight\n", ctx->inflight);
+	if (ctx->portal)
+		munmap(ctx->portal, DSA_PORTAL_SIZE);
+	if (ctx->fd >= 0)
+		close(ctx->fd);
+	accfg_unref(ctx->accfg);
+	free(ctx);
+}
+
+DSA_EXPORT bool dsa_ctx_is_cpu(struct dsa_ctx *ctx)
+{
+	return ctx->cpu;
+}
+
+DSA_EXPORT const char *dsa_ctx_get_wq_name(struct dsa_ctx *ctx)
+{
+	return ctx->wq ? accfg_wq_get_devname(ctx->wq) : NULL;
+}
+
+DSA_EXPORT uint64_t dsa_ctx_get_max_xfer_size(struct dsa_ctx *ctx)
+{
+	return ctx->max_xfer_size;
+}
+
+DSA_EXPORT unsigned int dsa_ctx_get_max_batch_size(struct dsa_ctx *ctx)
+{
+	return ctx->max_batch_size;
+}
+
+/* The DSA_CAP_* the device has, the CPU path has all of them */
+DSA_EXPORT uint64_t dsa_ctx_get_caps(struct dsa_ctx *ctx)
+{
+	return ctx->cpu ? DSA_CAP_ALL : ctx->gen_cap & DSA_CAP_ALL;
+}
+
+DSA_EXPORT int dsa_ctx_get_log_priority(struct dsa_ctx *ctx)
+{
+	return ctx->ctx.log_priority;
+}
+
+DSA_EXPORT void dsa_ctx_set_log_priority(struct dsa_ctx *ctx, int priority)
+{
+	ctx->ctx.log_priority = priority;
+}
+
+void dsa_op_init(struct dsa_op *op, struct dsa_ctx *ctx,
+		struct hw_desc *desc)
+{
+	memset(op, 0, sizeof(*op));
+	op->ctx = ctx;
+	op->desc = desc;
+	op->comp = &op->cr;
+}
+
+DSA_EXPORT int dsa_op_new(struct dsa_ctx *ctx, struct dsa_op **op)
+{
+	struct dsa_op *o;
+
+	o = aligned_alloc(64, sizeof(*o));
+	if (!o)
+		return -ENOMEM;
+
+	dsa_op_init(o, ctx, &o->hw);
+	*op = o;
+	return 0;
+}
+
+DSA_EXPORT void dsa_op_free(struct dsa_op *op)
+{
+	if (!op)
+		return;
+
+	/* the device may still write the completion record */
+	if (op->submitted) {
+		err(op->ctx, "op %p freed while in flight\n", op);
+		return;
+	}
+	free(op);
+}
+
+static int dsa_op_prep(struct dsa_op *op, uint8_t opcode, const void *dst,
+		const void *src, size_t len)
+{
+	struct hw_desc *hw = op->desc;
+
+	if (op->submitted)
+		return -EBUSY;
+	if (len > op->ctx->max_xfer_size)
+		return -E2BIG;
+
+	memset(hw, 0, sizeof(*hw));
+	hw->flags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR | op->ctx->desc_flags;
+	hw->opcode = opcode;
+	hw->src_addr = (uint64_t)src;
+	hw->dst_addr = (uint64_t)dst;
+	hw->xfer_size = len;
+	hw->completion_addr = (uint64_t)op->comp;
+	memset(op->comp, 0, sizeof(*op->comp));
+	op->fence = false;
+	op->resubmit = false;
+	op->faults = 0;
+	op->done = 0;
+
+	return 0;
+}
+
+/*
+ * Returns -EOPNOTSUPP for DSA_OP_FLAG_CACHE and DSA_OP_FLAG_READBACK
+ * when dsa_ctx_get_caps() lacks the matching capability.
+ */
+DSA_EXPORT int dsa_op_set_flags(struct dsa_op *op, uint32_t flags)
+{
+	uint64_t caps = dsa_ctx_get_caps(op->ctx);
+
+	if (flags & ~(DSA_OP_FLAG_FENCE | DSA_OP_FLAG_CACHE |
+			DSA_OP_FLAG_READBACK))
+		return -EINVAL;
+	if (((flags & DSA_OP_FLAG_CACHE) && !(caps & DSA_CAP_CACHE_CTRL)) ||
+			((flags & DSA_OP_FLAG_READBACK) &&
+			 !(caps & DSA_CAP_READBACK)))
+		return -EOPNOTSUPP;
+	if (op->submitted)
+		return -EBUSY;
+
+	op->desc->flags |= flags;
+	if (flags & DSA_OP_FLAG_FENCE)
+		op->fence = true;
+	return 0;
+}
+
+DSA_EXPORT int dsa_op_noop(struct dsa_op *op)
+{
+	return dsa_op_prep(op, DSA_OPCODE_NOOP, NULL, NULL, 0);
+}
+
+/* Completes once the descriptors submitted before it have completed */
+DSA_EXPORT int dsa_op_drain(struct dsa_op *op)
+{
+	return dsa_op_prep(op, DSA_OPCODE_DRAIN, NULL, NULL, 0);
+}
+
+/* Writes the cache lines of the range back to memory and evicts them */
+DSA_EXPORT int dsa_op_cflush(struct dsa_op *op, const void *addr, size_t len)
+{
+	if (!(dsa_ctx_get_caps(op->ctx) & DSA_CAP_CACHE_FLUSH))
+		return -EOPNOTSUPP;
+
+	return dsa_op_prep(op, DSA_OPCODE_CFLUSH, addr, NULL, len);
+}
+
+DSA_EXPORT int dsa_op_memmove(struct dsa_op *op, void *dst, const void *src,
+		size_t len)
+{
+	return dsa_op_prep(op, DSA_OPCODE_MEMMOVE, dst, src, len);
+}
+
+/* The two destinations must agree in bits 11:0 */
+DSA_EXPORT int dsa_op_dualcast(struct dsa_op *op, void *dst1, void *dst2,
+		const void *src, size_t len)
+{
+	int rc;
+
+	if (((uintptr_t)dst1 ^ (uintptr_t)dst2) & DSA_DUALCAST_MASK)
+		return -EINVAL;
+
+	rc = dsa_op_prep(op, DSA_OPCODE_DUALCAST, dst1, src, len);
+	if (rc)
+		return rc;
+
+	op->desc->dest2 = (uint64_t)dst2;
+	return 0;
+}
+
+DSA_EXPORT int dsa_op_memfill(struct dsa_op *op, void *dst, uint64_t pattern,
+		size_t len)
+{
+	int rc;
+
+	rc = dsa_op_prep(op, DSA_OPCODE_MEMFILL, dst, NULL, len);
+	if (rc)
+		return rc;
+
+	op->desc->pattern = pattern;
+	return 0;
+}
+
+DSA_EXPORT int dsa_op_compare(struct dsa_op *op, const void *src1,
+		const void *src2, size_t len)
+{
+	return dsa_op_prep(op, DSA_OPCODE_COMPARE, src2, src1, len);
+}
+
+DSA_EXPORT int dsa_op_compval(struct dsa_op *op, const void *src,
+		uint64_t pattern, size_t len)
+{
+	int rc;
+
+	rc = dsa_op_prep(op, DSA_OPCODE_COMPVAL, NULL, src, len);
+	if (rc)
+		return rc;
+
+	op->desc->comp_pattern = pattern;
+	return 0;
+}
+
+DSA_EXPORT int dsa_op_crcgen(struct dsa_op *op, const void *src, size_t len,
+		uint32_t seed)
+{
+	int rc;
+
+	rc = dsa_op_prep(op, DSA_OPCODE_CRCGEN, NULL, src, len);
+	if (rc)
+		return rc;
+
+	op->desc->crc_seed = seed;
+	return 0;
+}
+
+DSA_EXPORT int dsa_op_copy_crc(struct dsa_op *op, void *dst, const void *src,
+		size_t len, uint32_t seed)
+{
+	int rc;
+
+	rc = dsa_op_prep(op, DSA_OPCODE_COPY_CRC, dst, src, len);
+	if (rc)
+		return rc;
+
+	op->desc->crc_seed = seed;
+	return 0;
+}
+
+/* The delta record holds the words of src2 that differ from src1 */
+DSA_EXPORT int dsa_op_cr_delta(struct dsa_op *op, const void *src1,
+		const void *src2, size_t len, void *delta,
+		size_t max_delta_size)
+{
+	int rc;
+
+	if (len % sizeof(uint64_t) || max_delta_size > UINT32_MAX)
+		return -EINVAL;
+
+	rc = dsa_op_prep(op, DSA_OPCODE_CR_DELTA, src2, src1, len);
+	if (rc)
+		return rc;
+
+	op->desc->delta_addr = (uint64_t)delta;
+	op->desc->max_delta_size = max_delta_size;
+	return 0;
+}
+
+DSA_EXPORT int dsa_op_ap_delta(struct dsa_op *op, void *dst,
+		const void *delta, size_t delta_size, size_t len)
+{
+	int rc;
+
+	if (len % sizeof(uint64_t) || delta_size % DSA_DELTA_ENTRY_SIZE)
+		return -EINVAL;
+
+	rc = dsa_op_prep(op, DSA_OPCODE_AP_DELTA, dst, delta, len);
+	if (rc)
+		return rc;
+
+	op->desc->delta_rec_size = delta_size;
+	return 0;
+}
+
+/* Encodes block_size as the block size field of the DIF flags */
+static int dsa_dif_block(const struct dsa_dif *dif)
+{
+	switch (dif->block_size) {
+	case 512:
+		return 0;
+	case 520:
+		return 1;
+	case 4096:
+		return 2;
+	case 4104:
+		return 3;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int dsa_op_prep_dif(struct dsa_op *op, uint8_t opcode, void *dst,
+		const void *src, size_t len, const struct dsa_dif *dif)
+{
+	int blk, rc;
+
+	/* the CPU path only knows the default flags */
+	if (op->ctx->cpu && (dif->flags || dif->op_flags))
+		return -EOPNOTSUPP;
+
+	blk = dsa_dif_block(dif);
+	if (blk < 0)
+		return blk;
+
+	rc = dsa_op_prep(op, opcode, dst, src, len);
+	if (rc)
+		return rc;
+
+	return blk;
+}
+
+DSA_EXPORT int dsa_op_dif_check(struct dsa_op *op, const void *src,
+		size_t len, const struct dsa_dif *dif)
+{
+	struct hw_desc *hw = op->desc;
+	int blk;
+
+	blk = dsa_op_prep_dif(op, DSA_OPCODE_DIF_CHECK, NULL, src, len, dif);
+	if (blk < 0)
+		return blk;
+
+	hw->src_dif_flags = dif->flags;
+	hw->dif_chk_flags = dif->op_flags | blk;
+	hw->chk_ref_tag_seed = dif->ref_tag;
+	hw->chk_app_tag_mask = dif->app_tag_mask;
+	hw->chk_app_tag_seed = dif->app_tag;
+	return 0;
+}
+
+DSA_EXPORT int dsa_op_dif_insert(struct dsa_op *op, void *dst,
+		const void *src, size_t len, const struct dsa_dif *dif)
+{
+	struct hw_desc *hw = op->desc;
+	int blk;
+
+	blk = dsa_op_prep_dif(op, DSA_OPCODE_DIF_INS, dst, src, len, dif);
+	if (blk < 0)
+		return blk;
+
+	hw->dest_dif_flag = dif->flags;
+	hw->dif_ins_flags = dif->op_flags | blk;
+	hw->ins_ref_tag_seed = dif->ref_tag;
+	hw->ins_app_tag_mask = dif->app_tag_mask;
+	hw->ins_app_tag_seed = dif->app_tag;
+	return 0;
+}
+
+DSA_EXPORT int dsa_op_dif_strip(struct dsa_op *op, void *dst,
+		const void *src, size_t len, const struct dsa_dif *dif)
+{
+	struct hw_desc *hw = op->desc;
+	int blk;
+
+	blk = dsa_op_prep_dif(op, DSA_OPCODE_DIF_STRP, dst, src, len, dif);
+	if (blk < 0)
+		return blk;
+
+	hw->src_dif_flags = dif->flags;
+	hw->dif_chk_flags = dif->op_flags | blk;
+	hw->chk_ref_tag_seed = dif->ref_tag;
+	hw->chk_app_tag_mask = dif->app_tag_mask;
+	hw->chk_app_tag_seed = dif->app_tag;
+	return 0;
+}
+
+DSA_EXPORT int dsa_op_dif_update(struct dsa_op *op, void *dst,
+		const void *src, size_t len, const struct dsa_dif *src_dif,
+		const struct dsa_dif *dst_dif)
+{
+	struct hw_desc *hw = op->desc;
+	int blk;
+
+	if (src_dif->block_size != dst_dif->block_size)
+		return -EINVAL;
+	if (op->ctx->cpu && (dst_dif->flags || dst_dif->op_flags))
+		return -EOPNOTSUPP;
+
+	blk = dsa_op_prep_dif(op, DSA_OPCODE_DIF_UPDT, dst, src, len,
+			src_dif);
+	if (blk < 0)
+		return blk;
+
+	hw->src_upd_flags = src_dif->flags;
+	hw->upd_dest_flags = dst_dif->flags;
+	hw->dif_upd_flags = src_dif->op_flags | blk;
+	hw->src_ref_tag_seed = src_dif->ref_tag;
+	hw->src_app_tag_mask = src_dif->app_tag_mask;
+	hw->src_app_tag_seed = src_dif->app_tag;
+	hw->dest_ref_tag_seed = dst_dif->ref_tag;
+	hw->dest_app_tag_mask = dst_dif->app_tag_mask;
+	hw->dest_app_tag_seed = dst_dif->app_tag;
+	return 0;
+}
+
+/* Writes the protection info of the blocks at src to a separate buffer */
+DSA_EXPORT int dsa_op_dix_gen(struct dsa_op *op, void *pi, const void *src,
+		size_t len, const struct dsa_dif *dif)
+{
+	struct hw_desc *hw = op->desc;
+	int blk;
+
+	blk = dsa_op_prep_dif(op, DSA_OPCODE_DIX_GEN, pi, src, len, dif);
+	if (blk < 0)
+		return blk;
+
+	hw->dest_dif_flags = dif->flags;
+	hw->dif_flags = dif->op_flags | blk;
+	hw->ref_tag_seed = dif->ref_tag;
+	hw->app_tag_mask = dif->app_tag_mask;
+	hw->app_tag_seed = dif->app_tag;
+	return 0;
+}
+
+static int dsa_submit_desc(struct dsa_ctx *ctx, struct hw_desc *hw)
+{
+	int i;
+
+	if (ctx->dedicated) {
+		/* a dedicated wq silently drops what does not fit */
+		if (__atomic_add_fetch(&ctx->inflight, 1, __ATOMIC_ACQUIRE) >
+				(int)ctx->wq_size) {
+			__atomic_sub_fetch(&ctx->inflight, 1, __ATOMIC_RELEASE);
+			return -EBUSY;
+		}
+		movdir64b(ctx->portal, hw);
+		return 0;
+	}
+
+	if (ctx->portal && ctx->enqcmd) {
+		for (i = 0; i < DSA_ENQCMD_RETRIES; i++)
+			if (!enqcmd(ctx->portal, hw))
+				return 0;
+		return -EBUSY;
+	}
+
+	if (write(ctx->fd, hw, sizeof(*hw)) != sizeof(*hw))
+		return errno == EAGAIN ? -EBUSY : -errno;
+	return 0;
+}
+
+/* Called once the completion record of a submitted op was written */
+static void dsa_op_retire(struct dsa_op *op)
+{
+	if (!op->submitted)
+		return;
+
+	op->submitted = false;
+	if (op->ctx->dedicated)
+		__atomic_sub_fetch(&op->ctx->inflight, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * dsa_op_submit - queue a prepared op
+ * @op: op set up by one of the dsa_op_<opcode>() calls
+ *
+ * Returns -EBUSY when the work queue is full, the op can be submitted
+ * again later. On the CPU the op has completed on return.
+ */
+DSA_EXPORT int dsa_op_submit(struct dsa_op *op)
+{
+	struct dsa_ctx *ctx = op->ctx;
+	int rc;
+
+	if (op->submitted)
+		return -EBUSY;
+
+	op->resubmit = false;
+	op->comp->status = 0;
+	if (ctx->cpu) {
+		dsa_cpu_run(ctx, op->desc, op->comp);
+		return 0;
+	}
+
+	rc = dsa_submit_desc(ctx, op->desc);
+	if (rc)
+		return rc;
+
+	op->submitted = true;
+	return 0;
+}
+
+static void dsa_touch(struct completion_record *comp)
+{
+	volatile uint8_t *addr = (volatile uint8_t *)comp->fault_addr;
+
+	if (comp->status & DSA_COMP_STATUS_WRITE)
+		__atomic_fetch_add(addr, 0, __ATOMIC_RELAXED);
+	else
+		(void)*addr;
+}
+
+/* Resubmits a faulted op, it stays pending while the wq is full */
+static int dsa_op_resubmit(struct dsa_op *op)
+{
+	int rc = dsa_op_submit(op);
+
+	op->resubmit = rc == -EBUSY;
+	if (rc && !op->resubmit)
+		return rc;
+	return 1;
+}
+
+/*
+ * The descriptor stopped at comp->fault_addr without block on fault.
+ * Fault the page in and resubmit what is left, like the test harness
+ * reprep helpers do. Ops whose partial results cannot be carried over
+ * restart from the beginning, they are idempotent.
+ */
+static int dsa_op_fault(struct dsa_op *op)
+{
+	struct completion_record *comp = op->comp;
+	struct hw_desc *hw = op->desc;
+	uint32_t done = comp->bytes_completed;
+
+	if (++op->faults > DSA_FAULT_RETRIES) {
+		err(op->ctx, "op %p keeps faulting at %#" PRIx64 "\n", op,
+				(uint64_t)comp->fault_addr);
+		return -EFAULT;
+	}
+
+	dbg(op->ctx, "op %p fault at %#" PRIx64 " after %u bytes\n", op,
+			(uint64_t)comp->fault_addr, done);
+	dsa_touch(comp);
+
+	switch (hw->opcode) {
+	case DSA_OPCODE_MEMMOVE:
+		/* result 1 means an overlapping copy going downwards */
+		if (!comp->result) {
+			hw->src_addr += done;
+			hw->dst_addr += done;
+		}
+		hw->xfer_size -= done;
+		break;
+	case DSA_OPCODE_MEMFILL:
+		hw->dst_addr += done;
+		hw->xfer_size -= done;
+		break;
+	case DSA_OPCODE_DUALCAST:
+		hw->src_addr += done;
+		hw->dst_addr += done;
+		hw->dest2 += done;
+		hw->xfer_size -= done;
+		break;
+	case DSA_OPCODE_COMPARE:
+		hw->src2_addr += done;
+		/* fallthrough */
+	case DSA_OPCODE_COMPVAL:
+		hw->src_addr += done;
+		hw->xfer_size -= done;
+		op->done += done;
+		break;
+	case DSA_OPCODE_COPY_CRC:
+		hw->dst_addr += done;
+		/* fallthrough */
+	case DSA_OPCODE_CRCGEN:
+		hw->src_addr += done;
+		hw->xfer_size -= done;
+		hw->crc_seed = comp->crc_val;
+		break;
+	default:
+		break;
+	}
+
+	return dsa_op_resubmit(op);
+}
+
+/* Returns 0 once op completed successfully, 1 while pending, or -errno */
+static int dsa_op_check(struct dsa_op *op)
+{
+	switch (op->comp->status & DSA_COMP_STATUS_MASK) {
+	case DSA_COMP_NONE:
+		return op->submitted ? 1 : -EINVAL;
+	case DSA_COMP_SUCCESS:
+		return 0;
+	case DSA_COMP_PAGE_FAULT_NOBOF:
+		return dsa_op_fault(op);
+	default:
+		dbg(op->ctx, "op %p opcode %#x status %#x\n", op,
+				op->desc->opcode, op->comp->status);
+		return -EIO;
+	}
+}
+
+/**
+ * dsa_op_poll - check for completion of a submitted op
+ * @op: submitted op
+ *
+ * Returns 1 while the op is in flight, 0 when it completed successfully
+ * and -EIO when it failed, see dsa_op_get_status().
+ */
+DSA_EXPORT int dsa_op_poll(struct dsa_op *op)
+{
+	if (op->resubmit)
+		return dsa_op_resubmit(op);
+
+	/* test once, the record may be written between two reads */
+	if (!op->comp->status)
+		return op->submitted ? 1 : -EINVAL;
+	dsa_op_retire(op);
+
+	return dsa_op_check(op);
+}
+
+static uint64_t dsa_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+/* Waits a little for comp to be written */
+static void dsa_pause(struct dsa_ctx *ctx, struct completion_record *comp)
+{
+	if (ctx->umwait) {
+		umonitor(&comp->status);
+		if (!comp->status)
+			umwait(rdtsc() + DSA_UMWAIT_CYCLES, 0);
+	} else {
+		asm volatile("pause" ::: "memory");
+	}
+}
+
+/**
+ * dsa_op_wait - wait for a submitted op to complete
+ * @op: submitted op
+ * @timeout_ms: how long to wait, negative to wait forever
+ *
+ * Returns the dsa_op_poll() result, or -ETIMEDOUT with the op still in
+ * flight.
+ */
+DSA_EXPORT int dsa_op_wait(struct dsa_op *op, int timeout_ms)
+{
+	uint64_t start = dsa_now_ms();
+	int rc;
+
+	while ((rc = dsa_op_poll(op)) > 0) {
+		if (timeout_ms >= 0 &&
+				dsa_now_ms() - start >= (uint64_t)timeout_ms)
+			return -ETIMEDOUT;
+		dsa_pause(op->ctx, op->comp);
+	}
+
+	return rc;
+}
+
+DSA_EXPORT int dsa_op_get_status(struct dsa_op *op)
+{
+	return op->comp->status & DSA_COMP_STATUS_MASK;
+}
+
+DSA_EXPORT int dsa_op_get_result(struct dsa_op *op)
+{
+	return op->comp->result;
+}
+
+DSA_EXPORT uint32_t dsa_op_get_crc(struct dsa_op *op)
+{
+	return op->comp->crc_val;
+}
+
+DSA_EXPORT uint32_t dsa_op_get_delta_size(struct dsa_op *op)
+{
+	return op->comp->delta_rec_size;
+}
+
+/* For compare and compval, the offset of the first difference */
+DSA_EXPORT uint32_t dsa_op_get_bytes_completed(struct dsa_op *op)
+{
+	return op->done + op->comp->bytes_completed;
+}
+
+/**
+ * dsa_batch_new - allocate a batch of ops
+ * @ctx: dsa context
+ * @size: maximum number of ops, up to dsa_ctx_get_max_batch_size()
+ * @batch: batch to establish
+ *
+ * The ops returned by dsa_batch_get_op() are set up with the usual
+ * dsa_op_<opcode>() calls and submitted together by dsa_batch_submit().
+ */
+DSA_EXPORT int dsa_batch_new(struct dsa_ctx *ctx, unsigned int size,
+		struct dsa_batch **batch)
+{
+	struct dsa_batch *b;
+	unsigned int i;
+
+	if (!size || size > ctx->max_batch_size)
+		return -EINVAL;
+
+	b = aligned_alloc(64, sizeof(*b));
+	if (!b)
+		return -ENOMEM;
+	memset(b, 0, sizeof(*b));
+
+	b->descs = aligned_alloc(64, size * sizeof(*b->descs));
+	b->ops = aligned_alloc(64, size * sizeof(*b->ops));
+	if (!b->descs || !b->ops) {
+		free(b->descs);
+		free(b->ops);
+		free(b);
+		return -ENOMEM;
+	}
+	memset(b->descs, 0, size * sizeof(*b->descs));
+
+	dsa_op_init(&b->op, ctx, &b->op.hw);
+	for (i = 0; i < size; i++)
+		dsa_op_init(&b->ops[i], ctx, &b->descs[i]);
+	b->ctx = ctx;
+	b->size = size;
+
+	*batch = b;
+	return 0;
+}
+
+DSA_EXPORT void dsa_batch_free(struct dsa_batch *batch)
+{
+	unsigned int i;
+
+	if (!batch)
+		return;
+
+	if (batch->op.submitted) {
+		err(batch->ctx, "batch %p freed while in flight\n", batch);
+		return;
+	}
+	for (i = 0; i < batch->size; i++)
+		if (batch->ops[i].submitted) {
+			err(batch->ctx, "batch %p freed while in flight\n",
+					batch);
+			return;
+		}
+
+	free(batch->descs);
+	free(batch->ops);
+	free(batch);
+}
+
+DSA_EXPORT struct dsa_op *dsa_batch_get_op(struct dsa_batch *batch,
+		unsigned int idx)
+{
+	if (idx >= batch->size)
+		return NULL;
+	return &batch->ops[idx];
+}
+
+/**
+ * dsa_batch_submit - submit the first count ops of a batch
+ * @batch: batch with count ops set up
+ * @count: number of ops to submit
+ */
+DSA_EXPORT int dsa_batch_submit(struct dsa_batch *batch, unsigned int count)
+{
+	struct dsa_op *op = &batch->op;
+	struct hw_desc *hw = op->desc;
+	unsigned int i;
+
+	if (!count || count > batch->size)
+		return -EINVAL;
+	if (op->submitted)
+		return -EBUSY;
+
+	for (i = 0; i < count; i++) {
+		if (batch->ops[i].submitted)
+			return -EBUSY;
+		batch->ops[i].comp->status = 0;
+		/* a recovery may have cleared it from the descriptor */
+		if (batch->ops[i].fence)
+			batch->descs[i].flags |= IDXD_OP_FLAG_FENCE;
+	}
+	batch->count = count;
+	batch->recover = false;
+
+	/* the device rejects batches of one descriptor, and fences in others */
+	if (count == 1) {
+		batch->descs[0].flags &= ~IDXD_OP_FLAG_FENCE;
+		return dsa_op_submit(&batch->ops[0]);
+	}
+
+	memset(hw, 0, sizeof(*hw));
+	/* block on fault is reserved in the batch descriptor itself */
+	hw->flags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR;
+	hw->opcode = DSA_OPCODE_BATCH;
+	hw->desc_list_addr = (uint64_t)batch->descs;
+	hw->desc_count = count;
+	hw->completion_addr = (uint64_t)op->comp;
+
+	return dsa_op_submit(op);
+}
+
+/*
+ * After a failed batch, fault in and resubmit the entries that stopped
+ * on a page fault and submit those the device never got to. These go in
+ * as plain descriptors, so a fenced entry waits until everything before
+ * it completed and is left unsubmitted once something before it failed,
+ * for dsa_batch_redo() to run in order.
+ */
+static int dsa_batch_recover(struct dsa_batch *batch)
+{
+	struct dsa_op *op;
+	unsigned int i;
+	int pending = 0, rc, ret = 0;
+
+	for (i = 0; i < batch->count; i++) {
+		op = &batch->ops[i];
+		op->desc->flags &= ~IDXD_OP_FLAG_FENCE;
+		if (!op->comp->status && !op->submitted) {
+			if (op->fence && (pending || ret < 0))
+				break;
+			rc = dsa_op_submit(op);
+			if (rc == -EBUSY) {
+				pending++;
+				break;
+			}
+			if (rc) {
+				ret = rc;
+				continue;
+			}
+		}
+
+		rc = dsa_op_poll(op);
+		if (rc > 0)
+			pending++;
+		else if (rc < 0)
+			ret = rc;
+	}
+
+	return pending ? 1 : ret;
+}
+
+/**
+ * dsa_batch_poll - check for completion of a submitted batch
+ * @batch: submitted batch
+ *
+ * Returns 1 while the batch is in flight, 0 when every op completed
+ * successfully or a negative errno when at least one failed, the failed
+ * ops are found with dsa_op_get_status().
+ */
+DSA_EXPORT int dsa_batch_poll(struct dsa_batch *batch)
+{
+	struct dsa_op *op = &batch->op;
+
+	if (batch->count == 1)
+		return dsa_op_poll(&batch->ops[0]);
+	if (batch->recover)
+		return dsa_batch_recover(batch);
+
+	if (!op->comp->status)
+		return op->submitted ? 1 : -EINVAL;
+	dsa_op_retire(op);
+
+	switch (op->comp->status & DSA_COMP_STATUS_MASK) {
+	case DSA_COMP_SUCCESS:
+		return 0;
+	case DSA_COMP_BATCH_FAIL:
+	case DSA_COMP_BATCH_PAGE_FAULT:
+		batch->recover = true;
+		return dsa_batch_recover(batch);
+	default:
+		dbg(batch->ctx, "batch %p status %#x\n", batch,
+				op->comp->status);
+		return -EIO;
+	}
+}
+
+DSA_EXPORT int dsa_batch_wait(struct dsa_batch *batch, int timeout_ms)
+{
+	uint64_t start = dsa_now_ms();
+	int rc;
+
+	while ((rc = dsa_batch_poll(batch)) > 0) {
+		if (timeout_ms >= 0 &&
+				dsa_now_ms() - start >= (uint64_t)timeout_ms)
+			return -ETIMEDOUT;
+		dsa_pause(batch->ctx, batch->op.comp);
+	}
+
+	return rc;
+}
+
+/*
+ * Reruns on the CPU what the device failed of the first count ops of a
+ * completed batch. Returns -EIO if the CPU failed too, or -EBADMSG when
+ * protection info did not check, which is not rerun.
+ */
+int dsa_batch_redo(struct dsa_batch *batch, unsigned int count)
+{
+	struct dsa_op *op;
+	unsigned int i;
+	int rc = 0;
+
+	for (i = 0; i < count; i++) {
+		op = &batch->ops[i];
+		if (op->submitted || dsa_op_get_status(op) ==
+				DSA_OP_STATUS_SUCCESS)
+			continue;
+		if (dsa_op_get_status(op) == DSA_OP_STATUS_DIF_ERR) {
+			rc = -EBADMSG;
+			continue;
+		}
+		dbg(batch->ctx, "opcode %#x at %#" PRIx64 " failed: %#x\n",
+				op->desc->opcode, op->desc->dst_addr,
+				op->comp->status);
+		dsa_cpu_run(batch->ctx, op->desc, op->comp);
+		if (dsa_op_get_status(op) == DSA_OP_STATUS_DIF_ERR)
+			rc = -EBADMSG;
+		else if (dsa_op_get_status(op) != DSA_OP_STATUS_SUCCESS && !rc)
+			rc = -EIO;
+	}
+
+	return rc;
+}
+
+/* Submits and waits for the first count ops of a batch, see above */
+int dsa_batch_run(struct dsa_batch *batch, unsigned int count)
+{
+	int rc;
+
+	rc = dsa_batch_submit(batch, count);
+	if (!rc)
+		rc = dsa_batch_wait(batch, -1);
+	if (!rc)
+		return 0;
+
+	return dsa_batch_redo(batch, count);
+}
@@ -0,0 +1,280 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include "private.h"
+
+/*
+ * Persistence: dirty ranges are written back with CFLUSH descriptors and
+ * payloads are copied to memory with MEMMOVEs that bypass the cache,
+ * packed into batches. One batch is filled while the previous one runs,
+ * so flushing a log segment overlaps with writing the next. Everything
+ * queued is durable once dsa_persist_drain() returns.
+ */
+
+#define DSA_PERSIST_BATCH	32
+#define DSA_PERSIST_LINE	64
+
+struct dsa_persist {
+	struct dsa_ctx *ctx;
+	struct dsa_batch *batch[2];
+	struct dsa_op *drain;
+	unsigned int size;
+	/* ops set up in batch[cur], ops in flight in the other one */
+	unsigned int cur;
+	unsigned int count;
+	unsigned int inflight;
+	bool readback;
+	bool fence;
+	int err;
+	struct dsa_persist_stats stats;
+};
+
+static uint64_t dsa_persist_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * dsa_persist_new - allocate a persistence service
+ * @ctx: dsa context, its device must have DSA_CAP_CACHE_FLUSH
+ * @persist: persistence service to establish
+ */
+DSA_EXPORT int dsa_persist_new(struct dsa_ctx *ctx,
+		struct dsa_persist **persist)
+{
+	struct dsa_persist *p;
+	int rc;
+
+	if (!(dsa_ctx_get_caps(ctx) & DSA_CAP_CACHE_FLUSH))
+		return -EOPNOTSUPP;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+
+	p->ctx = ctx;
+	p->size = ctx->max_batch_size < DSA_PERSIST_BATCH ?
+		ctx->max_batch_size : DSA_PERSIST_BATCH;
+	p->readback = dsa_ctx_get_caps(ctx) & DSA_CAP_READBACK;
+	rc = dsa_batch_new(ctx, p->size, &p->batch[0]);
+	if (!rc)
+		rc = dsa_batch_new(ctx, p->size, &p->batch[1]);
+	if (!rc)
+		rc = dsa_op_new(ctx, &p->drain);
+	if (rc) {
+		dsa_persist_free(p);
+		return rc;
+	}
+
+	*persist = p;
+	return 0;
+}
+
+DSA_EXPORT void dsa_persist_free(struct dsa_persist *persist)
+{
+	if (!persist)
+		return;
+
+	dsa_batch_free(persist->batch[0]);
+	dsa_batch_free(persist->batch[1]);
+	dsa_op_free(persist->drain);
+	free(persist);
+}
+
+DSA_EXPORT void dsa_persist_get_stats(struct dsa_persist *persist,
+		struct dsa_persist_stats *stats)
+{
+	*stats = persist->stats;
+}
+
+static void dsa_persist_complete(struct dsa_persist *p)
+{
+	struct dsa_batch *b = p->batch[!p->cur];
+	int rc;
+
+	if (!p->inflight)
+		return;
+
+	if (dsa_batch_wait(b, -1)) {
+		rc = dsa_batch_redo(b, p->inflight);
+		if (rc && !p->err)
+			p->err = rc;
+	}
+	p->inflight = 0;
+}
+
+/*
+ * Submits the ops set up so far once the previous batch completed, which
+ * keeps batches in order without waiting for the one just submitted.
+ */
+static void dsa_persist_submit(struct dsa_persist *p)
+{
+	struct dsa_batch *b = p->batch[p->cur];
+	int rc;
+
+	if (!p->count)
+		return;
+
+	dsa_persist_complete(p);
+	if (dsa_batch_submit(b, p->count)) {
+		rc = dsa_batch_redo(b, p->count);
+		if (rc && !p->err)
+			p->err = rc;
+	} else {
+		p->inflight = p->count;
+		p->cur = !p->cur;
+	}
+	p->count = 0;
+}
+
+static struct dsa_op *dsa_persist_op(struct dsa_persist *p)
+{
+	if (p->count == p->size)
+		dsa_persist_submit(p);
+
+	return dsa_batch_get_op(p->batch[p->cur], p->count++);
+}
+
+/* Applies a pending fence to the op just set up */
+static void dsa_persist_order(struct dsa_persist *p, struct dsa_op *op)
+{
+	/* earlier batches complete before a later one is submitted */
+	if (p->fence && p->count > 1)
+		dsa_op_set_flags(op, DSA_OP_FLAG_FENCE);
+	p->fence = false;
+}
+
+static void dsa_persist_cflush(struct dsa_persist *p, const uint8_t *addr,
+		size_t len)
+{
+	size_t off, chunk;
+	struct dsa_op *op;
+
+	for (off = 0; off < len; off += chunk) {
+		chunk = len - off < p->ctx->max_xfer_size ? len - off :
+			p->ctx->max_xfer_size;
+		op = dsa_persist_op(p);
+		dsa_op_cflush(op, addr + off, chunk);
+		dsa_persist_order(p, op);
+	}
+}
+
+/**
+ * dsa_persist_flush - write dirty ranges back to memory
+ * @persist: persistence service
+ * @range: dirty ranges, widened to whole cache lines
+ * @count: number of entries in @range
+ *
+ * Adjacent ranges are merged. The flushes run in the background, they
+ * are durable once dsa_persist_drain() returns.
+ */
+DSA_EXPORT int dsa_persist_flush(struct dsa_persist *persist,
+		const struct dsa_persist_range *range, unsigned int count)
+{
+	uintptr_t start, end;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		start = (uintptr_t)range[i].addr & ~(DSA_PERSIST_LINE - 1);
+		end = (uintptr_t)range[i].addr + range[i].len;
+		while (i + 1 < count && (uintptr_t)range[i + 1].addr >= start &&
+				(uintptr_t)range[i + 1].addr <= end) {
+			i++;
+			if ((uintptr_t)range[i].addr + range[i].len > end)
+				end = (uintptr_t)range[i].addr + range[i].len;
+		}
+		end = (end + DSA_PERSIST_LINE - 1) & ~(DSA_PERSIST_LINE - 1);
+		dsa_persist_cflush(persist, (const uint8_t *)start,
+				end - start);
+		persist->stats.bytes_flushed += end - start;
+	}
+
+	dsa_persist_submit(persist);
+	return 0;
+}
+
+/**
+ * dsa_persist_memmove - copy to persistent memory, bypassing the cache
+ * @persist: persistence service
+ * @dst: destination
+ * @src: source, it must not change until the copy is drained
+ * @len: bytes to copy
+ *
+ * With DSA_CAP_READBACK each MEMMOVE reads its destination back, which
+ * makes it durable on completion. Without it, the destination is flushed
+ * by a fenced CFLUSH after the copy.
+ */
+DSA_EXPORT int dsa_persist_memmove(struct dsa_persist *persist, void *dst,
+		const void *src, size_t len)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t off, chunk;
+	struct dsa_op *op;
+
+	for (off = 0; off < len; off += chunk) {
+		chunk = len - off < persist->ctx->max_xfer_size ? len - off :
+			persist->ctx->max_xfer_size;
+		op = dsa_persist_op(persist);
+		dsa_op_memmove(op, d + off, s + off, chunk);
+		dsa_persist_order(persist, op);
+		if (persist->readback) {
+			dsa_op_set_flags(op, DSA_OP_FLAG_READBACK);
+			continue;
+		}
+
+		persist->fence = true;
+		dsa_persist_cflush(persist, d + off, chunk);
+	}
+	persist->stats.bytes_copied += len;
+
+	dsa_persist_submit(persist);
+	return 0;
+}
+
+/* Orders what is queued next after everything queued so far */
+DSA_EXPORT void dsa_persist_fence(struct dsa_persist *persist)
+{
+	persist->fence = true;
+}
+
+/**
+ * dsa_persist_drain - wait until everything queued is durable
+ * @persist: persistence service
+ *
+ * Waits for the outstanding batches, then for a DRAIN descriptor that
+ * completes after all earlier descriptors of this process on the device.
+ * Returns the first error since the previous drain.
+ */
+DSA_EXPORT int dsa_persist_drain(struct dsa_persist *persist)
+{
+	uint64_t start = dsa_persist_now_ns();
+	int rc;
+
+	dsa_persist_submit(persist);
+	dsa_persist_complete(persist);
+
+	rc = dsa_op_drain(persist->drain);
+	/* a full wq frees up as the device works, this waits anyway */
+	while (!rc && (rc = dsa_op_submit(persist->drain)) == -EBUSY)
+		rc = 0;
+	if (!rc)
+		rc = dsa_op_wait(persist->drain, -1);
+	if (rc)
+		dbg(persist->ctx, "drain failed: %d\n", rc);
+
+	/* without the drain nothing queued is known to be durable */
+	if (!rc)
+		rc = persist->err;
+	persist->err = 0;
+	persist->fence = false;
+	persist->stats.drains++;
+	persist->stats.ns += dsa_persist_now_ns() - start;
+
+	return rc;
+}
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+
+#ifndef _LIBACCDSA_PRIVATE_H_
+#define _LIBACCDSA_PRIVATE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <util/log.h>
+#include <accfg/libaccel_config.h>
+#include <accfg/libaccel_dsa.h>
+#include <accfg/idxd.h>
+
+#define DSA_EXPORT __attribute__ ((visibility("default")))
+
+#define DSA_PORTAL_SIZE		4096
+#define DSA_ENQCMD_RETRIES	3
+#define DSA_FAULT_RETRIES	32
+#define DSA_CPU_MAX_XFER	(1ULL << 31)
+#define DSA_CPU_MAX_BATCH	1024
+#define DSA_COPY_THRESHOLD	(16 << 10)
+#define DSA_NT_MIN		(256 << 10)
+#define DSA_SPLIT_MIN		(1 << 20)
+#define DSA_STRIPE_DEPTH	4
+#define DSA_DUALCAST_MASK	0xfff
+#define DSA_DIF_BLOCK_MASK	0x3
+
+struct dsa_ctx {
+	struct log_ctx ctx;
+	struct accfg_ctx *accfg;
+	struct accfg_wq *wq;
+	int fd;
+	void *portal;
+	bool cpu;
+	bool dedicated;
+	bool movdir64b;
+	bool enqcmd;
+	bool umwait;
+	bool avx512;
+	unsigned int wq_size;
+	int inflight;
+	uint32_t desc_flags;
+	uint64_t gen_cap;
+	uint64_t max_xfer_size;
+	unsigned int max_batch_size;
+	size_t copy_threshold;
+	unsigned int copy_split;
+};
+
+/*
+ * The descriptor and completion record of a standalone op are embedded,
+ * batch entries point desc into the contiguous descriptor list of the
+ * batch instead.
+ */
+struct dsa_op {
+	struct hw_desc hw __attribute__ ((aligned(64)));
+	struct completion_record cr __attribute__ ((aligned(64)));
+	struct dsa_ctx *ctx;
+	struct hw_desc *desc;
+	struct completion_record *comp;
+	bool submitted;
+	/* ordered after the earlier ops of its batch */
+	bool fence;
+	/* faulted and waiting for room in the wq to go again */
+	bool resubmit;
+	int faults;
+	uint32_t done;
+};
+
+struct dsa_batch {
+	struct dsa_op op;
+	struct dsa_ctx *ctx;
+	struct hw_desc *descs;
+	struct dsa_op *ops;
+	unsigned int size;
+	unsigned int count;
+	bool recover;
+};
+
+bool dsa_device_usable(struct accfg_device *dev);
+bool dsa_wq_usable(struct accfg_wq *wq, int flags);
+int dsa_ctx_new_wq(struct dsa_ctx **ctx, struct accfg_ctx *accfg,
+		struct accfg_wq *wq);
+int dsa_batch_redo(struct dsa_batch *batch, unsigned int count);
+int dsa_batch_run(struct dsa_batch *batch, unsigned int count);
+void dsa_op_init(struct dsa_op *op, struct dsa_ctx *ctx,
+		struct hw_desc *desc);
+void dsa_cpu_copy(struct dsa_ctx *ctx, void *dst, const void *src,
+		size_t len);
+void dsa_cpu_run(struct dsa_ctx *ctx, struct hw_desc *hw,
+		struct completion_record *comp);
+uint32_t dsa_cpu_crc32c(const void *buf, size_t len, uint32_t seed);
+uint16_t dsa_cpu_crc_t10dif(const void *buf, size_t len);
+void dsa_cpu_dif_gen(uint8_t *pi, const void *data, size_t len,
+		uint16_t app_tag, uint32_t ref_tag);
+int dsa_cpu_dif_verify(const uint8_t *pi, const void *data, size_t len,
+		uint16_t app_mask, uint16_t app_tag, uint32_t ref_tag);
+
+#endif
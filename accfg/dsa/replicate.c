@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdlib.h>
+#include "private.h"
+
+/*
+ * Replication: each payload is written to both of its destinations by
+ * one DUALCAST descriptor, which reads the source once. Destinations that
+ * do not agree in their low 12 address bits get two MEMMOVEs instead.
+ */
+
+#define DSA_REPLICATE_BATCH	32
+
+/* Next free op of the batch, running the batch first when it is full */
+static struct dsa_op *dsa_replicate_op(struct dsa_batch *b,
+		unsigned int *count, int *rc)
+{
+	int ret;
+
+	if (*count == b->size) {
+		ret = dsa_batch_run(b, *count);
+		if (ret && !*rc)
+			*rc = ret;
+		*count = 0;
+	}
+
+	return dsa_batch_get_op(b, (*count)++);
+}
+
+/**
+ * dsa_replicate - write payloads to two destinations each
+ * @ctx: dsa context
+ * @sg: payloads, no destination may overlap a source
+ * @count: number of entries in @sg
+ *
+ * The payloads are packed into batches of DUALCAST descriptors. Placing
+ * both replicas at the same offset within a 4K page lets every payload
+ * use DUALCAST. All payloads are written on return.
+ */
+DSA_EXPORT int dsa_replicate(struct dsa_ctx *ctx,
+		const struct dsa_replica_sg *sg, unsigned int count)
+{
+	unsigned int size, n = 0, i;
+	const uint8_t *src;
+	uint8_t *dst1, *dst2;
+	size_t off, chunk;
+	struct dsa_batch *b;
+	struct dsa_op *op;
+	int rc, ret;
+
+	size = ctx->max_batch_size < DSA_REPLICATE_BATCH ?
+		ctx->max_batch_size : DSA_REPLICATE_BATCH;
+	rc = dsa_batch_new(ctx, size, &b);
+	if (rc)
+		return rc;
+
+	for (i = 0; i < count; i++) {
+		src = sg[i].src;
+		dst1 = sg[i].dst1;
+		dst2 = sg[i].dst2;
+		if (((uintptr_t)dst1 ^ (uintptr_t)dst2) & DSA_DUALCAST_MASK)
+			dbg(ctx, "%p and %p differ in bits 11:0, no dualcast\n",
+					dst1, dst2);
+
+		for (off = 0; off < sg[i].len; off += chunk) {
+			chunk = sg[i].len - off;
+			if (chunk > ctx->max_xfer_size)
+				chunk = ctx->max_xfer_size;
+
+			op = dsa_replicate_op(b, &n, &rc);
+			if (!dsa_op_dualcast(op, dst1 + off, dst2 + off,
+					src + off, chunk))
+				continue;
+
+			dsa_op_memmove(op, dst1 + off, src + off, chunk);
+			op = dsa_replicate_op(b, &n, &rc);
+			dsa_op_memmove(op, dst2 + off, src + off, chunk);
+		}
+	}
+
+	if (n) {
+		ret = dsa_batch_run(b, n);
+		if (!rc)
+			rc = ret;
+	}
+	dsa_batch_free(b);
+
+	return rc;
+}
@@ -0,0 +1,366 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "private.h"
+
+/*
+ * Incremental snapshots: the region is compared against a baseline copy
+ * block by block with CR_DELTA. Changed blocks go into the stream as a
+ * delta record, or as raw data when the delta would not be smaller, and
+ * are applied to the baseline with AP_DELTA so that the next snapshot is
+ * taken against this one.
+ *
+ * A stream is a dsa_snap_hdr followed by one dsa_snap_rec per changed
+ * block, each followed by its payload padded to 8 bytes.
+ */
+
+#define DSA_SNAP_BLOCK		(64 << 10)
+#define DSA_SNAP_BATCH		32
+#define DSA_SNAP_MAGIC		0x50414e53	/* "SNAP" */
+#define DSA_SNAP_ALIGN(x)	(((x) + 7) & ~(size_t)7)
+
+#define DSA_SNAP_REC_DELTA	1
+#define DSA_SNAP_REC_RAW	2
+
+struct dsa_snap_hdr {
+	uint32_t magic;
+	uint32_t block_size;
+	uint64_t len;
+};
+
+struct dsa_snap_rec {
+	uint32_t block;
+	uint32_t type;
+	uint32_t len;
+	uint32_t rsvd;
+};
+
+struct dsa_snap {
+	struct dsa_ctx *ctx;
+	const uint8_t *region;
+	uint8_t *base;
+	size_t len;
+	size_t block;
+	uint32_t max_delta;
+	unsigned int size;
+	/* CR_DELTA of a group of blocks, then the baseline update */
+	struct dsa_batch *cr;
+	struct dsa_batch *ap;
+	uint8_t *deltas;
+	/* the baseline is unknown after a failed update */
+	bool invalid;
+	struct dsa_snap_stats stats;
+};
+
+static uint64_t dsa_snap_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int dsa_snap_batch_size(struct dsa_ctx *ctx)
+{
+	return ctx->max_batch_size < DSA_SNAP_BATCH ?
+		ctx->max_batch_size : DSA_SNAP_BATCH;
+}
+
+/**
+ * dsa_snap_new - start incremental snapshots of a memory region
+ * @ctx: dsa context
+ * @region: 8 byte aligned region, it must not change during
+ *	    dsa_snap_delta()
+ * @len: bytes in @region, a multiple of 8
+ * @snap: snapshot engine to establish
+ *
+ * The current content of @region becomes the baseline of the first
+ * delta.
+ */
+DSA_EXPORT int dsa_snap_new(struct dsa_ctx *ctx, const void *region,
+		size_t len, struct dsa_snap **snap)
+{
+	struct dsa_snap *s;
+	int rc;
+
+	if (!len || ((uintptr_t)region | len) & 7)
+		return -EINVAL;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+
+	s->ctx = ctx;
+	s->region = region;
+	s->len = len;
+	s->block = ctx->max_xfer_size < DSA_SNAP_BLOCK ?
+		ctx->max_xfer_size & ~7ULL : DSA_SNAP_BLOCK;
+	/* the device wants a multiple of 80, a larger delta is sent raw */
+	s->max_delta = s->block / 80 * 80;
+	s->size = dsa_snap_batch_size(ctx);
+	if (!s->max_delta) {
+		free(s);
+		return -EINVAL;
+	}
+
+	s->base = aligned_alloc(4096, (len + 4095) & ~(size_t)4095);
+	s->deltas = aligned_alloc(64, s->size * s->max_delta);
+	if (!s->base || !s->deltas) {
+		rc = -ENOMEM;
+		goto err;
+	}
+
+	rc = dsa_batch_new(ctx, s->size, &s->cr);
+	if (!rc)
+		rc = dsa_batch_new(ctx, s->size, &s->ap);
+	if (rc)
+		goto err;
+
+	dsa_memcpy(ctx, s->base, region, len);
+	*snap = s;
+	return 0;
+
+ err:
+	dsa_snap_free(s);
+	return rc;
+}
+
+DSA_EXPORT void dsa_snap_free(struct dsa_snap *snap)
+{
+	if (!snap)
+		return;
+
+	dsa_batch_free(snap->cr);
+	dsa_batch_free(snap->ap);
+	free(snap->deltas);
+	free(snap->base);
+	free(snap);
+}
+
+/* Stream size when every block changed beyond what a delta can hold */
+DSA_EXPORT size_t dsa_snap_get_max_stream_size(struct dsa_snap *snap)
+{
+	size_t blocks = (snap->len + snap->block - 1) / snap->block;
+
+	return sizeof(struct dsa_snap_hdr) +
+		blocks * (sizeof(struct dsa_snap_rec) + snap->block);
+}
+
+DSA_EXPORT void dsa_snap_get_stats(struct dsa_snap *snap,
+		struct dsa_snap_stats *stats)
+{
+	*stats = snap->stats;
+}
+
+static uint8_t *dsa_snap_emit(uint8_t *out, uint32_t block, uint32_t type,
+		const void *data, size_t len)
+{
+	struct dsa_snap_rec rec = {
+		.block = block,
+		.type = type,
+		.len = len,
+	};
+
+	memcpy(out, &rec, sizeof(rec));
+	memcpy(out + sizeof(rec), data, len);
+	memset(out + sizeof(rec) + len, 0, DSA_SNAP_ALIGN(len) - len);
+
+	return out + sizeof(rec) + DSA_SNAP_ALIGN(len);
+}
+
+/*
+ * Diffs the blocks [first, first + n) against the baseline, appends them
+ * to *out and updates the baseline. With full set every block is sent
+ * raw.
+ */
+static int dsa_snap_group(struct dsa_snap *s, size_t first,
+		unsigned int n, bool full, uint8_t **out)
+{
+	struct dsa_op *op, *ap;
+	unsigned int i, count = 0;
+	uint8_t *delta;
+	size_t off, len;
+
+	for (i = 0; i < n && !full; i++) {
+		off = (first + i) * s->block;
+		len = s->len - off < s->block ? s->len - off : s->block;
+		dsa_op_cr_delta(dsa_batch_get_op(s->cr, i), s->base + off,
+				s->region + off, len,
+				s->deltas + i * s->max_delta, s->max_delta);
+	}
+	/* blocks the device did not diff are sent raw */
+	if (!full && !dsa_batch_submit(s->cr, n))
+		dsa_batch_wait(s->cr, -1);
+
+	for (i = 0; i < n; i++) {
+		op = dsa_batch_get_op(s->cr, i);
+		if (!full && dsa_op_get_status(op) == DSA_OP_STATUS_SUCCESS &&
+				dsa_op_get_result(op) == DSA_OP_RESULT_MATCH)
+			continue;
+
+		off = (first + i) * s->block;
+		len = s->len - off < s->block ? s->len - off : s->block;
+		ap = dsa_batch_get_op(s->ap, count++);
+		if (!full && dsa_op_get_status(op) == DSA_OP_STATUS_SUCCESS &&
+				dsa_op_get_result(op) ==
+				DSA_OP_RESULT_MISMATCH) {
+			delta = s->deltas + i * s->max_delta;
+			*out = dsa_snap_emit(*out, first + i,
+					DSA_SNAP_REC_DELTA, delta,
+					dsa_op_get_delta_size(op));
+			dsa_op_ap_delta(ap, s->base + off, delta,
+					dsa_op_get_delta_size(op), len);
+			s->stats.blocks_delta++;
+		} else {
+			*out = dsa_snap_emit(*out, first + i,
+					DSA_SNAP_REC_RAW, s->region + off, len);
+			dsa_op_memmove(ap, s->base + off, s->region + off,
+					len);
+			s->stats.blocks_raw++;
+		}
+	}
+
+	if (count)
+		return dsa_batch_run(s->ap, count);
+
+	return 0;
+}
+
+/**
+ * dsa_snap_delta - take an incremental snapshot
+ * @snap: snapshot engine
+ * @buf: stream buffer, 8 byte aligned
+ * @size: bytes in @buf, at least dsa_snap_get_max_stream_size()
+ * @stream_len: bytes of stream written to @buf
+ *
+ * Writes the changes of the region since the previous snapshot to @buf,
+ * then makes the current content the baseline of the next one. If the
+ * baseline cannot be updated the stream must not be used, and the next
+ * snapshot sends the whole region.
+ */
+DSA_EXPORT int dsa_snap_delta(struct dsa_snap *snap, void *buf, size_t size,
+		size_t *stream_len)
+{
+	struct dsa_snap_hdr hdr = {
+		.magic = DSA_SNAP_MAGIC,
+		.block_size = snap->block,
+		.len = snap->len,
+	};
+	size_t blocks = (snap->len + snap->block - 1) / snap->block, first;
+	uint64_t start = dsa_snap_now_ns(), ns;
+	uint8_t *out = buf;
+	unsigned int n;
+	bool full;
+	int rc;
+
+	if ((uintptr_t)buf & 7)
+		return -EINVAL;
+	if (size < dsa_snap_get_max_stream_size(snap))
+		return -ENOSPC;
+
+	memcpy(out, &hdr, sizeof(hdr));
+	out += sizeof(hdr);
+
+	full = snap->invalid;
+	snap->invalid = false;
+	for (first = 0; first < blocks; first += n) {
+		n = blocks - first < snap->size ? blocks - first : snap->size;
+		rc = dsa_snap_group(snap, first, n, full, &out);
+		if (rc) {
+			err(snap->ctx, "baseline update failed: %d\n", rc);
+			snap->invalid = true;
+			return rc;
+		}
+	}
+
+	*stream_len = out - (uint8_t *)buf;
+	ns = dsa_snap_now_ns() - start;
+	snap->stats.snapshots++;
+	snap->stats.bytes_scanned += snap->len;
+	snap->stats.bytes_out += *stream_len;
+	snap->stats.ns += ns;
+
+	info(snap->ctx, "snapshot %zu of %zu bytes (%.2f%%) %.0f MB/s\n",
+			*stream_len, snap->len, *stream_len * 100.0 / snap->len,
+			ns ? snap->len * 1000.0 / ns : 0);
+	return 0;
+}
+
+/**
+ * dsa_snap_apply - bring a copy of the region up to a snapshot
+ * @ctx: dsa context
+ * @dst: copy of the region as of the previous snapshot
+ * @len: bytes in @dst
+ * @stream: stream from dsa_snap_delta(), 8 byte aligned
+ * @stream_len: bytes in @stream
+ */
+DSA_EXPORT int dsa_snap_apply(struct dsa_ctx *ctx, void *dst, size_t len,
+		const void *stream, size_t stream_len)
+{
+	const uint8_t *in = stream, *end = in + stream_len;
+	struct dsa_snap_hdr hdr;
+	struct dsa_snap_rec rec;
+	struct dsa_batch *b;
+	unsigned int count = 0;
+	struct dsa_op *op;
+	size_t off;
+	int rc;
+
+	if ((uintptr_t)stream & 7 || stream_len < sizeof(hdr))
+		return -EINVAL;
+	memcpy(&hdr, in, sizeof(hdr));
+	in += sizeof(hdr);
+	if (hdr.magic != DSA_SNAP_MAGIC || hdr.len != len ||
+			!hdr.block_size || hdr.block_size > ctx->max_xfer_size)
+		return -EINVAL;
+
+	rc = dsa_batch_new(ctx, dsa_snap_batch_size(ctx), &b);
+	if (rc)
+		return rc;
+
+	while (in < end) {
+		if ((size_t)(end - in) < sizeof(rec)) {
+			rc = -EINVAL;
+			break;
+		}
+		memcpy(&rec, in, sizeof(rec));
+		in += sizeof(rec);
+
+		off = (size_t)rec.block * hdr.block_size;
+		if ((size_t)(end - in) < DSA_SNAP_ALIGN(rec.len) ||
+				off >= len || rec.len > hdr.block_size) {
+			rc = -EINVAL;
+			break;
+		}
+
+		op = dsa_batch_get_op(b, count);
+		if (rec.type == DSA_SNAP_REC_DELTA)
+			rc = dsa_op_ap_delta(op, (uint8_t *)dst + off, in,
+					rec.len, len - off < hdr.block_size ?
+					len - off : hdr.block_size);
+		else if (rec.type == DSA_SNAP_REC_RAW && rec.len <= len - off)
+			rc = dsa_op_memmove(op, (uint8_t *)dst + off, in,
+					rec.len);
+		else
+			rc = -EINVAL;
+		if (rc)
+			break;
+		in += DSA_SNAP_ALIGN(rec.len);
+
+		if (++count == b->size) {
+			rc = dsa_batch_run(b, count);
+			count = 0;
+			if (rc)
+				break;
+		}
+	}
+
+	if (count && !rc)
+		rc = dsa_batch_run(b, count);
+	dsa_batch_free(b);
+
+	return rc;
+}
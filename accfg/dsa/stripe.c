@@ -0,0 +1,403 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "private.h"
+
+/*
+ * Striped copy: one copy is cut into max_xfer_size pieces that are fed
+ * to every work queue of the stripe at once, so that the bandwidth of
+ * several engines adds up.
+ */
+
+#define DSA_STRIPE_BYTES	(256 << 20)
+
+struct dsa_stripe {
+	struct log_ctx ctx;
+	struct accfg_ctx *accfg;
+	struct dsa_ctx **ctxs;
+	int *nodes;
+	unsigned int count;
+	bool numa;
+	uint64_t piece;
+	/* DSA_STRIPE_DEPTH pieces in flight per work queue */
+	struct dsa_op *ops;
+	size_t *offs;
+	size_t *lens;
+	unsigned int *head;
+	unsigned int *tail;
+};
+
+static int dsa_stripe_add(struct dsa_stripe *s, struct dsa_ctx *ctx)
+{
+	struct dsa_ctx **ctxs;
+	int *nodes;
+
+	ctxs = realloc(s->ctxs, (s->count + 1) * sizeof(*ctxs));
+	if (!ctxs)
+		return -ENOMEM;
+	s->ctxs = ctxs;
+
+	nodes = realloc(s->nodes, (s->count + 1) * sizeof(*nodes));
+	if (!nodes)
+		return -ENOMEM;
+	s->nodes = nodes;
+
+	nodes[s->count] = ctx->wq ?
+		accfg_device_get_numa_node(accfg_wq_get_device(ctx->wq)) : -1;
+	ctxs[s->count++] = ctx;
+	return 0;
+}
+
+/*
+ * Takes the rank'th usable wq of every device in turn, so that the first
+ * n work queues of the stripe are spread over as many devices as possible.
+ */
+static int dsa_stripe_open_rank(struct dsa_stripe *s, int node, int flags,
+		int rank, bool *more)
+{
+	struct accfg_device *dev;
+	struct accfg_wq *wq;
+	struct dsa_ctx *ctx;
+	int n, rc;
+
+	accfg_device_foreach(s->accfg, dev) {
+		if (!dsa_device_usable(dev))
+			continue;
+		if (node >= 0 && accfg_device_get_numa_node(dev) != node)
+			continue;
+
+		n = 0;
+		accfg_wq_foreach(dev, wq) {
+			if (!dsa_wq_usable(wq, flags) || n++ != rank)
+				continue;
+
+			*more = true;
+			rc = dsa_ctx_new_wq(&ctx, s->accfg, wq);
+			if (rc) {
+				dbg(s, "%s/%s: %s\n",
+						accfg_device_get_devname(dev),
+						accfg_wq_get_devname(wq),
+						strerror(-rc));
+				continue;
+			}
+			rc = dsa_stripe_add(s, ctx);
+			if (rc) {
+				dsa_ctx_free(ctx);
+				return rc;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int dsa_stripe_alloc_ops(struct dsa_stripe *s)
+{
+	unsigned int n = s->count * DSA_STRIPE_DEPTH, i;
+
+	s->ops = aligned_alloc(64, n * sizeof(*s->ops));
+	s->offs = calloc(n, sizeof(*s->offs));
+	s->lens = calloc(n, sizeof(*s->lens));
+	s->head = calloc(s->count, sizeof(*s->head));
+	s->tail = calloc(s->count, sizeof(*s->tail));
+	if (!s->ops || !s->offs || !s->lens || !s->head || !s->tail)
+		return -ENOMEM;
+
+	s->piece = UINT64_MAX;
+	for (i = 0; i < n; i++)
+		dsa_op_init(&s->ops[i], s->ctxs[i / DSA_STRIPE_DEPTH],
+				&s->ops[i].hw);
+	for (i = 0; i < s->count; i++) {
+		if (s->ctxs[i]->max_xfer_size < s->piece)
+			s->piece = s->ctxs[i]->max_xfer_size;
+		if (s->nodes[i] != s->nodes[0])
+			s->numa = true;
+	}
+
+	return 0;
+}
+
+/**
+ * dsa_stripe_new - open every usable DSA work queue for striped copies
+ * @stripe: stripe to establish
+ * @numa_node: only use devices of this node, -1 for all nodes
+ * @flags: DSA_CTX_* flags
+ *
+ * Without a usable work queue the stripe holds a single CPU context,
+ * unless DSA_CTX_NO_CPU is given.
+ */
+DSA_EXPORT int dsa_stripe_new(struct dsa_stripe **stripe, int numa_node,
+		int flags)
+{
+	struct dsa_stripe *s;
+	struct dsa_ctx *ctx;
+	bool more = true;
+	int rank, rc = 0;
+
+	if ((flags & DSA_CTX_CPU) && (flags & DSA_CTX_NO_CPU))
+		return -EINVAL;
+	if ((flags & DSA_CTX_SHARED) && (flags & DSA_CTX_DEDICATED))
+		return -EINVAL;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	log_init(&s->ctx, "libaccel-dsa", "ACCDSA_LOG");
+
+	if (!(flags & DSA_CTX_CPU) && accfg_new(&s->accfg) >= 0) {
+		for (rank = 0; !rc && more; rank++) {
+			more = false;
+			rc = dsa_stripe_open_rank(s, numa_node, flags, rank,
+					&more);
+		}
+		if (rc)
+			goto err;
+	}
+
+	if (!s->count) {
+		if (flags & DSA_CTX_NO_CPU) {
+			rc = -ENODEV;
+			goto err;
+		}
+		rc = dsa_ctx_new(&ctx, NULL, DSA_CTX_CPU);
+		if (rc)
+			goto err;
+		rc = dsa_stripe_add(s, ctx);
+		if (rc) {
+			dsa_ctx_free(ctx);
+			goto err;
+		}
+	}
+
+	rc = dsa_stripe_alloc_ops(s);
+	if (rc)
+		goto err;
+
+	info(s, "striping over %u work queues, piece %#" PRIx64 "%s\n",
+			s->count, s->piece, s->numa ? ", numa affine" : "");
+	*stripe = s;
+	return 0;
+
+ err:
+	dsa_stripe_free(s);
+	return rc;
+}
+
+DSA_EXPORT void dsa_stripe_free(struct dsa_stripe *stripe)
+{
+	unsigned int i;
+
+	if (!stripe)
+		return;
+
+	for (i = 0; i < stripe->count; i++)
+		dsa_ctx_free(stripe->ctxs[i]);
+	accfg_unref(stripe->accfg);
+	free(stripe->ctxs);
+	free(stripe->nodes);
+	free(stripe->ops);
+	free(stripe->offs);
+	free(stripe->lens);
+	free(stripe->head);
+	free(stripe->tail);
+	free(stripe);
+}
+
+DSA_EXPORT unsigned int dsa_stripe_get_count(struct dsa_stripe *stripe)
+{
+	return stripe->count;
+}
+
+DSA_EXPORT struct dsa_ctx *dsa_stripe_get_ctx(struct dsa_stripe *stripe,
+		unsigned int idx)
+{
+	return idx < stripe->count ? stripe->ctxs[idx] : NULL;
+}
+
+static int dsa_page_node(void *addr)
+{
+	int node;
+
+	if (syscall(SYS_get_mempolicy, &node, NULL, 0, addr,
+			MPOL_F_NODE | MPOL_F_ADDR))
+		return -1;
+	return node;
+}
+
+/* Round robin, preferring work queues local to the destination */
+static unsigned int dsa_stripe_pick(struct dsa_stripe *s, void *dst,
+		unsigned int width, unsigned int *next)
+{
+	unsigned int i, w;
+	int node;
+
+	if (s->numa) {
+		node = dsa_page_node(dst);
+		for (i = 0; node >= 0 && i < width; i++) {
+			w = (*next + i) % width;
+			if (s->nodes[w] == node) {
+				*next = w + 1;
+				return w;
+			}
+		}
+	}
+
+	w = *next % width;
+	*next = w + 1;
+	return w;
+}
+
+/* Completes the oldest piece of wq w */
+static void dsa_stripe_retire(struct dsa_stripe *s, unsigned int w,
+		void *dst, const void *src)
+{
+	unsigned int i;
+	int rc;
+
+	i = w * DSA_STRIPE_DEPTH + s->head[w]++ % DSA_STRIPE_DEPTH;
+	rc = dsa_op_wait(&s->ops[i], -1);
+	if (rc) {
+		/* redo what the device did not copy */
+		dbg(s, "%s: piece at %#zx failed: %d\n",
+				dsa_ctx_get_wq_name(s->ctxs[w]), s->offs[i], rc);
+		dsa_cpu_copy(s->ctxs[w], (char *)dst + s->offs[i],
+				(const char *)src + s->offs[i], s->lens[i]);
+	}
+}
+
+static void dsa_stripe_queue(struct dsa_stripe *s, unsigned int w,
+		void *dst, const void *src, size_t off, size_t len)
+{
+	struct dsa_ctx *ctx = s->ctxs[w];
+	unsigned int i;
+	int rc;
+
+	if (ctx->cpu) {
+		dsa_cpu_copy(ctx, (char *)dst + off, (const char *)src + off,
+				len);
+		return;
+	}
+
+	for (;;) {
+		if (s->tail[w] - s->head[w] == DSA_STRIPE_DEPTH)
+			dsa_stripe_retire(s, w, dst, src);
+
+		i = w * DSA_STRIPE_DEPTH + s->tail[w] % DSA_STRIPE_DEPTH;
+		dsa_op_memmove(&s->ops[i], (char *)dst + off,
+				(const char *)src + off, len);
+		rc = dsa_op_submit(&s->ops[i]);
+		if (rc == -EBUSY && s->tail[w] != s->head[w]) {
+			/* wq full, wait for the oldest piece to free a slot */
+			dsa_stripe_retire(s, w, dst, src);
+			continue;
+		}
+		break;
+	}
+
+	if (rc) {
+		dsa_cpu_copy(ctx, (char *)dst + off, (const char *)src + off,
+				len);
+		return;
+	}
+
+	s->offs[i] = off;
+	s->lens[i] = len;
+	s->tail[w]++;
+}
+
+/**
+ * dsa_stripe_copy - copy across the work queues of a stripe
+ * @stripe: dsa stripe
+ * @dst: destination, must not overlap src
+ * @src: source
+ * @len: bytes to copy
+ * @width: number of work queues to use, 0 for all of them
+ *
+ * The copy is cut into pieces of the smallest max_xfer_size of the stripe
+ * and handed out round robin. When the stripe spans NUMA nodes, a piece
+ * goes to a work queue on the node of its destination where one exists.
+ * Returns when every piece has completed.
+ */
+DSA_EXPORT int dsa_stripe_copy(struct dsa_stripe *stripe, void *dst,
+		const void *src, size_t len, unsigned int width)
+{
+	unsigned int next = 0, w;
+	size_t off, chunk;
+
+	if (width > stripe->count)
+		return -EINVAL;
+	if (!width)
+		width = stripe->count;
+
+	for (off = 0; off < len; off += chunk) {
+		chunk = len - off;
+		if (chunk > stripe->piece)
+			chunk = stripe->piece;
+		w = dsa_stripe_pick(stripe, (char *)dst + off, width, &next);
+		dsa_stripe_queue(stripe, w, dst, src, off, chunk);
+	}
+
+	for (w = 0; w < width; w++)
+		while (stripe->head[w] != stripe->tail[w])
+			dsa_stripe_retire(stripe, w, dst, src);
+
+	return 0;
+}
+
+static uint64_t dsa_stripe_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * dsa_stripe_scaling - measure copy bandwidth against stripe width
+ * @stripe: dsa stripe
+ * @dst: destination of @len bytes
+ * @src: source of @len bytes
+ * @len: bytes per copy
+ * @mbps: dsa_stripe_get_count() entries, entry n is the MB/s of a copy
+ *	  striped over n + 1 work queues
+ *
+ * Work queues are added in dsa_stripe_get_ctx() order, which takes one
+ * from each device before a second from any, so the curve shows how the
+ * bandwidth grows as devices are added.
+ */
+DSA_EXPORT int dsa_stripe_scaling(struct dsa_stripe *stripe, void *dst,
+		const void *src, size_t len, double *mbps)
+{
+	unsigned int reps, width, i;
+	uint64_t start, ns;
+
+	if (!len)
+		return -EINVAL;
+
+	reps = DSA_STRIPE_BYTES / len;
+	if (!reps)
+		reps = 1;
+
+	/* fault the buffers in so that no run pays for it */
+	dsa_stripe_copy(stripe, dst, src, len, 0);
+
+	for (width = 1; width <= stripe->count; width++) {
+		start = dsa_stripe_now_ns();
+		for (i = 0; i < reps; i++)
+			dsa_stripe_copy(stripe, dst, src, len, width);
+		ns = dsa_stripe_now_ns() - start;
+
+		mbps[width - 1] = ns ? (double)len * reps * 1000 / ns : 0;
+		info(stripe, "%u work queues: %.0f MB/s\n", width,
+				mbps[width - 1]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "private.h"
+
+/*
+ * Page zeroing: scatter lists of pages become MEMFILL descriptors with a
+ * zero pattern, packed into batches. One batch is filled while the
+ * previous one runs on the device.
+ */
+
+#define DSA_ZERO_BATCH		32
+#define DSA_ZERO_ALIGN		4096
+
+struct dsa_zero {
+	struct dsa_ctx *ctx;
+	struct dsa_batch *batch[2];
+	unsigned int size;
+	/* ops set up in batch[cur], ops in flight in the other one */
+	unsigned int cur;
+	unsigned int count;
+	unsigned int inflight;
+	struct dsa_zero_stats stats;
+};
+
+/**
+ * dsa_zero_new - allocate a page zeroing service
+ * @ctx: dsa context
+ * @batch_size: descriptors per batch, 0 for the default
+ * @zero: zeroing service to establish
+ */
+DSA_EXPORT int dsa_zero_new(struct dsa_ctx *ctx, unsigned int batch_size,
+		struct dsa_zero **zero)
+{
+	struct dsa_zero *z;
+	int rc;
+
+	if (!batch_size)
+		batch_size = ctx->max_batch_size < DSA_ZERO_BATCH ?
+			ctx->max_batch_size : DSA_ZERO_BATCH;
+
+	z = calloc(1, sizeof(*z));
+	if (!z)
+		return -ENOMEM;
+
+	z->ctx = ctx;
+	z->size = batch_size;
+	rc = dsa_batch_new(ctx, batch_size, &z->batch[0]);
+	if (!rc)
+		rc = dsa_batch_new(ctx, batch_size, &z->batch[1]);
+	if (rc) {
+		dsa_zero_free(z);
+		return rc;
+	}
+
+	*zero = z;
+	return 0;
+}
+
+DSA_EXPORT void dsa_zero_free(struct dsa_zero *zero)
+{
+	if (!zero)
+		return;
+
+	dsa_batch_free(zero->batch[0]);
+	dsa_batch_free(zero->batch[1]);
+	free(zero);
+}
+
+DSA_EXPORT void dsa_zero_get_stats(struct dsa_zero *zero,
+		struct dsa_zero_stats *stats)
+{
+	*stats = zero->stats;
+}
+
+/* Zero on the CPU what the device did not */
+static void dsa_zero_redo(struct dsa_zero *z, struct dsa_batch *b,
+		unsigned int count)
+{
+	struct dsa_op *op;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		op = dsa_batch_get_op(b, i);
+		if (op->submitted || dsa_op_get_status(op) ==
+				DSA_OP_STATUS_SUCCESS)
+			continue;
+		dbg(z->ctx, "zeroing %#x bytes at %#" PRIx64 " failed: %#x\n",
+				op->desc->xfer_size, op->desc->dst_addr,
+				op->comp->status);
+		memset((void *)op->desc->dst_addr, 0, op->desc->xfer_size);
+	}
+}
+
+static void dsa_zero_complete(struct dsa_zero *z)
+{
+	struct dsa_batch *b = z->batch[!z->cur];
+
+	if (!z->inflight)
+		return;
+
+	if (dsa_batch_wait(b, -1))
+		dsa_zero_redo(z, b, z->inflight);
+	z->inflight = 0;
+}
+
+static void dsa_zero_flush(struct dsa_zero *z)
+{
+	struct dsa_batch *b = z->batch[z->cur];
+
+	if (!z->count)
+		return;
+
+	dsa_zero_complete(z);
+	if (dsa_batch_submit(b, z->count)) {
+		dsa_zero_redo(z, b, z->count);
+	} else {
+		z->inflight = z->count;
+		z->cur = !z->cur;
+	}
+	z->count = 0;
+}
+
+static void dsa_zero_add(struct dsa_zero *z, void *addr, size_t len,
+		int flags)
+{
+	struct dsa_op *op;
+
+	op = dsa_batch_get_op(z->batch[z->cur], z->count);
+	dsa_op_memfill(op, addr, 0, len);
+	if (flags & DSA_ZERO_CACHE)
+		dsa_op_set_flags(op, DSA_OP_FLAG_CACHE);
+	z->stats.bytes += len;
+	z->stats.descs++;
+
+	if (++z->count == z->size)
+		dsa_zero_flush(z);
+}
+
+/**
+ * dsa_zero_pages - zero a scatter list of pages
+ * @zero: zeroing service
+ * @sg: page ranges, 4K aligned in address and length
+ * @count: number of entries in @sg
+ * @flags: DSA_ZERO_CACHE to leave the zeroed pages in the LLC
+ *
+ * Adjacent entries are merged and the result is cut into max_xfer_size
+ * descriptors, so a list of 4K pages from one 2M page costs a single
+ * descriptor. The pages are zero on return. Without DSA_ZERO_CACHE the
+ * zeroes go to memory, which suits pages that were freed. DSA_ZERO_CACHE
+ * fails with -EOPNOTSUPP on a device without DSA_CAP_CACHE_CTRL.
+ */
+DSA_EXPORT int dsa_zero_pages(struct dsa_zero *zero,
+		const struct dsa_zero_sg *sg, unsigned int count, int flags)
+{
+	uint64_t max = zero->ctx->max_xfer_size;
+	size_t len, off, chunk;
+	unsigned int i;
+	char *addr;
+
+	if (flags & ~DSA_ZERO_CACHE)
+		return -EINVAL;
+	if ((flags & DSA_ZERO_CACHE) &&
+			!(dsa_ctx_get_caps(zero->ctx) & DSA_CAP_CACHE_CTRL))
+		return -EOPNOTSUPP;
+	for (i = 0; i < count; i++)
+		if (((uintptr_t)sg[i].addr | sg[i].len) % DSA_ZERO_ALIGN)
+			return -EINVAL;
+
+	for (i = 0; i < count;) {
+		addr = sg[i].addr;
+		len = sg[i++].len;
+		while (i < count && addr + len == (char *)sg[i].addr)
+			len += sg[i++].len;
+
+		for (off = 0; off < len; off += chunk) {
+			chunk = len - off < max ? len - off : max;
+			dsa_zero_add(zero, addr + off, chunk, flags);
+		}
+	}
+
+	dsa_zero_flush(zero);
+	dsa_zero_complete(zero);
+
+	return 0;
+}
@@ -19,6 +19,8 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/param.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 #include <ccan/list/list.h>
 #include <ccan/minmax/minmax.h>
 #include <ccan/array_size/array_size.h>
@@ -156,17 +158,16 @@ static void save_last_error(struct accfg_device *device, struct accfg_wq *wq,
 		struct accfg_group *group, struct accfg_engine *engine)
 {
 	struct accfg_ctx *ctx = device->ctx;
+	unsigned int cmd_status = accfg_device_get_cmd_status(device);
 
-	if (!ctx->error_ctx)
-		ctx->error_ctx = calloc(1, sizeof(struct accfg_error_ctx));
-
-	if (ctx->error_ctx) {
-		ctx->error_ctx->cmd_status = accfg_device_get_cmd_status(device);
-		ctx->error_ctx->device = device;
-		ctx->error_ctx->wq = wq;
-		ctx->error_ctx->group = group;
-		ctx->error_ctx->engine = engine;
-	}
+	/* devices may be configured from several threads on one ctx */
+	pthread_mutex_lock(&ctx->error_lock);
+	ctx->error_ctx->cmd_status = cmd_status;
+	ctx->error_ctx->device = device;
+	ctx->error_ctx->wq = wq;
+	ctx->error_ctx->group = group;
+	ctx->error_ctx->engine = engine;
+	pthread_mutex_unlock(&ctx->error_lock);
 }
 
 static int accfg_set_param(struct accfg_ctx *ctx, int dfd, char *name,
@@ -319,6 +320,7 @@ static void free_context(struct accfg_ctx *ctx)
 	list_for_each_safe(&ctx->devices, device, _b, list)
 		free_device(device, &ctx->devices);
 	free(ctx->error_ctx);
+	pthread_mutex_destroy(&ctx->error_lock);
 	free(ctx);
 }
 
@@ -404,6 +406,13 @@ ACCFG_EXPORT int accfg_new(struct accfg_ctx **ctx)
 	if (!c)
 		return -ENOMEM;
 
+	c->error_ctx = calloc(1, sizeof(struct accfg_error_ctx));
+	if (!c->error_ctx) {
+		free(c);
+		return -ENOMEM;
+	}
+	pthread_mutex_init(&c->error_lock, NULL);
+
 	c->refcount = 1;
 	log_init(&c->ctx, "libaccfg", "ACCFG_LOG");
 	c->timeout = 5000;
@@ -1287,6 +1296,39 @@ ACCFG_EXPORT int accfg_device_get_clients(struct accfg_device *device)
 	return atoi(buf);
 }
 
+/*
+ * Returns an fd on a device sysfs attribute for callers that sample it
+ * repeatedly with pread() instead of reopening it every time.
+ */
+ACCFG_EXPORT int accfg_device_open_attr(struct accfg_device *device,
+		const char *attr)
+{
+	struct accfg_ctx *ctx;
+	char *path;
+	int len, fd;
+
+	if (!device || !attr)
+		return -EINVAL;
+
+	ctx = accfg_device_get_ctx(device);
+	path = device->device_buf;
+	len = device->buf_len;
+
+	if (snprintf(path, len, "%s/%s", device->device_path, attr) >= len) {
+		err(ctx, "%s: buffer too small!\n", __func__);
+		return -ENAMETOOLONG;
+	}
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err(ctx, "%s: open '%s' failed: %s\n", __func__, path,
+				strerror(errno));
+		return -errno;
+	}
+
+	return fd;
+}
+
 ACCFG_EXPORT int accfg_device_set_read_buffer_limit(struct accfg_device *dev, int val)
 {
 	struct accfg_ctx *ctx;
@@ -1779,6 +1821,34 @@ accfg_group_get_field(group, traffic_class_b)
 accfg_group_get_field(group, desc_progress_limit)
 accfg_group_get_field(group, batch_progress_limit)
 
+ACCFG_EXPORT int accfg_group_open_attr(struct accfg_group *group,
+		const char *attr)
+{
+	struct accfg_ctx *ctx;
+	int len, fd;
+
+	if (!group || !attr)
+		return -EINVAL;
+
+	ctx = accfg_group_get_ctx(group);
+	len = group->buf_len;
+
+	if (snprintf(group->group_buf, len, "%s/%s", group->group_path,
+				attr) >= len) {
+		err(ctx, "%s: buffer too small!\n", __func__);
+		return -ENAMETOOLONG;
+	}
+
+	fd = open(group->group_buf, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err(ctx, "%s: open '%s' failed: %s\n", __func__,
+				group->group_buf, strerror(errno));
+		return -errno;
+	}
+
+	return fd;
+}
+
 static void wqs_init(struct accfg_device *device)
 {
 	struct accfg_ctx *ctx = device->ctx;
@@ -1932,6 +2002,32 @@ ACCFG_EXPORT int accfg_wq_get_occupancy(struct accfg_wq *wq)
 	return occ;
 }
 
+ACCFG_EXPORT int accfg_wq_open_attr(struct accfg_wq *wq, const char *attr)
+{
+	struct accfg_ctx *ctx;
+	int len, fd;
+
+	if (!wq || !attr)
+		return -EINVAL;
+
+	ctx = accfg_wq_get_ctx(wq);
+	len = wq->buf_len;
+
+	if (snprintf(wq->wq_buf, len, "%s/%s", wq->wq_path, attr) >= len) {
+		err(ctx, "%s: buffer too small!\n", __func__);
+		return -ENAMETOOLONG;
+	}
+
+	fd = open(wq->wq_buf, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err(ctx, "%s: open '%s' failed: %s\n", __func__, wq->wq_buf,
+				strerror(errno));
+		return -errno;
+	}
+
+	return fd;
+}
+
 ACCFG_EXPORT int accfg_wq_get_clients(struct accfg_wq *wq)
 {
 	struct accfg_ctx *ctx = accfg_wq_get_ctx(wq);
@@ -2546,3 +2642,216 @@ ACCFG_EXPORT int accfg_engine_get_##field( \
 }
 
 accfg_engine_get_field(engine, group_id)
+
+static const struct {
+	const char *action;
+	enum accfg_event_type type;
+} accfg_event_actions[] = {
+	{ "add", ACCFG_EVENT_ADD },
+	{ "remove", ACCFG_EVENT_REMOVE },
+	{ "change", ACCFG_EVENT_CHANGE },
+	{ "bind", ACCFG_EVENT_BIND },
+	{ "unbind", ACCFG_EVENT_UNBIND },
+};
+
+/*
+ * Listens to the kernel uevents of the idxd bus. The driver binds and
+ * unbinds a device or wq when it is enabled or disabled, so the socket fd
+ * turns readable on state changes and can be added to a poll/epoll loop
+ * in place of rereading the state attributes of every object.
+ */
+ACCFG_EXPORT int accfg_monitor_new(struct accfg_ctx *ctx,
+		struct accfg_monitor **mon)
+{
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1,		/* kernel uevents */
+	};
+	struct accfg_monitor *m;
+	int rc;
+
+	if (!ctx || !mon)
+		return -EINVAL;
+
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return -ENOMEM;
+
+	m->ctx = ctx;
+	m->fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			NETLINK_KOBJECT_UEVENT);
+	if (m->fd < 0) {
+		rc = -errno;
+		err(ctx, "%s: netlink socket failed: %s\n", __func__,
+				strerror(errno));
+		free(m);
+		return rc;
+	}
+
+	if (bind(m->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		rc = -errno;
+		err(ctx, "%s: netlink bind failed: %s\n", __func__,
+				strerror(errno));
+		close(m->fd);
+		free(m);
+		return rc;
+	}
+
+	*mon = m;
+	return 0;
+}
+
+ACCFG_EXPORT void accfg_monitor_free(struct accfg_monitor *mon)
+{
+	if (!mon)
+		return;
+	close(mon->fd);
+	free(mon);
+}
+
+ACCFG_EXPORT int accfg_monitor_get_fd(struct accfg_monitor *mon)
+{
+	return mon ? mon->fd : -EINVAL;
+}
+
+static bool accfg_event_bus_match(const char *subsystem)
+{
+	char **bus_type;
+
+	for (bus_type = accfg_bus_types; *bus_type != NULL; bus_type++)
+		if (!strcmp(subsystem, *bus_type))
+			return true;
+	return false;
+}
+
+/* Points the event at the device and wq of the context it refers to */
+static void accfg_event_resolve(struct accfg_ctx *ctx,
+		struct accfg_event *event)
+{
+	struct accfg_device *device;
+	struct accfg_wq *wq;
+	int dev_id, id;
+
+	if (sscanf(event->devname, "wq%d.%d", &dev_id, &id) == 2 ||
+			sscanf(event->devname, "engine%d.%d", &dev_id, &id) == 2 ||
+			sscanf(event->devname, "group%d.%d", &dev_id, &id) == 2) {
+		accfg_device_foreach(ctx, device) {
+			if (accfg_device_get_id(device) != dev_id)
+				continue;
+			event->device = device;
+			if (event->devname[0] != 'w')
+				return;
+			accfg_wq_foreach(device, wq) {
+				if (accfg_wq_get_id(wq) == id) {
+					event->wq = wq;
+					return;
+				}
+			}
+			return;
+		}
+		return;
+	}
+
+	accfg_device_foreach(ctx, device) {
+		if (!strcmp(accfg_device_get_devname(device),
+					event->devname)) {
+			event->device = device;
+			return;
+		}
+	}
+}
+
+/*
+ * Reads the next idxd event. Returns 1 when an event was stored, 0 when
+ * there is nothing left to read and a negative errno on failure. Events
+ * of other subsystems are consumed and skipped.
+ */
+ACCFG_EXPORT int accfg_monitor_read(struct accfg_monitor *mon,
+		struct accfg_event *event)
+{
+	struct sockaddr_nl addr;
+	struct iovec iov;
+	struct msghdr msg;
+	const char *subsystem, *devpath, *driver, *action, *p, *end;
+	ssize_t len;
+	unsigned int i;
+
+	if (!mon || !event)
+		return -EINVAL;
+
+	for (;;) {
+		iov.iov_base = mon->buf;
+		iov.iov_len = sizeof(mon->buf) - 1;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &addr;
+		msg.msg_namelen = sizeof(addr);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		len = recvmsg(mon->fd, &msg, 0);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			if (errno == EINTR)
+				continue;
+			/* ENOBUFS: events were dropped, callers should resync */
+			return -errno;
+		}
+
+		/* only trust messages sent by the kernel */
+		if (addr.nl_pid != 0 || len == 0)
+			continue;
+		mon->buf[len] = '\0';
+		end = mon->buf + len;
+
+		subsystem = devpath = driver = action = NULL;
+		for (p = mon->buf + strlen(mon->buf) + 1; p < end;
+				p += strlen(p) + 1) {
+			if (!strncmp(p, "ACTION=", 7))
+				action = p + 7;
+			else if (!strncmp(p, "DEVPATH=", 8))
+				devpath = p + 8;
+			else if (!strncmp(p, "SUBSYSTEM=", 10))
+				subsystem = p + 10;
+			else if (!strncmp(p, "DRIVER=", 7))
+				driver = p + 7;
+		}
+
+		if (!action || !devpath || !subsystem ||
+				!accfg_event_bus_match(subsystem))
+			continue;
+
+		memset(event, 0, sizeof(*event));
+		for (i = 0; i < ARRAY_SIZE(accfg_event_actions); i++)
+			if (!strcmp(action, accfg_event_actions[i].action))
+				event->type = accfg_event_actions[i].type;
+		p = strrchr(devpath, '/');
+		snprintf(event->devname, sizeof(event->devname), "%s",
+				p ? p + 1 : devpath);
+		if (driver)
+			snprintf(event->driver, sizeof(event->driver), "%s",
+					driver);
+
+		accfg_event_resolve(mon->ctx, event);
+		dbg(mon->ctx, "%s: %s %s\n", __func__, action, event->devname);
+		return 1;
+	}
+}
+
+/* Calls fn for every pending event, returns the number of events */
+ACCFG_EXPORT int accfg_monitor_dispatch(struct accfg_monitor *mon,
+		accfg_event_fn fn, void *arg)
+{
+	struct accfg_event event;
+	int rc, n = 0;
+
+	if (!fn)
+		return -EINVAL;
+
+	while ((rc = accfg_monitor_read(mon, &event)) > 0) {
+		fn(&event, arg);
+		n++;
+	}
+
+	return rc < 0 ? rc : n;
+}
@@ -6,6 +6,7 @@
 
 #include <errno.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <syslog.h>
 #include <string.h>
 #include <inttypes.h>
@@ -135,6 +136,13 @@ struct accfg_error_ctx {
 	struct accfg_engine *engine;
 };
 
+/* kobject uevent listener, events are read from the netlink socket fd */
+struct accfg_monitor {
+	struct accfg_ctx *ctx;
+	int fd;
+	char buf[8192];
+};
+
 /**
  * struct accfg_ctx - library user context to find device instances
  *
@@ -154,6 +162,7 @@ struct accfg_ctx {
 	void *private_data;
 	bool compat;
 	struct accfg_error_ctx *error_ctx;
+	pthread_mutex_t error_lock;
 };
 
 #endif /* _LIBACCFG_PRIVATE_H_ */
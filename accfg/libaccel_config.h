@@ -73,6 +73,32 @@ enum accfg_control_flag {
 	ACCFG_WQ_DISABLE,
 };
 
+enum accfg_event_type {
+	ACCFG_EVENT_UNKNOWN = 0,
+	ACCFG_EVENT_ADD,
+	ACCFG_EVENT_REMOVE,
+	ACCFG_EVENT_CHANGE,
+	ACCFG_EVENT_BIND,
+	ACCFG_EVENT_UNBIND,
+};
+
+#define ACCFG_EVENT_NAME_LEN	32
+
+/*
+ * device and wq point at the objects of the context the event was matched
+ * against. For a wq, engine or group event device is its parent device.
+ * wq is NULL unless the event is for a wq, and either is NULL when the
+ * kernel object is not known to the context (e.g. a device added after
+ * the context was created).
+ */
+struct accfg_event {
+	enum accfg_event_type type;
+	char devname[ACCFG_EVENT_NAME_LEN];
+	char driver[ACCFG_EVENT_NAME_LEN];
+	struct accfg_device *device;
+	struct accfg_wq *wq;
+};
+
 /* no need to save device error */
 struct accfg_error {
 	uint32_t val[8];
@@ -204,6 +230,7 @@ unsigned int accfg_device_get_read_buffer_limit(struct accfg_device *device);
 unsigned int accfg_device_get_cdev_major(struct accfg_device *device);
 unsigned int accfg_device_get_version(struct accfg_device *device);
 int accfg_device_get_clients(struct accfg_device *device);
+int accfg_device_open_attr(struct accfg_device *device, const char *attr);
 int accfg_device_set_token_limit(struct accfg_device *dev, int val)
 	__attribute((deprecated));
 int accfg_device_set_read_buffer_limit(struct accfg_device *dev, int val);
@@ -219,6 +246,16 @@ struct accfg_wq *accfg_ctx_get_last_error_wq(struct accfg_ctx *ctx);
 struct accfg_group *accfg_ctx_get_last_error_group(struct accfg_ctx *ctx);
 struct accfg_engine *accfg_ctx_get_last_error_engine(struct accfg_ctx *ctx);
 
+/* libaccfg function for state change notification */
+struct accfg_monitor;
+typedef void (*accfg_event_fn)(struct accfg_event *event, void *arg);
+int accfg_monitor_new(struct accfg_ctx *ctx, struct accfg_monitor **mon);
+void accfg_monitor_free(struct accfg_monitor *mon);
+int accfg_monitor_get_fd(struct accfg_monitor *mon);
+int accfg_monitor_read(struct accfg_monitor *mon, struct accfg_event *event);
+int accfg_monitor_dispatch(struct accfg_monitor *mon, accfg_event_fn fn,
+		void *arg);
+
 /* libaccfg function for group */
 struct accfg_group;
 struct accfg_group *accfg_group_get_first(struct accfg_device *device);
@@ -247,6 +284,7 @@ int accfg_group_get_use_token_limit(struct accfg_group *group)
 int accfg_group_get_use_read_buffer_limit(struct accfg_group *group);
 int accfg_group_get_traffic_class_a(struct accfg_group *group);
 int accfg_group_get_traffic_class_b(struct accfg_group *group);
+int accfg_group_open_attr(struct accfg_group *group, const char *attr);
 int accfg_group_set_tokens_reserved(struct accfg_group *group, int val)
 	__attribute((deprecated));
 int accfg_group_set_read_buffers_reserved(struct accfg_group *group, int val);
@@ -299,6 +337,7 @@ int accfg_wq_get_threshold(struct accfg_wq *wq);
 int accfg_wq_get_clients(struct accfg_wq *wq);
 int accfg_wq_get_ats_disable(struct accfg_wq *wq);
 int accfg_wq_get_occupancy(struct accfg_wq *wq);
+int accfg_wq_open_attr(struct accfg_wq *wq, const char *attr);
 int accfg_wq_is_enabled(struct accfg_wq *wq);
 int accfg_wq_set_size(struct accfg_wq *wq, int val);
 int accfg_wq_set_priority(struct accfg_wq *wq, int val);
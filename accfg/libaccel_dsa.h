@@ -0,0 +1,301 @@
+// SPDX-License-Identifier: LGPL-2.1
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+
+#ifndef _LIBACCDSA_H_
+#define _LIBACCDSA_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Asynchronous offload of memory operations to a DSA user work queue.
+ *
+ * A dsa_ctx owns one work queue portal. Operations are described with
+ * the dsa_op_<opcode>() helpers, submitted with dsa_op_submit() and
+ * completed with dsa_op_poll() or dsa_op_wait(). When no usable work
+ * queue exists the context runs every operation on the CPU with the same
+ * completion semantics, so callers need a single code path.
+ */
+struct dsa_ctx;
+struct dsa_op;
+struct dsa_batch;
+struct dsa_stripe;
+struct dsa_zero;
+struct dsa_snap;
+struct dsa_dedup;
+struct dsa_dif_pipe;
+struct dsa_persist;
+
+/* dsa_ctx_new() flags */
+#define DSA_CTX_SHARED		0x1	/* only use shared work queues */
+#define DSA_CTX_DEDICATED	0x2	/* only use dedicated work queues */
+#define DSA_CTX_CPU		0x4	/* run everything on the CPU */
+#define DSA_CTX_NO_CPU		0x8	/* fail instead of falling back to the CPU */
+
+/* dsa_op_set_flags() flags, these are the descriptor flag bits */
+#define DSA_OP_FLAG_FENCE	0x0001	/* wait for earlier batch entries */
+#define DSA_OP_FLAG_CACHE	0x0100	/* write the destination to the cache */
+#define DSA_OP_FLAG_READBACK	0x4000	/* read back the destination */
+
+/* dsa_ctx_get_caps() bits, these are the GENCAP register bits */
+#define DSA_CAP_CACHE_CTRL	0x004	/* DSA_OP_FLAG_CACHE */
+#define DSA_CAP_CACHE_FLUSH	0x008	/* dsa_op_cflush() */
+#define DSA_CAP_READBACK	0x100	/* DSA_OP_FLAG_READBACK */
+#define DSA_CAP_DUR_WRITE	0x200	/* durable writes to persistent memory */
+#define DSA_CAP_ALL		(DSA_CAP_CACHE_CTRL | DSA_CAP_CACHE_FLUSH | \
+				 DSA_CAP_READBACK | DSA_CAP_DUR_WRITE)
+
+/* dsa_op_get_status() values of interest, see the DSA specification */
+#define DSA_OP_STATUS_PENDING	0x00
+#define DSA_OP_STATUS_SUCCESS	0x01
+#define DSA_OP_STATUS_PAGE_FAULT 0x03
+#define DSA_OP_STATUS_BATCH_FAIL 0x05
+#define DSA_OP_STATUS_DIF_ERR	0x09
+
+/* dsa_op_get_result() of compare, compval and cr_delta */
+#define DSA_OP_RESULT_MATCH	0
+#define DSA_OP_RESULT_MISMATCH	1
+#define DSA_OP_RESULT_OVERFLOW	2	/* delta record larger than allowed */
+
+/* Size of one create delta record entry, a u16 offset and 8 data bytes */
+#define DSA_DELTA_ENTRY_SIZE	10
+
+/* dsa_zero_pages() flags */
+#define DSA_ZERO_CACHE		0x1	/* leave the zeroed pages in the LLC */
+
+/* One range of pages for dsa_zero_pages() */
+struct dsa_zero_sg {
+	void *addr;
+	size_t len;
+};
+
+/* Totals over the dsa_zero_pages() calls of a zeroing service */
+struct dsa_zero_stats {
+	uint64_t bytes;
+	uint64_t descs;		/* MEMFILL descriptors after merging */
+};
+
+/* One payload for dsa_replicate() */
+struct dsa_replica_sg {
+	const void *src;
+	void *dst1;
+	void *dst2;
+	size_t len;
+};
+
+/* Totals over the dsa_snap_delta() calls of a snapshot engine */
+struct dsa_snap_stats {
+	uint64_t snapshots;
+	uint64_t bytes_scanned;	/* region bytes compared */
+	uint64_t bytes_out;	/* stream bytes produced */
+	uint64_t blocks_delta;	/* changed blocks sent as delta records */
+	uint64_t blocks_raw;	/* changed blocks sent as raw data */
+	uint64_t ns;		/* time spent taking snapshots */
+};
+
+/* Totals over the dsa_dedup_blocks() calls of a dedup engine */
+struct dsa_dedup_stats {
+	uint64_t blocks;
+	uint64_t duplicates;
+	uint64_t collisions;	/* fingerprint hits that did not compare */
+	uint64_t ns;		/* time spent deduping */
+};
+
+/* T10 protection information of one DIF operation */
+struct dsa_dif {
+	uint32_t block_size;	/* 512, 520, 4096 or 4104 */
+	uint8_t flags;		/* source or destination DIF flags byte */
+	uint8_t op_flags;	/* DIF check/insert/update flags byte */
+	uint16_t app_tag_mask;
+	uint16_t app_tag;
+	uint32_t ref_tag;
+};
+
+/* dsa_dif_pipe_run() operations */
+#define DSA_DIF_OP_CHECK	0
+#define DSA_DIF_OP_INSERT	1
+#define DSA_DIF_OP_STRIP	2
+#define DSA_DIF_OP_UPDATE	3
+
+/* dsa_dif_pipe_run() flags */
+#define DSA_DIF_VERIFY		0x1	/* recheck the result on the CPU */
+
+/* One run of blocks for dsa_dif_pipe_run() */
+struct dsa_dif_sg {
+	void *dst;		/* unused by DSA_DIF_OP_CHECK */
+	const void *src;
+	size_t blocks;
+};
+
+/* One run of blocks for dsa_dix_gen() and dsa_dix_verify() */
+struct dsa_dix_sg {
+	const void *data;
+	void *pi;		/* 8 bytes of protection info per block */
+	size_t blocks;
+};
+
+/* One dirty range for dsa_persist_flush() */
+struct dsa_persist_range {
+	const void *addr;
+	size_t len;
+};
+
+/* Totals of a persistence service */
+struct dsa_persist_stats {
+	uint64_t bytes_flushed;
+	uint64_t bytes_copied;
+	uint64_t drains;
+	uint64_t ns;		/* time spent waiting in dsa_persist_drain() */
+};
+
+/* Totals over the dsa_dif_pipe_run() and DIX calls of a DIF pipeline */
+struct dsa_dif_stats {
+	uint64_t blocks;
+	uint64_t bytes;		/* data bytes, without protection info */
+	uint64_t errors;	/* runs that failed a DIF check */
+	uint64_t ns;		/* time spent in runs */
+};
+
+int dsa_ctx_new(struct dsa_ctx **ctx, const char *wq_name, int flags);
+void dsa_ctx_free(struct dsa_ctx *ctx);
+bool dsa_ctx_is_cpu(struct dsa_ctx *ctx);
+const char *dsa_ctx_get_wq_name(struct dsa_ctx *ctx);
+uint64_t dsa_ctx_get_max_xfer_size(struct dsa_ctx *ctx);
+unsigned int dsa_ctx_get_max_batch_size(struct dsa_ctx *ctx);
+uint64_t dsa_ctx_get_caps(struct dsa_ctx *ctx);
+int dsa_ctx_get_log_priority(struct dsa_ctx *ctx);
+void dsa_ctx_set_log_priority(struct dsa_ctx *ctx, int priority);
+
+int dsa_op_new(struct dsa_ctx *ctx, struct dsa_op **op);
+void dsa_op_free(struct dsa_op *op);
+int dsa_op_set_flags(struct dsa_op *op, uint32_t flags);
+
+int dsa_op_noop(struct dsa_op *op);
+int dsa_op_drain(struct dsa_op *op);
+int dsa_op_cflush(struct dsa_op *op, const void *addr, size_t len);
+int dsa_op_memmove(struct dsa_op *op, void *dst, const void *src, size_t len);
+int dsa_op_dualcast(struct dsa_op *op, void *dst1, void *dst2,
+		const void *src, size_t len);
+int dsa_op_memfill(struct dsa_op *op, void *dst, uint64_t pattern,
+		size_t len);
+int dsa_op_compare(struct dsa_op *op, const void *src1, const void *src2,
+		size_t len);
+int dsa_op_compval(struct dsa_op *op, const void *src, uint64_t pattern,
+		size_t len);
+int dsa_op_crcgen(struct dsa_op *op, const void *src, size_t len,
+		uint32_t seed);
+int dsa_op_copy_crc(struct dsa_op *op, void *dst, const void *src,
+		size_t len, uint32_t seed);
+int dsa_op_cr_delta(struct dsa_op *op, const void *src1, const void *src2,
+		size_t len, void *delta, size_t max_delta_size);
+int dsa_op_ap_delta(struct dsa_op *op, void *dst, const void *delta,
+		size_t delta_size, size_t len);
+int dsa_op_dif_check(struct dsa_op *op, const void *src, size_t len,
+		const struct dsa_dif *dif);
+int dsa_op_dif_insert(struct dsa_op *op, void *dst, const void *src,
+		size_t len, const struct dsa_dif *dif);
+int dsa_op_dif_strip(struct dsa_op *op, void *dst, const void *src,
+		size_t len, const struct dsa_dif *dif);
+int dsa_op_dif_update(struct dsa_op *op, void *dst, const void *src,
+		size_t len, const struct dsa_dif *src_dif,
+		const struct dsa_dif *dst_dif);
+int dsa_op_dix_gen(struct dsa_op *op, void *pi, const void *src,
+		size_t len, const struct dsa_dif *dif);
+
+int dsa_op_submit(struct dsa_op *op);
+int dsa_op_poll(struct dsa_op *op);
+int dsa_op_wait(struct dsa_op *op, int timeout_ms);
+int dsa_op_get_status(struct dsa_op *op);
+int dsa_op_get_result(struct dsa_op *op);
+uint32_t dsa_op_get_crc(struct dsa_op *op);
+uint32_t dsa_op_get_delta_size(struct dsa_op *op);
+uint32_t dsa_op_get_bytes_completed(struct dsa_op *op);
+
+int dsa_memcpy(struct dsa_ctx *ctx, void *dst, const void *src, size_t len);
+int dsa_ctx_calibrate(struct dsa_ctx *ctx, const char *path);
+size_t dsa_ctx_get_copy_threshold(struct dsa_ctx *ctx);
+void dsa_ctx_set_copy_threshold(struct dsa_ctx *ctx, size_t threshold);
+unsigned int dsa_ctx_get_copy_split(struct dsa_ctx *ctx);
+int dsa_ctx_set_copy_split(struct dsa_ctx *ctx, unsigned int pct);
+
+int dsa_stripe_new(struct dsa_stripe **stripe, int numa_node, int flags);
+void dsa_stripe_free(struct dsa_stripe *stripe);
+unsigned int dsa_stripe_get_count(struct dsa_stripe *stripe);
+struct dsa_ctx *dsa_stripe_get_ctx(struct dsa_stripe *stripe,
+		unsigned int idx);
+int dsa_stripe_copy(struct dsa_stripe *stripe, void *dst, const void *src,
+		size_t len, unsigned int width);
+int dsa_stripe_scaling(struct dsa_stripe *stripe, void *dst,
+		const void *src, size_t len, double *mbps);
+
+int dsa_zero_new(struct dsa_ctx *ctx, unsigned int batch_size,
+		struct dsa_zero **zero);
+void dsa_zero_free(struct dsa_zero *zero);
+void dsa_zero_get_stats(struct dsa_zero *zero, struct dsa_zero_stats *stats);
+int dsa_zero_pages(struct dsa_zero *zero, const struct dsa_zero_sg *sg,
+		unsigned int count, int flags);
+
+int dsa_snap_new(struct dsa_ctx *ctx, const void *region, size_t len,
+		struct dsa_snap **snap);
+void dsa_snap_free(struct dsa_snap *snap);
+size_t dsa_snap_get_max_stream_size(struct dsa_snap *snap);
+void dsa_snap_get_stats(struct dsa_snap *snap, struct dsa_snap_stats *stats);
+int dsa_snap_delta(struct dsa_snap *snap, void *buf, size_t size,
+		size_t *stream_len);
+int dsa_snap_apply(struct dsa_ctx *ctx, void *dst, size_t len,
+		const void *stream, size_t stream_len);
+
+int dsa_replicate(struct dsa_ctx *ctx, const struct dsa_replica_sg *sg,
+		unsigned int count);
+
+int dsa_dedup_new(struct dsa_ctx *ctx, size_t block_size,
+		struct dsa_dedup **dedup);
+void dsa_dedup_free(struct dsa_dedup *dedup);
+void dsa_dedup_get_stats(struct dsa_dedup *dedup,
+		struct dsa_dedup_stats *stats);
+int dsa_dedup_blocks(struct dsa_dedup *dedup, const void *buf, size_t len,
+		uint64_t *ids);
+
+int dsa_dif_pipe_new(struct dsa_ctx *ctx, struct dsa_dif_pipe **pipe);
+void dsa_dif_pipe_free(struct dsa_dif_pipe *pipe);
+void dsa_dif_pipe_get_stats(struct dsa_dif_pipe *pipe,
+		struct dsa_dif_stats *stats);
+int dsa_dif_pipe_run(struct dsa_dif_pipe *pipe, int op,
+		const struct dsa_dif_sg *sg, unsigned int count,
+		const struct dsa_dif *src_dif, const struct dsa_dif *dst_dif,
+		int flags);
+int dsa_dix_gen(struct dsa_dif_pipe *pipe, const struct dsa_dix_sg *sg,
+		unsigned int count, const struct dsa_dif *dif, int flags);
+int dsa_dix_verify(struct dsa_dif_pipe *pipe, const struct dsa_dix_sg *sg,
+		unsigned int count, const struct dsa_dif *dif,
+		size_t *bad_block);
+
+int dsa_persist_new(struct dsa_ctx *ctx, struct dsa_persist **persist);
+void dsa_persist_free(struct dsa_persist *persist);
+void dsa_persist_get_stats(struct dsa_persist *persist,
+		struct dsa_persist_stats *stats);
+int dsa_persist_flush(struct dsa_persist *persist,
+		const struct dsa_persist_range *range, unsigned int count);
+int dsa_persist_memmove(struct dsa_persist *persist, void *dst,
+		const void *src, size_t len);
+void dsa_persist_fence(struct dsa_persist *persist);
+int dsa_persist_drain(struct dsa_persist *persist);
+
+int dsa_batch_new(struct dsa_ctx *ctx, unsigned int size,
+		struct dsa_batch **batch);
+void dsa_batch_free(struct dsa_batch *batch);
+struct dsa_op *dsa_batch_get_op(struct dsa_batch *batch, unsigned int idx);
+int dsa_batch_submit(struct dsa_batch *batch, unsigned int count);
+int dsa_batch_poll(struct dsa_batch *batch);
+int dsa_batch_wait(struct dsa_batch *batch, int timeout_ms);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -8,6 +8,7 @@
 #include <limits.h>
 #include <util/json.h>
 #include <util/filter.h>
+#include <util/image.h>
 #include <json-c/json.h>
 #include <json-c/json_object.h>
 #include <accfg/libaccel_config.h>
@@ -129,6 +130,7 @@ static uint64_t listopts_to_flags(void)
 
 static struct config_save {
 	const char *saved_file;
+	const char *format;
 } config_save;
 
 static int did_fail;
@@ -461,10 +463,232 @@ static void free_containers(struct list_filter_arg *lfa)
 	}
 }
 
-static int save_config(struct list_filter_arg *lfa, const char *saved_file)
+/*
+ * Streaming variants of the filters above. A device is written as soon as
+ * it is visited and each group is written together with its wqs and
+ * engines, so only one object is held as json-c at any time. The walk
+ * visits the wqs and engines of a device after its groups, the filters
+ * below then only write the ones that are not in a group.
+ */
+enum {
+	LIST_SECTION_NONE,
+	LIST_SECTION_GROUPS,
+	LIST_SECTION_WQS,
+	LIST_SECTION_ENGINES,
+};
+
+/* stream depth of the members of a device, inside the device array */
+#define LIST_DEVICE_DEPTH	2
+
+static bool stream_wq_listed(struct accfg_wq *wq)
+{
+	return list.idle || accfg_wq_is_enabled(wq);
+}
+
+static bool stream_engines_listed(struct accfg_device *dev,
+		struct list_filter_arg *lfa)
+{
+	return accfg_device_get_state(dev) == ACCFG_DEVICE_ENABLED ||
+		(lfa->flags & UTIL_JSON_IDLE);
+}
+
+static void stream_section(struct list_filter_arg *lfa, int section,
+		const char *key)
+{
+	if (lfa->section == section)
+		return;
+	util_json_stream_close_to(lfa->js, LIST_DEVICE_DEPTH);
+	util_json_stream_begin(lfa->js, key, true);
+	lfa->section = section;
+}
+
+static void stream_put(struct util_json_stream *js, struct json_object *jobj)
+{
+	util_json_stream_value(js, NULL, jobj);
+	json_object_put(jobj);
+}
+
+static bool stream_filter_device(struct accfg_device *device,
+		struct util_filter_ctx *ctx)
+{
+	struct list_filter_arg *lfa = ctx->list;
+	struct util_json_stream *js = lfa->js;
+	struct json_object *jdevice;
+
+	jdevice = util_device_to_json(device, lfa->flags);
+	if (!jdevice)
+		return false;
+
+	if (!js->depth)
+		util_json_stream_begin(js, NULL, true);
+	util_json_stream_close_to(js, 1);
+	util_json_stream_begin(js, NULL, false);
+	util_json_stream_members(js, jdevice);
+	json_object_put(jdevice);
+
+	lfa->section = LIST_SECTION_NONE;
+	lfa->dev_num++;
+
+	return true;
+}
+
+static bool stream_filter_group(struct accfg_group *group,
+		struct util_filter_ctx *ctx)
+{
+	struct list_filter_arg *lfa = ctx->list;
+	struct util_json_stream *js = lfa->js;
+	struct accfg_device *dev = accfg_group_get_device(group);
+	int group_id = accfg_group_get_id(group);
+	struct accfg_engine *engine;
+	struct json_object *jobj;
+	struct accfg_wq *wq;
+	bool open = false;
+
+	jobj = group_to_json(group, lfa->flags);
+	if (!jobj) {
+		fail("\n");
+		return false;
+	}
+
+	stream_section(lfa, LIST_SECTION_GROUPS, "groups");
+	util_json_stream_begin(js, NULL, false);
+	util_json_stream_members(js, jobj);
+	json_object_put(jobj);
+
+	accfg_wq_foreach(dev, wq) {
+		if (accfg_wq_get_group_id(wq) != group_id ||
+				!stream_wq_listed(wq))
+			continue;
+		jobj = util_wq_to_json(wq, lfa->flags);
+		if (!jobj)
+			continue;
+		if (!open)
+			util_json_stream_begin(js, "grouped_workqueues", true);
+		open = true;
+		stream_put(js, jobj);
+	}
+	if (open)
+		util_json_stream_end(js);
+
+	open = false;
+	if (stream_engines_listed(dev, lfa)) {
+		accfg_engine_foreach(dev, engine) {
+			if (accfg_engine_get_group_id(engine) != group_id)
+				continue;
+			jobj = util_engine_to_json(engine, lfa->flags);
+			if (!jobj)
+				continue;
+			if (!open)
+				util_json_stream_begin(js, "grouped_engines",
+						true);
+			open = true;
+			stream_put(js, jobj);
+		}
+	}
+	if (open)
+		util_json_stream_end(js);
+
+	util_json_stream_end(js);
+	lfa->group_num++;
+
+	return true;
+}
+
+static bool stream_filter_wq(struct accfg_wq *wq, struct util_filter_ctx *ctx)
+{
+	struct list_filter_arg *lfa = ctx->list;
+	struct accfg_device *dev = accfg_wq_get_device(wq);
+	struct json_object *jwq;
+
+	if (!stream_wq_listed(wq))
+		return true;
+
+	/* grouped wqs were written with their group */
+	if (accfg_device_group_get_by_id(dev, accfg_wq_get_group_id(wq)) ||
+			!(lfa->flags & UTIL_JSON_IDLE))
+		return true;
+
+	jwq = util_wq_to_json(wq, lfa->flags);
+	if (!jwq)
+		return false;
+
+	stream_section(lfa, LIST_SECTION_WQS, "ungrouped workqueues");
+	stream_put(lfa->js, jwq);
+
+	return true;
+}
+
+static bool stream_filter_engine(struct accfg_engine *engine,
+		struct util_filter_ctx *ctx)
+{
+	struct list_filter_arg *lfa = ctx->list;
+	struct accfg_device *dev = accfg_engine_get_device(engine);
+	struct json_object *jengine;
+
+	if (!stream_engines_listed(dev, lfa))
+		return false;
+
+	if (accfg_device_group_get_by_id(dev,
+				accfg_engine_get_group_id(engine)))
+		return true;
+
+	jengine = util_engine_to_json(engine, lfa->flags);
+	if (!jengine)
+		return false;
+
+	stream_section(lfa, LIST_SECTION_ENGINES, "ungrouped_engines");
+	stream_put(lfa->js, jengine);
+
+	return true;
+}
+
+/* Writes the device array to f while util_filter_walk() visits it */
+static int list_stream(struct accfg_ctx *ctx, FILE *f, uint64_t flags)
+{
+	struct util_filter_ctx fctx = { 0 };
+	struct list_filter_arg lfa = { 0 };
+	struct util_json_stream js;
+	int rc;
+
+	util_json_stream_init(&js, f);
+	lfa.js = &js;
+	lfa.flags = flags;
+	fctx.filter_device = stream_filter_device;
+	fctx.filter_group = stream_filter_group;
+	fctx.filter_wq = stream_filter_wq;
+	fctx.filter_engine = stream_filter_engine;
+	fctx.list = &lfa;
+
+	rc = util_filter_walk(ctx, &fctx, &util_param);
+	if (rc && !js.depth)
+		return rc;
+
+	if (!js.depth)
+		util_json_stream_begin(&js, NULL, true);
+	util_json_stream_close_to(&js, 0);
+	fputc('\n', f);
+
+	return rc;
+}
+
+static int save_config_image(FILE *fd, struct json_object *jdevices)
+{
+	struct strbuf sb = STRBUF_INIT;
+	int rc;
+
+	rc = util_image_from_json(jdevices, &sb);
+	if (!rc && fwrite(sb.buf, 1, sb.len, fd) != sb.len)
+		rc = -EIO;
+	strbuf_release(&sb);
+
+	return rc;
+}
+
+static int save_config(struct accfg_ctx *ctx, struct list_filter_arg *lfa,
+		const char *saved_file, bool binary)
 {
-	struct json_object *jdevices = lfa->jdevices;
 	FILE *fd = fopen(saved_file, "w");
+	int rc = 0;
 
 	if (!fd) {
 		fprintf(stderr, "Failed to open %s for save: %s\n",
@@ -472,14 +696,22 @@ static int save_config(struct list_filter_arg *lfa, const char *saved_file)
 		return -EIO;
 	}
 
-	if (jdevices)
-		util_display_json_array(fd, jdevices, lfa->flags);
+	if (binary) {
+		rc = save_config_image(fd, lfa->jdevices);
+		if (rc)
+			fprintf(stderr, "Failed to write config image: %s\n",
+					strerror(-rc));
+		json_object_put(lfa->jdevices);
+		/* free all the allocated container data structure */
+		free_containers(lfa);
+	} else {
+		rc = list_stream(ctx, fd, listopts_to_flags());
+	}
 
-	/* free all the allocated container data structure */
-	free_containers(lfa);
-	fclose(fd);
+	if (fclose(fd) && !rc)
+		rc = -EIO;
 
-	return 0;
+	return rc;
 }
 
 static int display_device(struct json_object *jdevices,
@@ -757,6 +989,14 @@ int cmd_list(int argc, const char **argv, void *ctx)
 		list.engines = !!util_param.engine;
 	}
 
+	/* the full listing is streamed, the filtered views need the tree */
+	if (num_list_flags() == 0) {
+		rc = list_stream(ctx, stdout, listopts_to_flags());
+		if (rc)
+			return rc;
+		return did_fail ? -EINVAL : 0;
+	}
+
 	lfa.jdevices = json_object_new_array();
 	if (!lfa.jdevices)
 		return -ENOMEM;
@@ -845,6 +1085,8 @@ int cmd_save(int argc, const char **argv, void *ctx)
 	const struct option options[] = {
 		OPT_STRING('s', "saved-file", &config_save.saved_file,
 			"saved-file", "specify saved file name and path"),
+		OPT_STRING('F', "format", &config_save.format, "json|binary",
+			"saved file format (default json)"),
 		OPT_END(),
 	};
 	const char *const u[] = {
@@ -855,6 +1097,7 @@ int cmd_save(int argc, const char **argv, void *ctx)
 	struct list_filter_arg lfa = { 0 };
 	int i, rc;
 	char *config_file;
+	bool binary;
 
 	argc = parse_options(argc, argv, options, u, 0);
 	for (i = 0; i < argc; i++)
@@ -863,22 +1106,33 @@ int cmd_save(int argc, const char **argv, void *ctx)
 	if (argc)
 		usage_with_options(u, options);
 
-	lfa.jdevices = json_object_new_array();
-	if (!lfa.jdevices)
-		return -ENOMEM;
-	list_head_init(&lfa.jdev_list);
+	if (config_save.format && strcmp(config_save.format, "json") &&
+			strcmp(config_save.format, "binary")) {
+		error("unknown format \"%s\"\n", config_save.format);
+		usage_with_options(u, options);
+	}
 
+	binary = config_save.format && !strcmp(config_save.format, "binary");
 	list.save_conf = true;
-	fctx.filter_device = filter_device;
-	fctx.filter_group = filter_group;
-	fctx.filter_wq = filter_wq;
-	fctx.filter_engine = filter_engine;
-	fctx.list = &lfa;
-	lfa.flags = listopts_to_flags();
 
-	rc = util_filter_walk(ctx, &fctx, &util_param);
-	if (rc)
-		return rc;
+	/* the image is encoded from the tree, json is streamed */
+	if (binary) {
+		lfa.jdevices = json_object_new_array();
+		if (!lfa.jdevices)
+			return -ENOMEM;
+		list_head_init(&lfa.jdev_list);
+
+		fctx.filter_device = filter_device;
+		fctx.filter_group = filter_group;
+		fctx.filter_wq = filter_wq;
+		fctx.filter_engine = filter_engine;
+		fctx.list = &lfa;
+		lfa.flags = listopts_to_flags();
+
+		rc = util_filter_walk(ctx, &fctx, &util_param);
+		if (rc)
+			return rc;
+	}
 
 	if (config_save.saved_file)
 		config_file = strdup(config_save.saved_file);
@@ -889,7 +1143,7 @@ int cmd_save(int argc, const char **argv, void *ctx)
 		return -ENOMEM;
 	}
 
-	rc = save_config(&lfa, config_file);
+	rc = save_config(ctx, &lfa, config_file, binary);
 	free(config_file);
 	if (rc < 0)
 		return rc;
@@ -0,0 +1,439 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright(c) 2019 Intel Corporation. All rights reserved.
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <linux/limits.h>
+#include <util/util.h>
+#include <util/parse-options.h>
+#include <util/strbuf.h>
+#include <accfg/libaccel_config.h>
+#include <accfg.h>
+
+#define METRICS_PREFIX		"accfg_"
+#define METRICS_ATTR_SIZE	256
+
+enum metric_obj {
+	METRIC_DEVICE,
+	METRIC_GROUP,
+	METRIC_WQ,
+};
+
+/*
+ * One OpenMetrics gauge family, read from a sysfs attribute of each object
+ * of its type. No sample is emitted where the attribute cannot be read.
+ */
+struct metric {
+	const char *name;
+	const char *help;
+	enum metric_obj obj;
+	const char *attr;
+	/* name before the token to read buffer rename */
+	const char *old_attr;
+};
+
+static const struct metric metrics[] = {
+	{ "device_clients", "Open clients of the device",
+		METRIC_DEVICE, "clients" },
+	{ "device_max_wq_size", "Total work queue entries of the device",
+		METRIC_DEVICE, "max_work_queues_size" },
+	{ "device_max_read_buffers", "Read buffers of the device",
+		METRIC_DEVICE, "max_read_buffers", "max_tokens" },
+	{ "device_read_buffer_limit", "Read buffer limit of the device",
+		METRIC_DEVICE, "read_buffer_limit", "token_limit" },
+	{ "device_event_log_size", "Event log entries of the device",
+		METRIC_DEVICE, "event_log_size" },
+	{ "group_read_buffers_reserved", "Read buffers reserved by the group",
+		METRIC_GROUP, "read_buffers_reserved", "tokens_reserved" },
+	{ "group_read_buffers_allowed", "Read buffers the group may use",
+		METRIC_GROUP, "read_buffers_allowed", "tokens_allowed" },
+	{ "group_use_read_buffer_limit", "Group is subject to the read buffer limit",
+		METRIC_GROUP, "use_read_buffer_limit", "use_token_limit" },
+	{ "wq_occupancy", "Descriptors queued in the work queue",
+		METRIC_WQ, "occupancy" },
+	{ "wq_clients", "Open clients of the work queue",
+		METRIC_WQ, "clients" },
+	{ "wq_size", "Entries of the work queue",
+		METRIC_WQ, "size" },
+	{ "wq_threshold", "Threshold of the shared work queue",
+		METRIC_WQ, "threshold" },
+	{ "wq_priority", "Priority of the work queue",
+		METRIC_WQ, "priority" },
+};
+
+#define NUM_METRICS	ARRAY_SIZE(metrics)
+
+/*
+ * A device, group or wq with its attributes held open, so that every
+ * interval rereads them with pread() like the monitor command does. The
+ * library caches most of them when the context is created.
+ */
+struct metrics_obj {
+	enum metric_obj type;
+	void *obj;
+	const char *dev;
+	const char *name;
+	int fd_state;
+	int fd_errors;
+	int fd[NUM_METRICS];
+};
+
+static const char * const dev_states[] = {
+	[ACCFG_DEVICE_DISABLED] = "disabled",
+	[ACCFG_DEVICE_ENABLED] = "enabled",
+};
+
+static const char * const wq_states[] = {
+	[ACCFG_WQ_DISABLED] = "disabled",
+	[ACCFG_WQ_ENABLED] = "enabled",
+	[ACCFG_WQ_QUIESCING] = "quiescing",
+	[ACCFG_WQ_LOCKED] = "locked",
+};
+
+static volatile sig_atomic_t metrics_stop;
+
+static void metrics_sig_handler(int sig)
+{
+	metrics_stop = 1;
+}
+
+static void metrics_family(struct strbuf *sb, const char *name,
+		const char *type, const char *help)
+{
+	strbuf_addf(sb, "# TYPE " METRICS_PREFIX "%s %s\n", name, type);
+	strbuf_addf(sb, "# HELP " METRICS_PREFIX "%s %s\n", name, help);
+}
+
+/* Rereads an attribute through its fd, trailing whitespace removed */
+static int metrics_read(int fd, char *buf, size_t len)
+{
+	ssize_t n;
+
+	if (fd < 0)
+		return -ENOENT;
+
+	n = pread(fd, buf, len - 1, 0);
+	if (n < 0)
+		return -errno;
+	while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' '))
+		n--;
+	buf[n] = '\0';
+
+	return 0;
+}
+
+static int metrics_open_attr(struct metrics_obj *mo, const char *attr)
+{
+	switch (mo->type) {
+	case METRIC_DEVICE:
+		return accfg_device_open_attr(mo->obj, attr);
+	case METRIC_GROUP:
+		return accfg_group_open_attr(mo->obj, attr);
+	default:
+		return accfg_wq_open_attr(mo->obj, attr);
+	}
+}
+
+static void metrics_open_obj(struct metrics_obj *mo, enum metric_obj type,
+		void *obj, const char *dev, const char *name)
+{
+	unsigned int i;
+
+	mo->type = type;
+	mo->obj = obj;
+	mo->dev = dev;
+	mo->name = name;
+	mo->fd_state = type == METRIC_GROUP ? -1 :
+		metrics_open_attr(mo, "state");
+	mo->fd_errors = type == METRIC_DEVICE ?
+		metrics_open_attr(mo, "errors") : -1;
+
+	for (i = 0; i < NUM_METRICS; i++) {
+		mo->fd[i] = -1;
+		if (metrics[i].obj != type)
+			continue;
+		mo->fd[i] = metrics_open_attr(mo, metrics[i].attr);
+		if (mo->fd[i] < 0 && metrics[i].old_attr)
+			mo->fd[i] = metrics_open_attr(mo, metrics[i].old_attr);
+	}
+}
+
+static void metrics_close(struct metrics_obj *objs, int num)
+{
+	unsigned int i;
+	int j;
+
+	for (j = 0; j < num; j++) {
+		if (objs[j].fd_state >= 0)
+			close(objs[j].fd_state);
+		if (objs[j].fd_errors >= 0)
+			close(objs[j].fd_errors);
+		for (i = 0; i < NUM_METRICS; i++)
+			if (objs[j].fd[i] >= 0)
+				close(objs[j].fd[i]);
+	}
+	free(objs);
+}
+
+/* Opens every device with its groups and wqs after it, in context order */
+static int metrics_open(struct accfg_ctx *ctx, struct metrics_obj **objs)
+{
+	struct accfg_device *dev;
+	struct accfg_group *group;
+	struct accfg_wq *wq;
+	struct metrics_obj *mo;
+	const char *devname;
+	int num = 0;
+
+	accfg_device_foreach(ctx, dev) {
+		num++;
+		accfg_group_foreach(dev, group)
+			num++;
+		accfg_wq_foreach(dev, wq)
+			num++;
+	}
+
+	mo = calloc(num, sizeof(*mo));
+	if (num && !mo)
+		return -ENOMEM;
+	*objs = mo;
+
+	accfg_device_foreach(ctx, dev) {
+		devname = accfg_device_get_devname(dev);
+		metrics_open_obj(mo++, METRIC_DEVICE, dev, devname, NULL);
+		accfg_group_foreach(dev, group)
+			metrics_open_obj(mo++, METRIC_GROUP, group, devname,
+					accfg_group_get_devname(group));
+		accfg_wq_foreach(dev, wq)
+			metrics_open_obj(mo++, METRIC_WQ, wq, devname,
+					accfg_wq_get_devname(wq));
+	}
+
+	return num;
+}
+
+static void metrics_render_gauge(struct metrics_obj *objs, int num,
+		struct strbuf *sb, unsigned int idx)
+{
+	const struct metric *m = &metrics[idx];
+	char buf[METRICS_ATTR_SIZE];
+	int j;
+
+	metrics_family(sb, m->name, "gauge", m->help);
+
+	for (j = 0; j < num; j++) {
+		if (objs[j].type != m->obj ||
+				metrics_read(objs[j].fd[idx], buf, sizeof(buf)))
+			continue;
+
+		if (m->obj == METRIC_DEVICE)
+			strbuf_addf(sb, METRICS_PREFIX
+				"%s{device=\"%s\"} %lld\n",
+				m->name, objs[j].dev, strtoll(buf, NULL, 0));
+		else
+			strbuf_addf(sb, METRICS_PREFIX
+				"%s{device=\"%s\",%s=\"%s\"} %lld\n",
+				m->name, objs[j].dev,
+				m->obj == METRIC_GROUP ? "group" : "wq",
+				objs[j].name, strtoll(buf, NULL, 0));
+	}
+}
+
+/* Index of the state string in names, -1 when it is none of them */
+static int metrics_state(int fd, const char * const *names, unsigned int n)
+{
+	char buf[METRICS_ATTR_SIZE];
+	unsigned int i;
+
+	if (metrics_read(fd, buf, sizeof(buf)))
+		return -1;
+	for (i = 0; i < n; i++)
+		if (names[i] && !strcmp(buf, names[i]))
+			return i;
+
+	return -1;
+}
+
+static void metrics_render_states(struct metrics_obj *objs, int num,
+		struct strbuf *sb)
+{
+	unsigned int i;
+	int j, state;
+
+	metrics_family(sb, "device_state", "stateset", "State of the device");
+	for (j = 0; j < num; j++) {
+		if (objs[j].type != METRIC_DEVICE)
+			continue;
+		state = metrics_state(objs[j].fd_state, dev_states,
+				ARRAY_SIZE(dev_states));
+		for (i = 0; i < ARRAY_SIZE(dev_states); i++)
+			strbuf_addf(sb, METRICS_PREFIX "device_state{device=\"%s\","
+				METRICS_PREFIX "device_state=\"%s\"} %d\n",
+				objs[j].dev, dev_states[i], state == (int)i);
+	}
+
+	metrics_family(sb, "wq_state", "stateset",
+			"State of the work queue");
+	for (j = 0; j < num; j++) {
+		if (objs[j].type != METRIC_WQ)
+			continue;
+		state = metrics_state(objs[j].fd_state, wq_states,
+				ARRAY_SIZE(wq_states));
+		for (i = 0; i < ARRAY_SIZE(wq_states); i++)
+			strbuf_addf(sb, METRICS_PREFIX
+				"wq_state{device=\"%s\",wq=\"%s\","
+				METRICS_PREFIX "wq_state=\"%s\"} %d\n",
+				objs[j].dev, objs[j].name, wq_states[i],
+				state == (int)i);
+	}
+}
+
+/* The errors attribute is a comma separated list of hex words */
+static int metrics_parse_errors(const char *buf, struct accfg_error *error)
+{
+	const char *p = buf;
+	unsigned int i;
+	char *end;
+
+	for (i = 0; i < ARRAY_SIZE(error->val); i++) {
+		error->val[i] = strtoul(p, &end, 16);
+		if (end == p)
+			return -EIO;
+		p = *end == ',' ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+static void metrics_render_errors(struct metrics_obj *objs, int num,
+		struct strbuf *sb)
+{
+	char buf[METRICS_ATTR_SIZE];
+	struct accfg_error error;
+	unsigned int i;
+	int j;
+
+	metrics_family(sb, "device_error", "gauge",
+			"Software error register words of the device");
+	for (j = 0; j < num; j++) {
+		if (objs[j].type != METRIC_DEVICE)
+			continue;
+		if (metrics_read(objs[j].fd_errors, buf, sizeof(buf)) ||
+				metrics_parse_errors(buf, &error))
+			continue;
+		for (i = 0; i < ARRAY_SIZE(error.val); i++)
+			strbuf_addf(sb, METRICS_PREFIX
+				"device_error{device=\"%s\",word=\"%u\"} %u\n",
+				objs[j].dev, i, error.val[i]);
+	}
+}
+
+/* Renders every family into sb, reusing its allocation */
+static void metrics_render(struct metrics_obj *objs, int num,
+		struct strbuf *sb)
+{
+	unsigned int i;
+
+	strbuf_setlen(sb, 0);
+	metrics_render_states(objs, num, sb);
+	for (i = 0; i < NUM_METRICS; i++)
+		metrics_render_gauge(objs, num, sb, i);
+	metrics_render_errors(objs, num, sb);
+	strbuf_addstr(sb, "# EOF\n");
+}
+
+static int metrics_write(struct strbuf *sb, const char *output)
+{
+	char tmp[PATH_MAX];
+	ssize_t n;
+	int fd;
+
+	if (!output) {
+		if (fwrite(sb->buf, 1, sb->len, stdout) != sb->len)
+			return -EIO;
+		fflush(stdout);
+		return 0;
+	}
+
+	/* write then rename so a scraper never sees a partial file */
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", output) >= (int)sizeof(tmp))
+		return -ENAMETOOLONG;
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", tmp,
+			strerror(errno));
+		return -errno;
+	}
+
+	n = write(fd, sb->buf, sb->len);
+	close(fd);
+	if (n != (ssize_t)sb->len || rename(tmp, output)) {
+		fprintf(stderr, "Failed to write %s: %s\n", output,
+			strerror(errno));
+		unlink(tmp);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int cmd_metrics(int argc, const char **argv, void *ctx)
+{
+	struct strbuf sb = STRBUF_INIT;
+	struct metrics_obj *objs = NULL;
+	unsigned int interval_ms = 0;
+	const char *output = NULL;
+	struct timespec ts;
+	int num, rc;
+
+	const struct option options[] = {
+		OPT_STRING('o', "output", &output, "output-file",
+			   "write the metrics to a file"),
+		OPT_UINTEGER('i', "interval", &interval_ms,
+			     "ms between updates, 0 writes the metrics once"),
+		OPT_END(),
+	};
+
+	const char *const u[] = {
+		"accel-config metrics [<options>]",
+		NULL
+	};
+
+	argc = parse_options(argc, argv, options, u, 0);
+
+	if (argc)
+		usage_with_options(u, options);
+
+	num = metrics_open(ctx, &objs);
+	if (num < 0)
+		return num;
+
+	if (interval_ms) {
+		signal(SIGINT, metrics_sig_handler);
+		signal(SIGTERM, metrics_sig_handler);
+	}
+
+	for (;;) {
+		metrics_render(objs, num, &sb);
+		rc = metrics_write(&sb, output);
+		if (rc || !interval_ms || metrics_stop)
+			break;
+		ts.tv_sec = interval_ms / 1000;
+		ts.tv_nsec = (interval_ms % 1000) * 1000000L;
+		nanosleep(&ts, NULL);
+		if (metrics_stop)
+			break;
+	}
+
+	metrics_close(objs, num);
+	strbuf_release(&sb);
+
+	return rc;
+}
@@ -0,0 +1,588 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright(c) 2019 Intel Corporation. All rights reserved.
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <json-c/json.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <util/util.h>
+#include <util/parse-options.h>
+#include <accfg/libaccel_config.h>
+#include <accfg.h>
+
+#define MON_ATTR_SIZE		128
+#define MON_INTERVAL_MS		1000
+#define MON_WINDOW		10
+
+struct mon_wq {
+	struct accfg_wq *wq;
+	const char *name;
+	int fd_state;
+	int fd_size;
+	int fd_occupancy;
+	int fd_clients;
+	char state[MON_ATTR_SIZE];
+	long size;
+	long occupancy;
+	long occupancy_max;
+	long clients;
+	double occupancy_avg;
+	double saturated_avg;
+};
+
+struct mon_dev {
+	struct accfg_device *dev;
+	const char *name;
+	int fd_state;
+	int fd_clients;
+	int fd_errors;
+	char state[MON_ATTR_SIZE];
+	char errors[MON_ATTR_SIZE];
+	long clients;
+	uint64_t error_events;
+	double error_rate;
+	double error_rate_avg;
+	struct mon_wq *wqs;
+	int num_wqs;
+};
+
+static volatile sig_atomic_t mon_stop;
+
+static void mon_sig_handler(int sig)
+{
+	mon_stop = 1;
+}
+
+/* Rereads a sysfs attribute through an fd kept open for the whole run */
+static int mon_read(int fd, char *buf)
+{
+	ssize_t n;
+
+	if (fd < 0)
+		return -ENOENT;
+
+	n = pread(fd, buf, MON_ATTR_SIZE - 1, 0);
+	if (n < 0)
+		return -errno;
+	while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' '))
+		n--;
+	buf[n] = '\0';
+
+	return 0;
+}
+
+static long mon_read_long(int fd)
+{
+	char buf[MON_ATTR_SIZE];
+
+	if (mon_read(fd, buf))
+		return -1;
+
+	return strtol(buf, NULL, 0);
+}
+
+/* The errors attribute is a comma separated list of hex words */
+static bool mon_errors_set(const char *errors)
+{
+	const char *p = errors;
+	char *end;
+
+	while (*p) {
+		if (strtoull(p, &end, 16))
+			return true;
+		if (end == p)
+			break;
+		p = end;
+		if (*p == ',')
+			p++;
+	}
+
+	return false;
+}
+
+static void mon_close(int fd)
+{
+	if (fd >= 0)
+		close(fd);
+}
+
+static int mon_open_dev(struct mon_dev *md, struct accfg_device *dev)
+{
+	struct accfg_wq *wq;
+	int i = 0;
+
+	md->dev = dev;
+	md->name = accfg_device_get_devname(dev);
+	md->fd_state = accfg_device_open_attr(dev, "state");
+	md->fd_clients = accfg_device_open_attr(dev, "clients");
+	md->fd_errors = accfg_device_open_attr(dev, "errors");
+	if (md->fd_state < 0)
+		return md->fd_state;
+
+	accfg_wq_foreach(dev, wq)
+		md->num_wqs++;
+
+	md->wqs = calloc(md->num_wqs, sizeof(*md->wqs));
+	if (!md->wqs)
+		return -ENOMEM;
+
+	accfg_wq_foreach(dev, wq) {
+		struct mon_wq *mw = &md->wqs[i++];
+
+		mw->wq = wq;
+		mw->name = accfg_wq_get_devname(wq);
+		mw->fd_state = accfg_wq_open_attr(wq, "state");
+		mw->fd_size = accfg_wq_open_attr(wq, "size");
+		mw->fd_occupancy = accfg_wq_open_attr(wq, "occupancy");
+		mw->fd_clients = accfg_wq_open_attr(wq, "clients");
+	}
+
+	return 0;
+}
+
+static void mon_close_dev(struct mon_dev *md)
+{
+	int i;
+
+	for (i = 0; i < md->num_wqs; i++) {
+		mon_close(md->wqs[i].fd_state);
+		mon_close(md->wqs[i].fd_size);
+		mon_close(md->wqs[i].fd_occupancy);
+		mon_close(md->wqs[i].fd_clients);
+	}
+	free(md->wqs);
+	mon_close(md->fd_state);
+	mon_close(md->fd_clients);
+	mon_close(md->fd_errors);
+}
+
+/*
+ * Takes one sample of a device and its wqs. Averages are exponentially
+ * weighted with alpha derived from the window, errors count as an event
+ * each time the error words change to a non-zero value.
+ */
+static void mon_sample(struct mon_dev *md, double alpha, double secs,
+		bool first)
+{
+	char errors[MON_ATTR_SIZE];
+	unsigned int events = 0;
+	int i;
+
+	if (mon_read(md->fd_state, md->state))
+		strcpy(md->state, "unknown");
+	md->clients = mon_read_long(md->fd_clients);
+
+	if (!mon_read(md->fd_errors, errors)) {
+		if (strcmp(errors, md->errors) && mon_errors_set(errors) &&
+				!first)
+			events = 1;
+		strcpy(md->errors, errors);
+	}
+	md->error_events += events;
+	md->error_rate = secs > 0 ? events / secs : 0;
+	md->error_rate_avg = first ? md->error_rate :
+		md->error_rate_avg + alpha * (md->error_rate -
+				md->error_rate_avg);
+
+	for (i = 0; i < md->num_wqs; i++) {
+		struct mon_wq *mw = &md->wqs[i];
+		double saturated;
+
+		if (mon_read(mw->fd_state, mw->state))
+			strcpy(mw->state, "unknown");
+		mw->size = mon_read_long(mw->fd_size);
+		mw->occupancy = mon_read_long(mw->fd_occupancy);
+		mw->clients = mon_read_long(mw->fd_clients);
+
+		saturated = mw->size > 0 && mw->occupancy >= mw->size;
+		if (first) {
+			mw->occupancy_avg = mw->occupancy;
+			mw->saturated_avg = saturated;
+		} else {
+			mw->occupancy_avg += alpha * (mw->occupancy -
+					mw->occupancy_avg);
+			mw->saturated_avg += alpha * (saturated -
+					mw->saturated_avg);
+		}
+		if (mw->occupancy > mw->occupancy_max)
+			mw->occupancy_max = mw->occupancy;
+	}
+}
+
+static bool mon_wq_shown(struct mon_wq *mw, bool all)
+{
+	return all || mw->size > 0 || strcmp(mw->state, "disabled");
+}
+
+static void mon_add_int(struct json_object *jobj, const char *key,
+		int64_t val)
+{
+	struct json_object *jval = json_object_new_int64(val);
+
+	if (jval)
+		json_object_object_add(jobj, key, jval);
+}
+
+static void mon_add_double(struct json_object *jobj, const char *key,
+		double val)
+{
+	struct json_object *jval = json_object_new_double(val);
+
+	if (jval)
+		json_object_object_add(jobj, key, jval);
+}
+
+static void mon_add_string(struct json_object *jobj, const char *key,
+		const char *val)
+{
+	struct json_object *jval = json_object_new_string(val);
+
+	if (jval)
+		json_object_object_add(jobj, key, jval);
+}
+
+/* Prints one line of JSON per sample so the stream can be tailed */
+static void mon_print_json(struct mon_dev *mds, int num, uint64_t ts_ms,
+		bool all)
+{
+	struct json_object *jsample, *jdevs, *jdev, *jwqs, *jwq;
+	int d, i;
+
+	jsample = json_object_new_object();
+	jdevs = json_object_new_array();
+	if (!jsample || !jdevs) {
+		json_object_put(jsample);
+		json_object_put(jdevs);
+		return;
+	}
+
+	mon_add_int(jsample, "timestamp_ms", ts_ms);
+	json_object_object_add(jsample, "devices", jdevs);
+
+	for (d = 0; d < num; d++) {
+		struct mon_dev *md = &mds[d];
+
+		jdev = json_object_new_object();
+		jwqs = json_object_new_array();
+		if (!jdev || !jwqs) {
+			json_object_put(jdev);
+			json_object_put(jwqs);
+			break;
+		}
+		json_object_array_add(jdevs, jdev);
+		mon_add_string(jdev, "dev", md->name);
+		mon_add_string(jdev, "state", md->state);
+		mon_add_int(jdev, "clients", md->clients);
+		mon_add_string(jdev, "errors", md->errors);
+		mon_add_int(jdev, "error_events", md->error_events);
+		mon_add_double(jdev, "error_rate", md->error_rate);
+		mon_add_double(jdev, "error_rate_avg", md->error_rate_avg);
+		json_object_object_add(jdev, "workqueues", jwqs);
+
+		for (i = 0; i < md->num_wqs; i++) {
+			struct mon_wq *mw = &md->wqs[i];
+
+			if (!mon_wq_shown(mw, all))
+				continue;
+			jwq = json_object_new_object();
+			if (!jwq)
+				break;
+			json_object_array_add(jwqs, jwq);
+			mon_add_string(jwq, "dev", mw->name);
+			mon_add_string(jwq, "state", mw->state);
+			mon_add_int(jwq, "clients", mw->clients);
+			mon_add_int(jwq, "size", mw->size);
+			mon_add_int(jwq, "occupancy", mw->occupancy);
+			mon_add_int(jwq, "occupancy_max", mw->occupancy_max);
+			mon_add_double(jwq, "occupancy_avg", mw->occupancy_avg);
+			mon_add_double(jwq, "saturated_avg", mw->saturated_avg);
+		}
+	}
+
+	printf("%s\n", json_object_to_json_string_ext(jsample,
+				JSON_C_TO_STRING_PLAIN));
+	fflush(stdout);
+	json_object_put(jsample);
+}
+
+static void mon_print_table(struct mon_dev *mds, int num, bool all,
+		bool clear)
+{
+	int d, i;
+
+	if (clear)
+		printf("\033[H\033[2J");
+
+	printf("%-10s %-10s %7s %9s %9s %9s %7s %6s\n", "DEVICE", "STATE",
+			"CLIENTS", "OCC", "OCC_AVG", "OCC_MAX", "SAT%", "ERR/s");
+	for (d = 0; d < num; d++) {
+		struct mon_dev *md = &mds[d];
+
+		printf("%-10s %-10s %7ld %9s %9s %9s %7s %6.2f%s\n",
+				md->name, md->state, md->clients, "", "", "",
+				"", md->error_rate_avg,
+				mon_errors_set(md->errors) ? " !" : "");
+		for (i = 0; i < md->num_wqs; i++) {
+			struct mon_wq *mw = &md->wqs[i];
+			char occ[32];
+
+			if (!mon_wq_shown(mw, all))
+				continue;
+			snprintf(occ, sizeof(occ), "%ld/%ld", mw->occupancy,
+					mw->size);
+			printf("  %-8s %-10s %7ld %9s %9.1f %9ld %7.1f\n",
+					mw->name, mw->state, mw->clients, occ,
+					mw->occupancy_avg, mw->occupancy_max,
+					mw->saturated_avg * 100);
+		}
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+static uint64_t mon_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static const char *mon_event_names[] = {
+	[ACCFG_EVENT_UNKNOWN] = "unknown",
+	[ACCFG_EVENT_ADD] = "add",
+	[ACCFG_EVENT_REMOVE] = "remove",
+	[ACCFG_EVENT_CHANGE] = "change",
+	[ACCFG_EVENT_BIND] = "enabled",
+	[ACCFG_EVENT_UNBIND] = "disabled",
+};
+
+static bool mon_event_match(struct accfg_event *ev, int argc,
+		const char **argv)
+{
+	int i;
+
+	if (!argc)
+		return true;
+	for (i = 0; i < argc; i++)
+		if (!strcmp(argv[i], ev->devname) || (ev->device &&
+				!strcmp(argv[i],
+					accfg_device_get_devname(ev->device))))
+			return true;
+	return false;
+}
+
+static void mon_print_event_json(struct accfg_event *ev, const char *state)
+{
+	struct json_object *jev = json_object_new_object();
+
+	if (!jev)
+		return;
+	mon_add_int(jev, "timestamp_ms", mon_now_ms());
+	mon_add_string(jev, "event", mon_event_names[ev->type]);
+	mon_add_string(jev, "dev", ev->devname);
+	if (ev->driver[0])
+		mon_add_string(jev, "driver", ev->driver);
+	mon_add_string(jev, "state", state);
+	printf("%s\n", json_object_to_json_string_ext(jev,
+				JSON_C_TO_STRING_PLAIN));
+	json_object_put(jev);
+}
+
+/* Prints state changes as the kernel reports them instead of sampling */
+static int mon_events(struct accfg_ctx *ctx, int argc, const char **argv,
+		unsigned int count, bool json)
+{
+	struct accfg_monitor *mon;
+	struct accfg_event ev;
+	struct pollfd pfd;
+	unsigned int n = 0;
+	const char *state;
+	int rc;
+
+	rc = accfg_monitor_new(ctx, &mon);
+	if (rc) {
+		fprintf(stderr, "failed to listen for events: %s\n",
+			strerror(-rc));
+		return rc;
+	}
+
+	pfd.fd = accfg_monitor_get_fd(mon);
+	pfd.events = POLLIN;
+
+	while (!mon_stop && (!count || n < count)) {
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			rc = -errno;
+			break;
+		}
+
+		while (!mon_stop && (!count || n < count)) {
+			rc = accfg_monitor_read(mon, &ev);
+			if (rc == -ENOBUFS) {
+				fprintf(stderr, "events were dropped\n");
+				rc = 0;
+				continue;
+			}
+			if (rc <= 0)
+				break;
+			rc = 0;
+			if (!mon_event_match(&ev, argc, argv))
+				continue;
+
+			/* only the object that changed is reread */
+			state = "-";
+			if (ev.wq)
+				state = accfg_wq_get_state(ev.wq) ==
+					ACCFG_WQ_ENABLED ? "enabled" :
+					"disabled";
+			else if (ev.device && !strcmp(ev.devname,
+					accfg_device_get_devname(ev.device)))
+				state = accfg_device_get_state(ev.device) ==
+					ACCFG_DEVICE_ENABLED ? "enabled" :
+					"disabled";
+
+			if (json)
+				mon_print_event_json(&ev, state);
+			else
+				printf("%-8s %-12s %-10s %s\n",
+					mon_event_names[ev.type], ev.devname,
+					ev.driver[0] ? ev.driver : "-", state);
+			fflush(stdout);
+			n++;
+		}
+		if (rc < 0)
+			break;
+	}
+
+	accfg_monitor_free(mon);
+	return rc;
+}
+
+int cmd_monitor(int argc, const char **argv, void *ctx)
+{
+	unsigned int interval_ms = MON_INTERVAL_MS;
+	unsigned int window = MON_WINDOW;
+	unsigned int count = 0, tick;
+	bool json = false, all = false, events = false;
+	struct accfg_device *dev;
+	struct timespec next, prev, now;
+	struct mon_dev *mds;
+	int num = 0, i, rc = 0;
+	double alpha;
+
+	const struct option options[] = {
+		OPT_UINTEGER('i', "interval", &interval_ms,
+			     "ms between samples (default 1000)"),
+		OPT_UINTEGER('c', "count", &count,
+			     "number of samples to take, 0 runs until interrupted"),
+		OPT_UINTEGER('w', "window", &window,
+			     "samples in the moving averages (default 10)"),
+		OPT_BOOLEAN('j', "json", &json,
+			    "print one line of JSON per sample"),
+		OPT_BOOLEAN('a', "all", &all,
+			    "include unconfigured work queues"),
+		OPT_BOOLEAN('e', "events", &events,
+			    "print enable and disable events instead of sampling"),
+		OPT_END(),
+	};
+
+	const char *const u[] = {
+		"accel-config monitor [<device name> ...] [<options>]",
+		NULL
+	};
+
+	argc = parse_options(argc, argv, options, u, 0);
+
+	if (!interval_ms || !window) {
+		error("interval and window must be non-zero\n");
+		return -EINVAL;
+	}
+
+	if (events) {
+		signal(SIGINT, mon_sig_handler);
+		signal(SIGTERM, mon_sig_handler);
+		return mon_events(ctx, argc, argv, count, json);
+	}
+
+	accfg_device_foreach(ctx, dev)
+		num++;
+
+	mds = calloc(num ? num : 1, sizeof(*mds));
+	if (!mds)
+		return -ENOMEM;
+
+	num = 0;
+	accfg_device_foreach(ctx, dev) {
+		if (argc) {
+			for (i = 0; i < argc; i++)
+				if (!strcmp(argv[i],
+						accfg_device_get_devname(dev)))
+					break;
+			if (i == argc)
+				continue;
+		}
+		rc = mon_open_dev(&mds[num++], dev);
+		if (rc) {
+			fprintf(stderr, "%s: failed to open attributes: %s\n",
+				accfg_device_get_devname(dev), strerror(-rc));
+			goto out;
+		}
+	}
+
+	if (!num) {
+		fprintf(stderr, "no matching device found\n");
+		rc = -ENODEV;
+		goto out;
+	}
+
+	signal(SIGINT, mon_sig_handler);
+	signal(SIGTERM, mon_sig_handler);
+
+	alpha = 2.0 / (window + 1);
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	prev = next;
+
+	for (tick = 0; !mon_stop && (!count || tick < count); tick++) {
+		double secs;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		secs = (now.tv_sec - prev.tv_sec) +
+			(now.tv_nsec - prev.tv_nsec) / 1e9;
+		prev = now;
+
+		for (i = 0; i < num; i++)
+			mon_sample(&mds[i], alpha, secs, tick == 0);
+
+		if (json)
+			mon_print_json(mds, num, mon_now_ms(), all);
+		else
+			mon_print_table(mds, num, all, isatty(STDOUT_FILENO));
+
+		if (count && tick + 1 == count)
+			break;
+
+		/* sleep to an absolute deadline so the rate does not drift */
+		next.tv_nsec += (interval_ms % 1000) * 1000000L;
+		next.tv_sec += interval_ms / 1000 + next.tv_nsec / 1000000000L;
+		next.tv_nsec %= 1000000000L;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+					NULL) == EINTR && !mon_stop)
+			;
+	}
+
+out:
+	for (i = 0; i < num; i++)
+		mon_close_dev(&mds[i]);
+	free(mds);
+
+	return rc;
+}
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright(c) 2019 Intel Corporation. All rights reserved.
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <util/filter.h>
+#include <util/util.h>
+#include <util/parse-options.h>
+#include <util/perfmon.h>
+#include <accfg/libaccel_config.h>
+#include <accfg.h>
+
+#define PERF_DURATION_MS	1000
+
+static int perf_set_events(struct perfmon *pm, const char *events)
+{
+	char *list, *tok, *save = NULL;
+	int rc = 0;
+
+	list = strdup(events);
+	if (!list)
+		return -ENOMEM;
+
+	for (tok = strtok_r(list, ",", &save); tok;
+			tok = strtok_r(NULL, ",", &save)) {
+		rc = perfmon_set_event(pm, tok);
+		if (rc) {
+			fprintf(stderr, "invalid event %s\n", tok);
+			break;
+		}
+	}
+
+	free(list);
+	return rc;
+}
+
+/* Runs the command, or sleeps for duration_ms when there is none */
+static int perf_run(int argc, const char **argv, unsigned int duration_ms)
+{
+	struct timespec ts;
+	pid_t pid;
+	int status;
+
+	if (!argc) {
+		ts.tv_sec = duration_ms / 1000;
+		ts.tv_nsec = (duration_ms % 1000) * 1000000L;
+		nanosleep(&ts, NULL);
+		return 0;
+	}
+
+	pid = fork();
+	if (pid < 0)
+		return -errno;
+	if (pid == 0) {
+		execvp(argv[0], (char * const *)argv);
+		fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+		_exit(127);
+	}
+
+	if (waitpid(pid, &status, 0) < 0)
+		return -errno;
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		fprintf(stderr, "%s exited with status %d\n", argv[0],
+			WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+
+	return 0;
+}
+
+int cmd_perf(int argc, const char **argv, void *ctx)
+{
+	unsigned int duration_ms = PERF_DURATION_MS;
+	const char *events = NULL, *replay_file = NULL, *record_file = NULL;
+	struct perfmon_replay *replay = NULL;
+	struct perfmon_report report;
+	struct accfg_device *dev;
+	struct perfmon pm;
+	unsigned int num_engines;
+	FILE *f;
+	int rc;
+
+	const struct option options[] = {
+		OPT_UINTEGER('t', "time", &duration_ms,
+			     "ms to count when no command is given (default 1000)"),
+		OPT_STRING('e', "events", &events, "name=category:event,...",
+			   "override event encodings"),
+		OPT_STRING('r', "replay", &replay_file, "file",
+			   "report counters recorded with --record"),
+		OPT_STRING('w', "record", &record_file, "file",
+			   "save the counter values to a file"),
+		OPT_END(),
+	};
+
+	const char *const u[] = {
+		"accel-config perf <device name> [<options>] [-- <command> [<args>]]",
+		NULL
+	};
+
+	argc = parse_options(argc, argv, options, u, 0);
+
+	if (argc < 1)
+		usage_with_options(u, options);
+
+	if (replay_file) {
+		rc = perfmon_replay_load(replay_file, &replay);
+		if (rc) {
+			fprintf(stderr, "failed to load %s: %s\n", replay_file,
+				strerror(-rc));
+			return rc;
+		}
+		num_engines = perfmon_replay_engines(replay);
+		rc = perfmon_init(&pm, argv[0], num_engines,
+				&perfmon_replay_ops, replay);
+	} else {
+		if (parse_device_name(ctx, argv[0], &dev)) {
+			fprintf(stderr, "%s is not a valid device name\n",
+				argv[0]);
+			return -EINVAL;
+		}
+		num_engines = accfg_device_get_max_engines(dev);
+		rc = perfmon_init(&pm, argv[0], num_engines,
+				&perfmon_perf_ops, NULL);
+	}
+	if (rc)
+		goto out;
+
+	if (events) {
+		rc = perf_set_events(&pm, events);
+		if (rc)
+			goto out;
+	}
+
+	rc = perfmon_start(&pm);
+	if (rc) {
+		fprintf(stderr, "%s: no perfmon counter could be opened\n",
+			argv[0]);
+		goto out;
+	}
+
+	if (!replay)
+		rc = perf_run(argc - 1, argv + 1, duration_ms);
+	perfmon_stop(&pm);
+	if (rc)
+		goto out;
+
+	perfmon_compute(&pm, &report);
+	perfmon_print(&report, pm.pmu, stdout);
+
+	if (record_file) {
+		f = fopen(record_file, "w");
+		if (!f) {
+			fprintf(stderr, "Failed to open %s for save: %s\n",
+				record_file, strerror(errno));
+			rc = -EIO;
+			goto out;
+		}
+		perfmon_record(&pm, f);
+		fclose(f);
+	}
+
+out:
+	perfmon_free(&pm);
+	perfmon_replay_free(replay);
+	return rc;
+}
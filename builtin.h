@@ -29,8 +29,13 @@ int cmd_enable_wq(int argc, const char **argv, void *ctx);
 int cmd_config_device(int argc, const char **argv, void *ctx);
 int cmd_config_group(int argc, const char **argv, void *ctx);
 int cmd_config_wq(int argc, const char **argv, void *ctx);
+int cmd_reconfigure_wq(int argc, const char **argv, void *ctx);
 int cmd_config_engine(int argc, const char **argv, void *ctx);
 int cmd_config_default(int argc, const char **argv, void *ctx);
+int cmd_autotune(int argc, const char **argv, void *ctx);
+int cmd_monitor(int argc, const char **argv, void *ctx);
+int cmd_metrics(int argc, const char **argv, void *ctx);
+int cmd_perf(int argc, const char **argv, void *ctx);
 #ifdef ENABLE_TEST
 int cmd_test(int argc, const char **argv, void *ctx);
 #endif
@@ -21,19 +21,6 @@ int debug_logging;
 int force_enqcmd = 0;
 static int umwait_support;
 
-static inline void cpuid(unsigned int *eax, unsigned int *ebx,
-			 unsigned int *ecx, unsigned int *edx)
-{
-	/* ecx is often an input as well as an output. */
-	asm volatile("cpuid"
-		: "=a" (*eax),
-		"=b" (*ebx),
-		"=c" (*ecx),
-		"=d" (*edx)
-		: "0" (*eax), "2" (*ecx)
-		: "memory");
-}
-
 int get_random_value(void)
 {
 	static int extra_seed;
@@ -104,7 +91,7 @@ static int acctest_setup_wq(struct acctest_context *ctx, struct accfg_wq *wq)
 }
 
 static struct accfg_wq *acctest_get_wq(struct acctest_context *ctx,
-				       int dev_id, int shared)
+				       int dev_id, int shared, int nth)
 {
 	struct accfg_device *device;
 	struct accfg_wq *wq;
@@ -148,6 +135,10 @@ static struct accfg_wq *acctest_get_wq(struct acctest_context *ctx,
 			    (mode == ACCFG_WQ_DEDICATED && shared))
 				continue;
 
+			/* Skip the usable wqs already claimed by the caller */
+			if (nth-- > 0)
+				continue;
+
 			rc = acctest_setup_wq(ctx, wq);
 			if (rc < 0)
 				return NULL;
@@ -208,23 +199,10 @@ static uint32_t bsr(uint32_t val)
 	return msb - 1;
 }
 
-int acctest_alloc(struct acctest_context *ctx, int shared, int dev_id, int wq_id)
+static void acctest_setup_ctx(struct acctest_context *ctx)
 {
 	struct accfg_device *dev;
 
-	/* Is wq already allocated? */
-	if (ctx->wq_reg)
-		return 0;
-
-	if (wq_id != ACCTEST_DEVICE_ID_NO_INPUT)
-		ctx->wq = acctest_get_wq_byid(ctx, dev_id, wq_id);
-	else
-		ctx->wq = acctest_get_wq(ctx, dev_id, shared);
-
-	if (!ctx->wq) {
-		err("No usable wq found\n");
-		return -ENODEV;
-	}
 	dev = accfg_wq_get_device(ctx->wq);
 	ctx->dedicated = accfg_wq_get_mode(ctx->wq);
 	ctx->wq_size = accfg_wq_get_size(ctx->wq);
@@ -243,6 +221,41 @@ int acctest_alloc(struct acctest_context *ctx, int shared, int dev_id, int wq_id
 	info("alloc wq %d %s size %d addr %p batch sz %#x xfer sz %#x\n",
 	     ctx->wq_idx, (ctx->dedicated == ACCFG_WQ_SHARED) ? "shared" : "dedicated",
 	     ctx->wq_size, ctx->wq_reg, ctx->max_batch_size, ctx->max_xfer_size);
+}
+
+int acctest_alloc(struct acctest_context *ctx, int shared, int dev_id, int wq_id)
+{
+	/* Is wq already allocated? */
+	if (ctx->wq_reg)
+		return 0;
+
+	if (wq_id != ACCTEST_DEVICE_ID_NO_INPUT)
+		ctx->wq = acctest_get_wq_byid(ctx, dev_id, wq_id);
+	else
+		ctx->wq = acctest_get_wq(ctx, dev_id, shared, 0);
+
+	if (!ctx->wq) {
+		err("No usable wq found\n");
+		return -ENODEV;
+	}
+	acctest_setup_ctx(ctx);
+
+	return 0;
+}
+
+/*
+ * Open the nth usable wq of ctx->dev_type so that one job can be spread
+ * over several wqs, each driven through its own context.
+ */
+int acctest_alloc_nth(struct acctest_context *ctx, int shared, int dev_id, int nth)
+{
+	if (ctx->wq_reg)
+		return 0;
+
+	ctx->wq = acctest_get_wq(ctx, dev_id, shared, nth);
+	if (!ctx->wq)
+		return -ENODEV;
+	acctest_setup_ctx(ctx);
 
 	return 0;
 }
@@ -322,32 +335,6 @@ static int acctest_desc_submit_swq(struct acctest_context *ctx, struct hw_desc *
 	return ret;
 }
 
-static inline unsigned long rdtsc(void)
-{
-	uint32_t a, d;
-
-	asm volatile("rdtsc" : "=a"(a), "=d"(d));
-	return ((uint64_t)d << 32) | (uint64_t)a;
-}
-
-static inline void umonitor(void *addr)
-{
-	asm volatile(".byte 0xf3, 0x48, 0x0f, 0xae, 0xf0" : : "a"(addr));
-}
-
-static inline int umwait(unsigned long timeout, unsigned int state)
-{
-	uint8_t r;
-	uint32_t timeout_low = (uint32_t)timeout;
-	uint32_t timeout_high = (uint32_t)(timeout >> 32);
-
-	asm volatile(".byte 0xf2, 0x48, 0x0f, 0xae, 0xf1\t\n"
-		"setc %0\t\n"
-		: "=r"(r)
-		: "c"(state), "a"(timeout_low), "d"(timeout_high));
-	return r;
-}
-
 int acctest_wait_on_desc_timeout(struct completion_record *comp,
 				 struct acctest_context *ctx,
 				 unsigned int msec_timeout)
@@ -550,3 +537,34 @@ void acctest_desc_submit(struct acctest_context *ctx, struct hw_desc *hw)
 		if (acctest_desc_submit_swq(ctx, hw))
 			usleep(10000);
 }
+
+/* Opens the perfmon counters of the device behind the test wq */
+int acctest_perfmon_start(struct acctest_context *ctx, struct perfmon *pm)
+{
+	struct accfg_device *dev = accfg_wq_get_device(ctx->wq);
+	int rc;
+
+	rc = perfmon_init(pm, accfg_device_get_devname(dev),
+			  accfg_device_get_max_engines(dev), &perfmon_perf_ops, NULL);
+	if (rc)
+		return rc;
+
+	rc = perfmon_start(pm);
+	if (rc) {
+		err("perfmon counters of %s not available: %d\n",
+		    accfg_device_get_devname(dev), rc);
+		perfmon_free(pm);
+	}
+
+	return rc;
+}
+
+void acctest_perfmon_stop(struct perfmon *pm)
+{
+	struct perfmon_report r;
+
+	perfmon_stop(pm);
+	perfmon_compute(pm, &r);
+	perfmon_print(&r, pm->pmu, stdout);
+	perfmon_free(pm);
+}
@@ -4,6 +4,7 @@
 #define __ACCEL_TEST_H__
 #include <accfg/libaccel_config.h>
 #include <accfg/idxd.h>
+#include <util/perfmon.h>
 #include "accfg_test.h"
 
 #pragma GCC diagnostic ignored "-Wpedantic"
@@ -275,6 +276,7 @@ static inline void resolve_page_fault(uint64_t addr, uint8_t status)
 int get_random_value(void);
 struct acctest_context *acctest_init(int tflags);
 int acctest_alloc(struct acctest_context *ctx, int shared, int dev_id, int wq_id);
+int acctest_alloc_nth(struct acctest_context *ctx, int shared, int dev_id, int nth);
 int acctest_alloc_multiple_tasks(struct acctest_context *ctx, int num_itr);
 struct task *acctest_alloc_task(struct acctest_context *ctx);
 
@@ -295,4 +297,7 @@ void acctest_prep_desc_common(struct hw_desc *hw, char opcode,
 			      uint64_t dest, uint64_t src, size_t len, unsigned long dflags);
 void acctest_desc_submit(struct acctest_context *ctx, struct hw_desc *hw);
 
+int acctest_perfmon_start(struct acctest_context *ctx, struct perfmon *pm);
+void acctest_perfmon_stop(struct perfmon *pm);
+
 #endif
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+#include "iaa_bitmap.h"
+
+enum bitmap_op {
+	BITMAP_AND,
+	BITMAP_OR,
+	BITMAP_ANDNOT,
+};
+
+static int avx512_support = -1;
+static int vpopcnt_support;
+
+static void bitmap_detect_cpu(void)
+{
+	__builtin_cpu_init();
+	avx512_support = __builtin_cpu_supports("avx512f");
+	vpopcnt_support = avx512_support && __builtin_cpu_supports("avx512vpopcntdq");
+}
+
+static inline uint64_t bitmap_op_u64(enum bitmap_op op, uint64_t a, uint64_t b)
+{
+	switch (op) {
+	case BITMAP_AND:
+		return a & b;
+	case BITMAP_OR:
+		return a | b;
+	case BITMAP_ANDNOT:
+	default:
+		return a & ~b;
+	}
+}
+
+/* Handles the tail, and everything when AVX-512 is not available */
+static void bitmap_combine_scalar(uint8_t *dst, const uint8_t *src1, const uint8_t *src2,
+				  uint32_t len, enum bitmap_op op)
+{
+	uint64_t a, b, r;
+	uint32_t i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&a, src1 + i, 8);
+		memcpy(&b, src2 + i, 8);
+		r = bitmap_op_u64(op, a, b);
+		memcpy(dst + i, &r, 8);
+	}
+	for (; i < len; i++)
+		dst[i] = (uint8_t)bitmap_op_u64(op, src1[i], src2[i]);
+}
+
+__attribute__((target("avx512f")))
+static uint32_t bitmap_combine_avx512(uint8_t *dst, const uint8_t *src1, const uint8_t *src2,
+				      uint32_t len, enum bitmap_op op)
+{
+	__m512i a, b, r;
+	uint32_t i;
+
+	for (i = 0; i + 64 <= len; i += 64) {
+		a = _mm512_loadu_si512(src1 + i);
+		b = _mm512_loadu_si512(src2 + i);
+		if (op == BITMAP_AND)
+			r = _mm512_and_si512(a, b);
+		else if (op == BITMAP_OR)
+			r = _mm512_or_si512(a, b);
+		else
+			r = _mm512_andnot_si512(b, a);
+		_mm512_storeu_si512(dst + i, r);
+	}
+
+	return i;
+}
+
+static void bitmap_combine(void *dst, const void *src1, const void *src2,
+			   uint32_t len, enum bitmap_op op)
+{
+	uint32_t done = 0;
+
+	if (avx512_support < 0)
+		bitmap_detect_cpu();
+
+	if (avx512_support)
+		done = bitmap_combine_avx512(dst, src1, src2, len, op);
+
+	bitmap_combine_scalar((uint8_t *)dst + done, (const uint8_t *)src1 + done,
+			      (const uint8_t *)src2 + done, len - done, op);
+}
+
+void iaa_bitmap_and(void *dst, const void *src1, const void *src2, uint32_t len)
+{
+	bitmap_combine(dst, src1, src2, len, BITMAP_AND);
+}
+
+void iaa_bitmap_or(void *dst, const void *src1, const void *src2, uint32_t len)
+{
+	bitmap_combine(dst, src1, src2, len, BITMAP_OR);
+}
+
+/* dst = src1 & ~src2 */
+void iaa_bitmap_andnot(void *dst, const void *src1, const void *src2, uint32_t len)
+{
+	bitmap_combine(dst, src1, src2, len, BITMAP_ANDNOT);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static uint32_t bitmap_popcount_avx512(const uint8_t *src, uint32_t len, uint64_t *count)
+{
+	__m512i acc = _mm512_setzero_si512();
+	uint32_t i;
+
+	for (i = 0; i + 64 <= len; i += 64)
+		acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(src + i)));
+	*count = _mm512_reduce_add_epi64(acc);
+
+	return i;
+}
+
+uint64_t iaa_bitmap_popcount(const void *src, uint32_t len)
+{
+	const uint8_t *p = src;
+	uint64_t count = 0, v;
+	uint32_t i = 0;
+
+	if (avx512_support < 0)
+		bitmap_detect_cpu();
+
+	if (vpopcnt_support)
+		i = bitmap_popcount_avx512(p, len, &count);
+
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&v, p + i, 8);
+		count += __builtin_popcountll(v);
+	}
+	for (; i < len; i++)
+		count += __builtin_popcount(p[i]);
+
+	return count;
+}
+
+/* Write the positions of the set bits to dst, returns how many were written */
+uint32_t iaa_bitmap_to_indices(uint32_t *dst, const void *src, uint32_t num_bits)
+{
+	const uint8_t *p = src;
+	uint32_t n = 0, base, len = num_bits / 8;
+	uint64_t v;
+	uint32_t i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&v, p + i, 8);
+		base = i * 8;
+		while (v) {
+			dst[n++] = base + __builtin_ctzll(v);
+			v &= v - 1;
+		}
+	}
+	for (base = i * 8; base < num_bits; base++) {
+		if ((p[base / 8] >> (base % 8)) & 1)
+			dst[n++] = base;
+	}
+
+	return n;
+}
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#ifndef _IAA_BITMAP_H_
+#define _IAA_BITMAP_H_
+
+#include <stdint.h>
+
+/*
+ * Combinators for the bit vectors written by the IAA filter ops, bit i of
+ * the vector is bit (i % 8) of byte (i / 8). Lengths are in bytes except
+ * for iaa_bitmap_to_indices() which takes the number of valid bits.
+ */
+void iaa_bitmap_and(void *dst, const void *src1, const void *src2, uint32_t len);
+void iaa_bitmap_or(void *dst, const void *src1, const void *src2, uint32_t len);
+void iaa_bitmap_andnot(void *dst, const void *src1, const void *src2, uint32_t len);
+uint64_t iaa_bitmap_popcount(const void *src, uint32_t len);
+uint32_t iaa_bitmap_to_indices(uint32_t *dst, const void *src, uint32_t num_bits);
+
+#endif
@@ -2,6 +2,7 @@
 /* Copyright(c) 2019 Intel Corporation. All rights reserved. */
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <zlib.h>
 #include "iaa_compress.h"
@@ -56,3 +57,140 @@ int iaa_do_decompress(void *dst, void *src, int src_len, int *out_len)
 	*out_len = stream.total_out;
 	return ret;
 }
+
+/* Software deflate used to build compressed inputs for the hardware */
+int iaa_do_compress(void *dst, int dst_len, void *src, int src_len, int *out_len)
+{
+	int ret = 0;
+	z_stream stream;
+
+	memset(&stream, 0, sizeof(z_stream));
+
+	ret = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS,
+			   8, Z_DEFAULT_STRATEGY);
+	if (ret) {
+		printf("Error deflateInit2 status %d\n", ret);
+		return ret;
+	}
+
+	stream.avail_in = src_len;
+	stream.next_in = src;
+	stream.avail_out = dst_len;
+	stream.next_out = dst;
+
+	ret = deflate(&stream, Z_FINISH);
+	if (ret != Z_STREAM_END) {
+		deflateEnd(&stream);
+		printf("Error deflate status %d\n", ret);
+		return ret == Z_OK ? Z_BUF_ERROR : ret;
+	}
+
+	*out_len = stream.total_out;
+	return deflateEnd(&stream);
+}
+
+/*
+ * Inflate a raw deflate stream that may end on a sync marker rather than a
+ * final block, as the non-final chunks of a parallel compress container do.
+ */
+int iaa_do_inflate(void *dst, int dst_len, void *src, int src_len, int *out_len)
+{
+	int ret = 0;
+	z_stream stream;
+
+	memset(&stream, 0, sizeof(z_stream));
+
+	ret = inflateInit2(&stream, -MAX_WBITS);
+	if (ret) {
+		printf("Error inflateInit2 status %d\n", ret);
+		return ret;
+	}
+
+	stream.avail_in = src_len;
+	stream.next_in = src;
+	stream.avail_out = dst_len;
+	stream.next_out = dst;
+
+	do {
+		ret = inflate(&stream, Z_SYNC_FLUSH);
+		if (ret != Z_OK && ret != Z_STREAM_END) {
+			inflateEnd(&stream);
+			printf("Error inflate status %d\n", ret);
+			return ret;
+		}
+	} while (ret != Z_STREAM_END && stream.avail_in && stream.avail_out);
+
+	*out_len = stream.total_out;
+	inflateEnd(&stream);
+
+	return stream.avail_in ? Z_DATA_ERROR : Z_OK;
+}
+
+/*
+ * Append an empty stored block (BFINAL=0) after a block that ended with EOB,
+ * bringing the stream back to a byte boundary. out_bits is the number of
+ * valid bits in the last output byte, 0 when the output is byte aligned.
+ * Returns the number of bytes written at end.
+ */
+uint32_t iaa_deflate_sync_marker(uint8_t *end, uint8_t out_bits)
+{
+	static const uint8_t stored_len[4] = { 0x00, 0x00, 0xff, 0xff };
+	uint32_t n = 0;
+
+	/* The 3 header bits are zero, so they fit in the padding if there is room */
+	if (out_bits == 0 || out_bits > 5)
+		end[n++] = 0;
+	memcpy(end + n, stored_len, sizeof(stored_len));
+
+	return n + sizeof(stored_len);
+}
+
+int iaa_pcompress_verify(void *container, void *raw, uint64_t raw_size)
+{
+	struct iaa_pcompress_hdr *hdr = container;
+	struct iaa_pcompress_idx *idx = (struct iaa_pcompress_idx *)(hdr + 1);
+	uint8_t *payload;
+	uint8_t *out;
+	uint64_t raw_off = 0;
+	uint32_t i;
+	int out_len = 0;
+	int ret = -1;
+
+	if (hdr->magic != IAA_PCOMPRESS_MAGIC || hdr->version != IAA_PCOMPRESS_VERSION ||
+	    hdr->raw_size != raw_size) {
+		printf("Bad container header magic %#x version %d size %lu\n",
+		       hdr->magic, hdr->version, hdr->raw_size);
+		return -1;
+	}
+	payload = (uint8_t *)container + IAA_PCOMPRESS_HDR_SIZE(hdr->num_chunks);
+
+	out = malloc(raw_size + 1);
+	if (!out)
+		return -1;
+
+	/* The payload must inflate as a single stream */
+	if (iaa_do_inflate(out, raw_size + 1, payload, hdr->payload_size, &out_len) ||
+	    (uint64_t)out_len != raw_size || memcmp(out, raw, raw_size)) {
+		printf("Payload mismatch, exp len %lu, act len %d\n", raw_size, out_len);
+		goto out;
+	}
+
+	/* And every chunk must inflate on its own from the index */
+	for (i = 0; i < hdr->num_chunks; i++) {
+		memset(out, 0, idx[i].raw_size);
+		if (iaa_do_inflate(out, idx[i].raw_size + 1, payload + idx[i].offset,
+				   idx[i].comp_size, &out_len) ||
+		    (uint32_t)out_len != idx[i].raw_size ||
+		    memcmp(out, (uint8_t *)raw + raw_off, out_len)) {
+			printf("Chunk %u mismatch, exp len %u, act len %d\n",
+			       i, idx[i].raw_size, out_len);
+			goto out;
+		}
+		raw_off += idx[i].raw_size;
+	}
+	ret = 0;
+
+ out:
+	free(out);
+	return ret;
+}
@@ -13,6 +13,47 @@
 #define IAA_DECOMPRESS_SRC2_SIZE (IAA_DECOMPRESS_AECS_SIZE * 2)
 #define IAA_DECOMPRESS_MAX_DEST_SIZE (2097152 * 2)
 
+/* AECS dwords holding the preloaded deflate block header (BFINAL, BTYPE) */
+#define IAA_COMPRESS_AECS_ACC_BITS_IDX (7)
+#define IAA_COMPRESS_AECS_ACC_DATA_IDX (8)
+#define IAA_COMPRESS_HDR_FIXED_FINAL (0x3)
+#define IAA_COMPRESS_HDR_FIXED (0x2)
+
+/* End the block with EOB but leave BFINAL clear */
+#define IAA_COMPRESS_FLAG_EOB (0x0004)
+
+/*
+ * Parallel compress container: a header and a chunk index followed by the
+ * compressed payload. Every chunk but the last ends on an empty stored
+ * block, so the payload alone is one valid raw deflate stream and each
+ * chunk can also be inflated on its own starting from its index entry.
+ */
+#define IAA_PCOMPRESS_MAGIC (0x50414149) /* "IAAP" */
+#define IAA_PCOMPRESS_VERSION (1)
+#define IAA_PCOMPRESS_CHUNK_SIZE (65536)
+#define IAA_PCOMPRESS_MAX_WQS (16)
+/* Fixed huffman worst case plus room for the sync marker */
+#define IAA_PCOMPRESS_CHUNK_DEST_SIZE(c) ((c) + ((c) >> 2) + 64)
+
+struct iaa_pcompress_hdr {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	rsvd;
+	uint32_t	chunk_size;
+	uint32_t	num_chunks;
+	uint64_t	raw_size;
+	uint64_t	payload_size;
+};
+
+struct iaa_pcompress_idx {
+	uint64_t	offset;		/* from the start of the payload */
+	uint32_t	comp_size;
+	uint32_t	raw_size;
+};
+
+#define IAA_PCOMPRESS_HDR_SIZE(n) \
+	(sizeof(struct iaa_pcompress_hdr) + (n) * sizeof(struct iaa_pcompress_idx))
+
 static const uint32_t iaa_compress_aecs[IAA_COMPRESS_AECS_SIZE / 4] = {
 0x12345678, // crc
 0x0000abcd, // XOR Checksum
@@ -409,5 +450,9 @@ static const uint32_t iaa_compress_aecs[IAA_COMPRESS_AECS_SIZE / 4] = {
 };
 
 int iaa_do_decompress(void *dst, void *src, int src_len, int *out_len);
+int iaa_do_compress(void *dst, int dst_len, void *src, int src_len, int *out_len);
+int iaa_do_inflate(void *dst, int dst_len, void *src, int src_len, int *out_len);
+uint32_t iaa_deflate_sync_marker(uint8_t *end, uint8_t out_bits);
+int iaa_pcompress_verify(void *container, void *raw, uint64_t raw_size);
 
 #endif
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 /* Copyright(c) 2019 Intel Corporation. All rights reserved. */
 #include <stdio.h>
+#include <errno.h>
 #include <openssl/evp.h>
 #include "accel_test.h"
 #include "iaa_crypto.h"
@@ -109,3 +110,87 @@ int iaa_do_crypto(uint8_t *out, uint8_t *in, int in_len, uint8_t *aes_key, uint8
 
 	return (out_len + out_final_len);
 }
+
+static const EVP_CIPHER *crypto_cipher(int key_size, enum _crypto_type_t crypto_type)
+{
+	switch (crypto_type) {
+	case IAA_AES_GCM:
+		return key_size == 128 ? EVP_aes_128_gcm() : EVP_aes_256_gcm();
+	case IAA_AES_CFB:
+		return key_size == 128 ? EVP_aes_128_cfb() : EVP_aes_256_cfb();
+	case IAA_AES_XTS:
+		return key_size == 128 ? EVP_aes_128_xts() : EVP_aes_256_xts();
+	default:
+		return NULL;
+	}
+}
+
+int iaa_crypto_ref_init(struct iaa_crypto_ref *ref, uint8_t *aes_key, int key_size,
+			enum _crypto_type_t crypto_type)
+{
+	const EVP_CIPHER *cipher = crypto_cipher(key_size, crypto_type);
+
+	ref->enc = NULL;
+	ref->dec = NULL;
+	if (!cipher) {
+		err("Unknown crypto type %d\n", crypto_type);
+		return -EINVAL;
+	}
+
+	dump_aes_key(aes_key);
+	ref->enc = EVP_CIPHER_CTX_new();
+	ref->dec = EVP_CIPHER_CTX_new();
+	if (!ref->enc || !ref->dec)
+		goto fail;
+
+	/* Expand the key once, each run only loads a new IV */
+	if (!EVP_CipherInit_ex(ref->enc, cipher, NULL, aes_key, NULL, 1) ||
+	    !EVP_CipherInit_ex(ref->dec, cipher, NULL, aes_key, NULL, 0))
+		goto fail;
+
+	return 0;
+
+ fail:
+	iaa_crypto_ref_free(ref);
+	return -ENOMEM;
+}
+
+int iaa_crypto_ref_run(struct iaa_crypto_ref *ref, uint8_t *out, uint8_t *in, int in_len,
+		       uint8_t *aes_iv, int do_encrypt)
+{
+	EVP_CIPHER_CTX *ctx = do_encrypt ? ref->enc : ref->dec;
+	int out_len = 0, out_final_len = 0;
+
+	if (!EVP_CipherInit_ex(ctx, NULL, NULL, NULL, aes_iv, do_encrypt))
+		return -1;
+
+	if (!EVP_CipherUpdate(ctx, out, &out_len, in, in_len))
+		return -1;
+
+	if (!EVP_CipherFinal_ex(ctx, out + out_len, &out_final_len))
+		return -1;
+
+	return (out_len + out_final_len);
+}
+
+void iaa_crypto_ref_free(struct iaa_crypto_ref *ref)
+{
+	EVP_CIPHER_CTX_free(ref->enc);
+	EVP_CIPHER_CTX_free(ref->dec);
+	ref->enc = NULL;
+	ref->dec = NULL;
+}
+
+/* Treat the IV as a 128-bit little endian data unit number, as XTS does */
+void iaa_crypto_iv_add(uint8_t *aes_iv, uint64_t n)
+{
+	unsigned int carry = 0;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		carry += aes_iv[i] + (uint8_t)n;
+		aes_iv[i] = (uint8_t)carry;
+		carry >>= 8;
+		n >>= 8;
+	}
+}
@@ -31,7 +31,19 @@ struct iaa_crypto_aecs_t {
 	uint8_t		complement[24];
 };
 
+/* Software reference with the key schedule set up once per key */
+struct iaa_crypto_ref {
+	struct evp_cipher_ctx_st *enc;
+	struct evp_cipher_ctx_st *dec;
+};
+
 int iaa_do_crypto(uint8_t *out, uint8_t *in, int in_len, uint8_t *aes_key, uint8_t *aes_iv,
 		  int key_size, enum _crypto_type_t crypto_type, int do_encrypt);
+int iaa_crypto_ref_init(struct iaa_crypto_ref *ref, uint8_t *aes_key, int key_size,
+			enum _crypto_type_t crypto_type);
+int iaa_crypto_ref_run(struct iaa_crypto_ref *ref, uint8_t *out, uint8_t *in, int in_len,
+		       uint8_t *aes_iv, int do_encrypt);
+void iaa_crypto_ref_free(struct iaa_crypto_ref *ref);
+void iaa_crypto_iv_add(uint8_t *aes_iv, uint64_t n);
 
 #endif
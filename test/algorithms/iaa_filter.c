@@ -309,3 +309,24 @@ uint32_t iaa_do_expand(void *dst, void *src1, void *src2,
 
 	return dst_size;
 }
+
+/* Pack 32-bit values into consecutive element_width-bit elements, LSB first */
+uint32_t iaa_pack_elements(void *dst, uint32_t *values, uint32_t num_inputs,
+			   uint32_t element_width)
+{
+	uint64_t *qword_addr;
+	uint32_t *dst_ptr = (uint32_t *)dst;
+	uint32_t input_idx;
+	uint64_t bit_pos;
+	uint32_t mask = (element_width == 32) ? 0xffffffff : ((1U << element_width) - 1);
+
+	for (input_idx = 0; input_idx < num_inputs; input_idx++) {
+		bit_pos = (uint64_t)input_idx * element_width;
+		qword_addr = (uint64_t *)&dst_ptr[bit_pos / 32];
+		*qword_addr |= ((uint64_t)(values[input_idx] & mask)) << (bit_pos % 32);
+	}
+
+	bit_pos = (uint64_t)num_inputs * element_width;
+
+	return (bit_pos + 7) / 8;
+}
@@ -48,5 +48,7 @@ uint32_t iaa_do_find_unique(void *dst, void *src1, void *src2,
 			    uint32_t num_inputs, uint32_t filter_flags);
 uint32_t iaa_do_expand(void *dst, void *src1, void *src2,
 		       uint32_t num_inputs, uint32_t filter_flags);
+uint32_t iaa_pack_elements(void *dst, uint32_t *values, uint32_t num_inputs,
+			   uint32_t element_width);
 
 #endif
@@ -1589,7 +1589,7 @@ int task_result_verify(struct task *tsk, int mismatch_expected)
 		rc = task_result_verify_dif_tags(tsk, tsk->xfer_size - 8 * tsk->blks);
 		return rc;
 	case DSA_OPCODE_DIX_GEN:
-		rc = task_result_verify_dif(tsk, tsk->xfer_size, mismatch_expected);
+		rc = task_result_verify_dix_tags(tsk);
 		if (rc != ACCTEST_STATUS_OK)
 			return rc;
 	}
@@ -2174,6 +2174,48 @@ int task_result_verify_dif_tags(struct task *tsk, unsigned long xfer_size)
 	return ACCTEST_STATUS_OK;
 }
 
+/* DIX generate writes the 8 tag bytes of each block to a buffer of their own */
+int task_result_verify_dix_tags(struct task *tsk)
+{
+	unsigned long buf_size = dif_blk_arr[tsk->blk_idx_flg];
+	unsigned char *src1 = (unsigned char *)tsk->src1;
+	unsigned char *pi = (unsigned char *)tsk->dst1;
+	unsigned int dif_reftag = tsk->reftag;
+	unsigned int dif_apptag = tsk->apptag;
+	unsigned int dif_guardtag;
+	unsigned long blks = tsk->blks;
+	unsigned long errors = 0;
+	unsigned long i;
+
+	if (tsk->comp->status == 0x83 ||
+	    tsk->comp->status == DSA_COMP_PAGE_FAULT_NOBOF ||
+	    tsk->comp->status == DSA_COMP_PAGE_FAULT_IR)
+		blks = tsk->comp->bytes_completed / buf_size;
+
+	info("Checking DIX Tags of %ld blocks\n", blks);
+	for (i = 0; i < blks; i++, pi += 8, dif_reftag++) {
+		dif_guardtag = dsa_calculate_crc_t10dif(src1 + buf_size * i,
+							buf_size, 0);
+		if (pi[DIF_BLK_GRD_1] != ((dif_guardtag >> 8) & 0xff) ||
+		    pi[DIF_BLK_GRD_2] != (dif_guardtag & 0xff) ||
+		    pi[DIF_APP_TAG_1] != ((dif_apptag >> 8) & 0xff) ||
+		    pi[DIF_APP_TAG_2] != (dif_apptag & 0xff) ||
+		    pi[DIF_REF_TAG_1] != ((dif_reftag >> 24) & 0xff) ||
+		    pi[DIF_REF_TAG_2] != ((dif_reftag >> 16) & 0xff) ||
+		    pi[DIF_REF_TAG_3] != ((dif_reftag >> 8) & 0xff) ||
+		    pi[DIF_REF_TAG_4] != (dif_reftag & 0xff))
+			errors++;
+	}
+
+	if (errors) {
+		err("DIX Tag Errors Found in %ld of %ld blocks\n", errors, blks);
+		return -ENXIO;
+	}
+
+	info("All DIX Tags Validated\n");
+	return ACCTEST_STATUS_OK;
+}
+
 int batch_result_verify(struct batch_task *btsk, int bof, int cpfault)
 {
 	uint8_t core_stat, sub_stat;
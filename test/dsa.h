@@ -164,6 +164,7 @@ int task_result_verify_crcgen(struct task *tsk, int mismatch_expected);
 int task_result_verify_crc_copy(struct task *tsk, int mismatch_expected);
 int task_result_verify_dif(struct task *tsk, unsigned long xfer_size, int mismatch_expected);
 int task_result_verify_dif_tags(struct task *tsk, unsigned long xfer_size);
+int task_result_verify_dix_tags(struct task *tsk);
 int batch_result_verify(struct batch_task *btsk, int bof, int cp_fault);
 
 int alloc_batch_task(struct acctest_context *ctx, unsigned int task_num, int num_itr);
@@ -36,6 +36,7 @@ static void usage(void)
 	"                ; <bc_fault:bc_wr_fail:bd_fault:bd_fault_idx>:<desc_fault:cp_fault:cp_wr_fail:fence>:\n"
 	"-v              ; verbose\n"
 	"-u              ; use ENQCMD to submit descriptor\n"
+	"-P              ; report device perfmon counters for the run\n"
 	"-h              ; print this message\n");
 }
 
@@ -849,8 +850,10 @@ int main(int argc, char *argv[])
 	unsigned int num_desc = 1;
 	struct evl_desc_list *edl = NULL;
 	char *edl_str = NULL;
+	struct perfmon pm;
+	int perf_mon = 0;
 
-	while ((opt = getopt(argc, argv, "e:w:l:f:o:b:c:d:n:t:p:vuh")) != -1) {
+	while ((opt = getopt(argc, argv, "e:w:l:f:o:b:c:d:n:t:p:vuPh")) != -1) {
 		switch (opt) {
 		case 'e':
 			edl_str = optarg;
@@ -893,6 +896,9 @@ int main(int argc, char *argv[])
 		case 'u':
 			force_enqcmd = 1;
 			break;
+		case 'P':
+			perf_mon = 1;
+			break;
 		case 'h':
 			usage();
 			exit(0);
@@ -923,6 +929,9 @@ int main(int argc, char *argv[])
 		return -EINVAL;
 	}
 
+	if (perf_mon && acctest_perfmon_start(dsa, &pm))
+		perf_mon = 0;
+
 	switch (opcode) {
 	case DSA_OPCODE_NOOP:
 		rc = test_noop(dsa, tflags, num_desc);
@@ -984,6 +993,8 @@ int main(int argc, char *argv[])
 	}
 
  error:
+	if (perf_mon)
+		acctest_perfmon_stop(&pm);
 	free(edl);
 	acctest_free(dsa);
 	return rc;
@@ -35,6 +35,49 @@ static struct iaa_filter_aecs_t iaa_filter_aecs = {
 	.rsvd6 = 0
 };
 
+/*
+ * Fused decompress and filter: replace the plain column in src1 with its
+ * deflate stream so the engine inflates it on the way into the filter.
+ * tsk->input is scratch for the software reference decompress.
+ */
+static int init_filter_decompress(struct task *tsk)
+{
+	void *plain = tsk->src1;
+	int out_len = 0;
+	int rc;
+
+	if (!(tsk->iaa_decompr_flags & IDXD_DECOMPRESS_FLAG_EN_DECOMPRESS))
+		return ACCTEST_STATUS_OK;
+
+	tsk->src1 = aligned_alloc(ADDR_ALIGNMENT, IAA_COMPRESS_MAX_DEST_SIZE);
+	if (!tsk->src1) {
+		tsk->src1 = plain;
+		return -ENOMEM;
+	}
+	rc = iaa_do_compress(tsk->src1, IAA_COMPRESS_MAX_DEST_SIZE,
+			     plain, tsk->xfer_size, &out_len);
+	free(plain);
+	if (rc)
+		return -ENXIO;
+	tsk->xfer_size = out_len;
+
+	tsk->input = aligned_alloc(ADDR_ALIGNMENT, IAA_DECOMPRESS_MAX_DEST_SIZE);
+	if (!tsk->input)
+		return -ENOMEM;
+	memset_pattern(tsk->input, 0, IAA_DECOMPRESS_MAX_DEST_SIZE);
+
+	return ACCTEST_STATUS_OK;
+}
+
+/* With decompression enabled the filter params sit in a decompress AECS */
+static uint32_t filter_aecs_size(struct task *tsk)
+{
+	if (tsk->iaa_decompr_flags & IDXD_DECOMPRESS_FLAG_EN_DECOMPRESS)
+		return IAA_DECOMPRESS_AECS_SIZE;
+
+	return IAA_FILTER_AECS_SIZE;
+}
+
 static int init_crc64(struct task *tsk, int tflags, int opcode, unsigned long src1_xfer_size)
 {
 	tsk->pattern = 0x98765432abcdef01;
@@ -294,6 +337,7 @@ static int init_scan(struct task *tsk, int tflags,
 {
 	uint32_t i;
 	uint32_t pattern = 0x98765432;
+	int rc;
 
 	tsk->opcode = opcode;
 	tsk->test_flags = tflags;
@@ -305,14 +349,18 @@ static int init_scan(struct task *tsk, int tflags,
 	for (i = 0; i < (src1_xfer_size / 4); i++)
 		((uint32_t *)tsk->src1)[i] = pattern++;
 
-	tsk->src2 = aligned_alloc(32, IAA_FILTER_AECS_SIZE);
+	rc = init_filter_decompress(tsk);
+	if (rc != ACCTEST_STATUS_OK)
+		return rc;
+
+	tsk->src2 = aligned_alloc(32, filter_aecs_size(tsk));
 	if (!tsk->src2)
 		return -ENOMEM;
-	memset_pattern(tsk->src2, 0, IAA_FILTER_AECS_SIZE);
+	memset_pattern(tsk->src2, 0, filter_aecs_size(tsk));
 	iaa_filter_aecs.low_filter_param = 0x98765440;
 	iaa_filter_aecs.high_filter_param = 0x98765540;
 	memcpy(tsk->src2, (void *)&iaa_filter_aecs, IAA_FILTER_AECS_SIZE);
-	tsk->iaa_src2_xfer_size = IAA_FILTER_AECS_SIZE;
+	tsk->iaa_src2_xfer_size = filter_aecs_size(tsk);
 
 	tsk->dst1 = aligned_alloc(ADDR_ALIGNMENT, IAA_FILTER_MAX_DEST_SIZE);
 	if (!tsk->dst1)
@@ -368,6 +416,7 @@ static int init_extract(struct task *tsk, int tflags,
 {
 	uint32_t i;
 	uint32_t pattern = 0x98765432;
+	int rc;
 
 	tsk->opcode = opcode;
 	tsk->test_flags = tflags;
@@ -379,14 +428,18 @@ static int init_extract(struct task *tsk, int tflags,
 	for (i = 0; i < (src1_xfer_size / 4); i++)
 		((uint32_t *)tsk->src1)[i] = pattern++;
 
-	tsk->src2 = aligned_alloc(32, IAA_FILTER_AECS_SIZE);
+	rc = init_filter_decompress(tsk);
+	if (rc != ACCTEST_STATUS_OK)
+		return rc;
+
+	tsk->src2 = aligned_alloc(32, filter_aecs_size(tsk));
 	if (!tsk->src2)
 		return -ENOMEM;
-	memset_pattern(tsk->src2, 0, IAA_FILTER_AECS_SIZE);
+	memset_pattern(tsk->src2, 0, filter_aecs_size(tsk));
 	iaa_filter_aecs.low_filter_param = 10;
 	iaa_filter_aecs.high_filter_param = 100;
 	memcpy(tsk->src2, (void *)&iaa_filter_aecs, IAA_FILTER_AECS_SIZE);
-	tsk->iaa_src2_xfer_size = IAA_FILTER_AECS_SIZE;
+	tsk->iaa_src2_xfer_size = filter_aecs_size(tsk);
 
 	tsk->dst1 = aligned_alloc(ADDR_ALIGNMENT, IAA_FILTER_MAX_DEST_SIZE);
 	if (!tsk->dst1)
@@ -408,6 +461,7 @@ static int init_select(struct task *tsk, int tflags,
 {
 	uint32_t i;
 	uint32_t pattern = 0x98765432;
+	int rc;
 
 	tsk->opcode = opcode;
 	tsk->test_flags = tflags;
@@ -419,6 +473,10 @@ static int init_select(struct task *tsk, int tflags,
 	for (i = 0; i < (src1_xfer_size / 4); i++)
 		((uint32_t *)tsk->src1)[i] = pattern++;
 
+	rc = init_filter_decompress(tsk);
+	if (rc != ACCTEST_STATUS_OK)
+		return rc;
+
 	tsk->src2 = aligned_alloc(32, IAA_FILTER_MAX_SRC2_SIZE);
 	if (!tsk->src2)
 		return -ENOMEM;
@@ -1339,6 +1397,179 @@ int iaa_decompress_multi_task_nodes(struct acctest_context *ctx)
 	return ret;
 }
 
+static int init_pcompress_chunk(struct acctest_context *ctx, struct task *tsk, int tflags,
+				void *src, uint32_t chunk_len, int final)
+{
+	uint32_t *aecs;
+
+	tsk->opcode = IAX_OPCODE_COMPRESS;
+	tsk->test_flags = tflags;
+	tsk->xfer_size = chunk_len;
+
+	/* src1 points into the caller's buffer, see iaa_pcompress_free_tasks() */
+	tsk->src1 = src;
+
+	tsk->src2 = aligned_alloc(32, IAA_COMPRESS_SRC2_SIZE);
+	if (!tsk->src2)
+		return -ENOMEM;
+	memset_pattern(tsk->src2, 0, IAA_COMPRESS_SRC2_SIZE);
+	memcpy(tsk->src2, (void *)iaa_compress_aecs, IAA_COMPRESS_AECS_SIZE);
+
+	/* Only the last chunk may carry BFINAL in its block header */
+	aecs = tsk->src2;
+	aecs[IAA_COMPRESS_AECS_ACC_DATA_IDX] = final ? IAA_COMPRESS_HDR_FIXED_FINAL :
+						       IAA_COMPRESS_HDR_FIXED;
+	tsk->iaa_src2_xfer_size = IAA_COMPRESS_AECS_SIZE;
+
+	tsk->dst1 = aligned_alloc(32, IAA_PCOMPRESS_CHUNK_DEST_SIZE(chunk_len));
+	if (!tsk->dst1)
+		return -ENOMEM;
+	memset_pattern(tsk->dst1, 0, IAA_PCOMPRESS_CHUNK_DEST_SIZE(chunk_len));
+
+	/* Keep room behind the output for the sync marker */
+	tsk->iaa_max_dst_size = IAA_PCOMPRESS_CHUNK_DEST_SIZE(chunk_len) - 8;
+
+	tsk->iaa_compr_flags = IDXD_COMPRESS_FLAG_FLUSH_OUTPUT;
+	tsk->iaa_compr_flags |= final ? IDXD_COMPRESS_FLAG_EOB_BFINAL : IAA_COMPRESS_FLAG_EOB;
+
+	tsk->dflags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR | IDXD_OP_FLAG_RD_SRC2_AECS;
+	if ((tflags & TEST_FLAGS_BOF) && ctx->bof)
+		tsk->dflags |= IDXD_OP_FLAG_BOF;
+
+	iaa_prep_compress(tsk);
+
+	return ACCTEST_STATUS_OK;
+}
+
+static void iaa_pcompress_free_tasks(struct acctest_context *ctx)
+{
+	struct task_node *tsk_node = ctx->multi_task_node;
+
+	while (tsk_node) {
+		tsk_node->tsk->src1 = NULL;
+		tsk_node = tsk_node->next;
+	}
+	acctest_free_task(ctx);
+}
+
+/*
+ * Compress src in chunk_size pieces spread over all the wqs in ctxs[] and
+ * write a struct iaa_pcompress_hdr container to dst. Each round fills every
+ * wq up to its depth, so the engines behind different wqs run concurrently.
+ */
+int iaa_parallel_compress(struct acctest_context *ctxs[], int num_ctx, int tflags,
+			  void *src, uint64_t src_size, uint32_t chunk_size,
+			  void *dst, uint64_t dst_size, uint64_t *out_size)
+{
+	struct iaa_pcompress_hdr *hdr = dst;
+	struct iaa_pcompress_idx *idx = (struct iaa_pcompress_idx *)(hdr + 1);
+	struct task_node *tsk_node;
+	struct task *tsk;
+	uint32_t num_chunks, next = 0, done = 0;
+	uint32_t chunk_len, comp_len;
+	uint64_t off, pos = 0;
+	uint8_t *payload;
+	int i, n, range;
+	int ret = ACCTEST_STATUS_OK;
+
+	if (!chunk_size || !src_size || num_ctx <= 0)
+		return -EINVAL;
+
+	num_chunks = (src_size + chunk_size - 1) / chunk_size;
+	if (dst_size < IAA_PCOMPRESS_HDR_SIZE(num_chunks))
+		return -ENOSPC;
+	payload = (uint8_t *)dst + IAA_PCOMPRESS_HDR_SIZE(num_chunks);
+
+	while (done < num_chunks) {
+		for (i = 0; i < num_ctx && next < num_chunks; i++) {
+			if (ctxs[i]->dedicated == ACCFG_WQ_SHARED)
+				range = ctxs[i]->threshold;
+			else
+				range = ctxs[i]->wq_size;
+			n = ((num_chunks - next) < (uint32_t)range) ? (int)(num_chunks - next) : range;
+
+			ctxs[i]->is_batch = 0;
+			ret = acctest_alloc_multiple_tasks(ctxs[i], n);
+			if (ret != ACCTEST_STATUS_OK)
+				goto out;
+
+			tsk_node = ctxs[i]->multi_task_node;
+			while (tsk_node) {
+				off = (uint64_t)next * chunk_size;
+				chunk_len = (src_size - off < chunk_size) ?
+					    (uint32_t)(src_size - off) : chunk_size;
+				ret = init_pcompress_chunk(ctxs[i], tsk_node->tsk, tflags,
+							   (uint8_t *)src + off, chunk_len,
+							   next == num_chunks - 1);
+				if (ret != ACCTEST_STATUS_OK)
+					goto out;
+				next++;
+				tsk_node = tsk_node->next;
+			}
+		}
+
+		info("Submitting compress chunks %u-%u\n", done, next - 1);
+		for (i = 0; i < num_ctx; i++) {
+			tsk_node = ctxs[i]->multi_task_node;
+			while (tsk_node) {
+				acctest_desc_submit(ctxs[i], tsk_node->tsk->desc);
+				tsk_node = tsk_node->next;
+			}
+		}
+
+		/* The wqs were filled in chunk order, so collect them the same way */
+		for (i = 0; i < num_ctx; i++) {
+			tsk_node = ctxs[i]->multi_task_node;
+			while (tsk_node) {
+				tsk = tsk_node->tsk;
+				ret = iaa_wait_compress(ctxs[i], tsk);
+				if (ret != ACCTEST_STATUS_OK)
+					goto out;
+				if (tsk->comp->status != IAX_COMP_SUCCESS) {
+					err("chunk %u compress failed status %#x\n",
+					    done, tsk->comp->status);
+					ret = tsk->comp->status;
+					goto out;
+				}
+
+				comp_len = tsk->comp->iax_output_size;
+				if (done != num_chunks - 1)
+					comp_len += iaa_deflate_sync_marker((uint8_t *)tsk->dst1 +
+									    comp_len,
+									    tsk->comp->iax_output_bits);
+
+				if (IAA_PCOMPRESS_HDR_SIZE(num_chunks) + pos + comp_len > dst_size) {
+					ret = -ENOSPC;
+					goto out;
+				}
+				memcpy(payload + pos, tsk->dst1, comp_len);
+				idx[done].offset = pos;
+				idx[done].comp_size = comp_len;
+				idx[done].raw_size = tsk->xfer_size;
+				pos += comp_len;
+				done++;
+				tsk_node = tsk_node->next;
+			}
+			iaa_pcompress_free_tasks(ctxs[i]);
+		}
+	}
+
+	hdr->magic = IAA_PCOMPRESS_MAGIC;
+	hdr->version = IAA_PCOMPRESS_VERSION;
+	hdr->rsvd = 0;
+	hdr->chunk_size = chunk_size;
+	hdr->num_chunks = num_chunks;
+	hdr->raw_size = src_size;
+	hdr->payload_size = pos;
+	*out_size = IAA_PCOMPRESS_HDR_SIZE(num_chunks) + pos;
+
+ out:
+	for (i = 0; i < num_ctx; i++)
+		iaa_pcompress_free_tasks(ctxs[i]);
+
+	return ret;
+}
+
 static int iaa_wait_scan(struct acctest_context *ctx, struct task *tsk)
 {
 	struct completion_record *comp = tsk->comp;
@@ -1828,6 +2059,210 @@ int iaa_decrypto_multi_task_nodes(struct acctest_context *ctx)
 	return ret;
 }
 
+/*
+ * A crypto session holds one key. The AECS template and the software key
+ * schedule are built once, each descriptor gets a copy of the template with
+ * the IV advanced by its sequence number.
+ */
+int iaa_crypto_session_init(struct iaa_crypto_session *sess, uint8_t algorithm, uint8_t flags)
+{
+	struct iaa_crypto_aecs_t *aecs;
+	int i, rc;
+
+	memset(sess, 0, sizeof(*sess));
+	if (algorithm != IAA_AES_CFB) {
+		err("Unsupported crypto mode %d\n", algorithm);
+		return -EPERM;
+	}
+
+	aecs = aligned_alloc(ADDR_ALIGNMENT, IAA_CRYPTO_SRC2_SIZE);
+	if (!aecs)
+		return -ENOMEM;
+	memset_pattern(aecs, 0, IAA_CRYPTO_SRC2_SIZE);
+	sess->aecs = aecs;
+
+	aecs->crypto_algorithm = algorithm;
+	aecs->crypto_flags = flags;
+	if (aecs->crypto_flags & IAA_CRYPTO_MASK_KEY_SIZE)
+		sess->key_size = 256;
+	else
+		sess->key_size = 128;
+	aecs->crypto_flags |= IAA_CRYPTO_MASK_FLUSH_CRYPTO_IN_ACCUM;
+
+	for (i = 0; i < 4; i++)
+		aecs->aes_key_low[i] = (uint32_t)get_random_value();
+	if (sess->key_size == 256) {
+		for (i = 0; i < 4; i++)
+			aecs->aes_key_high[i] = (uint32_t)get_random_value();
+	}
+	for (i = 0; i < 4; i++)
+		aecs->counter_iv[i] = (uint32_t)get_random_value();
+	aecs->complement[8] = 1;
+
+	rc = iaa_crypto_ref_init(&sess->ref, (uint8_t *)aecs->aes_key_low,
+				 sess->key_size, algorithm);
+	if (rc) {
+		iaa_crypto_session_free(sess);
+		return rc;
+	}
+
+	return ACCTEST_STATUS_OK;
+}
+
+void iaa_crypto_session_free(struct iaa_crypto_session *sess)
+{
+	iaa_crypto_ref_free(&sess->ref);
+	free(sess->aecs);
+	sess->aecs = NULL;
+}
+
+static int init_crypto_session_task(struct task *tsk, struct iaa_crypto_session *sess,
+				    int tflags, int opcode, unsigned long buf_size)
+{
+	struct iaa_crypto_aecs_t *aecs;
+
+	tsk->pattern = 0x98765432abcdef01;
+	tsk->opcode = opcode;
+	tsk->test_flags = tflags;
+	tsk->crypto_aecs.algorithm = sess->aecs->crypto_algorithm;
+	tsk->crypto_aecs.flags = sess->aecs->crypto_flags;
+
+	tsk->src2 = aligned_alloc(ADDR_ALIGNMENT, IAA_CRYPTO_SRC2_SIZE);
+	if (!tsk->src2)
+		return -ENOMEM;
+	memcpy(tsk->src2, sess->aecs, IAA_CRYPTO_SRC2_SIZE);
+	aecs = (struct iaa_crypto_aecs_t *)tsk->src2;
+	iaa_crypto_iv_add((uint8_t *)aecs->counter_iv, sess->seq++);
+	tsk->iaa_src2_xfer_size = IAA_CRYPTO_AECS_SIZE;
+
+	tsk->src1 = aligned_alloc(ADDR_ALIGNMENT, buf_size);
+	if (!tsk->src1)
+		return -ENOMEM;
+
+	if (opcode == IAX_OPCODE_ENCRYPT) {
+		memset_pattern(tsk->src1, tsk->pattern, buf_size);
+		tsk->xfer_size = buf_size;
+	} else {
+		tsk->input = aligned_alloc(ADDR_ALIGNMENT, buf_size);
+		if (!tsk->input)
+			return -ENOMEM;
+		memset_pattern(tsk->input, tsk->pattern, buf_size);
+		tsk->xfer_size = iaa_crypto_ref_run(&sess->ref, tsk->src1, tsk->input, buf_size,
+						    (uint8_t *)aecs->counter_iv, 1);
+		if (tsk->xfer_size != buf_size) {
+			err("Pre encrypted size %d is not equal to input size %d\n",
+			    tsk->xfer_size, buf_size);
+			return -ENOMEM;
+		}
+	}
+
+	tsk->dst1 = aligned_alloc(ADDR_ALIGNMENT, buf_size);
+	if (!tsk->dst1)
+		return -ENOMEM;
+	memset_pattern(tsk->dst1, 0, buf_size);
+
+	tsk->output = aligned_alloc(ADDR_ALIGNMENT, buf_size);
+	if (!tsk->output)
+		return -ENOMEM;
+	memset_pattern(tsk->output, 0, buf_size);
+
+	tsk->iaa_max_dst_size = buf_size;
+
+	return ACCTEST_STATUS_OK;
+}
+
+static int crypto_session_verify(struct iaa_crypto_session *sess, struct task *tsk)
+{
+	struct iaa_crypto_aecs_t *aecs = (struct iaa_crypto_aecs_t *)tsk->src2;
+	int expected_len;
+
+	if (tsk->comp->status != IAX_COMP_SUCCESS) {
+		err("crypto session desc failed, status 0x%x\n", tsk->comp->status);
+		return tsk->comp->status;
+	}
+
+	expected_len = iaa_crypto_ref_run(&sess->ref, tsk->output, tsk->src1, tsk->xfer_size,
+					  (uint8_t *)aecs->counter_iv,
+					  tsk->opcode == IAX_OPCODE_ENCRYPT);
+	if (expected_len < 0) {
+		err("iaa_crypto_ref_run returned: %d\n", expected_len);
+		return -ENXIO;
+	}
+
+	if (expected_len - tsk->comp->iax_output_size) {
+		err("crypto session mismatch, exp len %d, act len %d\n",
+		    expected_len, tsk->comp->iax_output_size);
+		return -ENXIO;
+	}
+
+	if (memcmp(tsk->dst1, tsk->output, expected_len)) {
+		err("crypto session mismatch for desc %p\n", tsk->desc);
+		return -ENXIO;
+	}
+
+	return ACCTEST_STATUS_OK;
+}
+
+/*
+ * Run num_desc encrypt or decrypt descriptors of buf_size bytes under one
+ * session, keeping a full wq worth of them in flight at a time.
+ */
+int iaa_crypto_session_run(struct acctest_context *ctx, struct iaa_crypto_session *sess,
+			   int tflags, int opcode, unsigned long buf_size, int num_desc)
+{
+	struct task_node *tsk_node;
+	int rc = ACCTEST_STATUS_OK;
+	int n, range;
+
+	if (opcode != IAX_OPCODE_ENCRYPT && opcode != IAX_OPCODE_DECRYPT)
+		return -EINVAL;
+
+	ctx->is_batch = 0;
+	if (ctx->dedicated == ACCFG_WQ_SHARED)
+		range = ctx->threshold;
+	else
+		range = ctx->wq_size;
+
+	while (num_desc > 0) {
+		n = (num_desc < range) ? num_desc : range;
+		rc = acctest_alloc_multiple_tasks(ctx, n);
+		if (rc != ACCTEST_STATUS_OK)
+			return rc;
+
+		tsk_node = ctx->multi_task_node;
+		while (tsk_node) {
+			rc = init_crypto_session_task(tsk_node->tsk, sess, tflags, opcode, buf_size);
+			if (rc != ACCTEST_STATUS_OK)
+				goto out;
+			tsk_node = tsk_node->next;
+		}
+
+		if (opcode == IAX_OPCODE_ENCRYPT)
+			rc = iaa_encrypto_multi_task_nodes(ctx);
+		else
+			rc = iaa_decrypto_multi_task_nodes(ctx);
+		if (rc != ACCTEST_STATUS_OK)
+			goto out;
+
+		tsk_node = ctx->multi_task_node;
+		while (tsk_node) {
+			rc = crypto_session_verify(sess, tsk_node->tsk);
+			if (rc != ACCTEST_STATUS_OK)
+				goto out;
+			tsk_node = tsk_node->next;
+		}
+
+		acctest_free_task(ctx);
+		num_desc -= n;
+	}
+
+	return ACCTEST_STATUS_OK;
+
+ out:
+	acctest_free_task(ctx);
+	return rc;
+}
+
 /* mismatch_expected: expect mismatched buffer with success status 0x1 */
 int iaa_task_result_verify(struct task *tsk, int mismatch_expected)
 {
@@ -2292,16 +2727,36 @@ int task_result_verify_decompress(struct task *tsk, int mismatch_expected)
 	return -ENXIO;
 }
 
+/* Source for the software filter reference, inflated first for fused jobs */
+static void *filter_ref_src1(struct task *tsk)
+{
+	int out_len = 0;
+
+	if (!(tsk->iaa_decompr_flags & IDXD_DECOMPRESS_FLAG_EN_DECOMPRESS))
+		return tsk->src1;
+
+	if (iaa_do_decompress(tsk->input, tsk->src1, tsk->xfer_size, &out_len)) {
+		err("reference decompress failed\n");
+		return NULL;
+	}
+
+	return tsk->input;
+}
+
 int task_result_verify_scan(struct task *tsk, int mismatch_expected)
 {
 	uint32_t i;
 	int rc;
 	uint32_t expected_len;
+	void *src1;
 
 	if (mismatch_expected)
 		warn("invalid arg mismatch_expected for %d\n", tsk->opcode);
 
-	expected_len = iaa_do_scan(tsk->output, tsk->src1, tsk->src2,
+	src1 = filter_ref_src1(tsk);
+	if (!src1)
+		return -ENXIO;
+	expected_len = iaa_do_scan(tsk->output, src1, tsk->src2,
 				   tsk->iaa_num_inputs, tsk->iaa_filter_flags);
 	rc = memcmp(tsk->dst1, tsk->output, expected_len);
 
@@ -2381,11 +2836,15 @@ int task_result_verify_extract(struct task *tsk, int mismatch_expected)
 	uint32_t i;
 	int rc;
 	uint32_t expected_len;
+	void *src1;
 
 	if (mismatch_expected)
 		warn("invalid arg mismatch_expected for %d\n", tsk->opcode);
 
-	expected_len = iaa_do_extract(tsk->output, tsk->src1, tsk->src2,
+	src1 = filter_ref_src1(tsk);
+	if (!src1)
+		return -ENXIO;
+	expected_len = iaa_do_extract(tsk->output, src1, tsk->src2,
 				      tsk->iaa_num_inputs, tsk->iaa_filter_flags);
 	rc = memcmp(tsk->dst1, tsk->output, expected_len);
 
@@ -2423,11 +2882,15 @@ int task_result_verify_select(struct task *tsk, int mismatch_expected)
 	uint32_t i;
 	int rc;
 	uint32_t expected_len;
+	void *src1;
 
 	if (mismatch_expected)
 		warn("invalid arg mismatch_expected for %d\n", tsk->opcode);
 
-	expected_len = iaa_do_select(tsk->output, tsk->src1, tsk->src2,
+	src1 = filter_ref_src1(tsk);
+	if (!src1)
+		return -ENXIO;
+	expected_len = iaa_do_select(tsk->output, src1, tsk->src2,
 				     tsk->iaa_num_inputs, tsk->iaa_filter_flags);
 	rc = memcmp(tsk->dst1, tsk->output, expected_len);
 
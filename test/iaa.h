@@ -6,6 +6,41 @@
 #include <accfg/idxd.h>
 #include "accel_test.h"
 #include "accfg_test.h"
+#include "algorithms/iaa_crypto.h"
+
+#define IAA_QUERY_MAX_COLS 16
+
+struct iaa_query_col {
+	const char *name;
+	void *data;		/* bit packed column */
+	uint32_t low;		/* inclusive predicate range */
+	uint32_t high;
+	int filter;		/* column is part of the conjunction */
+	void *result;		/* selected rows, device */
+	uint32_t result_size;
+	void *ref_result;	/* selected rows, software reference */
+	uint32_t ref_result_size;
+};
+
+struct iaa_query {
+	struct iaa_query_col cols[IAA_QUERY_MAX_COLS];
+	int num_cols;
+	uint32_t num_rows;
+	uint32_t filter_flags;
+	uint32_t col_size;
+	void *bitmap;
+	void *ref_bitmap;
+	uint32_t bitmap_size;
+	uint32_t num_matches;
+	uint32_t ref_matches;
+};
+
+struct iaa_crypto_session {
+	struct iaa_crypto_aecs_t *aecs;	/* key and base IV, copied per desc */
+	int key_size;
+	uint64_t seq;			/* next IV/tweak offset */
+	struct iaa_crypto_ref ref;
+};
 
 int init_task(struct task *tsk, int tflags, int opcode, unsigned long src1_xfer_size);
 
@@ -29,6 +64,20 @@ int iaa_expand_multi_task_nodes(struct acctest_context *ctx);
 int iaa_transl_fetch_multi_task_nodes(struct acctest_context *ctx);
 int iaa_encrypto_multi_task_nodes(struct acctest_context *ctx);
 int iaa_decrypto_multi_task_nodes(struct acctest_context *ctx);
+int iaa_crypto_session_init(struct iaa_crypto_session *sess, uint8_t algorithm, uint8_t flags);
+int iaa_crypto_session_run(struct acctest_context *ctx, struct iaa_crypto_session *sess,
+			   int tflags, int opcode, unsigned long buf_size, int num_desc);
+void iaa_crypto_session_free(struct iaa_crypto_session *sess);
+int iaa_parallel_compress(struct acctest_context *ctxs[], int num_ctx, int tflags,
+			  void *src, uint64_t src_size, uint32_t chunk_size,
+			  void *dst, uint64_t dst_size, uint64_t *out_size);
+
+int iaa_query_init(struct iaa_query *q, int num_cols, uint32_t num_rows,
+		   uint32_t filter_flags);
+void iaa_query_free(struct iaa_query *q);
+int iaa_query_run(struct acctest_context *ctx, struct iaa_query *q, int tflags);
+int iaa_query_run_cpu(struct iaa_query *q);
+int iaa_query_verify(struct iaa_query *q);
 
 void iaa_prep_noop(struct task *tsk);
 void iaa_prep_crc64(struct task *tsk);
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include "algorithms/iaa_bitmap.h"
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: check failed: %s\n",		\
+			__func__, __LINE__, #cond);			\
+		return -EINVAL;						\
+	}								\
+} while (0)
+
+/* Long enough for the AVX-512 loops, odd so the tails run too */
+#define BITMAP_LEN	(3 * 64 + 13)
+
+static uint8_t a[BITMAP_LEN], b[BITMAP_LEN], out[BITMAP_LEN];
+static uint32_t idx[BITMAP_LEN * 8];
+
+static int test_combine(void)
+{
+	uint32_t len, i;
+
+	for (len = 0; len <= BITMAP_LEN; len += 7) {
+		iaa_bitmap_and(out, a, b, len);
+		for (i = 0; i < len; i++)
+			CHECK(out[i] == (a[i] & b[i]));
+
+		iaa_bitmap_or(out, a, b, len);
+		for (i = 0; i < len; i++)
+			CHECK(out[i] == (a[i] | b[i]));
+
+		iaa_bitmap_andnot(out, a, b, len);
+		for (i = 0; i < len; i++)
+			CHECK(out[i] == (uint8_t)(a[i] & ~b[i]));
+	}
+
+	return 0;
+}
+
+static int test_popcount(void)
+{
+	uint64_t count = 0;
+	uint32_t i, bit;
+
+	for (i = 0; i < BITMAP_LEN; i++)
+		for (bit = 0; bit < 8; bit++)
+			count += (a[i] >> bit) & 1;
+	CHECK(iaa_bitmap_popcount(a, BITMAP_LEN) == count);
+	CHECK(iaa_bitmap_popcount(a, 0) == 0);
+
+	return 0;
+}
+
+static int test_to_indices(void)
+{
+	uint32_t num_bits = BITMAP_LEN * 8 - 3, n, i, j = 0;
+
+	n = iaa_bitmap_to_indices(idx, a, num_bits);
+	for (i = 0; i < num_bits; i++) {
+		if (!((a[i / 8] >> (i % 8)) & 1))
+			continue;
+		CHECK(j < n && idx[j] == i);
+		j++;
+	}
+	CHECK(j == n);
+
+	return 0;
+}
+
+int main(void)
+{
+	int rc = 0;
+	uint32_t i;
+
+	srand(1);
+	for (i = 0; i < BITMAP_LEN; i++) {
+		a[i] = rand();
+		b[i] = rand();
+	}
+
+	rc |= test_combine();
+	rc |= test_popcount();
+	rc |= test_to_indices();
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
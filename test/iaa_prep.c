@@ -138,6 +138,7 @@ void iaa_prep_scan(struct task *tsk)
 	tsk->desc->iax_src2_xfer_size = tsk->iaa_src2_xfer_size;
 	tsk->desc->iax_filter_flags = tsk->iaa_filter_flags;
 	tsk->desc->iax_num_inputs = tsk->iaa_num_inputs;
+	tsk->desc->iax_decompr_flags = tsk->iaa_decompr_flags;
 	tsk->comp->status = 0;
 }
 
@@ -168,6 +169,7 @@ void iaa_prep_extract(struct task *tsk)
 	tsk->desc->iax_src2_xfer_size = tsk->iaa_src2_xfer_size;
 	tsk->desc->iax_filter_flags = tsk->iaa_filter_flags;
 	tsk->desc->iax_num_inputs = tsk->iaa_num_inputs;
+	tsk->desc->iax_decompr_flags = tsk->iaa_decompr_flags;
 	tsk->comp->status = 0;
 }
 
@@ -183,6 +185,7 @@ void iaa_prep_select(struct task *tsk)
 	tsk->desc->iax_src2_xfer_size = tsk->iaa_src2_xfer_size;
 	tsk->desc->iax_filter_flags = tsk->iaa_filter_flags;
 	tsk->desc->iax_num_inputs = tsk->iaa_num_inputs;
+	tsk->desc->iax_decompr_flags = tsk->iaa_decompr_flags;
 	tsk->comp->status = 0;
 }
 
@@ -0,0 +1,356 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <accfg/idxd.h>
+#include "accel_test.h"
+#include "iaa.h"
+#include "algorithms/iaa_filter.h"
+#include "algorithms/iaa_bitmap.h"
+
+/* TPC-H lineitem-like value ranges and predicates for the synthetic columns */
+static const struct {
+	const char *name;
+	uint32_t min;
+	uint32_t max;
+	uint32_t low;
+	uint32_t high;
+	int filter;
+} query_col_profile[] = {
+	{ "l_quantity", 1, 50, 1, 24, 1 },
+	{ "l_discount", 0, 10, 5, 7, 1 },
+	{ "l_shipdate", 0, 2525, 365, 730, 1 },
+	{ "l_extendedprice", 900, 104949, 0, 0, 0 },
+};
+
+#define QUERY_NUM_PROFILES (sizeof(query_col_profile) / sizeof(query_col_profile[0]))
+
+/* Packed buffers get a spare qword, the reference reads and writes past the end */
+#define QUERY_PAD 8
+
+int iaa_query_init(struct iaa_query *q, int num_cols, uint32_t num_rows,
+		   uint32_t filter_flags)
+{
+	struct iaa_filter_flags_t *flags_ptr = (struct iaa_filter_flags_t *)&filter_flags;
+	uint32_t width = flags_ptr->src1_width + 1;
+	uint32_t *values;
+	uint32_t r, range;
+	int i, p;
+
+	memset(q, 0, sizeof(*q));
+	if (num_cols <= 0 || num_cols > IAA_QUERY_MAX_COLS || !num_rows)
+		return -EINVAL;
+
+	q->num_rows = num_rows;
+	q->filter_flags = filter_flags;
+	q->col_size = ((uint64_t)num_rows * width + 7) / 8;
+	q->bitmap_size = (num_rows + 7) / 8;
+
+	values = malloc(num_rows * sizeof(uint32_t));
+	if (!values)
+		return -ENOMEM;
+
+	for (i = 0; i < num_cols; i++) {
+		struct iaa_query_col *col = &q->cols[i];
+
+		q->num_cols = i + 1;
+		p = i % QUERY_NUM_PROFILES;
+		col->name = query_col_profile[p].name;
+		col->low = query_col_profile[p].low;
+		col->high = query_col_profile[p].high;
+		col->filter = query_col_profile[p].filter;
+
+		col->data = aligned_alloc(ADDR_ALIGNMENT, PAGE_ALIGN(q->col_size + QUERY_PAD));
+		col->result = aligned_alloc(ADDR_ALIGNMENT, PAGE_ALIGN(q->col_size + QUERY_PAD));
+		col->ref_result = aligned_alloc(ADDR_ALIGNMENT, PAGE_ALIGN(q->col_size + QUERY_PAD));
+		if (!col->data || !col->result || !col->ref_result) {
+			free(values);
+			return -ENOMEM;
+		}
+		memset(col->data, 0, q->col_size + QUERY_PAD);
+
+		range = query_col_profile[p].max - query_col_profile[p].min + 1;
+		for (r = 0; r < num_rows; r++)
+			values[r] = query_col_profile[p].min + rand() % range;
+		iaa_pack_elements(col->data, values, num_rows, width);
+	}
+	free(values);
+
+	q->bitmap = aligned_alloc(ADDR_ALIGNMENT, PAGE_ALIGN(q->bitmap_size + QUERY_PAD));
+	q->ref_bitmap = aligned_alloc(ADDR_ALIGNMENT, PAGE_ALIGN(q->bitmap_size + QUERY_PAD));
+	if (!q->bitmap || !q->ref_bitmap)
+		return -ENOMEM;
+
+	return ACCTEST_STATUS_OK;
+}
+
+void iaa_query_free(struct iaa_query *q)
+{
+	int i;
+
+	for (i = 0; i < q->num_cols; i++) {
+		free(q->cols[i].data);
+		free(q->cols[i].result);
+		free(q->cols[i].ref_result);
+	}
+	free(q->bitmap);
+	free(q->ref_bitmap);
+}
+
+static int init_query_scan(struct acctest_context *ctx, struct task *tsk,
+			   struct iaa_query *q, struct iaa_query_col *col, int tflags)
+{
+	struct iaa_filter_aecs_t *aecs;
+
+	tsk->opcode = IAX_OPCODE_SCAN;
+	tsk->test_flags = tflags;
+	tsk->xfer_size = q->col_size;
+	tsk->src1 = col->data;
+	tsk->iaa_filter_flags = q->filter_flags;
+	tsk->iaa_num_inputs = q->num_rows;
+
+	tsk->src2 = aligned_alloc(32, IAA_FILTER_AECS_SIZE);
+	if (!tsk->src2)
+		return -ENOMEM;
+	memset(tsk->src2, 0, IAA_FILTER_AECS_SIZE);
+	aecs = tsk->src2;
+	aecs->low_filter_param = col->low;
+	aecs->high_filter_param = col->high;
+	tsk->iaa_src2_xfer_size = IAA_FILTER_AECS_SIZE;
+
+	tsk->dst1 = aligned_alloc(ADDR_ALIGNMENT, PAGE_ALIGN(q->bitmap_size + QUERY_PAD));
+	if (!tsk->dst1)
+		return -ENOMEM;
+	memset(tsk->dst1, 0, q->bitmap_size + QUERY_PAD);
+	tsk->iaa_max_dst_size = q->bitmap_size + QUERY_PAD;
+
+	tsk->dflags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR | IDXD_OP_FLAG_RD_SRC2_AECS;
+	if ((tflags & TEST_FLAGS_BOF) && ctx->bof)
+		tsk->dflags |= IDXD_OP_FLAG_BOF;
+
+	iaa_prep_scan(tsk);
+
+	return ACCTEST_STATUS_OK;
+}
+
+static void init_query_select(struct acctest_context *ctx, struct task *tsk,
+			      struct iaa_query *q, struct iaa_query_col *col, int tflags)
+{
+	tsk->opcode = IAX_OPCODE_SELECT;
+	tsk->test_flags = tflags;
+	tsk->xfer_size = q->col_size;
+	tsk->src1 = col->data;
+	tsk->src2 = q->bitmap;
+	tsk->iaa_src2_xfer_size = q->bitmap_size;
+	tsk->dst1 = col->result;
+	memset(tsk->dst1, 0, q->col_size + QUERY_PAD);
+	tsk->iaa_max_dst_size = q->col_size + QUERY_PAD;
+	tsk->iaa_filter_flags = q->filter_flags;
+	tsk->iaa_num_inputs = q->num_rows;
+
+	tsk->dflags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR | IDXD_OP_FLAG_RD_SRC2_2ND;
+	if ((tflags & TEST_FLAGS_BOF) && ctx->bof)
+		tsk->dflags |= IDXD_OP_FLAG_BOF;
+
+	iaa_prep_select(tsk);
+}
+
+/* The query buffers belong to struct iaa_query, drop them before freeing tasks */
+static void query_free_tasks(struct acctest_context *ctx, struct iaa_query *q)
+{
+	struct task_node *tsk_node = ctx->multi_task_node;
+
+	while (tsk_node) {
+		tsk_node->tsk->src1 = NULL;
+		if (tsk_node->tsk->src2 == q->bitmap)
+			tsk_node->tsk->src2 = NULL;
+		if (tsk_node->tsk->opcode == IAX_OPCODE_SELECT)
+			tsk_node->tsk->dst1 = NULL;
+		tsk_node = tsk_node->next;
+	}
+	acctest_free_task(ctx);
+}
+
+/* Keep the wq full: submit a window of descriptors, reap it, then the next */
+static int query_submit_wait(struct acctest_context *ctx)
+{
+	struct task_node *first = ctx->multi_task_node;
+	struct task_node *tsk_node;
+	int range, i;
+
+	if (ctx->dedicated == ACCFG_WQ_SHARED)
+		range = ctx->threshold;
+	else
+		range = ctx->wq_size;
+
+	while (first) {
+		for (tsk_node = first, i = 0; tsk_node && i < range; tsk_node = tsk_node->next, i++)
+			acctest_desc_submit(ctx, tsk_node->tsk->desc);
+
+		for (tsk_node = first, i = 0; tsk_node && i < range; tsk_node = tsk_node->next, i++) {
+			if (acctest_wait_on_desc_timeout(tsk_node->tsk->comp, ctx, ms_timeout) < 0) {
+				err("query desc timeout\n");
+				return ACCTEST_STATUS_TIMEOUT;
+			}
+			if (tsk_node->tsk->comp->status != IAX_COMP_SUCCESS) {
+				err("query op %#x failed status %#x\n", tsk_node->tsk->opcode,
+				    tsk_node->tsk->comp->status);
+				return tsk_node->tsk->comp->status;
+			}
+		}
+		first = tsk_node;
+	}
+
+	return ACCTEST_STATUS_OK;
+}
+
+static uint32_t query_count_matches(uint8_t *bitmap, uint32_t size)
+{
+	uint32_t i, n = 0;
+
+	for (i = 0; i < size; i++)
+		n += __builtin_popcount(bitmap[i]);
+
+	return n;
+}
+
+/*
+ * Run the conjunction on the device: scan every predicate column, AND the
+ * bitmaps on the CPU, then select every column through the result.
+ */
+int iaa_query_run(struct acctest_context *ctx, struct iaa_query *q, int tflags)
+{
+	struct task_node *tsk_node;
+	uint8_t *bitmap = q->bitmap;
+	int i, n = 0;
+	int rc;
+
+	for (i = 0; i < q->num_cols; i++)
+		n += q->cols[i].filter;
+	if (!n)
+		return -EINVAL;
+
+	ctx->is_batch = 0;
+	rc = acctest_alloc_multiple_tasks(ctx, n);
+	if (rc != ACCTEST_STATUS_OK)
+		goto out;
+
+	i = 0;
+	tsk_node = ctx->multi_task_node;
+	while (tsk_node) {
+		while (!q->cols[i].filter)
+			i++;
+		rc = init_query_scan(ctx, tsk_node->tsk, q, &q->cols[i++], tflags);
+		if (rc != ACCTEST_STATUS_OK)
+			goto out;
+		tsk_node = tsk_node->next;
+	}
+
+	rc = query_submit_wait(ctx);
+	if (rc != ACCTEST_STATUS_OK)
+		goto out;
+
+	memset(bitmap, 0xff, q->bitmap_size);
+	memset(bitmap + q->bitmap_size, 0, QUERY_PAD);
+	tsk_node = ctx->multi_task_node;
+	while (tsk_node) {
+		iaa_bitmap_and(bitmap, bitmap, tsk_node->tsk->dst1, q->bitmap_size);
+		tsk_node = tsk_node->next;
+	}
+	query_free_tasks(ctx, q);
+	q->num_matches = iaa_bitmap_popcount(bitmap, q->bitmap_size);
+
+	rc = acctest_alloc_multiple_tasks(ctx, q->num_cols);
+	if (rc != ACCTEST_STATUS_OK)
+		goto out;
+
+	i = 0;
+	tsk_node = ctx->multi_task_node;
+	while (tsk_node) {
+		init_query_select(ctx, tsk_node->tsk, q, &q->cols[i++], tflags);
+		tsk_node = tsk_node->next;
+	}
+
+	rc = query_submit_wait(ctx);
+	if (rc != ACCTEST_STATUS_OK)
+		goto out;
+
+	i = 0;
+	tsk_node = ctx->multi_task_node;
+	while (tsk_node) {
+		q->cols[i++].result_size = tsk_node->tsk->comp->iax_output_size;
+		tsk_node = tsk_node->next;
+	}
+
+ out:
+	query_free_tasks(ctx, q);
+	return rc;
+}
+
+/* The same query with the software filter reference */
+int iaa_query_run_cpu(struct iaa_query *q)
+{
+	struct iaa_filter_aecs_t aecs;
+	uint8_t *bitmap = q->ref_bitmap;
+	uint8_t *col_bitmap;
+	uint32_t j;
+	int i;
+
+	col_bitmap = calloc(1, q->bitmap_size + QUERY_PAD);
+	if (!col_bitmap)
+		return -ENOMEM;
+
+	memset(bitmap, 0xff, q->bitmap_size);
+	memset(bitmap + q->bitmap_size, 0, QUERY_PAD);
+	memset(&aecs, 0, sizeof(aecs));
+	for (i = 0; i < q->num_cols; i++) {
+		if (!q->cols[i].filter)
+			continue;
+		aecs.low_filter_param = q->cols[i].low;
+		aecs.high_filter_param = q->cols[i].high;
+		memset(col_bitmap, 0, q->bitmap_size + QUERY_PAD);
+		iaa_do_scan(col_bitmap, q->cols[i].data, &aecs, q->num_rows, q->filter_flags);
+		for (j = 0; j < q->bitmap_size; j++)
+			bitmap[j] &= col_bitmap[j];
+	}
+	free(col_bitmap);
+	q->ref_matches = query_count_matches(bitmap, q->bitmap_size);
+
+	for (i = 0; i < q->num_cols; i++) {
+		memset(q->cols[i].ref_result, 0, q->col_size + QUERY_PAD);
+		q->cols[i].ref_result_size = iaa_do_select(q->cols[i].ref_result,
+							   q->cols[i].data, bitmap,
+							   q->num_rows, q->filter_flags);
+	}
+
+	return ACCTEST_STATUS_OK;
+}
+
+int iaa_query_verify(struct iaa_query *q)
+{
+	int i;
+
+	if (q->num_matches != q->ref_matches ||
+	    memcmp(q->bitmap, q->ref_bitmap, q->bitmap_size)) {
+		err("Query bitmap mismatch, exp matches %u, act matches %u\n",
+		    q->ref_matches, q->num_matches);
+		return -ENXIO;
+	}
+
+	for (i = 0; i < q->num_cols; i++) {
+		if (q->cols[i].result_size != q->cols[i].ref_result_size ||
+		    memcmp(q->cols[i].result, q->cols[i].ref_result,
+			   q->cols[i].ref_result_size)) {
+			err("Query column %s mismatch, exp len %u, act len %u\n",
+			    q->cols[i].name, q->cols[i].ref_result_size,
+			    q->cols[i].result_size);
+			return -ENXIO;
+		}
+	}
+
+	return ACCTEST_STATUS_OK;
+}
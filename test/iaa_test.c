@@ -5,8 +5,10 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <time.h>
 #include "accel_test.h"
 #include "iaa.h"
+#include "algorithms/iaa_compress.h"
 
 #define IAA_TEST_SIZE 20000
 #pragma GCC diagnostic ignored "-Wformat"
@@ -23,11 +25,17 @@ static void usage(void)
 	"-2 <extra_flags_2> ; specified by each opcpde\n"
 	"-3 <extra_flags_3> ; specified by each opcpde\n"
 	"-a <aecs> ; specifies AECS\n"
+	"-k <chunk_size> ; with -o 0x43, compress in chunks across all wqs\n"
+	"-s <num_keys> ; with -o 0x40/0x41, run -n descs per key through a\n"
+	"              ; crypto session that reuses the key schedule\n"
+	"-q <columns> ; run a scan/select query over that many synthetic columns,\n"
+	"             ; -2 gives the filter flags and -3 the number of rows\n"
 	"-o <opcode>     ; opcode, same value as in IAA spec\n"
 	"-d              ; wq device such as iax1/wq1.0\n"
 	"-n <number of descriptors> ;descriptor count to submit\n"
 	"-t <ms timeout> ; ms to wait for descs to complete\n"
 	"-v              ; verbose\n"
+	"-P              ; report device perfmon counters for the run\n"
 	"-h              ; print this message\n");
 }
 
@@ -315,14 +323,15 @@ static int test_compress(struct acctest_context *ctx, size_t buf_size, int tflag
 }
 
 static int test_filter(struct acctest_context *ctx, size_t buf_size, int tflags,
-		       int extra_flags_2, int extra_flags_3, uint32_t opcode, int num_desc)
+		       int extra_flags_1, int extra_flags_2, int extra_flags_3,
+		       uint32_t opcode, int num_desc)
 {
 	struct task_node *tsk_node;
 	int rc = ACCTEST_STATUS_OK;
 	int itr = num_desc, i = 0, range = 0;
 
-	info("test filter: opcode %d len %#lx tflags %#x num_desc %ld\n",
-	     opcode, buf_size, tflags, num_desc);
+	info("test filter: opcode %d len %#lx tflags %#x num_desc %ld decompr_flags %#x\n",
+	     opcode, buf_size, tflags, num_desc, extra_flags_1);
 
 	ctx->is_batch = 0;
 
@@ -341,6 +350,8 @@ static int test_filter(struct acctest_context *ctx, size_t buf_size, int tflags,
 		/* allocate memory to src and dest buffers and fill in the desc for all the nodes*/
 		tsk_node = ctx->multi_task_node;
 		while (tsk_node) {
+			/* scan, extract and select inflate src1 first if 0x1 is set */
+			tsk_node->tsk->iaa_decompr_flags = extra_flags_1;
 			tsk_node->tsk->iaa_filter_flags = (uint32_t)extra_flags_2;
 			tsk_node->tsk->iaa_num_inputs = (uint32_t)extra_flags_3;
 
@@ -562,6 +573,153 @@ static int test_crypto(struct acctest_context *ctx, size_t buf_size, int tflags,
 	return rc;
 }
 
+static double elapsed_sec(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int test_parallel_compress(struct acctest_context *iaa, size_t buf_size, int tflags,
+				  int wq_type, int dev_id, int wq_id, uint32_t chunk_size)
+{
+	struct acctest_context *ctxs[IAA_PCOMPRESS_MAX_WQS];
+	struct timespec start, end;
+	uint64_t num_chunks, dst_size, out_size = 0;
+	void *src = NULL, *dst = NULL;
+	double elapsed;
+	int num_ctx = 1;
+	int rc = -ENOMEM;
+
+	info("test parallel compress: len %#lx tflags %#x chunk %#x\n",
+	     buf_size, tflags, chunk_size);
+
+	if (chunk_size > iaa->max_xfer_size) {
+		err("invalid chunk size: %u\n", chunk_size);
+		return -EINVAL;
+	}
+
+	/* An explicit -d pins the job to that wq, otherwise use every usable one */
+	ctxs[0] = iaa;
+	while (wq_id == ACCTEST_DEVICE_ID_NO_INPUT && num_ctx < IAA_PCOMPRESS_MAX_WQS) {
+		ctxs[num_ctx] = acctest_init(tflags);
+		if (!ctxs[num_ctx])
+			goto out;
+		ctxs[num_ctx]->dev_type = ACCFG_DEVICE_IAX;
+		if (acctest_alloc_nth(ctxs[num_ctx], wq_type, dev_id, num_ctx) < 0) {
+			accfg_unref(ctxs[num_ctx]->ctx);
+			free(ctxs[num_ctx]);
+			break;
+		}
+		num_ctx++;
+	}
+	info("spreading compress over %d wqs\n", num_ctx);
+
+	num_chunks = (buf_size + chunk_size - 1) / chunk_size;
+	dst_size = IAA_PCOMPRESS_HDR_SIZE(num_chunks) +
+		   num_chunks * IAA_PCOMPRESS_CHUNK_DEST_SIZE(chunk_size);
+
+	src = aligned_alloc(32, buf_size);
+	dst = aligned_alloc(32, dst_size);
+	if (!src || !dst)
+		goto out;
+	memset_pattern(src, 0x98765432abcdef01, buf_size);
+	memset_pattern(dst, 0, dst_size);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	rc = iaa_parallel_compress(ctxs, num_ctx, tflags, src, buf_size, chunk_size,
+				   dst, dst_size, &out_size);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (rc != ACCTEST_STATUS_OK)
+		goto out;
+
+	elapsed = elapsed_sec(&start, &end);
+	info("compressed %lu bytes to %lu in %lu chunks, %.2f MB/s\n",
+	     buf_size, out_size, num_chunks, buf_size / elapsed / 1e6);
+
+	if (iaa_pcompress_verify(dst, src, buf_size)) {
+		err("parallel compress verify failed\n");
+		rc = -ENXIO;
+	}
+
+ out:
+	while (--num_ctx > 0)
+		acctest_free(ctxs[num_ctx]);
+	free(src);
+	free(dst);
+	return rc;
+}
+
+static int test_crypto_session(struct acctest_context *ctx, size_t buf_size, int tflags,
+			       int crypto_aecs, uint32_t opcode, int num_desc, int num_keys)
+{
+	struct iaa_crypto_session sess;
+	struct timespec start, end;
+	double elapsed = 0;
+	int rc = ACCTEST_STATUS_OK;
+	int k;
+
+	info("test crypto session: opcode %d len %#lx tflags %#x num_desc %d keys %d aecs %#x\n",
+	     opcode, buf_size, tflags, num_desc, num_keys, crypto_aecs);
+
+	for (k = 0; k < num_keys && rc == ACCTEST_STATUS_OK; k++) {
+		rc = iaa_crypto_session_init(&sess, crypto_aecs & 0xff, (crypto_aecs >> 8) & 0xff);
+		if (rc != ACCTEST_STATUS_OK)
+			return rc;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		rc = iaa_crypto_session_run(ctx, &sess, tflags, opcode, buf_size, num_desc);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		elapsed += elapsed_sec(&start, &end);
+
+		iaa_crypto_session_free(&sess);
+	}
+
+	if (rc == ACCTEST_STATUS_OK)
+		info("%d descs over %d keys, %.0f ops/s, %.2f MB/s\n",
+		     num_desc * num_keys, num_keys, num_desc * num_keys / elapsed,
+		     (double)buf_size * num_desc * num_keys / elapsed / 1e6);
+
+	return rc;
+}
+
+static int test_query(struct acctest_context *ctx, int tflags, int num_cols,
+		      uint32_t num_rows, uint32_t filter_flags)
+{
+	struct iaa_query q;
+	struct timespec start, end;
+	double hw_sec, cpu_sec;
+	int rc;
+
+	info("test query: columns %d rows %u filter flags %#x\n",
+	     num_cols, num_rows, filter_flags);
+
+	rc = iaa_query_init(&q, num_cols, num_rows, filter_flags);
+	if (rc != ACCTEST_STATUS_OK)
+		goto out;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	rc = iaa_query_run(ctx, &q, tflags);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (rc != ACCTEST_STATUS_OK)
+		goto out;
+	hw_sec = elapsed_sec(&start, &end);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	rc = iaa_query_run_cpu(&q);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (rc != ACCTEST_STATUS_OK)
+		goto out;
+	cpu_sec = elapsed_sec(&start, &end);
+
+	info("query matched %u of %u rows\n", q.num_matches, num_rows);
+	info("iaa %.0f rows/s, cpu %.0f rows/s\n", num_rows / hw_sec, num_rows / cpu_sec);
+
+	rc = iaa_query_verify(&q);
+
+ out:
+	iaa_query_free(&q);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct acctest_context *iaa;
@@ -580,8 +738,13 @@ int main(int argc, char *argv[])
 	int dev_id = ACCTEST_DEVICE_ID_NO_INPUT;
 	int dev_wq_id = ACCTEST_DEVICE_ID_NO_INPUT;
 	unsigned int num_desc = 1;
+	uint32_t chunk_size = 0;
+	int num_cols = 0;
+	int num_keys = 0;
+	struct perfmon pm;
+	int perf_mon = 0;
 
-	while ((opt = getopt(argc, argv, "w:l:f:1:2:3:a:m:o:b:c:d:n:t:p:vh")) != -1) {
+	while ((opt = getopt(argc, argv, "w:l:f:1:2:3:a:k:m:o:b:c:d:n:q:s:t:p:vPh")) != -1) {
 		switch (opt) {
 		case 'w':
 			wq_type = atoi(optarg);
@@ -604,6 +767,9 @@ int main(int argc, char *argv[])
 		case 'a':
 			aecs = strtoul(optarg, NULL, 0);
 			break;
+		case 'k':
+			chunk_size = strtoul(optarg, NULL, 0);
+			break;
 		case 'o':
 			opcode = strtoul(optarg, NULL, 0);
 			break;
@@ -618,12 +784,21 @@ int main(int argc, char *argv[])
 		case 'n':
 			num_desc = strtoul(optarg, NULL, 0);
 			break;
+		case 'q':
+			num_cols = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			num_keys = strtoul(optarg, NULL, 0);
+			break;
 		case 't':
 			ms_timeout = strtoul(optarg, NULL, 0);
 			break;
 		case 'v':
 			debug_logging = 1;
 			break;
+		case 'P':
+			perf_mon = 1;
+			break;
 		case 'h':
 			usage();
 			exit(0);
@@ -642,11 +817,20 @@ int main(int argc, char *argv[])
 	if (rc < 0)
 		return -ENOMEM;
 
-	if (buf_size > iaa->max_xfer_size) {
+	/* Parallel compress splits the buffer, only each chunk must fit */
+	if (buf_size > iaa->max_xfer_size && !chunk_size) {
 		err("invalid transfer size: %lu\n", buf_size);
 		return -EINVAL;
 	}
 
+	if (perf_mon && acctest_perfmon_start(iaa, &pm))
+		perf_mon = 0;
+
+	if (num_cols) {
+		rc = test_query(iaa, tflags, num_cols, extra_flags_3, extra_flags_2);
+		goto error;
+	}
+
 	switch (opcode) {
 	case IAX_OPCODE_NOOP:
 		rc = test_noop(iaa, tflags, num_desc);
@@ -672,6 +856,14 @@ int main(int argc, char *argv[])
 		break;
 
 	case IAX_OPCODE_COMPRESS:
+		if (chunk_size) {
+			rc = test_parallel_compress(iaa, buf_size, tflags, wq_type,
+						    dev_id, wq_id, chunk_size);
+			if (rc != ACCTEST_STATUS_OK)
+				goto error;
+			break;
+		}
+		/* fallthrough */
 	case IAX_OPCODE_DECOMPRESS:
 		rc = test_compress(iaa, buf_size, tflags, extra_flags_1, opcode, num_desc);
 		if (rc != ACCTEST_STATUS_OK)
@@ -685,7 +877,7 @@ int main(int argc, char *argv[])
 	case IAX_OPCODE_RLE_BURST:
 	case IAX_OPCODE_FIND_UNIQUE:
 	case IAX_OPCODE_EXPAND:
-		rc = test_filter(iaa, buf_size, tflags, extra_flags_2,
+		rc = test_filter(iaa, buf_size, tflags, extra_flags_1, extra_flags_2,
 				 extra_flags_3, opcode, num_desc);
 		if (rc != ACCTEST_STATUS_OK)
 			goto error;
@@ -697,6 +889,13 @@ int main(int argc, char *argv[])
 		break;
 	case IAX_OPCODE_ENCRYPT:
 	case IAX_OPCODE_DECRYPT:
+		if (num_keys) {
+			rc = test_crypto_session(iaa, buf_size, tflags, aecs, opcode,
+						 num_desc, num_keys);
+			if (rc != ACCTEST_STATUS_OK)
+				goto error;
+			break;
+		}
 		rc = test_crypto(iaa, buf_size, tflags, aecs, opcode, num_desc);
 		if (rc != ACCTEST_STATUS_OK)
 			goto error;
@@ -708,6 +907,8 @@ int main(int argc, char *argv[])
 	}
 
  error:
+	if (perf_mon)
+		acctest_perfmon_stop(&pm);
 	acctest_free(iaa);
 	return rc;
 }
@@ -299,6 +299,60 @@ test_op_filter()
 	done
 }
 
+# Filter with the column fed through the decompressor (-1 0x1)
+test_op_filter_decompress()
+{
+	local flag="$1"
+	local wq_mode_code
+	local opcode
+
+	for wq_mode_code in 0 1; do
+		for opcode in $IAA_OPCODE_SCAN $IAA_OPCODE_EXTRACT $IAA_OPCODE_SELECT; do
+			if [ $(((1 << opcode) & OP_CAP2)) -eq 0 ]; then
+				continue
+			fi
+			"$IAATEST" -w "$wq_mode_code" -f "$flag" -l 4096 -1 0x1 -2 0x7c \
+				-3 1024 -o $opcode -t 5000 "${VERBOSE}" $DEV_OPT
+			"$IAATEST" -w "$wq_mode_code" -f "$flag" -l 65536 -1 0x1 -2 0x7c \
+				-3 16384 -o $opcode -t 5000 "${VERBOSE}" $DEV_OPT
+			"$IAATEST" -w "$wq_mode_code" -f "$flag" -l 1048576 -1 0x1 -2 0x7c \
+				-3 262144 -o $opcode -t 5000 "${VERBOSE}" $DEV_OPT
+		done
+	done
+}
+
+# Conjunctive scan/select query over synthetic columns
+test_op_query()
+{
+	local flag="$1"
+	local wq_mode_code
+
+	for wq_mode_code in 0 1; do
+		"$IAATEST" -w "$wq_mode_code" -f "$flag" -q 4 -2 0x7c \
+			-3 65536 -t 5000 "${VERBOSE}" $DEV_OPT
+		"$IAATEST" -w "$wq_mode_code" -f "$flag" -q 8 -2 0x3c \
+			-3 262144 -t 5000 "${VERBOSE}" $DEV_OPT
+	done
+}
+
+test_op_parallel_compress()
+{
+	local flag="$1"
+	local wq_mode_code
+	local wq_mode_name
+
+	for wq_mode_code in 0 1; do
+		wq_mode_name=$(wq_mode2name "$wq_mode_code")
+		echo "Performing $wq_mode_name WQ parallel compress testing"
+		for xfer_size in $SIZE_64K $SIZE_1M $SIZE_2M; do
+			echo "Testing $xfer_size bytes"
+
+			"$IAATEST" -w "$wq_mode_code" -l "$xfer_size" -o $IAA_OPCODE_COMPRESS \
+				-k $SIZE_64K -f "$flag" -t 5000 "${VERBOSE}" $DEV_OPT
+		done
+	done
+}
+
 test_op_crypto()
 {
 	local opcode="$1"
@@ -321,6 +375,24 @@ test_op_crypto()
 	done
 }
 
+test_op_crypto_session()
+{
+	local opcode="$1"
+	local flag="$2"
+	local aecs_flag="$3"
+	local op_name
+	op_name=$(opcode2name "$opcode")
+	local wq_mode_code
+	local wq_mode_name
+
+	for wq_mode_code in 0 1; do
+		wq_mode_name=$(wq_mode2name "$wq_mode_code")
+		echo "Performing $wq_mode_name WQ $op_name session testing"
+		"$IAATEST" -w "$wq_mode_code" -l $SIZE_4K -o "$opcode" -n 256 -s 4 \
+			-f "$flag" -a "$aecs_flag" -t 5000 "${VERBOSE}" $DEV_OPT
+	done
+}
+
 test_op_transl_fetch()
 {
 	local opcode="$1"
@@ -423,6 +495,14 @@ if [ $((IAA_OPCODE_MASK_COMPRESS & OP_CAP2)) -ne 0 ]; then
 	flag="0x0"
 	echo "Testing with 'block on fault' flag OFF"
 	test_op $IAA_OPCODE_COMPRESS $flag
+
+	flag="0x1"
+	echo "Testing with 'block on fault' flag ON"
+	test_op_parallel_compress $flag
+
+	flag="0x0"
+	echo "Testing with 'block on fault' flag OFF"
+	test_op_parallel_compress $flag
 fi
 
 if [ $((IAA_OPCODE_MASK_DECOMPRESS & OP_CAP2)) -ne 0 ]; then
@@ -461,6 +541,23 @@ test_op_filter $flag
 flag="0x0"
 test_op_filter $flag
 
+if [ $((IAA_OPCODE_MASK_DECOMPRESS & OP_CAP2)) -ne 0 ]; then
+	flag="0x1"
+	test_op_filter_decompress $flag
+
+	flag="0x0"
+	test_op_filter_decompress $flag
+fi
+
+if [ $((IAA_OPCODE_MASK_SCAN & OP_CAP2)) -ne 0 ] &&
+   [ $((IAA_OPCODE_MASK_SELECT & OP_CAP2)) -ne 0 ]; then
+	flag="0x1"
+	test_op_query $flag
+
+	flag="0x0"
+	test_op_query $flag
+fi
+
 if [ $((IAA_OPCODE_MASK_ENCRYPT & OP_CAP2)) -ne 0 ]; then
 	flag="0x1"
 	aecs_flag="0x0101"
@@ -471,6 +568,7 @@ if [ $((IAA_OPCODE_MASK_ENCRYPT & OP_CAP2)) -ne 0 ]; then
 	aecs_flag="0x0301"
 	echo "Testing with 'block on fault' flag OFF"
 	test_op_crypto $IAA_OPCODE_ENCRYPT $flag $aecs_flag
+	test_op_crypto_session $IAA_OPCODE_ENCRYPT $flag $aecs_flag
 fi
 
 if [ $((IAA_OPCODE_MASK_DECRYPT & OP_CAP2)) -ne 0 ]; then
@@ -483,6 +581,7 @@ if [ $((IAA_OPCODE_MASK_DECRYPT & OP_CAP2)) -ne 0 ]; then
 	aecs_flag="0x0301"
 	echo "Testing with 'block on fault' flag OFF"
 	test_op_crypto $IAA_OPCODE_DECRYPT $flag $aecs_flag
+	test_op_crypto_session $IAA_OPCODE_DECRYPT $flag $aecs_flag
 fi
 
 if [ $((IAA_OPCODE_MASK_TRANSL_FETCH & OP_CAP0)) -ne 0 ]; then
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <json-c/json.h>
+#include <util/image.h>
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: check failed: %s\n",		\
+			__func__, __LINE__, #cond);			\
+		return -EINVAL;						\
+	}								\
+} while (0)
+
+static const char *config_json =
+	"[{\"dev\":\"dsa0\",\"max_groups\":4,\"pasid_enabled\":true,"
+	"\"groups\":[{\"dev\":\"group0.0\",\"grouped_workqueues\":"
+	"[{\"dev\":\"wq0.0\",\"mode\":\"dedicated\",\"size\":16,"
+	"\"threshold\":null}]}]},"
+	"{\"dev\":\"iax1\",\"read_buffer_limit\":0}]";
+
+/* The records config_json encodes to, in load-config order */
+static const struct util_image_rec config_recs[] = {
+	{ UTIL_IMAGE_DEVICE, "", 0, NULL },
+	{ UTIL_IMAGE_STRING, "dev", 0, "dsa0" },
+	{ UTIL_IMAGE_INT, "max_groups", 4, NULL },
+	{ UTIL_IMAGE_INT, "pasid_enabled", 1, NULL },
+	{ UTIL_IMAGE_STRING, "dev", 0, "group0.0" },
+	{ UTIL_IMAGE_STRING, "dev", 0, "wq0.0" },
+	{ UTIL_IMAGE_STRING, "mode", 0, "dedicated" },
+	{ UTIL_IMAGE_INT, "size", 16, NULL },
+	{ UTIL_IMAGE_DEVICE, "", 0, NULL },
+	{ UTIL_IMAGE_STRING, "dev", 0, "iax1" },
+	{ UTIL_IMAGE_INT, "read_buffer_limit", 0, NULL },
+};
+
+#define NUM_RECS	(sizeof(config_recs) / sizeof(config_recs[0]))
+
+static int encode(const char *json, struct strbuf *sb)
+{
+	json_object *jobj;
+	int rc;
+
+	jobj = json_tokener_parse(json);
+	if (!jobj)
+		return -ENOMEM;
+	rc = util_image_from_json(jobj, sb);
+	json_object_put(jobj);
+
+	return rc;
+}
+
+static int test_roundtrip(struct strbuf *sb)
+{
+	const struct util_image_rec *want;
+	struct util_image_rec rec;
+	char *recs, *end;
+	unsigned int i = 0;
+	int rc;
+
+	CHECK(util_image_detect(sb->buf, sb->len));
+	CHECK(util_image_check(sb->buf, sb->len, &recs, &end) == 2);
+
+	while ((rc = util_image_next(&recs, end, &rec)) > 0) {
+		CHECK(i < NUM_RECS);
+		want = &config_recs[i++];
+		CHECK(rec.type == want->type);
+		CHECK(!strcmp(rec.key, want->key));
+		CHECK(rec.ival == want->ival);
+		CHECK(!rec.sval == !want->sval);
+		CHECK(!rec.sval || !strcmp(rec.sval, want->sval));
+	}
+	CHECK(rc == 0 && i == NUM_RECS);
+
+	return 0;
+}
+
+static int test_corrupt(struct strbuf *sb)
+{
+	struct util_image_hdr hdr;
+	char *recs, *end;
+
+	/* a flipped bit in the records fails the crc */
+	sb->buf[sb->len - 2] ^= 1;
+	CHECK(util_image_check(sb->buf, sb->len, &recs, &end) == -EBADMSG);
+	sb->buf[sb->len - 2] ^= 1;
+
+	CHECK(util_image_check(sb->buf, sb->len - 1, &recs, &end) ==
+			-EBADMSG);
+	CHECK(util_image_check(sb->buf, sizeof(hdr) - 1, &recs, &end) ==
+			-EINVAL);
+
+	memcpy(&hdr, sb->buf, sizeof(hdr));
+	hdr.version++;
+	memcpy(sb->buf, &hdr, sizeof(hdr));
+	CHECK(util_image_check(sb->buf, sb->len, &recs, &end) ==
+			-EPROTONOSUPPORT);
+	hdr.version--;
+	memcpy(sb->buf, &hdr, sizeof(hdr));
+
+	sb->buf[0] = 'X';
+	CHECK(!util_image_detect(sb->buf, sb->len));
+	CHECK(util_image_check(sb->buf, sb->len, &recs, &end) == -EINVAL);
+	sb->buf[0] = UTIL_IMAGE_MAGIC[0];
+
+	return 0;
+}
+
+/* Records cut short inside the checksummed area are still refused */
+static int test_truncated(struct strbuf *sb)
+{
+	struct util_image_rec rec;
+	char *recs, *end;
+	int rc;
+
+	CHECK(util_image_check(sb->buf, sb->len, &recs, &end) == 2);
+	end--;
+	while ((rc = util_image_next(&recs, end, &rec)) > 0)
+		;
+	CHECK(rc == -EBADMSG);
+
+	return 0;
+}
+
+static int test_invalid(void)
+{
+	struct strbuf sb = STRBUF_INIT;
+
+	/* bare values have no attribute name and objects are not arrays */
+	CHECK(encode("[{\"dev\":\"dsa0\",\"groups\":[1]}]", &sb) == -EINVAL);
+	strbuf_release(&sb);
+	CHECK(encode("{\"dev\":\"dsa0\"}", &sb) == -EINVAL);
+	strbuf_release(&sb);
+
+	return 0;
+}
+
+int main(void)
+{
+	struct strbuf sb = STRBUF_INIT;
+	int rc = 0;
+
+	if (encode(config_json, &sb)) {
+		fprintf(stderr, "encoding the config failed\n");
+		return EXIT_FAILURE;
+	}
+
+	rc |= test_roundtrip(&sb);
+	rc |= test_corrupt(&sb);
+	rc |= test_roundtrip(&sb);
+	rc |= test_truncated(&sb);
+	rc |= test_invalid();
+	strbuf_release(&sb);
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,490 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <accfg/libaccel_dsa.h>
+#include <accfg/dsa/private.h>
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: check failed: %s\n",		\
+			__func__, __LINE__, #cond);			\
+		return -EINVAL;						\
+	}								\
+} while (0)
+
+#define BUF_SIZE 4096
+
+static char src[BUF_SIZE], dst[BUF_SIZE], delta[2 * BUF_SIZE];
+
+static int run(struct dsa_op *op)
+{
+	int rc;
+
+	rc = dsa_op_submit(op);
+	if (rc)
+		return rc;
+	return dsa_op_wait(op, 1000);
+}
+
+static int test_copy_compare(struct dsa_op *op)
+{
+	int i;
+
+	for (i = 0; i < BUF_SIZE; i++)
+		src[i] = i * 7;
+
+	CHECK(dsa_op_memmove(op, dst, src, BUF_SIZE) == 0);
+	CHECK(run(op) == 0);
+	CHECK(!memcmp(src, dst, BUF_SIZE));
+
+	CHECK(dsa_op_compare(op, src, dst, BUF_SIZE) == 0);
+	CHECK(run(op) == 0);
+	CHECK(dsa_op_get_result(op) == DSA_OP_RESULT_MATCH);
+
+	dst[1000] ^= 1;
+	CHECK(dsa_op_compare(op, src, dst, BUF_SIZE) == 0);
+	CHECK(run(op) == 0);
+	CHECK(dsa_op_get_result(op) == DSA_OP_RESULT_MISMATCH);
+	CHECK(dsa_op_get_bytes_completed(op) == 1000);
+
+	return 0;
+}
+
+static int test_fill_crc(struct dsa_op *op)
+{
+	uint64_t pattern = 0x0102030405060708ULL;
+
+	CHECK(dsa_op_memfill(op, dst, pattern, BUF_SIZE - 3) == 0);
+	CHECK(run(op) == 0);
+	CHECK(dsa_op_compval(op, dst, pattern, BUF_SIZE - 3) == 0);
+	CHECK(run(op) == 0);
+	CHECK(dsa_op_get_result(op) == DSA_OP_RESULT_MATCH);
+
+	/* CRC-32C check value */
+	CHECK(dsa_op_crcgen(op, "123456789", 9, 0) == 0);
+	CHECK(run(op) == 0);
+	CHECK(dsa_op_get_crc(op) == 0xe3069283);
+
+	return 0;
+}
+
+static int test_delta(struct dsa_op *op)
+{
+	char copy[BUF_SIZE];
+
+	memcpy(dst, src, BUF_SIZE);
+	dst[8] = 1;
+	dst[BUF_SIZE - 1] = 2;
+
+	CHECK(dsa_op_cr_delta(op, src, dst, BUF_SIZE, delta,
+			sizeof(delta)) == 0);
+	CHECK(run(op) == 0);
+	CHECK(dsa_op_get_result(op) == DSA_OP_RESULT_MISMATCH);
+	CHECK(dsa_op_get_delta_size(op) == 2 * DSA_DELTA_ENTRY_SIZE);
+
+	memcpy(copy, src, BUF_SIZE);
+	CHECK(dsa_op_ap_delta(op, copy, delta, dsa_op_get_delta_size(op),
+			BUF_SIZE) == 0);
+	CHECK(run(op) == 0);
+	CHECK(!memcmp(copy, dst, BUF_SIZE));
+
+	CHECK(dsa_op_cr_delta(op, src, dst, BUF_SIZE, delta,
+			DSA_DELTA_ENTRY_SIZE) == 0);
+	CHECK(run(op) == 0);
+	CHECK(dsa_op_get_result(op) == DSA_OP_RESULT_OVERFLOW);
+
+	return 0;
+}
+
+static int test_memcpy(struct dsa_ctx *ctx)
+{
+	CHECK(dsa_ctx_calibrate(ctx, NULL) == 0);
+	CHECK(dsa_ctx_get_copy_threshold(ctx) == SIZE_MAX);
+	CHECK(dsa_ctx_set_copy_split(ctx, 101) == -EINVAL);
+
+	memset(dst, 0, BUF_SIZE);
+	CHECK(dsa_memcpy(ctx, dst + 1, src + 3, BUF_SIZE - 3) == 0);
+	CHECK(!memcmp(dst + 1, src + 3, BUF_SIZE - 3));
+
+	return 0;
+}
+
+/* Splits a copy into many small ops, with a share left to the CPU */
+static int test_memcpy_split(struct dsa_ctx *ctx)
+{
+	static char big_src[DSA_SPLIT_MIN + 1000], big_dst[sizeof(big_src)];
+	uint64_t xfer = ctx->max_xfer_size;
+	size_t i;
+
+	for (i = 0; i < sizeof(big_src); i++)
+		big_src[i] = i * 7;
+
+	ctx->max_xfer_size = BUF_SIZE;
+	dsa_ctx_set_copy_threshold(ctx, 0);
+	CHECK(dsa_ctx_set_copy_split(ctx, 30) == 0);
+	CHECK(dsa_memcpy(ctx, big_dst, big_src, sizeof(big_src)) == 0);
+	CHECK(!memcmp(big_dst, big_src, sizeof(big_src)));
+
+	ctx->max_xfer_size = xfer;
+	dsa_ctx_set_copy_threshold(ctx, SIZE_MAX);
+
+	return 0;
+}
+
+static int test_stripe(void)
+{
+	struct dsa_stripe *stripe;
+	double mbps;
+
+	CHECK(dsa_stripe_new(&stripe, -1, DSA_CTX_CPU) == 0);
+	CHECK(dsa_stripe_get_count(stripe) == 1);
+	CHECK(dsa_ctx_is_cpu(dsa_stripe_get_ctx(stripe, 0)));
+	CHECK(dsa_stripe_get_ctx(stripe, 1) == NULL);
+
+	memset(dst, 0, BUF_SIZE);
+	CHECK(dsa_stripe_copy(stripe, dst, src, BUF_SIZE, 0) == 0);
+	CHECK(!memcmp(dst, src, BUF_SIZE));
+	CHECK(dsa_stripe_copy(stripe, dst, src, BUF_SIZE, 2) == -EINVAL);
+	CHECK(dsa_stripe_scaling(stripe, dst, src, BUF_SIZE, &mbps) == 0);
+	CHECK(mbps > 0);
+	dsa_stripe_free(stripe);
+
+	return 0;
+}
+
+static int test_zero(struct dsa_ctx *ctx)
+{
+	struct dsa_zero_stats stats;
+	struct dsa_zero_sg sg[3];
+	struct dsa_zero *zero;
+	char *pages;
+
+	pages = aligned_alloc(4096, 5 * 4096);
+	if (!pages)
+		return -ENOMEM;
+	memset(pages, 0xff, 5 * 4096);
+
+	/* the first two pages are adjacent and take one descriptor */
+	sg[0].addr = pages + 4096;
+	sg[0].len = 4096;
+	sg[1].addr = pages + 2 * 4096;
+	sg[1].len = 4096;
+	sg[2].addr = pages + 4 * 4096;
+	sg[2].len = 4096;
+
+	CHECK(dsa_zero_new(ctx, 0, &zero) == 0);
+	CHECK(dsa_zero_pages(zero, sg, 3, DSA_ZERO_CACHE) == 0);
+	CHECK(pages[0] == -1 && pages[3 * 4096] == -1);
+	CHECK(pages[4096] == 0 && pages[3 * 4096 - 1] == 0);
+	CHECK(pages[4 * 4096] == 0 && pages[5 * 4096 - 1] == 0);
+	dsa_zero_get_stats(zero, &stats);
+	CHECK(stats.descs == 2 && stats.bytes == 3 * 4096);
+
+	sg[0].len = 100;
+	CHECK(dsa_zero_pages(zero, sg, 1, 0) == -EINVAL);
+	dsa_zero_free(zero);
+	free(pages);
+
+	return 0;
+}
+
+static int test_snap(struct dsa_ctx *ctx)
+{
+	static uint64_t region[BUF_SIZE], copy[BUF_SIZE];
+	struct dsa_snap_stats stats;
+	struct dsa_snap *snap;
+	size_t size, len;
+	uint64_t *stream;
+	int i;
+
+	for (i = 0; i < BUF_SIZE; i++)
+		region[i] = i;
+	memcpy(copy, region, sizeof(region));
+
+	CHECK(dsa_snap_new(ctx, region, sizeof(region), &snap) == 0);
+	size = dsa_snap_get_max_stream_size(snap);
+	stream = malloc(size);
+	CHECK(stream);
+
+	CHECK(dsa_snap_delta(snap, stream, size, &len) == 0);
+	CHECK(dsa_snap_apply(ctx, copy, sizeof(copy), stream, len) == 0);
+
+	region[5] = 0;
+	region[BUF_SIZE - 1] = 0;
+	CHECK(dsa_snap_delta(snap, stream, size, &len) == 0);
+	CHECK(dsa_snap_apply(ctx, copy, sizeof(copy), stream, len) == 0);
+	CHECK(!memcmp(copy, region, sizeof(region)));
+
+	dsa_snap_get_stats(snap, &stats);
+	CHECK(stats.snapshots == 2 && stats.blocks_delta == 1);
+	CHECK(stats.bytes_out == len + 16);
+
+	CHECK(dsa_snap_apply(ctx, copy, 8, stream, len) == -EINVAL);
+	free(stream);
+	dsa_snap_free(snap);
+
+	return 0;
+}
+
+static int test_replicate(struct dsa_ctx *ctx, struct dsa_op *op)
+{
+	struct dsa_replica_sg sg[2];
+	char *r1, *r2;
+
+	r1 = aligned_alloc(4096, 2 * BUF_SIZE);
+	r2 = aligned_alloc(4096, 2 * BUF_SIZE);
+	if (!r1 || !r2)
+		return -ENOMEM;
+
+	CHECK(dsa_op_dualcast(op, r1, r2 + 8, src, 64) == -EINVAL);
+
+	/* the first pair can use dualcast, the second cannot */
+	sg[0].src = src;
+	sg[0].dst1 = r1;
+	sg[0].dst2 = r2;
+	sg[0].len = BUF_SIZE;
+	sg[1].src = src;
+	sg[1].dst1 = r1 + BUF_SIZE;
+	sg[1].dst2 = r2 + BUF_SIZE + 8;
+	sg[1].len = 100;
+
+	CHECK(dsa_replicate(ctx, sg, 2) == 0);
+	CHECK(!memcmp(r1, src, BUF_SIZE) && !memcmp(r2, src, BUF_SIZE));
+	CHECK(!memcmp(r1 + BUF_SIZE, src, 100));
+	CHECK(!memcmp(r2 + BUF_SIZE + 8, src, 100));
+	free(r1);
+	free(r2);
+
+	return 0;
+}
+
+static int test_dedup(struct dsa_ctx *ctx)
+{
+	struct dsa_dedup_stats stats;
+	struct dsa_dedup *dedup;
+	static char blocks[4][512];
+	uint64_t ids[4];
+
+	/* blocks 0 and 2 are the same, block 3 repeats block 1 next call */
+	memset(blocks[0], 1, 512);
+	memset(blocks[1], 2, 512);
+	memset(blocks[2], 1, 512);
+	memset(blocks[3], 2, 512);
+
+	CHECK(dsa_dedup_new(ctx, 512, &dedup) == 0);
+	CHECK(dsa_dedup_blocks(dedup, blocks, 3 * 512, ids) == 0);
+	CHECK(ids[0] == 0 && ids[1] == 1 && ids[2] == 0);
+	CHECK(dsa_dedup_blocks(dedup, blocks[3], 512, ids) == 0);
+	CHECK(ids[0] == 1);
+	CHECK(dsa_dedup_blocks(dedup, blocks, 100, ids) == -EINVAL);
+
+	dsa_dedup_get_stats(dedup, &stats);
+	CHECK(stats.blocks == 4 && stats.duplicates == 2);
+	dsa_dedup_free(dedup);
+
+	return 0;
+}
+
+/*
+ * The guard starts from zero, so leading zero bytes leave it unchanged
+ * and a block ending in "123456789" has the CRC-T10DIF check value.
+ */
+static int test_dif_known(struct dsa_ctx *ctx)
+{
+	static const uint8_t tuple[8] = {
+		0xd0, 0xdb, 0x12, 0x34, 0x00, 0x00, 0x00, 0x64,
+	};
+	struct dsa_dif dif = {
+		.block_size = 512,
+		.app_tag = 0x1234,
+		.ref_tag = 100,
+	};
+	static char data[512], pi[520];
+	static uint8_t tag[8];
+	struct dsa_dif_sg sg = { .dst = pi, .src = data, .blocks = 1 };
+	struct dsa_dix_sg dix = { .data = data, .pi = tag, .blocks = 1 };
+	struct dsa_dif_pipe *pipe;
+
+	memcpy(data + 512 - 9, "123456789", 9);
+
+	CHECK(dsa_dif_pipe_new(ctx, &pipe) == 0);
+	CHECK(dsa_dif_pipe_run(pipe, DSA_DIF_OP_INSERT, &sg, 1, NULL, &dif,
+			0) == 0);
+	CHECK(!memcmp(pi + 512, tuple, sizeof(tuple)));
+	CHECK(dsa_dix_gen(pipe, &dix, 1, &dif, 0) == 0);
+	CHECK(!memcmp(tag, tuple, sizeof(tuple)));
+	dsa_dif_pipe_free(pipe);
+
+	return 0;
+}
+
+static int test_dif(struct dsa_ctx *ctx)
+{
+	struct dsa_dif dif = {
+		.block_size = 512,
+		.app_tag = 0x1234,
+		.ref_tag = 100,
+	};
+	static char data[4][512], pi[4][520], out[4][512];
+	struct dsa_dif_sg sg[2] = {
+		{ .dst = pi[0], .src = data[0], .blocks = 1 },
+		{ .dst = pi[1], .src = data[1], .blocks = 3 },
+	};
+	struct dsa_dif_stats stats;
+	struct dsa_dif_pipe *pipe;
+
+	memset(data, 0x5a, sizeof(data));
+	data[2][7] = 1;
+
+	/* ref tags run on across the list, 100 to 103 */
+	CHECK(dsa_dif_pipe_new(ctx, &pipe) == 0);
+	CHECK(dsa_dif_pipe_run(pipe, DSA_DIF_OP_INSERT, sg, 2, NULL, &dif,
+			DSA_DIF_VERIFY) == 0);
+	CHECK(pi[3][516] == 0 && pi[3][519] == 103);
+
+	sg[0].dst = out[0];
+	sg[0].src = pi[0];
+	sg[0].blocks = 4;
+	CHECK(dsa_dif_pipe_run(pipe, DSA_DIF_OP_CHECK, sg, 1, &dif, NULL,
+			DSA_DIF_VERIFY) == 0);
+	CHECK(dsa_dif_pipe_run(pipe, DSA_DIF_OP_STRIP, sg, 1, &dif, NULL,
+			DSA_DIF_VERIFY) == 0);
+	CHECK(memcmp(out, data, sizeof(data)) == 0);
+
+	pi[2][3] ^= 1;
+	CHECK(dsa_dif_pipe_run(pipe, DSA_DIF_OP_CHECK, sg, 1, &dif, NULL,
+			0) == -EBADMSG);
+
+	dsa_dif_pipe_get_stats(pipe, &stats);
+	CHECK(stats.blocks == 16 && stats.errors == 1);
+	dsa_dif_pipe_free(pipe);
+
+	return 0;
+}
+
+static int test_dix(struct dsa_ctx *ctx)
+{
+	struct dsa_dif dif = {
+		.block_size = 512,
+		.app_tag_mask = 0x00ff,
+		.app_tag = 0xab00,
+		.ref_tag = 7,
+	};
+	static char data[5][512];
+	static uint8_t pi[5][8];
+	struct dsa_dix_sg sg[2] = {
+		{ .data = data[0], .pi = pi[0], .blocks = 2 },
+		{ .data = data[2], .pi = pi[2], .blocks = 3 },
+	};
+	struct dsa_dif_pipe *pipe;
+	size_t bad = 0;
+	int i;
+
+	for (i = 0; i < 5; i++)
+		memset(data[i], i, 512);
+
+	/* guard of a zero block is zero, tags follow in big endian */
+	CHECK(dsa_dif_pipe_new(ctx, &pipe) == 0);
+	CHECK(dsa_dix_gen(pipe, sg, 2, &dif, DSA_DIF_VERIFY) == 0);
+	CHECK(pi[0][0] == 0 && pi[0][1] == 0 && pi[0][2] == 0xab);
+	CHECK(pi[4][7] == 11);
+	CHECK(dsa_dix_verify(pipe, sg, 2, &dif, &bad) == 0);
+
+	/* masked app tag bits are not checked */
+	pi[1][3] ^= 0x10;
+	CHECK(dsa_dix_verify(pipe, sg, 2, &dif, &bad) == 0);
+	data[3][100] ^= 1;
+	CHECK(dsa_dix_verify(pipe, sg, 2, &dif, &bad) == -EBADMSG);
+	CHECK(bad == 3);
+	dsa_dif_pipe_free(pipe);
+
+	return 0;
+}
+
+static int test_persist(struct dsa_ctx *ctx)
+{
+	struct dsa_persist_range range[2] = {
+		{ .addr = dst, .len = 100 },
+		{ .addr = dst + 100, .len = 1000 },
+	};
+	struct dsa_persist_stats stats;
+	struct dsa_persist *persist;
+
+	memset(src, 0x3c, BUF_SIZE);
+	memset(dst, 0, BUF_SIZE);
+
+	/* a log record, then its commit flag once the record is durable */
+	CHECK(dsa_persist_new(ctx, &persist) == 0);
+	CHECK(dsa_persist_memmove(persist, dst, src, BUF_SIZE - 8) == 0);
+	dsa_persist_fence(persist);
+	CHECK(dsa_persist_memmove(persist, dst + BUF_SIZE - 8, src, 8) == 0);
+	CHECK(dsa_persist_flush(persist, range, 2) == 0);
+	CHECK(dsa_persist_drain(persist) == 0);
+	CHECK(memcmp(dst, src, BUF_SIZE) == 0);
+
+	/* the two ranges merge into 18 whole lines */
+	dsa_persist_get_stats(persist, &stats);
+	CHECK(stats.bytes_copied == BUF_SIZE && stats.drains == 1);
+	CHECK(stats.bytes_flushed == 18 * 64);
+	dsa_persist_free(persist);
+
+	return 0;
+}
+
+static int test_batch(struct dsa_ctx *ctx)
+{
+	struct dsa_batch *batch;
+
+	CHECK(dsa_batch_new(ctx, 4, &batch) == 0);
+	CHECK(dsa_op_memfill(dsa_batch_get_op(batch, 0), dst, 0,
+			BUF_SIZE) == 0);
+	CHECK(dsa_op_compval(dsa_batch_get_op(batch, 1), dst, 0,
+			BUF_SIZE) == 0);
+	CHECK(dsa_op_set_flags(dsa_batch_get_op(batch, 1),
+			DSA_OP_FLAG_FENCE) == 0);
+	CHECK(dsa_batch_submit(batch, 2) == 0);
+	CHECK(dsa_batch_wait(batch, 1000) == 0);
+	CHECK(dsa_op_get_result(dsa_batch_get_op(batch, 1)) ==
+			DSA_OP_RESULT_MATCH);
+	CHECK(dsa_batch_get_op(batch, 4) == NULL);
+	dsa_batch_free(batch);
+
+	return 0;
+}
+
+int main(void)
+{
+	struct dsa_ctx *ctx;
+	struct dsa_op *op;
+	int rc = 0;
+
+	/* the CPU path behaves the same on any machine */
+	if (dsa_ctx_new(&ctx, NULL, DSA_CTX_CPU) || dsa_op_new(ctx, &op))
+		return EXIT_FAILURE;
+
+	rc |= test_copy_compare(op);
+	rc |= test_fill_crc(op);
+	rc |= test_delta(op);
+	rc |= test_memcpy(ctx);
+	rc |= test_memcpy_split(ctx);
+	rc |= test_stripe();
+	rc |= test_zero(ctx);
+	rc |= test_snap(ctx);
+	rc |= test_replicate(ctx, op);
+	rc |= test_dedup(ctx);
+	rc |= test_dif_known(ctx);
+	rc |= test_dif(ctx);
+	rc |= test_dix(ctx);
+	rc |= test_persist(ctx);
+	rc |= test_batch(ctx);
+
+	dsa_op_free(op);
+	dsa_ctx_free(ctx);
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <math.h>
+#include <util/perfmon.h>
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: check failed: %s\n",		\
+			__func__, __LINE__, #cond);			\
+		return -EINVAL;						\
+	}								\
+} while (0)
+
+static int close_to(double a, double b)
+{
+	return fabs(a - b) < 1e-6 * (fabs(b) + 1);
+}
+
+/* Two engines over 2 seconds, engine 1 saturated, few ATC misses */
+static int build_engine_bound(struct perfmon_replay **replay)
+{
+	int rc = 0;
+
+	rc |= perfmon_replay_add(replay, "time", -1, 1000000000ULL,
+			3000000000ULL);
+	rc |= perfmon_replay_add(replay, "cycles", -1, 100, 2000100);
+	rc |= perfmon_replay_add(replay, "engine_busy", 0, 0, 1000000);
+	rc |= perfmon_replay_add(replay, "engine_busy", 1, 50, 1900050);
+	rc |= perfmon_replay_add(replay, "descs_completed", 0, 10, 2010);
+	rc |= perfmon_replay_add(replay, "descs_completed", 1, 0, 8000);
+	rc |= perfmon_replay_add(replay, "bytes_read", -1, 0, 4000000000ULL);
+	rc |= perfmon_replay_add(replay, "bytes_written", -1, 0,
+			2000000000ULL);
+	rc |= perfmon_replay_add(replay, "atc_lookups", -1, 0, 1000);
+	rc |= perfmon_replay_add(replay, "atc_misses", -1, 0, 10);
+
+	return rc;
+}
+
+static int run_replay(struct perfmon_replay *replay, struct perfmon *pm,
+		struct perfmon_report *r)
+{
+	int rc;
+
+	rc = perfmon_init(pm, "dsa0", perfmon_replay_engines(replay),
+			&perfmon_replay_ops, replay);
+	if (rc)
+		return rc;
+	rc = perfmon_start(pm);
+	if (rc)
+		return rc;
+	perfmon_stop(pm);
+	perfmon_compute(pm, r);
+
+	return 0;
+}
+
+static int test_engine_bound(void)
+{
+	struct perfmon_replay *replay = NULL;
+	struct perfmon_report r;
+	struct perfmon pm;
+
+	CHECK(build_engine_bound(&replay) == 0);
+	CHECK(run_replay(replay, &pm, &r) == 0);
+
+	CHECK(r.num_engines == 2);
+	CHECK(close_to(r.secs, 2.0));
+	CHECK(close_to(r.eng_util[0], 50.0));
+	CHECK(close_to(r.eng_util[1], 95.0));
+	CHECK(close_to(r.eng_descs[0], 1000.0));
+	CHECK(close_to(r.eng_descs[1], 4000.0));
+	CHECK(close_to(r.rd_mbps, 2000.0));
+	CHECK(close_to(r.wr_mbps, 1000.0));
+	CHECK(close_to(r.atc_miss_pct, 1.0));
+	CHECK(close_to(r.atc_miss_rate, 5.0));
+	CHECK(!strcmp(r.bound, "engine"));
+
+	perfmon_free(&pm);
+	perfmon_replay_free(replay);
+
+	return 0;
+}
+
+static int test_translation_bound(void)
+{
+	struct perfmon_replay *replay = NULL;
+	struct perfmon_report r;
+	struct perfmon pm;
+
+	/* engine 0 looks busy but most translations miss the ATC */
+	CHECK(perfmon_replay_add(&replay, "time", -1, 0, 1000000000ULL) == 0);
+	CHECK(perfmon_replay_add(&replay, "cycles", -1, 0, 1000) == 0);
+	CHECK(perfmon_replay_add(&replay, "engine_busy", 0, 0, 990) == 0);
+	CHECK(perfmon_replay_add(&replay, "atc_lookups", -1, 0, 1000) == 0);
+	CHECK(perfmon_replay_add(&replay, "atc_misses", -1, 0, 400) == 0);
+	CHECK(run_replay(replay, &pm, &r) == 0);
+
+	CHECK(close_to(r.atc_miss_pct, 40.0));
+	CHECK(r.rd_mbps < 0 && r.wr_mbps < 0 && r.eng_descs[0] < 0);
+	CHECK(!strcmp(r.bound, "translation"));
+
+	perfmon_free(&pm);
+	perfmon_replay_free(replay);
+
+	return 0;
+}
+
+static int test_record_roundtrip(void)
+{
+	struct perfmon_replay *replay = NULL, *loaded = NULL;
+	struct perfmon_report r1, r2;
+	struct perfmon pm1, pm2;
+	char path[] = "/tmp/perfmon_test.XXXXXX";
+	FILE *f;
+	int fd;
+
+	CHECK(build_engine_bound(&replay) == 0);
+	CHECK(run_replay(replay, &pm1, &r1) == 0);
+
+	fd = mkstemp(path);
+	CHECK(fd >= 0);
+	f = fdopen(fd, "w");
+	CHECK(f);
+	perfmon_record(&pm1, f);
+	fclose(f);
+
+	CHECK(perfmon_replay_load(path, &loaded) == 0);
+	unlink(path);
+	CHECK(run_replay(loaded, &pm2, &r2) == 0);
+
+	CHECK(close_to(r1.secs, r2.secs));
+	CHECK(close_to(r1.eng_util[1], r2.eng_util[1]));
+	CHECK(close_to(r1.rd_mbps, r2.rd_mbps));
+	CHECK(close_to(r1.atc_miss_pct, r2.atc_miss_pct));
+
+	perfmon_free(&pm1);
+	perfmon_free(&pm2);
+	perfmon_replay_free(replay);
+	perfmon_replay_free(loaded);
+
+	return 0;
+}
+
+static int test_set_event(void)
+{
+	struct perfmon pm;
+
+	CHECK(perfmon_init(&pm, "dsa0", 1, &perfmon_replay_ops, NULL) == 0);
+	CHECK(perfmon_set_event(&pm, "atc_misses=0x2:0x10") == 0);
+	CHECK(pm.events[PERFMON_EV_ATC_MISSES].category == 2);
+	CHECK(pm.events[PERFMON_EV_ATC_MISSES].event == 0x10);
+	CHECK(perfmon_set_event(&pm, "atc=1:1") == -ENOENT);
+	CHECK(perfmon_set_event(&pm, "cycles=1") == -EINVAL);
+	CHECK(perfmon_start(&pm) == -ENODEV);
+	perfmon_free(&pm);
+
+	return 0;
+}
+
+int main(void)
+{
+	int rc = 0;
+
+	rc |= test_engine_bound();
+	rc |= test_translation_bound();
+	rc |= test_record_roundtrip();
+	rc |= test_set_event();
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
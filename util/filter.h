@@ -54,6 +54,10 @@ struct list_filter_arg {
 	int dev_num;
 	/* track group_num during walk-through */
 	int group_num;
+	/* streaming writer, used instead of jdevices when set */
+	struct util_json_stream *js;
+	/* device member the stream is currently writing */
+	int section;
 
 
 };
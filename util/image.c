@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright(c) 2019 Intel Corporation. All rights reserved.
+#include <errno.h>
+#include <string.h>
+#include <endian.h>
+#include <json-c/json.h>
+#include <util/image.h>
+
+/* IEEE 802.3 crc32, images are a few KB so a bitwise loop is enough */
+static uint32_t image_crc32(const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	uint32_t crc = ~0U;
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xedb88320U & -(crc & 1));
+	}
+
+	return ~crc;
+}
+
+static int image_add_rec(struct strbuf *sb, enum util_image_rec_type type,
+		const char *key, const void *val, size_t val_len)
+{
+	size_t key_len = strlen(key) + 1;
+	uint16_t vlen = htole16(val_len);
+	uint8_t hdr[2] = { type, key_len };
+
+	if (key_len > UINT8_MAX || val_len > UINT16_MAX)
+		return -E2BIG;
+
+	strbuf_add(sb, hdr, sizeof(hdr));
+	strbuf_add(sb, &vlen, sizeof(vlen));
+	strbuf_add(sb, key, key_len);
+	strbuf_add(sb, val, val_len);
+
+	return 0;
+}
+
+static int image_add_value(struct strbuf *sb, const char *key,
+		struct json_object *jval)
+{
+	const char *s;
+	int64_t v;
+
+	switch (json_object_get_type(jval)) {
+	case json_type_boolean:
+	case json_type_int:
+		v = htole64(json_object_get_int64(jval));
+		return image_add_rec(sb, UTIL_IMAGE_INT, key, &v, sizeof(v));
+	case json_type_double:
+	case json_type_string:
+		s = json_object_get_string(jval);
+		return image_add_rec(sb, UTIL_IMAGE_STRING, key, s,
+				strlen(s) + 1);
+	case json_type_null:
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int image_add_array(struct strbuf *sb, struct json_object *jarray);
+
+/* Follows the walk of json_parse() in accfg/config.c */
+static int image_add_object(struct strbuf *sb, struct json_object *jobj)
+{
+	json_object_iter iter;
+	int rc;
+
+	json_object_object_foreachC(jobj, iter) {
+		switch (json_object_get_type(iter.val)) {
+		case json_type_object:
+			rc = image_add_object(sb, iter.val);
+			break;
+		case json_type_array:
+			rc = image_add_array(sb, iter.val);
+			break;
+		default:
+			rc = image_add_value(sb, iter.key, iter.val);
+			break;
+		}
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static int image_add_array(struct strbuf *sb, struct json_object *jarray)
+{
+	struct json_object *jval;
+	int i, n, rc;
+
+	n = json_object_array_length(jarray);
+	for (i = 0; i < n; i++) {
+		jval = json_object_array_get_idx(jarray, i);
+		switch (json_object_get_type(jval)) {
+		case json_type_object:
+			rc = image_add_object(sb, jval);
+			break;
+		case json_type_array:
+			rc = image_add_array(sb, jval);
+			break;
+		default:
+			/* bare values have no attribute name to apply to */
+			rc = -EINVAL;
+			break;
+		}
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+/* Encodes the device array built for save-config into sb */
+int util_image_from_json(struct json_object *jdevices, struct strbuf *sb)
+{
+	struct util_image_hdr hdr;
+	struct json_object *jdev;
+	size_t start;
+	int i, n, rc;
+
+	if (json_object_get_type(jdevices) != json_type_array)
+		return -EINVAL;
+
+	start = sb->len;
+	strbuf_grow(sb, sizeof(hdr));
+	strbuf_setlen(sb, start + sizeof(hdr));
+
+	n = json_object_array_length(jdevices);
+	for (i = 0; i < n; i++) {
+		jdev = json_object_array_get_idx(jdevices, i);
+		if (json_object_get_type(jdev) != json_type_object)
+			return -EINVAL;
+		rc = image_add_rec(sb, UTIL_IMAGE_DEVICE, "", "", 0);
+		if (rc)
+			return rc;
+		rc = image_add_object(sb, jdev);
+		if (rc)
+			return rc;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, UTIL_IMAGE_MAGIC, sizeof(hdr.magic));
+	hdr.version = htole16(UTIL_IMAGE_VERSION);
+	hdr.hdr_len = htole16(sizeof(hdr));
+	hdr.num_devices = htole32(n);
+	hdr.len = htole32(sb->len - start - sizeof(hdr));
+	hdr.crc = htole32(image_crc32(sb->buf + start + sizeof(hdr),
+				sb->len - start - sizeof(hdr)));
+	memcpy(sb->buf + start, &hdr, sizeof(hdr));
+
+	return 0;
+}
+
+bool util_image_detect(const void *buf, size_t len)
+{
+	return len >= sizeof(struct util_image_hdr) &&
+		!memcmp(buf, UTIL_IMAGE_MAGIC, strlen(UTIL_IMAGE_MAGIC));
+}
+
+/*
+ * Validates the header and checksum of an image. Returns the number of
+ * devices and the bounds of the records, or a negative errno.
+ */
+int util_image_check(void *buf, size_t len, char **recs, char **end)
+{
+	struct util_image_hdr hdr;
+	size_t hdr_len, rec_len;
+
+	if (!util_image_detect(buf, len))
+		return -EINVAL;
+
+	memcpy(&hdr, buf, sizeof(hdr));
+	if (le16toh(hdr.version) != UTIL_IMAGE_VERSION)
+		return -EPROTONOSUPPORT;
+
+	hdr_len = le16toh(hdr.hdr_len);
+	rec_len = le32toh(hdr.len);
+	if (hdr_len < sizeof(hdr) || hdr_len > len ||
+			rec_len != len - hdr_len)
+		return -EBADMSG;
+
+	if (image_crc32((char *)buf + hdr_len, rec_len) != le32toh(hdr.crc))
+		return -EBADMSG;
+
+	*recs = (char *)buf + hdr_len;
+	*end = *recs + rec_len;
+
+	return le32toh(hdr.num_devices);
+}
+
+/* Returns 1 and the record at *pos, 0 at the end or -EBADMSG */
+int util_image_next(char **pos, char *end, struct util_image_rec *rec)
+{
+	uint8_t *p = (uint8_t *)*pos;
+	size_t key_len, val_len;
+	uint16_t vlen;
+	int64_t v;
+
+	if (*pos == end)
+		return 0;
+	if (end - *pos < 4)
+		return -EBADMSG;
+
+	key_len = p[1];
+	memcpy(&vlen, p + 2, sizeof(vlen));
+	val_len = le16toh(vlen);
+	if ((size_t)(end - *pos) < 4 + key_len + val_len || !key_len ||
+			p[4 + key_len - 1] != '\0')
+		return -EBADMSG;
+
+	rec->type = p[0];
+	rec->key = (char *)p + 4;
+	rec->sval = NULL;
+	rec->ival = 0;
+
+	switch (rec->type) {
+	case UTIL_IMAGE_DEVICE:
+		break;
+	case UTIL_IMAGE_INT:
+		if (val_len != sizeof(v))
+			return -EBADMSG;
+		memcpy(&v, p + 4 + key_len, sizeof(v));
+		rec->ival = le64toh(v);
+		break;
+	case UTIL_IMAGE_STRING:
+		if (!val_len || p[4 + key_len + val_len - 1] != '\0')
+			return -EBADMSG;
+		rec->sval = (char *)p + 4 + key_len;
+		break;
+	default:
+		return -EBADMSG;
+	}
+
+	*pos += 4 + key_len + val_len;
+	return 1;
+}
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+#ifndef __ACCFG_IMAGE_H__
+#define __ACCFG_IMAGE_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <util/strbuf.h>
+
+/*
+ * Binary configuration image written by save-config --format=binary.
+ *
+ * A fixed little endian header is followed by a flat list of records, one
+ * per attribute, in the order load-config applies the attributes of the
+ * JSON file. A DEVICE record starts each top level device entry so the
+ * devices can be configured in parallel. The crc covers the records.
+ *
+ * record: u8 type, u8 key_len, u16 val_len, key, value
+ * key and string values are NUL terminated and the lengths include the
+ * NUL, integer values are 8 byte little endian.
+ */
+#define UTIL_IMAGE_MAGIC	"ACCFGIMG"
+#define UTIL_IMAGE_VERSION	1
+
+struct util_image_hdr {
+	char magic[8];
+	uint16_t version;
+	uint16_t hdr_len;
+	uint32_t num_devices;
+	uint32_t len;
+	uint32_t crc;
+};
+
+enum util_image_rec_type {
+	UTIL_IMAGE_DEVICE = 1,
+	UTIL_IMAGE_INT,
+	UTIL_IMAGE_STRING,
+};
+
+struct util_image_rec {
+	enum util_image_rec_type type;
+	char *key;
+	int64_t ival;
+	char *sval;
+};
+
+struct json_object;
+int util_image_from_json(struct json_object *jdevices, struct strbuf *sb);
+bool util_image_detect(const void *buf, size_t len);
+int util_image_check(void *buf, size_t len, char **recs, char **end);
+int util_image_next(char **pos, char *end, struct util_image_rec *rec);
+
+#endif /* __ACCFG_IMAGE_H__ */
@@ -124,6 +124,103 @@ void util_display_json_array(FILE *f_out, struct json_object *jarray,
 	json_object_put(jarray);
 }
 
+void util_json_stream_init(struct util_json_stream *js, FILE *f)
+{
+	memset(js, 0, sizeof(*js));
+	js->f = f;
+}
+
+/* Separator, indent and key of the next item of the open container */
+static void util_json_stream_item(struct util_json_stream *js,
+		const char *key)
+{
+	int i;
+
+	if (!js->depth)
+		return;
+	if (js->had_children[js->depth - 1])
+		fputs(",\n", js->f);
+	js->had_children[js->depth - 1] = true;
+	for (i = 0; i < js->depth; i++)
+		fputs("  ", js->f);
+	if (!js->array[js->depth - 1])
+		fprintf(js->f, "\"%s\":", key);
+}
+
+int util_json_stream_begin(struct util_json_stream *js, const char *key,
+		bool array)
+{
+	if (js->depth == UTIL_JSON_STREAM_DEPTH)
+		return -E2BIG;
+
+	util_json_stream_item(js, key);
+	fputs(array ? "[\n" : "{\n", js->f);
+	js->array[js->depth] = array;
+	js->had_children[js->depth] = false;
+	js->depth++;
+
+	return 0;
+}
+
+void util_json_stream_end(struct util_json_stream *js)
+{
+	int i;
+
+	if (!js->depth)
+		return;
+	js->depth--;
+	if (js->had_children[js->depth])
+		fputc('\n', js->f);
+	for (i = 0; i < js->depth; i++)
+		fputs("  ", js->f);
+	fputc(js->array[js->depth] ? ']' : '}', js->f);
+}
+
+void util_json_stream_close_to(struct util_json_stream *js, int depth)
+{
+	while (js->depth > depth)
+		util_json_stream_end(js);
+}
+
+void util_json_stream_members(struct util_json_stream *js,
+		struct json_object *jobj)
+{
+	json_object_iter iter;
+
+	json_object_object_foreachC(jobj, iter)
+		util_json_stream_value(js, iter.key, iter.val);
+}
+
+/* Scalars keep their json-c serializer, e.g. display_size() */
+void util_json_stream_value(struct util_json_stream *js, const char *key,
+		struct json_object *jobj)
+{
+	int i, n;
+
+	switch (json_object_get_type(jobj)) {
+	case json_type_object:
+		if (util_json_stream_begin(js, key, false))
+			return;
+		util_json_stream_members(js, jobj);
+		util_json_stream_end(js);
+		break;
+	case json_type_array:
+		if (util_json_stream_begin(js, key, true))
+			return;
+		n = json_object_array_length(jobj);
+		for (i = 0; i < n; i++)
+			util_json_stream_value(js, NULL,
+					json_object_array_get_idx(jobj, i));
+		util_json_stream_end(js);
+		break;
+	default:
+		util_json_stream_item(js, key);
+		fputs(json_object_to_json_string_ext(jobj,
+					JSON_C_TO_STRING_PRETTY), js->f);
+		break;
+	}
+}
+
 /* bit_array must be of 8 32 bit ints */
 static struct json_object *util_bitmask_to_string(uint32_t *bit_array)
 {
@@ -519,3 +616,71 @@ err:
 	json_object_put(jaccfg);
 	return NULL;
 }
+
+struct json_object *util_group_to_json(struct accfg_group *group,
+				      uint64_t flags)
+{
+	struct json_object *jgroup = json_object_new_object();
+	struct json_object *jobj = NULL;
+	int dpl, gpl;
+
+	if (!jgroup)
+		return NULL;
+
+	jobj = json_object_new_string(accfg_group_get_devname(group));
+	if (!jobj)
+		goto err;
+
+	json_object_object_add(jgroup, "dev", jobj);
+	jobj = json_object_new_int(accfg_group_get_read_buffers_reserved(group));
+	if (!jobj)
+		goto err;
+
+	json_object_object_add(jgroup, "read_buffers_reserved", jobj);
+	jobj = json_object_new_int(accfg_group_get_use_read_buffer_limit(group));
+	if (!jobj)
+		goto err;
+
+	json_object_object_add(jgroup, "use_read_buffer_limit", jobj);
+	jobj = json_object_new_int(accfg_group_get_read_buffers_allowed(group));
+	if (!jobj)
+		goto err;
+
+	json_object_object_add(jgroup, "read_buffers_allowed", jobj);
+	jobj = json_object_new_int(accfg_group_get_traffic_class_a(
+				group));
+	if (!jobj)
+		goto err;
+
+	json_object_object_add(jgroup, "traffic_class_a", jobj);
+	jobj = json_object_new_int(accfg_group_get_traffic_class_b(
+				group));
+	if (!jobj)
+		goto err;
+
+	json_object_object_add(jgroup, "traffic_class_b", jobj);
+
+	dpl = accfg_group_get_desc_progress_limit(group);
+	if (dpl >= 0) {
+		jobj = json_object_new_int(dpl);
+		if (!jobj)
+			goto err;
+
+		json_object_object_add(jgroup, "desc_progress_limit", jobj);
+	}
+
+	gpl = accfg_group_get_batch_progress_limit(group);
+	if (gpl >= 0) {
+		jobj = json_object_new_int(gpl);
+		if (!jobj)
+			goto err;
+
+		json_object_object_add(jgroup, "batch_progress_limit", jobj);
+	}
+
+	return jgroup;
+
+err:
+	json_object_put(jgroup);
+	return NULL;
+}
@@ -23,8 +23,33 @@ struct json_object *util_wq_to_json(struct accfg_wq *accfg_wq,
 		uint64_t flags);
 struct json_object *util_engine_to_json(struct accfg_engine *accfg_engine,
 		uint64_t flags);
+struct json_object *util_group_to_json(struct accfg_group *group,
+		uint64_t flags);
 struct json_object *util_json_object_size(uint64_t size,
 		uint64_t flags);
 struct json_object *util_json_object_hex(uint64_t val,
 		uint64_t flags);
+
+/*
+ * Writes json incrementally in the layout of JSON_C_TO_STRING_PRETTY so
+ * that a listing does not need to be built as one json-c tree first.
+ */
+#define UTIL_JSON_STREAM_DEPTH	8
+
+struct util_json_stream {
+	FILE *f;
+	int depth;
+	bool array[UTIL_JSON_STREAM_DEPTH];
+	bool had_children[UTIL_JSON_STREAM_DEPTH];
+};
+
+void util_json_stream_init(struct util_json_stream *js, FILE *f);
+int util_json_stream_begin(struct util_json_stream *js, const char *key,
+		bool array);
+void util_json_stream_end(struct util_json_stream *js);
+void util_json_stream_close_to(struct util_json_stream *js, int depth);
+void util_json_stream_value(struct util_json_stream *js, const char *key,
+		struct json_object *jobj);
+void util_json_stream_members(struct util_json_stream *js,
+		struct json_object *jobj);
 #endif /* __ACCFG_JSON_H__ */
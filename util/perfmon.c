@@ -0,0 +1,582 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright(c) 2019 Intel Corporation. All rights reserved.
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <linux/limits.h>
+#include <util/perfmon.h>
+
+#define PERFMON_SYSFS		"/sys/bus/event_source/devices"
+#define PERFMON_ENGINE_BOUND	90.0
+#define PERFMON_ATC_BOUND	10.0
+
+/*
+ * Default encodings from the DSA perfmon event tables. Parts that differ
+ * can override them with perfmon_set_event().
+ */
+static const struct perfmon_event perfmon_default_events[PERFMON_EV_MAX] = {
+	[PERFMON_EV_CYCLES] = { "cycles", 0x1, 0x01, 0 },
+	[PERFMON_EV_ENG_BUSY] = { "engine_busy", 0x1, 0x02, 1 },
+	[PERFMON_EV_DESCS] = { "descs_completed", 0x1, 0x04, 1 },
+	[PERFMON_EV_RD_BYTES] = { "bytes_read", 0x3, 0x01, 0 },
+	[PERFMON_EV_WR_BYTES] = { "bytes_written", 0x3, 0x02, 0 },
+	[PERFMON_EV_ATC_LOOKUPS] = { "atc_lookups", 0x2, 0x01, 0 },
+	[PERFMON_EV_ATC_MISSES] = { "atc_misses", 0x2, 0x02, 0 },
+};
+
+/* Field layout used when the PMU has no format directory */
+static const struct perfmon_format {
+	const char *name;
+	int config1;
+	unsigned int shift;
+	unsigned int width;
+} perfmon_formats[] = {
+	{ "event_category", 0, 0, 4 },
+	{ "event", 0, 4, 28 },
+	{ "filter_wq", 1, 0, 32 },
+	{ "filter_tc", 1, 32, 8 },
+	{ "filter_pgsz", 1, 40, 4 },
+	{ "filter_sz", 1, 44, 8 },
+	{ "filter_eng", 1, 52, 8 },
+};
+
+enum {
+	PERFMON_FMT_CATEGORY,
+	PERFMON_FMT_EVENT,
+	PERFMON_FMT_WQ,
+	PERFMON_FMT_TC,
+	PERFMON_FMT_PGSZ,
+	PERFMON_FMT_SZ,
+	PERFMON_FMT_ENG,
+};
+
+static uint64_t perfmon_clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int perfmon_read_sysfs(const char *pmu, const char *attr, char *buf,
+		size_t size)
+{
+	char path[PATH_MAX];
+	FILE *f;
+	int rc = 0;
+
+	snprintf(path, sizeof(path), PERFMON_SYSFS "/%s/%s", pmu, attr);
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	if (!fgets(buf, size, f))
+		rc = -EIO;
+	fclose(f);
+
+	return rc;
+}
+
+/* Places val into config[0] or config[1] as described by format/<name> */
+static void perfmon_set_field(const char *pmu, unsigned int idx,
+		uint64_t val, uint64_t *config)
+{
+	const struct perfmon_format *fmt = &perfmon_formats[idx];
+	unsigned int lo = fmt->shift, hi = fmt->shift + fmt->width - 1;
+	int word = fmt->config1;
+	char buf[64], attr[64];
+	uint64_t mask;
+
+	snprintf(attr, sizeof(attr), "format/%s", fmt->name);
+	if (!perfmon_read_sysfs(pmu, attr, buf, sizeof(buf))) {
+		word = !strncmp(buf, "config1:", 8);
+		if (sscanf(strchr(buf, ':') ? strchr(buf, ':') + 1 : buf,
+					"%u-%u", &lo, &hi) == 1)
+			hi = lo;
+	}
+
+	mask = hi - lo >= 63 ? ~0ULL : ((1ULL << (hi - lo + 1)) - 1);
+	config[word] |= (val & mask) << lo;
+}
+
+static int perfmon_perf_open(struct perfmon *pm, struct perfmon_counter *c)
+{
+	const struct perfmon_event *ev = &pm->events[c->id];
+	struct perf_event_attr attr;
+	uint64_t config[2] = { 0, 0 };
+	char buf[64];
+	int type, cpu;
+
+	if (perfmon_read_sysfs(pm->pmu, "type", buf, sizeof(buf)))
+		return -ENODEV;
+	type = atoi(buf);
+	cpu = perfmon_read_sysfs(pm->pmu, "cpumask", buf, sizeof(buf)) ?
+		0 : atoi(buf);
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+		PERF_FORMAT_TOTAL_TIME_RUNNING;
+	perfmon_set_field(pm->pmu, PERFMON_FMT_CATEGORY, ev->category, config);
+	perfmon_set_field(pm->pmu, PERFMON_FMT_EVENT, ev->event, config);
+	perfmon_set_field(pm->pmu, PERFMON_FMT_WQ, ~0ULL, config);
+	perfmon_set_field(pm->pmu, PERFMON_FMT_TC, ~0ULL, config);
+	perfmon_set_field(pm->pmu, PERFMON_FMT_PGSZ, ~0ULL, config);
+	perfmon_set_field(pm->pmu, PERFMON_FMT_SZ, ~0ULL, config);
+	perfmon_set_field(pm->pmu, PERFMON_FMT_ENG,
+			c->engine < 0 ? ~0ULL : 1ULL << c->engine, config);
+	attr.config = config[0];
+	attr.config1 = config[1];
+
+	c->fd = syscall(__NR_perf_event_open, &attr, -1, cpu, -1, 0);
+	if (c->fd < 0)
+		return -errno;
+
+	return 0;
+}
+
+/* Scales the count when the PMU had to multiplex the counters */
+static int perfmon_perf_read(struct perfmon *pm, struct perfmon_counter *c,
+		int end, uint64_t *val)
+{
+	uint64_t data[3];
+
+	if (read(c->fd, data, sizeof(data)) != sizeof(data))
+		return -EIO;
+
+	*val = data[0];
+	if (data[2] && data[2] < data[1])
+		*val = (uint64_t)((double)data[0] * data[1] / data[2]);
+
+	return 0;
+}
+
+static void perfmon_perf_close(struct perfmon *pm, struct perfmon_counter *c)
+{
+	if (c->fd >= 0)
+		close(c->fd);
+	c->fd = -1;
+}
+
+static uint64_t perfmon_perf_now(struct perfmon *pm, int end)
+{
+	return perfmon_clock_ns();
+}
+
+const struct perfmon_ops perfmon_perf_ops = {
+	.open = perfmon_perf_open,
+	.read = perfmon_perf_read,
+	.close = perfmon_perf_close,
+	.now_ns = perfmon_perf_now,
+};
+
+struct perfmon_replay_rec {
+	char name[PERFMON_NAME_LEN];
+	int engine;
+	uint64_t start;
+	uint64_t end;
+};
+
+struct perfmon_replay {
+	unsigned int num;
+	unsigned int alloc;
+	struct perfmon_replay_rec *recs;
+};
+
+static struct perfmon_replay_rec *perfmon_replay_find(
+		struct perfmon_replay *replay, const char *name, int engine)
+{
+	unsigned int i;
+
+	for (i = 0; replay && i < replay->num; i++)
+		if (!strcmp(replay->recs[i].name, name) &&
+				replay->recs[i].engine == engine)
+			return &replay->recs[i];
+
+	return NULL;
+}
+
+int perfmon_replay_add(struct perfmon_replay **replay, const char *name,
+		int engine, uint64_t start, uint64_t end)
+{
+	struct perfmon_replay *r = *replay;
+	struct perfmon_replay_rec *rec;
+
+	if (!r) {
+		r = calloc(1, sizeof(*r));
+		if (!r)
+			return -ENOMEM;
+		*replay = r;
+	}
+
+	if (r->num == r->alloc) {
+		unsigned int alloc = r->alloc ? r->alloc * 2 : 16;
+
+		rec = realloc(r->recs, alloc * sizeof(*rec));
+		if (!rec)
+			return -ENOMEM;
+		r->recs = rec;
+		r->alloc = alloc;
+	}
+
+	rec = &r->recs[r->num++];
+	snprintf(rec->name, sizeof(rec->name), "%s", name);
+	rec->engine = engine;
+	rec->start = start;
+	rec->end = end;
+
+	return 0;
+}
+
+/*
+ * Loads a recording written by perfmon_record(). Each line holds an event
+ * name, the engine or '-', and the counter values at start and end. The
+ * "time" event holds the timestamps in ns.
+ */
+int perfmon_replay_load(const char *path, struct perfmon_replay **replay)
+{
+	char line[256], name[PERFMON_NAME_LEN], eng[16];
+	unsigned long long start, end;
+	FILE *f;
+	int rc = 0;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%31s %15s %llu %llu", name, eng, &start,
+					&end) != 4) {
+			rc = -EINVAL;
+			break;
+		}
+		rc = perfmon_replay_add(replay, name,
+				eng[0] == '-' ? -1 : atoi(eng), start, end);
+		if (rc)
+			break;
+	}
+
+	fclose(f);
+	if (rc) {
+		perfmon_replay_free(*replay);
+		*replay = NULL;
+	}
+
+	return rc;
+}
+
+unsigned int perfmon_replay_engines(struct perfmon_replay *replay)
+{
+	unsigned int i, num = 0;
+
+	for (i = 0; replay && i < replay->num; i++)
+		if (replay->recs[i].engine >= (int)num)
+			num = replay->recs[i].engine + 1;
+
+	return num;
+}
+
+void perfmon_replay_free(struct perfmon_replay *replay)
+{
+	if (!replay)
+		return;
+	free(replay->recs);
+	free(replay);
+}
+
+static int perfmon_replay_open(struct perfmon *pm, struct perfmon_counter *c)
+{
+	if (!perfmon_replay_find(pm->priv, pm->events[c->id].name, c->engine))
+		return -ENOENT;
+
+	return 0;
+}
+
+static int perfmon_replay_read(struct perfmon *pm, struct perfmon_counter *c,
+		int end, uint64_t *val)
+{
+	struct perfmon_replay_rec *rec;
+
+	rec = perfmon_replay_find(pm->priv, pm->events[c->id].name, c->engine);
+	if (!rec)
+		return -ENOENT;
+	*val = end ? rec->end : rec->start;
+
+	return 0;
+}
+
+static void perfmon_replay_close(struct perfmon *pm,
+		struct perfmon_counter *c)
+{
+}
+
+static uint64_t perfmon_replay_now(struct perfmon *pm, int end)
+{
+	struct perfmon_replay_rec *rec;
+
+	rec = perfmon_replay_find(pm->priv, "time", -1);
+	if (!rec)
+		return end ? 1000000000ULL : 0;
+
+	return end ? rec->end : rec->start;
+}
+
+const struct perfmon_ops perfmon_replay_ops = {
+	.open = perfmon_replay_open,
+	.read = perfmon_replay_read,
+	.close = perfmon_replay_close,
+	.now_ns = perfmon_replay_now,
+};
+
+int perfmon_init(struct perfmon *pm, const char *pmu,
+		unsigned int num_engines, const struct perfmon_ops *ops,
+		void *priv)
+{
+	unsigned int i, n = 0;
+	int e;
+
+	memset(pm, 0, sizeof(*pm));
+	snprintf(pm->pmu, sizeof(pm->pmu), "%s", pmu);
+	if (num_engines > PERFMON_MAX_ENGINES)
+		num_engines = PERFMON_MAX_ENGINES;
+	pm->num_engines = num_engines;
+	pm->ops = ops;
+	pm->priv = priv;
+	memcpy(pm->events, perfmon_default_events, sizeof(pm->events));
+
+	for (i = 0; i < PERFMON_EV_MAX; i++)
+		pm->num_counters += pm->events[i].per_engine ? num_engines : 1;
+
+	pm->counters = calloc(pm->num_counters, sizeof(*pm->counters));
+	if (!pm->counters)
+		return -ENOMEM;
+
+	for (i = 0; i < PERFMON_EV_MAX; i++) {
+		for (e = pm->events[i].per_engine ? 0 : -1;
+				e < (pm->events[i].per_engine ?
+					(int)num_engines : 0); e++) {
+			pm->counters[n].id = i;
+			pm->counters[n].engine = e;
+			pm->counters[n].fd = -1;
+			n++;
+		}
+	}
+
+	return 0;
+}
+
+/* Overrides an event encoding with a "name=category:event" spec */
+int perfmon_set_event(struct perfmon *pm, const char *spec)
+{
+	const char *eq = strchr(spec, '=');
+	unsigned int i;
+	char *end;
+	unsigned long cat, ev;
+
+	if (!eq)
+		return -EINVAL;
+
+	cat = strtoul(eq + 1, &end, 0);
+	if (*end != ':')
+		return -EINVAL;
+	ev = strtoul(end + 1, &end, 0);
+	if (*end)
+		return -EINVAL;
+
+	for (i = 0; i < PERFMON_EV_MAX; i++) {
+		if (strlen(pm->events[i].name) != (size_t)(eq - spec) ||
+				strncmp(pm->events[i].name, spec, eq - spec))
+			continue;
+		pm->events[i].category = cat;
+		pm->events[i].event = ev;
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+int perfmon_start(struct perfmon *pm)
+{
+	unsigned int i, valid = 0;
+	struct perfmon_counter *c;
+
+	for (i = 0; i < pm->num_counters; i++) {
+		c = &pm->counters[i];
+		c->valid = 0;
+		if (pm->ops->open(pm, c))
+			continue;
+		if (pm->ops->read(pm, c, 0, &c->start)) {
+			pm->ops->close(pm, c);
+			continue;
+		}
+		c->valid = 1;
+		valid++;
+	}
+	pm->start_ns = pm->ops->now_ns(pm, 0);
+
+	return valid ? 0 : -ENODEV;
+}
+
+int perfmon_stop(struct perfmon *pm)
+{
+	unsigned int i;
+	struct perfmon_counter *c;
+
+	pm->end_ns = pm->ops->now_ns(pm, 1);
+	for (i = 0; i < pm->num_counters; i++) {
+		c = &pm->counters[i];
+		if (!c->valid)
+			continue;
+		if (pm->ops->read(pm, c, 1, &c->end))
+			c->valid = 0;
+		pm->ops->close(pm, c);
+	}
+
+	return 0;
+}
+
+/* Returns the counted delta or -1 when the counter is not available */
+static double perfmon_delta(struct perfmon *pm, enum perfmon_event_id id,
+		int engine)
+{
+	unsigned int i;
+	struct perfmon_counter *c;
+
+	for (i = 0; i < pm->num_counters; i++) {
+		c = &pm->counters[i];
+		if (c->id != id || c->engine != engine)
+			continue;
+		if (!c->valid || c->end < c->start)
+			return -1;
+		return (double)(c->end - c->start);
+	}
+
+	return -1;
+}
+
+static double perfmon_rate(double count, double secs, double scale)
+{
+	if (count < 0 || secs <= 0)
+		return -1;
+
+	return count / secs / scale;
+}
+
+void perfmon_compute(struct perfmon *pm, struct perfmon_report *r)
+{
+	double cycles, busy, lookups, misses, util_max = -1;
+	unsigned int e;
+
+	memset(r, 0, sizeof(*r));
+	r->secs = pm->end_ns > pm->start_ns ?
+		(pm->end_ns - pm->start_ns) / 1e9 : 0;
+	r->num_engines = pm->num_engines;
+
+	cycles = perfmon_delta(pm, PERFMON_EV_CYCLES, -1);
+	for (e = 0; e < pm->num_engines; e++) {
+		busy = perfmon_delta(pm, PERFMON_EV_ENG_BUSY, e);
+		r->eng_util[e] = cycles > 0 && busy >= 0 ?
+			100.0 * busy / cycles : -1;
+		if (r->eng_util[e] > util_max)
+			util_max = r->eng_util[e];
+		r->eng_descs[e] = perfmon_rate(perfmon_delta(pm,
+					PERFMON_EV_DESCS, e), r->secs, 1);
+	}
+
+	r->rd_mbps = perfmon_rate(perfmon_delta(pm, PERFMON_EV_RD_BYTES, -1),
+			r->secs, 1e6);
+	r->wr_mbps = perfmon_rate(perfmon_delta(pm, PERFMON_EV_WR_BYTES, -1),
+			r->secs, 1e6);
+
+	lookups = perfmon_delta(pm, PERFMON_EV_ATC_LOOKUPS, -1);
+	misses = perfmon_delta(pm, PERFMON_EV_ATC_MISSES, -1);
+	r->atc_miss_pct = lookups > 0 && misses >= 0 ?
+		100.0 * misses / lookups : -1;
+	r->atc_miss_rate = perfmon_rate(misses, r->secs, 1);
+
+	/*
+	 * Engines waiting on translations also count as busy, so a high
+	 * miss ratio takes precedence over a high utilisation.
+	 */
+	if (r->atc_miss_pct >= PERFMON_ATC_BOUND)
+		r->bound = "translation";
+	else if (util_max >= PERFMON_ENGINE_BOUND)
+		r->bound = "engine";
+	else if (util_max < 0 && r->atc_miss_pct < 0)
+		r->bound = "unknown";
+	else
+		r->bound = "neither";
+}
+
+static void perfmon_print_val(FILE *f, const char *fmt, double val)
+{
+	if (val < 0)
+		fprintf(f, "n/a");
+	else
+		fprintf(f, fmt, val);
+}
+
+void perfmon_print(struct perfmon_report *r, const char *pmu, FILE *f)
+{
+	unsigned int e;
+
+	fprintf(f, "%s perfmon over %.3f s\n", pmu, r->secs);
+	for (e = 0; e < r->num_engines; e++) {
+		fprintf(f, "  engine %u: busy ", e);
+		perfmon_print_val(f, "%.1f%%", r->eng_util[e]);
+		fprintf(f, ", descs/s ");
+		perfmon_print_val(f, "%.0f", r->eng_descs[e]);
+		fprintf(f, "\n");
+	}
+	fprintf(f, "  read MB/s ");
+	perfmon_print_val(f, "%.1f", r->rd_mbps);
+	fprintf(f, ", write MB/s ");
+	perfmon_print_val(f, "%.1f", r->wr_mbps);
+	fprintf(f, "\n  ATC miss ratio ");
+	perfmon_print_val(f, "%.1f%%", r->atc_miss_pct);
+	fprintf(f, ", misses/s ");
+	perfmon_print_val(f, "%.0f", r->atc_miss_rate);
+	fprintf(f, "\n  bound: %s\n", r->bound);
+}
+
+/* Writes the counters in the format read by perfmon_replay_load() */
+void perfmon_record(struct perfmon *pm, FILE *f)
+{
+	struct perfmon_counter *c;
+	unsigned int i;
+
+	fprintf(f, "# %s\ntime - %llu %llu\n", pm->pmu,
+			(unsigned long long)pm->start_ns,
+			(unsigned long long)pm->end_ns);
+	for (i = 0; i < pm->num_counters; i++) {
+		c = &pm->counters[i];
+		if (!c->valid)
+			continue;
+		if (c->engine < 0)
+			fprintf(f, "%s - ", pm->events[c->id].name);
+		else
+			fprintf(f, "%s %d ", pm->events[c->id].name,
+					c->engine);
+		fprintf(f, "%llu %llu\n", (unsigned long long)c->start,
+				(unsigned long long)c->end);
+	}
+}
+
+void perfmon_free(struct perfmon *pm)
+{
+	unsigned int i;
+
+	for (i = 0; pm->counters && i < pm->num_counters; i++)
+		if (pm->counters[i].fd >= 0)
+			pm->ops->close(pm, &pm->counters[i]);
+	free(pm->counters);
+	pm->counters = NULL;
+}
@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+
+#ifndef _ACCFG_PERFMON_H_
+#define _ACCFG_PERFMON_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define PERFMON_MAX_ENGINES	16
+#define PERFMON_NAME_LEN	32
+
+enum perfmon_event_id {
+	PERFMON_EV_CYCLES,
+	PERFMON_EV_ENG_BUSY,
+	PERFMON_EV_DESCS,
+	PERFMON_EV_RD_BYTES,
+	PERFMON_EV_WR_BYTES,
+	PERFMON_EV_ATC_LOOKUPS,
+	PERFMON_EV_ATC_MISSES,
+	PERFMON_EV_MAX,
+};
+
+struct perfmon_event {
+	const char *name;
+	unsigned int category;
+	unsigned int event;
+	int per_engine;
+};
+
+/* One counter, engine is -1 for events counted over the whole device */
+struct perfmon_counter {
+	enum perfmon_event_id id;
+	int engine;
+	int fd;
+	int valid;
+	uint64_t start;
+	uint64_t end;
+};
+
+struct perfmon;
+
+/*
+ * Counter source. The perf source opens the idxd PMU with perf_event_open(),
+ * the replay source returns values recorded by perfmon_record() so that the
+ * reporting can be checked without hardware.
+ */
+struct perfmon_ops {
+	int (*open)(struct perfmon *pm, struct perfmon_counter *c);
+	int (*read)(struct perfmon *pm, struct perfmon_counter *c, int end,
+			uint64_t *val);
+	void (*close)(struct perfmon *pm, struct perfmon_counter *c);
+	uint64_t (*now_ns)(struct perfmon *pm, int end);
+};
+
+struct perfmon {
+	char pmu[PERFMON_NAME_LEN];
+	unsigned int num_engines;
+	const struct perfmon_ops *ops;
+	void *priv;
+	struct perfmon_event events[PERFMON_EV_MAX];
+	struct perfmon_counter *counters;
+	unsigned int num_counters;
+	uint64_t start_ns;
+	uint64_t end_ns;
+};
+
+struct perfmon_report {
+	double secs;
+	unsigned int num_engines;
+	double eng_util[PERFMON_MAX_ENGINES];
+	double eng_descs[PERFMON_MAX_ENGINES];
+	double rd_mbps;
+	double wr_mbps;
+	double atc_miss_pct;
+	double atc_miss_rate;
+	const char *bound;
+};
+
+extern const struct perfmon_ops perfmon_perf_ops;
+extern const struct perfmon_ops perfmon_replay_ops;
+
+int perfmon_init(struct perfmon *pm, const char *pmu,
+		unsigned int num_engines, const struct perfmon_ops *ops,
+		void *priv);
+int perfmon_set_event(struct perfmon *pm, const char *spec);
+int perfmon_start(struct perfmon *pm);
+int perfmon_stop(struct perfmon *pm);
+void perfmon_compute(struct perfmon *pm, struct perfmon_report *r);
+void perfmon_print(struct perfmon_report *r, const char *pmu, FILE *f);
+void perfmon_record(struct perfmon *pm, FILE *f);
+void perfmon_free(struct perfmon *pm);
+
+struct perfmon_replay;
+int perfmon_replay_load(const char *path, struct perfmon_replay **replay);
+int perfmon_replay_add(struct perfmon_replay **replay, const char *name,
+		int engine, uint64_t start, uint64_t end);
+unsigned int perfmon_replay_engines(struct perfmon_replay *replay);
+void perfmon_replay_free(struct perfmon_replay *replay);
+
+#endif /* _ACCFG_PERFMON_H_ */
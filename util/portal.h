@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/* Copyright(c) 2019 Intel Corporation. All rights reserved. */
+
+#ifndef __UTIL_PORTAL_H__
+#define __UTIL_PORTAL_H__
+
+#include <stdint.h>
+
+/* ecx is often an input as well as an output */
+static inline void cpuid(unsigned int *eax, unsigned int *ebx,
+		unsigned int *ecx, unsigned int *edx)
+{
+	asm volatile("cpuid"
+		: "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+		: "0" (*eax), "2" (*ecx)
+		: "memory");
+}
+
+static inline void movdir64b(volatile void *portal, void *desc)
+{
+	asm volatile("sfence\t\n"
+			".byte 0x66, 0x0f, 0x38, 0xf8, 0x02\t\n"
+			: : "a" (portal), "d" (desc));
+}
+
+/* Returns non-zero when the shared wq did not accept the descriptor */
+static inline unsigned char enqcmd(volatile void *portal, void *desc)
+{
+	unsigned char retry;
+
+	asm volatile("sfence\t\n"
+			".byte 0xf2, 0x0f, 0x38, 0xf8, 0x02\t\n"
+			"setz %0\t\n"
+			: "=r" (retry) : "a" (portal), "d" (desc));
+	return retry;
+}
+
+static inline uint64_t rdtsc(void)
+{
+	uint32_t a, d;
+
+	asm volatile("rdtsc" : "=a" (a), "=d" (d));
+	return ((uint64_t)d << 32) | a;
+}
+
+static inline void umonitor(volatile void *addr)
+{
+	asm volatile(".byte 0xf3, 0x48, 0x0f, 0xae, 0xf0" : : "a" (addr));
+}
+
+/* Returns non-zero when the wait ended on the TSC deadline */
+static inline unsigned char umwait(uint64_t deadline, unsigned int state)
+{
+	unsigned char r;
+
+	asm volatile(".byte 0xf2, 0x48, 0x0f, 0xae, 0xf1\t\n"
+			"setc %0\t\n"
+			: "=r" (r) : "c" (state), "a" ((uint32_t)deadline),
+			"d" ((uint32_t)(deadline >> 32)));
+	return r;
+}
+
+#endif /* __UTIL_PORTAL_H__ */